@@ -0,0 +1,616 @@
+//Throughput of the alert pipeline on the host: the camera's line ISR per
+//format, capture conversion, JPEG encode, radar and getUpdates parsing, Telegram request construction and
+//whole requests against a local stand-in for api.telegram.org.
+//
+//  pipeline_bench [--filter text] [--min-time-ms n] [--out file.json]
+//                 [--baseline file.json] [--tolerance percent]
+//
+//Every case is calibrated to run at least min-time, then repeated; the
+//median is reported, with the heap calls per operation over all repetitions.
+//The results go out as JSON, one benchmark per line.
+//With --baseline, a case slower than the baseline by more than tolerance
+//percent is reported on stderr and the exit code is 2; a case that fails
+//its own check makes it 1.
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "BMP.h"
+#include "bmp_to_jpg.h"
+#include "jpeg_encoder.h"
+#include "LD2420.h"
+#include "OV7670.h"
+#include "RequestBuffer.h"
+#include "send_text.h"
+#include "send_media_group.h"
+#include "send_photobmp.h"
+#include "TelegramCommands.h"
+#include "allocations.h"
+
+const char* BOT_TOKEN = "123456789:host-benchmark-token";
+const char* CHAT_ID = "123456789";
+const char* TELEGRAM_CERTIFICATE_ROOT = "";
+WiFiClientSecure secureClient;
+
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE ""
+#endif
+
+//---------------------------------------------------------------- harness
+
+struct Result
+{
+  std::string name;
+  uint64_t iterations;
+  double nsPerOp;
+  double bytesPerOp;
+  double allocsPerOp;
+  bool ok;
+};
+
+static std::vector<Result> results;
+static const char* filter = "";
+static double minTimeNs = 300e6;
+static const int REPETITIONS = 5;
+
+//op() runs one operation and returns false if its result is wrong; items
+//divides the time when one call handles several (lines, messages)
+template<typename F> static void measure(const std::string& name, double bytesPerOp, int items, F op)
+{
+  if(!strstr(name.c_str(), filter))
+    return;
+  typedef std::chrono::steady_clock Clock;
+  bool ok = op();
+  uint64_t n = 1;
+  for(;;)
+  {
+    Clock::time_point start = Clock::now();
+    for(uint64_t i = 0; i < n; i++)
+      ok = op() && ok;
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if(ns >= minTimeNs / REPETITIONS || n >= (1ULL << 40))
+      break;
+    n = ns < 1000 ? n * 100 : std::max(n + 1, (uint64_t)(n * (minTimeNs / REPETITIONS) / ns * 1.2));
+  }
+  std::vector<double> times;
+  times.reserve(REPETITIONS);
+  uint64_t allocated = allocations();
+  for(int r = 0; r < REPETITIONS; r++)
+  {
+    Clock::time_point start = Clock::now();
+    for(uint64_t i = 0; i < n; i++)
+      ok = op() && ok;
+    times.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n / items);
+  }
+  allocated = allocations() - allocated;
+  std::sort(times.begin(), times.end());
+  Result r = { name, n * REPETITIONS * items, times[REPETITIONS / 2], bytesPerOp / items,
+               (double)allocated / (n * REPETITIONS * items), ok };
+  results.push_back(r);
+  fprintf(stderr, "%-40s %12.1f ns/op %10.2f MB/s %8.2f allocs/op%s\n", name.c_str(), r.nsPerOp,
+          r.bytesPerOp ? r.bytesPerOp * 1e3 / r.nsPerOp : 0.0, r.allocsPerOp, ok ? "" : "  FAILED");
+}
+
+static void writeJson(FILE* out)
+{
+  fprintf(out, "{\n  \"context\": {\"compiler\": \"%s\", \"build_type\": \"%s\", \"min_time_ms\": %.0f, \"repetitions\": %d},\n",
+          __VERSION__, BENCH_BUILD_TYPE, minTimeNs / 1e6, REPETITIONS);
+  fprintf(out, "  \"benchmarks\": [\n");
+  for(size_t i = 0; i < results.size(); i++)
+  {
+    const Result& r = results[i];
+    fprintf(out, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"bytes_per_op\": %.0f, \"mb_per_s\": %.3f, \"allocs_per_op\": %.3f, \"ok\": %s}%s\n",
+            r.name.c_str(), (unsigned long long)r.iterations, r.nsPerOp, r.bytesPerOp,
+            r.bytesPerOp ? r.bytesPerOp * 1e3 / r.nsPerOp : 0.0, r.allocsPerOp, r.ok ? "true" : "false", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+//the cases of a file written by writeJson() that are more than tolerance
+//percent slower now
+static int compareBaseline(const char* path, double tolerance)
+{
+  FILE* f = fopen(path, "r");
+  if(!f)
+  {
+    fprintf(stderr, "cannot read baseline %s\n", path);
+    return -1;
+  }
+  int regressions = 0;
+  char line[512];
+  while(fgets(line, sizeof(line), f))
+  {
+    char name[128];
+    const char* ns = strstr(line, "\"ns_per_op\": ");
+    if(sscanf(line, " {\"name\": \"%127[^\"]\"", name) != 1 || !ns)
+      continue;
+    double before = atof(ns + 13);
+    for(const Result& r : results)
+      if(r.name == name && before > 0 && r.nsPerOp > before * (1 + tolerance / 100))
+      {
+        fprintf(stderr, "REGRESSION %s: %.1f -> %.1f ns/op (%+.1f%%)\n", name, before, r.nsPerOp, (r.nsPerOp / before - 1) * 100);
+        regressions++;
+      }
+  }
+  fclose(f);
+  return regressions;
+}
+
+//---------------------------------------------------------------- inputs
+
+//a deterministic scene: gradient, a bright block and sensor noise
+static std::vector<uint8_t> luma(int width, int height)
+{
+  std::vector<uint8_t> y(width * height);
+  uint32_t seed = 12345;
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      seed = seed * 1664525 + 1013904223;
+      int v = (i * 160 / width) + (j * 64 / height) + (int)(seed >> 29);
+      if(i > width / 3 && i < width / 2 && j > height / 4 && j < height * 3 / 4)
+        v += 60;
+      y[j * width + i] = v > 255 ? 255 : v;
+    }
+  return y;
+}
+
+static std::vector<uint8_t> frame(int width, int height, JpegEncoder::Input input)
+{
+  std::vector<uint8_t> y = luma(width, height);
+  if(input == JpegEncoder::GRAY8)
+    return y;
+  std::vector<uint8_t> out(width * height * 2);
+  for(int p = 0; p < width * height; p++)
+  {
+    int v = y[p];
+    if(input == JpegEncoder::RGB565)
+    {
+      //little endian, as the ISR stores it
+      uint16_t c = ((v >> 3) << 11) | ((v >> 2) << 5) | ((255 - v) >> 3);
+      out[p * 2] = c & 0xff;
+      out[p * 2 + 1] = c >> 8;
+    }
+    else
+    {
+      //U Y V Y
+      out[p * 2] = (p & 1) ? 128 + (v >> 3) : 128 - (v >> 3);
+      out[p * 2 + 1] = v;
+    }
+  }
+  return out;
+}
+
+//LD2420 serial input, or anything else read from a Stream
+class MemoryStream : public Stream
+{
+  public:
+  std::string input;
+  size_t position = 0;
+  size_t written = 0;
+
+  void rewind()
+  {
+    position = 0;
+  }
+  int available() override
+  {
+    return input.size() - position;
+  }
+  int read() override
+  {
+    return position < input.size() ? (uint8_t)input[position++] : -1;
+  }
+  int peek() override
+  {
+    return position < input.size() ? (uint8_t)input[position] : -1;
+  }
+  size_t write(uint8_t c) override
+  {
+    written++;
+    return 1;
+  }
+};
+
+//answers every getUpdates request with the next update, keep-alive
+class ScriptedClient : public Client
+{
+  public:
+  uint32_t updateId = 1000;
+  const char* text = "\\/snap";
+  std::string answer;
+  size_t position = 0;
+  bool open = false;
+
+  using Print::write;
+  int connect(const char* host, uint16_t port) override
+  {
+    open = true;
+    return 1;
+  }
+  size_t write(uint8_t c) override
+  {
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override
+  {
+    char body[256];
+    int n = snprintf(body, sizeof(body),
+                     "{\"ok\":true,\"result\":[{\"update_id\":%lu,\"message\":{\"message_id\":7,"
+                     "\"from\":{\"id\":%s,\"is_bot\":false,\"first_name\":\"Bench\"},\"chat\":{\"id\":%s,"
+                     "\"type\":\"private\"},\"date\":%lu,\"text\":\"%s\"}}]}",
+                     (unsigned long)updateId++, CHAT_ID, CHAT_ID, (unsigned long)time(nullptr), text);
+    char head[160];
+    int h = snprintf(head, sizeof(head),
+                     "HTTP/1.1 200 OK\r\nServer: nginx\r\nContent-Type: application/json\r\nContent-Length: %d\r\n"
+                     "Connection: keep-alive\r\n\r\n", n);
+    answer.assign(head, h).append(body, n);
+    position = 0;
+    return size;
+  }
+  int available() override
+  {
+    return answer.size() - position;
+  }
+  int read() override
+  {
+    return position < answer.size() ? (uint8_t)answer[position++] : -1;
+  }
+  int read(uint8_t* buffer, size_t size) override
+  {
+    size_t n = std::min(size, answer.size() - position);
+    memcpy(buffer, answer.data() + position, n);
+    position += n;
+    return n ? (int)n : -1;
+  }
+  int peek() override
+  {
+    return position < answer.size() ? (uint8_t)answer[position] : -1;
+  }
+  void flush() override
+  {
+  }
+  void stop() override
+  {
+    open = false;
+  }
+  uint8_t connected() override
+  {
+    return open;
+  }
+  operator bool() override
+  {
+    return open;
+  }
+};
+
+//api.telegram.org on 127.0.0.1: reads a request up to its Content-Length,
+//answers {"ok":true} and closes, one connection at a time
+class TelegramServer
+{
+  public:
+  uint16_t start()
+  {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(bind(listener, (sockaddr*)&address, sizeof(address)) || listen(listener, 16)
+       || getsockname(listener, (sockaddr*)&address, &length))
+      return 0;
+    thread = std::thread(&TelegramServer::run, this);
+    return ntohs(address.sin_port);
+  }
+
+  void stop()
+  {
+    running = false;
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    if(thread.joinable())
+      thread.join();
+  }
+
+  private:
+  int listener = -1;
+  std::atomic<bool> running{true};
+  std::thread thread;
+
+  void run()
+  {
+    static const char ANSWER[] =
+      "HTTP/1.1 200 OK\r\nServer: nginx\r\nContent-Type: application/json\r\nContent-Length: 57\r\n"
+      "Connection: close\r\n\r\n{\"ok\":true,\"result\":{\"message_id\":1,\"date\":1700000000}}";
+    std::vector<char> request(1 << 20);
+    while(running)
+    {
+      int connection = accept(listener, nullptr, nullptr);
+      if(connection < 0)
+        continue;
+      size_t received = 0;
+      long expected = -1;
+      while(received < request.size())
+      {
+        ssize_t n = recv(connection, request.data() + received, request.size() - received, 0);
+        if(n <= 0)
+          break;
+        received += n;
+        if(expected < 0)
+        {
+          request[received < request.size() ? received : received - 1] = 0;
+          const char* end = strstr(request.data(), "\r\n\r\n");
+          const char* length = strcasestr(request.data(), "Content-Length:");
+          if(end)
+            expected = (end - request.data()) + 4 + (length ? atol(length + 15) : 0);
+        }
+        if(expected >= 0 && (long)received >= expected)
+          break;
+      }
+      send(connection, ANSWER, sizeof(ANSWER) - 1, MSG_NOSIGNAL);
+      close(connection);
+    }
+  }
+};
+
+//---------------------------------------------------------------- cases
+
+static const struct
+{
+  int width;
+  int height;
+} SIZES[] = { { 160, 120 }, { 320, 240 }, { 640, 480 } };
+
+static std::string sizeName(int width, int height)
+{
+  return std::to_string(width) + "x" + std::to_string(height);
+}
+
+static void captureCases()
+{
+  for(const auto& s : SIZES)
+  {
+    std::vector<uint8_t> pixels = frame(s.width, s.height, JpegEncoder::RGB565);
+    size_t bytes = pixels.size();
+    measure("capture/swap_rgb565/" + sizeName(s.width, s.height), bytes, 1, [&]() {
+      swap_rgb565_bytes(pixels.data(), bytes);
+      return true;
+    });
+    measure("capture/flip_rgb565/" + sizeName(s.width, s.height), bytes, 1, [&]() {
+      flipRGB565Vertically(pixels.data(), s.width, s.height);
+      return true;
+    });
+  }
+  //header and pixels in one buffer, as a BMP capture lies in memory
+  std::vector<uint8_t> pixels = frame(160, 120, JpegEncoder::RGB565);
+  std::vector<uint8_t> bmp(54 + pixels.size());
+  memcpy(bmp.data() + 54, pixels.data(), pixels.size());
+  measure("capture/bmp_to_jpeg/160x120", pixels.size(), 1, [&]() {
+    uint8_t header[BMP::headerSize];
+    BMP::construct16BitHeader(header, 160, 120);
+    memcpy(bmp.data(), header, 54);
+    uint8_t* jpeg = nullptr;
+    size_t size = 0;
+    bool ok = convertBMPtoJPEG(bmp.data(), 160, 120, &jpeg, &size, 80);
+    ok = ok && size > 4 && jpeg[0] == 0xff && jpeg[1] == 0xd8;
+    free(jpeg);
+    return ok;
+  });
+}
+
+//the line ISR per format and size, called back to back on the DMA buffers of
+//an emulated capture (stubs/OV7670Sensor.h) like ov7670_fixed_test does; the
+//frame buffer holds VGA, every line is kept
+static void isrCases()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, OV7670::modeBytes(OV7670::VGA_RGB565), 1 },
+  };
+  static const struct
+  {
+    OV7670::Mode smallest;
+    const char* name;
+  } FORMATS[] = { { OV7670::QQQVGA_RGB565, "rgb565" }, { OV7670::QQQVGA_YUV422, "yuv422" }, { OV7670::QQQVGA_Y8, "y8" } };
+  if(!bufferPool.begin(classes, 2))
+    return;
+  OV7670 camera(OV7670::QQVGA_RGB565, 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25, OV7670::VGA_RGB565);
+  for(const auto& f : FORMATS)
+    for(const auto& s : SIZES)
+    {
+      OV7670::Mode mode = f.smallest;
+      while(OV7670::modeXres(mode) < s.width)
+        mode = (OV7670::Mode)(mode + 1);
+      //one captured frame, oneFrame() leaves the interrupt disabled
+      bool ok = camera.setMode(mode) && camera.oneFrame() && camera.maxBandLines() >= s.height;
+      I2SCamera::blocksReceived = 0;
+      I2SCamera::dmaBufferActive = 0;
+      I2SCamera::framePointer = 0;
+      measure(std::string("capture/isr_") + f.name + "/" + sizeName(s.width, s.height), OV7670::modeBytes(mode), s.height, [&]() {
+        int frames = I2SCamera::framesReceived;
+        for(int y = 0; y < s.height; y++)
+          I2SCamera::i2sInterrupt(nullptr);
+        return ok && I2SCamera::framesReceived == frames + 1;
+      });
+    }
+  I2SCamera::dmaBufferDeinit();
+  bufferPool.give(I2SCamera::frame);
+  I2SCamera::frame = nullptr;
+}
+
+static void encodeCases()
+{
+  static const struct
+  {
+    JpegEncoder::Input input;
+    const char* name;
+  } INPUTS[] = { { JpegEncoder::RGB565, "rgb565" }, { JpegEncoder::YUV422, "yuv422" }, { JpegEncoder::GRAY8, "gray8" } };
+  static JpegEncoder encoder;
+  for(const auto& in : INPUTS)
+    for(const auto& s : SIZES)
+    {
+      std::vector<uint8_t> pixels = frame(s.width, s.height, in.input);
+      std::vector<uint8_t> out(pixels.size() + 4096);
+      int lineBytes = pixels.size() / s.height;
+      //stripes of 16 lines bottom up, as banded_capture feeds the bands
+      measure(std::string("encode/jpeg_") + in.name + "/" + sizeName(s.width, s.height), pixels.size(), 1, [&]() {
+        JpegEncoder::Buffer buffer = { out.data(), 0, out.size() };
+        bool ok = encoder.begin(s.width, s.height, 60, JpegEncoder::fixedWriter, &buffer, in.input);
+        for(int y = 0; ok && y < s.height; y += JpegEncoder::STRIPE_ALIGN)
+          ok = encoder.addStripe(pixels.data() + y * lineBytes, std::min(JpegEncoder::STRIPE_ALIGN, s.height - y), true);
+        return ok && encoder.finish() && buffer.size > 600;
+      });
+    }
+}
+
+static void parseCases()
+{
+  static const int LINES = 64;
+  MemoryStream serial;
+  for(int i = 0; i < LINES; i++)
+    serial.input += "Range " + std::to_string(40 + i * 7) + "\r\n";
+  LD2420 radar;
+  bool ok = radar.begin(serial);
+  radar.setUpdateInterval(0);
+  measure("parse/ld2420/range_line", serial.input.size(), LINES, [&]() {
+    serial.rewind();
+    radar.update();
+    return ok && radar.isDataValid() && radar.getDistance() == 40 + (LINES - 1) * 7;
+  });
+
+  ScriptedClient client;
+  Preferences prefs;
+  TelegramCommands commands(client, prefs);
+  commands.begin("api.telegram.org", 443, BOT_TOKEN, CHAT_ID);
+  //one poll sends the request, the next takes the answer
+  measure("parse/getupdates/command", 0, 1, [&]() {
+    TelegramCommands::Command c = commands.poll(millis());
+    if(c == TelegramCommands::NONE)
+      c = commands.poll(millis());
+    return c == TelegramCommands::SNAP;
+  });
+}
+
+static void requestCases()
+{
+  static const char* ALERT =
+    "🚨 Person detected at 2.4 m\nConfidence 87%, motion 3.1% of the frame\n2025-07-22 03:14:07 & still there?";
+  measure("request/build/send_message", 0, 1, []() {
+    telegramRequest.clear();
+    telegramRequest.add("chat_id=");
+    telegramRequest.addFormEncoded(CHAT_ID);
+    telegramRequest.add("&text=");
+    telegramRequest.addFormEncoded(ALERT);
+    telegramRequest.finish(BOT_TOKEN, "sendMessage", "application/x-www-form-urlencoded");
+    return !telegramRequest.overflowed();
+  });
+  measure("request/build/media_group_captions", 0, 1, []() {
+    telegramRequest.clear();
+    telegramRequest.addPartHeader("----bench", "chat_id");
+    telegramRequest.add(CHAT_ID);
+    telegramRequest.add("\r\n");
+    telegramRequest.addPartHeader("----bench", "media");
+    telegramRequest.add("[");
+    for(int i = 0; i < 3; i++)
+    {
+      telegramRequest.add(i ? ",{\"type\":\"photo\",\"caption\":\"" : "{\"type\":\"photo\",\"caption\":\"");
+      telegramRequest.addJsonEscaped(ALERT);
+      telegramRequest.add("\"}");
+    }
+    telegramRequest.add("]");
+    telegramRequest.finish(BOT_TOKEN, "sendMediaGroup", "multipart/form-data; boundary=----bench", 3 * 4000);
+    return !telegramRequest.overflowed();
+  });
+
+  TelegramServer server;
+  uint16_t port = server.start();
+  if(!port)
+  {
+    fprintf(stderr, "no loopback server, request/loopback cases skipped\n");
+    return;
+  }
+  WiFiClient::redirect("127.0.0.1", port);
+
+  std::vector<uint8_t> pixels = frame(160, 120, JpegEncoder::YUV422);
+  JpegEncoder::Buffer jpeg = { nullptr, 0, 0 };
+  JpegEncoder* encoder = new JpegEncoder();
+  encoder->begin(160, 120, 60, JpegEncoder::memoryWriter, &jpeg, JpegEncoder::YUV422);
+  encoder->addStripe(pixels.data(), 120);
+  encoder->finish();
+  delete encoder;
+
+  measure("request/loopback/send_message", 0, 1, []() {
+    return sendTextToTelegram(ALERT);
+  });
+  measure("request/loopback/send_photo", jpeg.size, 1, [&]() {
+    return sendPhotoToTelegram(jpeg.data, jpeg.size);
+  });
+  uint8_t* jpegs[3] = { jpeg.data, jpeg.data, jpeg.data };
+  size_t sizes[3] = { jpeg.size, jpeg.size, jpeg.size };
+  const char* captions[3] = { ALERT, "", nullptr };
+  measure("request/loopback/send_media_group_3", jpeg.size * 3, 1, [&]() {
+    return sendMediaGroupToTelegram(captions, jpegs, sizes, 3);
+  });
+
+  WiFiClient::redirect(nullptr, 0);
+  server.stop();
+  free(jpeg.data);
+}
+
+int main(int argc, char** argv)
+{
+  const char* outPath = nullptr;
+  const char* baseline = nullptr;
+  double tolerance = 10;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    if(i + 1 < argc && a == "--filter")
+      filter = argv[++i];
+    else if(i + 1 < argc && a == "--min-time-ms")
+      minTimeNs = atof(argv[++i]) * 1e6;
+    else if(i + 1 < argc && a == "--out")
+      outPath = argv[++i];
+    else if(i + 1 < argc && a == "--baseline")
+      baseline = argv[++i];
+    else if(i + 1 < argc && a == "--tolerance")
+      tolerance = atof(argv[++i]);
+    else
+    {
+      fprintf(stderr, "usage: %s [--filter text] [--min-time-ms n] [--out file.json] [--baseline file.json] [--tolerance percent]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  isrCases();
+  captureCases();
+  encodeCases();
+  parseCases();
+  requestCases();
+
+  FILE* out = outPath ? fopen(outPath, "w") : stdout;
+  if(!out)
+  {
+    fprintf(stderr, "cannot write %s\n", outPath);
+    return 1;
+  }
+  writeJson(out);
+  if(out != stdout)
+    fclose(out);
+
+  bool failed = false;
+  for(const Result& r : results)
+    failed = failed || !r.ok;
+  int regressions = baseline ? compareBaseline(baseline, tolerance) : 0;
+  if(failed || regressions < 0)
+    return 1;
+  return regressions ? 2 : 0;
+}
@@ -0,0 +1,147 @@
+//EventRecorder on a file-backed stand-in for the flash: sustained write rate
+//of alert-sized JPEG frames, the worst single frame and the index flushes,
+//then the seek latency of a player jumping to random frames through
+//openSegment(), as /recordings serves a Range request.
+//
+//  recorder_bench [--dir path] [--frames n] [--frame-bytes n] [--seeks n]
+//
+//The directory is emptied first. The numbers are those of the host's file
+//system, not of LittleFS on the device flash; what carries over is how the
+//flushes and the seeks scale with the segment and frame count. A frame
+//that is not found where the index says, or a reopen that loses flushed
+//frames, makes the exit code 1.
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include <string.h>
+#include "EventRecorder.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double microsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+//entropy like a JPEG's, with its markers
+static std::vector<uint8_t> jpegLike(size_t bytes, uint32_t seed)
+{
+  std::vector<uint8_t> jpeg(bytes);
+  std::mt19937 random(seed);
+  for(uint8_t& b : jpeg)
+    b = random();
+  jpeg[0] = 0xff;
+  jpeg[1] = 0xd8;
+  jpeg[bytes - 2] = 0xff;
+  jpeg[bytes - 1] = 0xd9;
+  return jpeg;
+}
+
+int main(int argc, char** argv)
+{
+  std::string dir = "recorder_bench.flash";
+  int frames = 600;
+  size_t frameBytes = 12000;
+  int seeks = 1000;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    if(i + 1 < argc && a == "--dir")
+      dir = argv[++i];
+    else if(i + 1 < argc && a == "--frames")
+      frames = atoi(argv[++i]);
+    else if(i + 1 < argc && a == "--frame-bytes")
+      frameBytes = atoi(argv[++i]);
+    else if(i + 1 < argc && a == "--seeks")
+      seeks = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "usage: %s [--dir path] [--frames n] [--frame-bytes n] [--seeks n]\n", argv[0]);
+      return 1;
+    }
+  }
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  fs::FS flash(dir);
+  bool ok = true;
+
+  static const int SEGMENTS = 4;
+  static const size_t SEGMENT_BYTES = 1024 * 1024;
+  static EventRecorder recorder;
+  Clock::time_point start = Clock::now();
+  if(!recorder.begin(flash, "/rec", SEGMENTS, SEGMENT_BYTES))
+  {
+    fprintf(stderr, "begin failed\n");
+    return 1;
+  }
+  printf("{\"name\": \"recorder/preallocate\", \"segments\": %d, \"segment_bytes\": %u, \"ms\": %.1f}\n",
+         SEGMENTS, (unsigned)SEGMENT_BYTES, microsSince(start) / 1000);
+
+  std::vector<uint8_t> jpeg = jpegLike(frameBytes, 1);
+  double worst = 0;
+  double worstFlush = 0;
+  start = Clock::now();
+  for(int i = 0; i < frames; i++)
+  {
+    Clock::time_point frame = Clock::now();
+    if(!recorder.addFrame(jpeg.data(), jpeg.size(), 320, 240, 100 + i % 300, 1700000000 + i / 10))
+    {
+      fprintf(stderr, "frame %d not recorded\n", i);
+      ok = false;
+    }
+    worst = std::max(worst, microsSince(frame));
+    worstFlush = std::max(worstFlush, (double)recorder.lastFlushMicros);
+  }
+  double us = microsSince(start);
+  printf("{\"name\": \"recorder/write\", \"frames\": %d, \"frame_bytes\": %u, \"fps\": %.0f, \"mb_per_s\": %.2f, "
+         "\"worst_frame_us\": %.0f, \"worst_flush_us\": %.0f}\n",
+         frames, (unsigned)frameBytes, frames * 1e6 / us, frames * frameBytes / us, worst, worstFlush);
+  recorder.flush();
+
+  //a reboot without close(): everything up to the last flush is there
+  static EventRecorder reopened;
+  reopened.begin(flash, "/rec", SEGMENTS, SEGMENT_BYTES);
+  RecordingHeader list[EventRecorder::MAX_SEGMENTS];
+  int count = reopened.list(list, EventRecorder::MAX_SEGMENTS);
+  if(!count || !list[0].frames)
+  {
+    fprintf(stderr, "no segment after reopening\n");
+    return 1;
+  }
+
+  //the frames of a segment are back to back chunks that end where the idx1
+  //of the valid length starts
+  std::mt19937 random(2);
+  std::vector<uint8_t> read(frameBytes);
+  std::vector<double> latencies;
+  for(int i = 0; i < seeks; i++)
+  {
+    const RecordingHeader& h = list[random() % count];
+    int frame = random() % h.frames;
+    start = Clock::now();
+    size_t length = 0;
+    File file = reopened.openSegment(h.sequence, length);
+    size_t chunk = frameBytes + (frameBytes & 1) + 8;
+    size_t moviEnd = length - 8 - h.frames * 16;
+    size_t offset = moviEnd - (h.frames - frame) * chunk + 8;
+    bool found = file && file.seek(offset) && file.read(read.data(), read.size()) == read.size();
+    file.close();
+    latencies.push_back(microsSince(start));
+    if(!found || memcmp(read.data(), jpeg.data(), frameBytes))
+    {
+      fprintf(stderr, "segment %u frame %d not at %u\n", (unsigned)h.sequence, frame, (unsigned)offset);
+      ok = false;
+      break;
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  if(!latencies.empty())
+    printf("{\"name\": \"recorder/seek\", \"seeks\": %d, \"segments\": %d, \"median_us\": %.1f, \"p99_us\": %.1f, \"worst_us\": %.1f}\n",
+           (int)latencies.size(), count, latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back());
+  std::filesystem::remove_all(dir);
+  return ok ? 0 : 1;
+}
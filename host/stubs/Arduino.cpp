@@ -0,0 +1,120 @@
+#include "Arduino.h"
+#include <stdarg.h>
+#include <errno.h>
+#include <sched.h>
+
+static uint64_t monotonicMicros()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+//both count from the first call, and wrap as on the device
+static uint64_t sinceStart()
+{
+  static const uint64_t start = monotonicMicros();
+  return monotonicMicros() - start + hostClockSkipMs * 1000;
+}
+
+unsigned long millis()
+{
+  return (uint32_t)(sinceStart() / 1000);
+}
+
+unsigned long micros()
+{
+  return (uint32_t)sinceStart();
+}
+
+void delay(unsigned long ms)
+{
+  struct timespec t = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+  while(nanosleep(&t, &t) && errno == EINTR)
+    ;
+}
+
+void yield()
+{
+  sched_yield();
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+  while(n < size && write(buffer[n]))
+    n++;
+  return n;
+}
+
+size_t Print::print(long value)
+{
+  char text[24];
+  snprintf(text, sizeof(text), "%ld", value);
+  return write(text);
+}
+
+size_t Print::print(unsigned long value)
+{
+  char text[24];
+  snprintf(text, sizeof(text), "%lu", value);
+  return write(text);
+}
+
+size_t Print::print(double value, int digits)
+{
+  char text[48];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Print::printf(const char* format, ...)
+{
+  char small[128];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if(n < 0)
+    return 0;
+  if((size_t)n < sizeof(small))
+    return write((const uint8_t*)small, n);
+  char* large = (char*)malloc(n + 1);
+  if(!large)
+    return 0;
+  va_start(args, format);
+  vsnprintf(large, n + 1, format, args);
+  va_end(args);
+  size_t written = write((const uint8_t*)large, n);
+  free(large);
+  return written;
+}
+
+int Stream::timedRead()
+{
+  unsigned long start = millis();
+  do
+  {
+    int c = read();
+    if(c >= 0)
+      return c;
+    yield();
+  } while(millis() - start < timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length)
+{
+  size_t n = 0;
+  for(int c; n < length && (c = timedRead()) >= 0; n++)
+    buffer[n] = c;
+  return n;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  std::string text;
+  for(int c; (c = timedRead()) >= 0 && c != terminator;)
+    text += (char)c;
+  return String(text);
+}
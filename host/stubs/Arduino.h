@@ -0,0 +1,56 @@
+#pragma once
+//Host stand-in for the parts of the Arduino core the pipeline uses. The clock
+//is CLOCK_MONOTONIC and delay() really sleeps, so the waits the firmware does
+//show up in the timings. Tests of interval logic move the clock forward with
+//hostClockSkipMs instead of waiting.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+
+typedef uint8_t byte;
+
+inline uint64_t hostClockSkipMs = 0;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+//pins are not emulated, see OV7670Sensor.h for the camera's
+inline void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+//the free heap is what esp_heap_caps.h reports
+class EspClass
+{
+  public:
+  uint32_t getFreeHeap()
+  {
+    return (uint32_t)std::min(heap_caps_get_free_size(MALLOC_CAP_DEFAULT), (size_t)UINT32_MAX);
+  }
+};
+
+inline EspClass ESP;
+
+inline bool isDigit(int c)
+{
+  return isdigit(c);
+}
+
+using std::min;
+using std::max;
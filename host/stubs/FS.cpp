@@ -0,0 +1,166 @@
+#include "FS.h"
+#include <filesystem>
+
+namespace fs
+{
+struct FileImpl
+{
+  FILE* file = nullptr;
+  std::string path;
+  bool directory = false;
+  std::vector<std::string> entries;
+  size_t next = 0;
+
+  ~FileImpl()
+  {
+    if(file)
+      fclose(file);
+  }
+};
+
+size_t File::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size)
+{
+  return impl && impl->file && size ? fwrite(buffer, 1, size, impl->file) : 0;
+}
+
+int File::available()
+{
+  return impl && impl->file ? (int)(size() - position()) : 0;
+}
+
+int File::read()
+{
+  return impl && impl->file ? fgetc(impl->file) : -1;
+}
+
+int File::peek()
+{
+  if(!impl || !impl->file)
+    return -1;
+  int c = fgetc(impl->file);
+  if(c >= 0)
+    ungetc(c, impl->file);
+  return c;
+}
+
+size_t File::read(uint8_t* buffer, size_t size)
+{
+  return impl && impl->file ? fread(buffer, 1, size, impl->file) : 0;
+}
+
+bool File::seek(uint32_t position, SeekMode mode)
+{
+  static const int WHENCE[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+  return impl && impl->file && fseek(impl->file, position, WHENCE[mode]) == 0;
+}
+
+size_t File::position() const
+{
+  return impl && impl->file ? ftell(impl->file) : 0;
+}
+
+size_t File::size() const
+{
+  if(!impl || !impl->file)
+    return 0;
+  fflush(impl->file);
+  std::error_code error;
+  size_t bytes = std::filesystem::file_size(impl->path, error);
+  return error ? 0 : bytes;
+}
+
+void File::flush()
+{
+  if(impl && impl->file)
+    fflush(impl->file);
+}
+
+void File::close()
+{
+  if(impl && impl->file)
+  {
+    fclose(impl->file);
+    impl->file = nullptr;
+  }
+  impl.reset();
+}
+
+const char* File::name() const
+{
+  return impl ? impl->path.c_str() : "";
+}
+
+bool File::isDirectory() const
+{
+  return impl && impl->directory;
+}
+
+File File::openNextFile()
+{
+  if(!impl || !impl->directory || impl->next >= impl->entries.size())
+    return File();
+  std::shared_ptr<FileImpl> entry = std::make_shared<FileImpl>();
+  entry->path = impl->entries[impl->next++];
+  entry->directory = true;
+  return File(entry);
+}
+
+File::operator bool() const
+{
+  return impl && (impl->file || impl->directory);
+}
+
+File FS::open(const String& path, const char* mode)
+{
+  std::string r = real(path);
+  std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+  impl->path = r;
+  std::error_code error;
+  if(std::filesystem::is_directory(r, error))
+  {
+    impl->directory = true;
+    for(const auto& entry : std::filesystem::directory_iterator(r, error))
+      impl->entries.push_back(std::string(path.c_str()) + "/" + entry.path().filename().string());
+    return File(impl);
+  }
+  std::string m = mode;
+  impl->file = fopen(r.c_str(), m == "r" ? "rb" : m == "a" ? "ab" : m == "r+" ? "r+b" : "wb");
+  return impl->file ? File(impl) : File();
+}
+
+bool FS::exists(const String& path)
+{
+  std::error_code error;
+  return std::filesystem::exists(real(path), error);
+}
+
+bool FS::mkdir(const String& path)
+{
+  std::error_code error;
+  return std::filesystem::create_directories(real(path), error) || std::filesystem::is_directory(real(path), error);
+}
+
+bool FS::remove(const String& path)
+{
+  std::error_code error;
+  return std::filesystem::remove(real(path), error);
+}
+
+bool FS::rename(const String& from, const String& to)
+{
+  std::error_code error;
+  std::filesystem::rename(real(from), real(to), error);
+  return !error;
+}
+
+bool FS::rmdir(const String& path)
+{
+  std::error_code error;
+  return std::filesystem::remove(real(path), error);
+}
+}
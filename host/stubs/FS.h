@@ -0,0 +1,81 @@
+#pragma once
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Stream.h"
+
+//The ESP32 fs::FS and fs::File on a directory of the host: paths are taken
+//below the root the FS was made with, files are stdio streams. Copies of a
+//File share the open file, as on the device. A directory opened lists its
+//entries through openNextFile(), whose name() is the full path.
+namespace fs
+{
+enum SeekMode
+{
+  SeekSet,
+  SeekCur,
+  SeekEnd,
+};
+
+struct FileImpl;
+
+class File : public Stream
+{
+  public:
+  File()
+  {
+  }
+  explicit File(std::shared_ptr<FileImpl> impl)
+    :impl(impl)
+  {
+  }
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* buffer, size_t size);
+  bool seek(uint32_t position, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close();
+  const char* name() const;
+  bool isDirectory() const;
+  File openNextFile();
+  explicit operator bool() const;
+
+  private:
+  std::shared_ptr<FileImpl> impl;
+};
+
+class FS
+{
+  public:
+  explicit FS(const std::string& root)
+    :root(root)
+  {
+  }
+
+  //modes "r", "w", "a" and "r+"; a missing file opened for reading is false
+  File open(const String& path, const char* mode = "r");
+  bool exists(const String& path);
+  bool mkdir(const String& path);
+  bool remove(const String& path);
+  bool rename(const String& from, const String& to);
+  bool rmdir(const String& path);
+
+  private:
+  std::string root;
+  std::string real(const String& path) const
+  {
+    return root + path.c_str();
+  }
+};
+}
+
+using fs::File;
+using fs::FS;
@@ -0,0 +1,305 @@
+#include "OV7670Sensor.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "Wire.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "rom/lldesc.h"
+#include "soc/i2s_struct.h"
+
+i2s_dev_t I2S0;
+gpio_dev_t GPIO;
+TwoWire Wire;
+
+static const uint8_t SENSOR_ADDRESS = 0x21;
+static const uint8_t COM2 = 0x09;
+static const uint8_t COM2_SSLEEP = 0x10;
+static const uint8_t COM3 = 0x0c;
+static const uint8_t COM3_DCW = 0x04;
+static const uint8_t COM7 = 0x12;
+static const uint8_t COM7_RGB = 0x04;
+static const uint8_t CLKRC = 0x11;
+static const uint8_t MVFP = 0x1e;
+static const uint8_t MVFP_VFLIP = 0x10;
+static const uint8_t DCWCTR = 0x72;
+//VGA timing of the datasheet: 784 x 510 pixel times of two PCLKs, 480 of
+//the rows with HREF; the scaled modes keep it and skip rows
+static const int PCLKS_PER_ROW = 784 * 2;
+static const int ROWS = 510;
+static const int ACTIVE_ROWS = 480;
+static const int ROWS_BEFORE_HREF = 20;
+static const int LINES_PER_PAUSE = 8;
+
+static volatile uint8_t registers[256];
+static uint8_t pointer = 0;
+
+struct intr_handle_data_t
+{
+  intr_handler_t handler = nullptr;
+  void* arg = nullptr;
+  std::atomic<bool> enabled{false};
+};
+
+static intr_handle_data_t i2sInterrupt;
+static intr_handle_data_t gpioInterrupt;
+//pins with a falling edge interrupt enabled, VSYNC among them
+static std::atomic<uint64_t> fallingEdgePins{0};
+static gpio_int_type_t pinTypes[64];
+static std::atomic<bool> xclk{false};
+static std::atomic<uint32_t> xclkHz{0};
+static std::atomic<unsigned long> frames{0};
+
+//a scene about as smooth as a photo for the encoder, different in every row:
+//in RGB565 the row is in red and blue and green ramps across; in U Y V Y the
+//luma ramps across and down and the row is in the chroma
+uint8_t hostSensorByte(int y, int index)
+{
+  int x = index >> 1;
+  if(registers[COM7] & COM7_RGB)
+  {
+    int pixel = (y >> 4) << 11 | (((y >> 3) + (x >> 4)) & 63) << 5 | (y & 31);
+    return index & 1 ? pixel & 0xff : pixel >> 8;
+  }
+  if(index & 1)
+    return (uint8_t)(y / 2 + x / 4);
+  return index & 2 ? 64 + (y >> 8) * 64 : y & 255;
+}
+
+static int scale(int shift)
+{
+  return registers[COM3] & COM3_DCW ? (registers[DCWCTR] >> shift) & 3 : 0;
+}
+
+int hostSensorLines()
+{
+  return 480 >> scale(4);
+}
+
+int hostSensorLineBytes()
+{
+  return (640 >> scale(0)) * 2;
+}
+
+uint8_t hostSensorRegister(uint8_t reg)
+{
+  return registers[reg];
+}
+
+unsigned long hostSensorFrames()
+{
+  return frames;
+}
+
+//two bytes of the wire per DMA word: the first in bits 16..23, the second
+//in bits 0..7, as SM_0A0B_0C0D packs them
+static void line(lldesc_t* descriptor, int y, int bytes)
+{
+  volatile uint8_t* buffer = descriptor->buf;
+  for(int k = 0; k < bytes && (k >> 1) * 4 + 3 < (int)descriptor->length; k++)
+    buffer[(k >> 1) * 4 + (k & 1 ? 0 : 2)] = hostSensorByte(y, k);
+}
+
+//XCLK through the CLKRC prescaler
+static double rowNanos()
+{
+  double pclkHz = (double)xclkHz / ((registers[CLKRC] & 0x3f) + 1);
+  return PCLKS_PER_ROW * 1e9 / pclkHz;
+}
+
+static void stream()
+{
+  using namespace std::chrono;
+  for(;;)
+  {
+    if(!xclk || !xclkHz || (registers[COM2] & COM2_SSLEEP))
+    {
+      std::this_thread::sleep_for(milliseconds(1));
+      continue;
+    }
+    auto start = steady_clock::now();
+    double row = rowNanos();
+    //a late wakeup delays the rest of the frame; catching up would put a
+    //burst of lines on the DMA that no sensor sends
+    auto pace = [&](int rows) {
+      auto at = start + nanoseconds((long long)(rows * row));
+      auto now = steady_clock::now();
+      if(at < now)
+        start += now - at;
+      else
+        std::this_thread::sleep_until(at);
+    };
+    frames++;
+    if(gpioInterrupt.enabled && fallingEdgePins)
+      gpioInterrupt.handler(gpioInterrupt.arg);
+    //vertical blanking, the VSYNC handler's task sets up the receiver
+    pace(ROWS_BEFORE_HREF);
+    bool capture = i2sInterrupt.enabled && I2S0.conf.rx_start;
+    lldesc_t* descriptor = (lldesc_t*)I2S0.in_link.addr;
+    int lines = hostSensorLines();
+    int bytes = hostSensorLineBytes();
+    bool flip = registers[MVFP] & MVFP_VFLIP;
+    for(int y = 0; y < lines; y++)
+    {
+      capture = capture && descriptor && i2sInterrupt.enabled && I2S0.conf.rx_start;
+      if(capture)
+      {
+        line(descriptor, flip ? lines - 1 - y : y, bytes);
+        descriptor = descriptor->qe.stqe_next;
+        I2S0.int_raw.val = 1;
+        i2sInterrupt.handler(i2sInterrupt.arg);
+      }
+      //a few lines at a time, at the row rate, captured or not
+      if(y % LINES_PER_PAUSE == LINES_PER_PAUSE - 1)
+        pace(ROWS_BEFORE_HREF + (y + 1) * ACTIVE_ROWS / lines);
+    }
+    pace(ROWS);
+  }
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* config)
+{
+  if(!config->freq_hz)
+    return ESP_FAIL;
+  xclkHz = config->freq_hz;
+  return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* config)
+{
+  static std::once_flag started;
+  std::call_once(started, []() { std::thread(stream).detach(); });
+  xclk = true;
+  return ESP_OK;
+}
+
+void periph_module_enable(periph_module_t module)
+{
+}
+
+void periph_module_disable(periph_module_t module)
+{
+  if(module == PERIPH_LEDC_MODULE)
+    xclk = false;
+}
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+  for(int pin = 0; pin < 64; pin++)
+    if(config->pin_bit_mask & (1ULL << pin))
+    {
+      pinTypes[pin] = config->intr_type;
+      fallingEdgePins &= ~(1ULL << pin);
+    }
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type)
+{
+  pinTypes[pin & 63] = type;
+  if(type != GPIO_INTR_NEGEDGE && type != GPIO_INTR_ANYEDGE)
+    fallingEdgePins &= ~(1ULL << (pin & 63));
+  return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t pin)
+{
+  if(pinTypes[pin & 63] == GPIO_INTR_NEGEDGE || pinTypes[pin & 63] == GPIO_INTR_ANYEDGE)
+    fallingEdgePins |= 1ULL << (pin & 63);
+  return ESP_OK;
+}
+
+void gpio_matrix_in(uint32_t pin, uint32_t signal, bool invert)
+{
+}
+
+static esp_err_t attach(intr_handle_data_t& interrupt, intr_handler_t handler, void* arg, int flags, intr_handle_t* handle)
+{
+  interrupt.enabled = false;
+  interrupt.handler = handler;
+  interrupt.arg = arg;
+  interrupt.enabled = !(flags & ESP_INTR_FLAG_INTRDISABLED);
+  if(handle)
+    *handle = &interrupt;
+  return ESP_OK;
+}
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void* arg, intr_handle_t* handle)
+{
+  return source == ETS_I2S0_INTR_SOURCE ? attach(i2sInterrupt, handler, arg, flags, handle) : ESP_FAIL;
+}
+
+esp_err_t gpio_isr_register(intr_handler_t handler, void* arg, int flags, intr_handle_t* handle)
+{
+  return attach(gpioInterrupt, handler, arg, flags, handle);
+}
+
+esp_err_t esp_intr_enable(intr_handle_t handle)
+{
+  if(!handle)
+    return ESP_FAIL;
+  handle->enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_intr_disable(intr_handle_t handle)
+{
+  if(!handle)
+    return ESP_FAIL;
+  handle->enabled = false;
+  return ESP_OK;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  this->address = address;
+  length = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if(length >= sizeof(this->data))
+    return 0;
+  this->data[length++] = data;
+  return 1;
+}
+
+//SCCB: a register write is the address and value, a read sets the pointer
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  transactions++;
+  bits += 2 + 9 * (1 + length);
+  if(address != SENSOR_ADDRESS)
+    return 2;
+  if(length >= 1)
+    pointer = data[0];
+  if(length == 2)
+  {
+    registers[pointer] = data[1];
+    //COM7 reset, every register back to its default; zero stands in for those
+    if(pointer == COM7 && (data[1] & 0x80))
+      for(volatile uint8_t& r : registers)
+        r = 0;
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t count)
+{
+  transactions++;
+  bits += 2 + 9 * (1 + count);
+  reads++;
+  received = -1;
+  if(address != SENSOR_ADDRESS || count != 1)
+    return 0;
+  received = registers[pointer];
+  return 1;
+}
+
+int TwoWire::read()
+{
+  int value = received;
+  received = -1;
+  return value;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+//The OV7670 the host stubs emulate. Its registers sit behind Wire, and while
+//XCLK runs, COM2 does not put it in soft sleep and the I2S receiver is
+//started it streams frames into the DMA descriptors, one line interrupt per
+//line, with a VSYNC interrupt before each. Frames take the sensor's VGA
+//timing at the pixel clock XCLK and CLKRC give, 510 rows of 784 pixels, and
+//the lines come a few at a time at the row rate. The frame size follows COM3
+//and the DCW control register as the scaling tables set them; with the MVFP
+//flip the rows go out bottom up. A row is the same bytes in every frame; a
+//capture starts at the first VSYNC after rx_start, as the I2S camera mode
+//does.
+
+//byte index of the wire order of row y (U Y V Y or RGB565 high byte first)
+uint8_t hostSensorByte(int y, int index);
+int hostSensorLines();
+int hostSensorLineBytes();
+uint8_t hostSensorRegister(uint8_t reg);
+//frames streamed so far, captured or not
+unsigned long hostSensorFrames();
@@ -0,0 +1,61 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+//Preferences in memory, nothing survives the process
+class Preferences
+{
+  public:
+  bool begin(const char* name, bool readOnly = false)
+  {
+    return true;
+  }
+  void end()
+  {
+  }
+
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0)
+  {
+    auto at = values.find(key);
+    return at == values.end() ? defaultValue : at->second;
+  }
+  size_t putULong(const char* key, uint32_t value)
+  {
+    values[key] = value;
+    return sizeof(value);
+  }
+  bool getBool(const char* key, bool defaultValue = false)
+  {
+    return getULong(key, defaultValue) != 0;
+  }
+  size_t putBool(const char* key, bool value)
+  {
+    return putULong(key, value) ? 1 : 0;
+  }
+
+  //a blob is read back only whole, as NVS does
+  size_t getBytes(const char* key, void* buffer, size_t maxLength)
+  {
+    auto at = blobs.find(key);
+    if(at == blobs.end() || at->second.size() > maxLength)
+      return 0;
+    memcpy(buffer, at->second.data(), at->second.size());
+    return at->second.size();
+  }
+  size_t putBytes(const char* key, const void* value, size_t length)
+  {
+    blobs[key].assign((const char*)value, length);
+    return length;
+  }
+  bool remove(const char* key)
+  {
+    return values.erase(key) + blobs.erase(key) > 0;
+  }
+
+  private:
+  std::map<std::string, uint32_t> values;
+  std::map<std::string, std::string> blobs;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+class Print
+{
+  public:
+  virtual ~Print()
+  {
+  }
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* text)
+  {
+    return text ? write((const uint8_t*)text, strlen(text)) : 0;
+  }
+
+  size_t print(const char* text)
+  {
+    return write(text);
+  }
+  size_t print(const String& text)
+  {
+    return write(text.c_str());
+  }
+  size_t print(char c)
+  {
+    return write((uint8_t)c);
+  }
+  size_t print(int value)
+  {
+    return print((long)value);
+  }
+  size_t print(unsigned int value)
+  {
+    return print((unsigned long)value);
+  }
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t print(double value, int digits = 2);
+
+  size_t println()
+  {
+    return write("\r\n");
+  }
+  template<typename T> size_t println(const T& value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include "Print.h"
+
+class Stream : public Print
+{
+  public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long ms)
+  {
+    timeout = ms;
+  }
+
+  //waits up to the timeout for every byte, as the Arduino core does
+  size_t readBytes(uint8_t* buffer, size_t length);
+  String readStringUntil(char terminator);
+
+  protected:
+  unsigned long timeout = 1000;
+
+  int timedRead();
+};
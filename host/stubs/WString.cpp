@@ -0,0 +1,79 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+String String::substring(unsigned int from) const
+{
+  return from < s.length() ? String(s.substr(from)) : String();
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if(from > to)
+    std::swap(from, to);
+  if(from >= s.length())
+    return String();
+  return String(s.substr(from, to - from));
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  size_t at = s.find(c, from);
+  return at == std::string::npos ? -1 : (int)at;
+}
+
+int String::indexOf(const char* text, unsigned int from) const
+{
+  size_t at = s.find(text, from);
+  return at == std::string::npos ? -1 : (int)at;
+}
+
+bool String::startsWith(const char* prefix) const
+{
+  return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+bool String::endsWith(const char* suffix) const
+{
+  size_t n = strlen(suffix);
+  return s.length() >= n && s.compare(s.length() - n, n, suffix) == 0;
+}
+
+long String::toInt() const
+{
+  return atol(s.c_str());
+}
+
+void String::trim()
+{
+  size_t first = 0;
+  while(first < s.length() && isspace((unsigned char)s[first]))
+    first++;
+  size_t end = s.length();
+  while(end > first && isspace((unsigned char)s[end - 1]))
+    end--;
+  s = s.substr(first, end - first);
+}
+
+void String::toUpperCase()
+{
+  for(char& c : s)
+    c = toupper((unsigned char)c);
+}
+
+void String::toLowerCase()
+{
+  for(char& c : s)
+    c = tolower((unsigned char)c);
+}
+
+void String::replace(const char* from, const char* to)
+{
+  size_t n = strlen(from);
+  if(!n)
+    return;
+  size_t m = strlen(to);
+  for(size_t at = s.find(from); at != std::string::npos; at = s.find(from, at + m))
+    s.replace(at, n, to);
+}
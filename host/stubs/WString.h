@@ -0,0 +1,106 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+
+//Arduino String on std::string, the members the pipeline calls
+class String
+{
+  public:
+  String(const char* text = "")
+    :s(text ? text : "")
+  {
+  }
+  String(const std::string& text)
+    :s(text)
+  {
+  }
+  explicit String(char c)
+    :s(1, c)
+  {
+  }
+  explicit String(int value)
+    :s(std::to_string(value))
+  {
+  }
+  explicit String(unsigned long value)
+    :s(std::to_string(value))
+  {
+  }
+
+  const char* c_str() const
+  {
+    return s.c_str();
+  }
+  unsigned int length() const
+  {
+    return s.length();
+  }
+  bool reserve(unsigned int size)
+  {
+    s.reserve(size);
+    return true;
+  }
+  char charAt(unsigned int i) const
+  {
+    return i < s.length() ? s[i] : 0;
+  }
+  char operator[](unsigned int i) const
+  {
+    return charAt(i);
+  }
+
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const char* text, unsigned int from = 0) const;
+  bool startsWith(const char* prefix) const;
+  bool endsWith(const char* suffix) const;
+  long toInt() const;
+  void trim();
+  void toUpperCase();
+  void toLowerCase();
+  void replace(const char* from, const char* to);
+
+  String& operator+=(const String& other)
+  {
+    s += other.s;
+    return *this;
+  }
+  String& operator+=(const char* text)
+  {
+    s += text;
+    return *this;
+  }
+  String& operator+=(char c)
+  {
+    s += c;
+    return *this;
+  }
+  friend String operator+(const String& a, const String& b)
+  {
+    return String(a.s + b.s);
+  }
+  friend String operator+(const String& a, const char* b)
+  {
+    return String(a.s + b);
+  }
+  friend String operator+(const char* a, const String& b)
+  {
+    return String(a + b.s);
+  }
+  bool operator==(const String& other) const
+  {
+    return s == other.s;
+  }
+  bool operator==(const char* text) const
+  {
+    return s == text;
+  }
+  bool operator!=(const String& other) const
+  {
+    return s != other.s;
+  }
+
+  private:
+  std::string s;
+};
@@ -0,0 +1,195 @@
+#include "WiFiClient.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <string>
+
+static bool redirected = false;
+static sockaddr_storage redirectAddress;
+static socklen_t redirectLength;
+
+//copies of a client per descriptor
+static const int MAX_SOCKETS = 4096;
+static int references[MAX_SOCKETS];
+
+void WiFiClient::redirect(const char* host, uint16_t port)
+{
+  redirected = false;
+  if(!host)
+    return;
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* found = nullptr;
+  if(getaddrinfo(host, std::to_string(port).c_str(), &hints, &found) || !found)
+    return;
+  memcpy(&redirectAddress, found->ai_addr, found->ai_addrlen);
+  redirectLength = found->ai_addrlen;
+  redirected = true;
+  freeaddrinfo(found);
+}
+
+WiFiClient::WiFiClient(int fd)
+{
+  if(fd >= 0 && fd < MAX_SOCKETS)
+    adopt(fd);
+}
+
+WiFiClient::WiFiClient(const WiFiClient& other)
+  :socket(other.socket), timeoutSeconds(other.timeoutSeconds)
+{
+  if(socket >= 0)
+    __atomic_add_fetch(&references[socket], 1, __ATOMIC_RELAXED);
+}
+
+WiFiClient& WiFiClient::operator=(const WiFiClient& other)
+{
+  if(this != &other)
+  {
+    if(other.socket >= 0)
+      __atomic_add_fetch(&references[other.socket], 1, __ATOMIC_RELAXED);
+    stop();
+    socket = other.socket;
+    timeoutSeconds = other.timeoutSeconds;
+  }
+  return *this;
+}
+
+WiFiClient::~WiFiClient()
+{
+  stop();
+}
+
+void WiFiClient::adopt(int fd)
+{
+  //lwIP on the device sends small writes at once as well
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  references[fd] = 1;
+  socket = fd;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+  stop();
+  int fd = -1;
+  if(redirected)
+  {
+    fd = ::socket(redirectAddress.ss_family, SOCK_STREAM, 0);
+    if(fd >= 0 && ::connect(fd, (sockaddr*)&redirectAddress, redirectLength))
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+  else
+  {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* found = nullptr;
+    if(getaddrinfo(host, std::to_string(port).c_str(), &hints, &found))
+      return 0;
+    for(struct addrinfo* a = found; a && fd < 0; a = a->ai_next)
+    {
+      fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if(fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen))
+      {
+        close(fd);
+        fd = -1;
+      }
+    }
+    freeaddrinfo(found);
+  }
+  if(fd < 0 || fd >= MAX_SOCKETS)
+  {
+    if(fd >= 0)
+      close(fd);
+    return 0;
+  }
+  adopt(fd);
+  return 1;
+}
+
+size_t WiFiClient::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size)
+{
+  int fd = this->fd();
+  size_t sent = 0;
+  while(fd >= 0 && sent < size)
+  {
+    ssize_t n = send(fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+    if(n > 0)
+    {
+      sent += n;
+      continue;
+    }
+    if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      break;
+    struct pollfd p = { fd, POLLOUT, 0 };
+    poll(&p, 1, 1000);
+  }
+  return sent;
+}
+
+int WiFiClient::available()
+{
+  int fd = this->fd();
+  int n = 0;
+  if(fd < 0 || ioctl(fd, FIONREAD, &n))
+    return 0;
+  return n;
+}
+
+int WiFiClient::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size)
+{
+  int fd = this->fd();
+  if(fd < 0)
+    return -1;
+  ssize_t n = recv(fd, buffer, size, 0);
+  return n > 0 ? (int)n : -1;
+}
+
+int WiFiClient::peek()
+{
+  int fd = this->fd();
+  uint8_t c;
+  if(fd < 0 || recv(fd, &c, 1, MSG_PEEK) != 1)
+    return -1;
+  return c;
+}
+
+void WiFiClient::stop()
+{
+  if(socket >= 0 && !__atomic_sub_fetch(&references[socket], 1, __ATOMIC_ACQ_REL))
+    close(socket);
+  socket = -1;
+}
+
+//connected while the peer has not closed, or while unread bytes are left
+uint8_t WiFiClient::connected()
+{
+  int fd = this->fd();
+  if(fd < 0)
+    return 0;
+  uint8_t c;
+  ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "Arduino.h"
+#include "Client.h"
+
+//WiFiClient on a POSIX TCP socket. As on the device, connect() blocks and
+//reads do not: available() and read() return what has arrived. write()
+//blocks until everything is handed to the kernel. Copies share the socket,
+//which closes when the last of them stops; the references are counted per
+//descriptor, so like lwIP nothing here allocates once connected.
+//redirect() sends every following connect to one address instead of the
+//host asked for, so the Telegram code can be pointed at a local server;
+//those connects do not resolve names and do not allocate either.
+class WiFiClient : public Client
+{
+  public:
+  WiFiClient()
+  {
+  }
+  //takes over a connected socket, as WiFiServer::available() does
+  explicit WiFiClient(int fd);
+  WiFiClient(const WiFiClient& other);
+  WiFiClient& operator=(const WiFiClient& other);
+  ~WiFiClient();
+
+  static void redirect(const char* host, uint16_t port);
+
+  using Print::write;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek() override;
+  void flush() override
+  {
+  }
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override
+  {
+    return connected();
+  }
+
+  //seconds on the ESP32 core; kept, the socket reads do not block anyway
+  void setTimeout(uint32_t seconds)
+  {
+    timeoutSeconds = seconds;
+  }
+
+  int fd() const
+  {
+    return socket;
+  }
+
+  private:
+  int socket = -1;
+  uint32_t timeoutSeconds = 0;
+
+  void adopt(int fd);
+};
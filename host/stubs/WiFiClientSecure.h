@@ -0,0 +1,15 @@
+#pragma once
+#include "WiFiClient.h"
+
+//no TLS on the host: the connection is plain TCP, the certificate is ignored,
+//so the timings leave the handshake and the record encryption out
+class WiFiClientSecure : public WiFiClient
+{
+  public:
+  void setCACert(const char* rootCA)
+  {
+  }
+  void setInsecure()
+  {
+  }
+};
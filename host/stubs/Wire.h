@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+//I2C master with the emulated OV7670 (OV7670Sensor.h) as the only device on
+//the bus. It answers at 0x21 and keeps the registers written to it; other
+//addresses are not acknowledged. Counts what a real bus would have to clock.
+class TwoWire
+{
+  public:
+  bool begin(int sda, int scl, uint32_t frequency = 100000)
+  {
+    this->frequency = frequency;
+    return true;
+  }
+  void setClock(uint32_t frequency)
+  {
+    this->frequency = frequency;
+  }
+
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t count);
+  int read();
+
+  uint32_t frequency = 100000;
+  //transactions and the bits they take on the wire, start and stop included
+  unsigned long transactions = 0;
+  unsigned long bits = 0;
+  //one byte reads; each follows a transaction that sets the register pointer
+  unsigned long reads = 0;
+
+  private:
+  uint8_t address = 0;
+  uint8_t data[4];
+  size_t length = 0;
+  int received = -1;
+};
+
+extern TwoWire Wire;
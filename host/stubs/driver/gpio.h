@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+
+//driver/gpio.h with what it pulls in on the device: esp_err_t, the
+//interrupt allocator, the GPIO matrix and the GPIO registers. Interrupts are
+//delivered by the emulated sensor in stubs/OV7670Sensor.cpp.
+
+#define IRAM_ATTR
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef int gpio_num_t;
+
+typedef enum
+{
+  GPIO_MODE_INPUT = 1,
+} gpio_mode_t;
+
+typedef enum
+{
+  GPIO_PULLUP_DISABLE,
+  GPIO_PULLUP_ENABLE,
+} gpio_pullup_t;
+
+typedef enum
+{
+  GPIO_PULLDOWN_DISABLE,
+  GPIO_PULLDOWN_ENABLE,
+} gpio_pulldown_t;
+
+typedef enum
+{
+  GPIO_INTR_DISABLE,
+  GPIO_INTR_POSEDGE,
+  GPIO_INTR_NEGEDGE,
+  GPIO_INTR_ANYEDGE,
+  GPIO_INTR_LOW_LEVEL,
+  GPIO_INTR_HIGH_LEVEL,
+} gpio_int_type_t;
+
+typedef struct
+{
+  uint64_t pin_bit_mask;
+  gpio_mode_t mode;
+  gpio_pullup_t pull_up_en;
+  gpio_pulldown_t pull_down_en;
+  gpio_int_type_t intr_type;
+} gpio_config_t;
+
+esp_err_t gpio_config(const gpio_config_t* config);
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type);
+esp_err_t gpio_intr_enable(gpio_num_t pin);
+void gpio_matrix_in(uint32_t pin, uint32_t signal, bool invert);
+
+typedef struct intr_handle_data_t* intr_handle_t;
+typedef void (*intr_handler_t)(void* arg);
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+#define ESP_INTR_FLAG_INTRDISABLED (1 << 11)
+#define ETS_I2S0_INTR_SOURCE 32
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void* arg, intr_handle_t* handle);
+esp_err_t esp_intr_enable(intr_handle_t handle);
+esp_err_t esp_intr_disable(intr_handle_t handle);
+esp_err_t gpio_isr_register(intr_handler_t handler, void* arg, int flags, intr_handle_t* handle);
+
+typedef volatile struct gpio_dev_s
+{
+  uint32_t status;
+  uint32_t status_w1tc;
+  struct
+  {
+    uint32_t val;
+  } status1, status1_w1tc;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
@@ -0,0 +1,48 @@
+#pragma once
+#include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+
+//the LEDC timer and channel that put out XCLK
+typedef enum
+{
+  LEDC_HIGH_SPEED_MODE,
+} ledc_mode_t;
+
+typedef enum
+{
+  LEDC_TIMER_0,
+} ledc_timer_t;
+
+typedef enum
+{
+  LEDC_CHANNEL_0,
+} ledc_channel_t;
+
+typedef enum
+{
+  LEDC_INTR_DISABLE,
+} ledc_intr_type_t;
+
+typedef int ledc_timer_bit_t;
+
+typedef struct
+{
+  ledc_mode_t speed_mode;
+  ledc_timer_bit_t bit_num;
+  ledc_timer_t timer_num;
+  uint32_t freq_hz;
+} ledc_timer_config_t;
+
+typedef struct
+{
+  int gpio_num;
+  ledc_mode_t speed_mode;
+  ledc_channel_t channel;
+  ledc_intr_type_t intr_type;
+  ledc_timer_t timer_sel;
+  uint32_t duty;
+  int hpoint;
+} ledc_channel_config_t;
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* config);
+esp_err_t ledc_channel_config(const ledc_channel_config_t* config);
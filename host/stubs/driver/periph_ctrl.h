@@ -0,0 +1,10 @@
+#pragma once
+
+typedef enum
+{
+  PERIPH_LEDC_MODULE,
+  PERIPH_I2S0_MODULE,
+} periph_module_t;
+
+void periph_module_enable(periph_module_t module);
+void periph_module_disable(periph_module_t module);
@@ -0,0 +1,20 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+//the frame buffer type of the esp32-camera component, as bmp_to_jpg.h uses it
+typedef enum
+{
+  PIXFORMAT_RGB565,
+  PIXFORMAT_YUV422,
+  PIXFORMAT_GRAYSCALE,
+} pixformat_t;
+
+typedef struct
+{
+  uint8_t* buf;
+  size_t len;
+  size_t width;
+  size_t height;
+  pixformat_t format;
+} camera_fb_t;
@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//Every capability is the host heap, PSRAM included. The free size is what
+//the tests set, unlimited by default.
+#define MALLOC_CAP_EXEC (1 << 0)
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+inline size_t hostHeapFree = SIZE_MAX;
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps)
+{
+  return size <= hostHeapFree ? malloc(size) : nullptr;
+}
+
+inline void heap_caps_free(void* p)
+{
+  free(p);
+}
+
+inline size_t heap_caps_get_free_size(uint32_t caps)
+{
+  return hostHeapFree;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+//ticks are milliseconds
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xffffffff)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+//CPU cycles as xtensa/hal.h counts them on the device; the time stamp
+//counter on x86, nanoseconds elsewhere
+uint32_t xthal_get_ccount();
+
+//the scheduler runs the woken task by itself
+#define portYIELD_FROM_ISR()
+
+//a detached thread, the priority and the core are ignored
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth, void* arg, unsigned int priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+
+//critical sections are a spinlock shared with the ISR stand-ins
+typedef struct
+{
+  volatile int locked;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+void vPortEnterCritical(portMUX_TYPE* mux);
+void vPortExitCritical(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
@@ -0,0 +1,95 @@
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth, void* arg, unsigned int priority, TaskHandle_t* handle, BaseType_t core)
+{
+  std::thread(code, arg).detach();
+  if(handle)
+    *handle = nullptr;
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+uint32_t xthal_get_ccount()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint32_t)__builtin_ia32_rdtsc();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void vPortEnterCritical(portMUX_TYPE* mux)
+{
+  while(__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE))
+    ;
+}
+
+void vPortExitCritical(portMUX_TYPE* mux)
+{
+  __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+struct Semaphore
+{
+  std::mutex lock;
+  std::condition_variable given;
+  bool available;
+};
+
+static SemaphoreHandle_t create(bool available)
+{
+  Semaphore* s = new Semaphore();
+  s->available = available;
+  return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return create(true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  return create(false);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+  Semaphore* s = (Semaphore*)semaphore;
+  std::unique_lock<std::mutex> lock(s->lock);
+  if(ticks == portMAX_DELAY)
+    s->given.wait(lock, [s]() { return s->available; });
+  else if(!s->given.wait_for(lock, std::chrono::milliseconds(ticks), [s]() { return s->available; }))
+    return pdFALSE;
+  s->available = false;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  Semaphore* s = (Semaphore*)semaphore;
+  {
+    std::lock_guard<std::mutex> lock(s->lock);
+    if(s->available)
+      return pdFALSE;
+    s->available = true;
+  }
+  s->given.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken)
+{
+  if(higherPriorityTaskWoken)
+    *higherPriorityTaskWoken = pdFALSE;
+  return xSemaphoreGive(semaphore);
+}
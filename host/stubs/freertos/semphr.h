@@ -0,0 +1,12 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void* SemaphoreHandle_t;
+
+//mutexes and binary semaphores, both a flag under a lock: a mutex starts
+//given, a binary semaphore taken. The ISR stand-ins give from their thread.
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken);
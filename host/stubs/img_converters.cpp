@@ -0,0 +1,26 @@
+#include "img_converters.h"
+#include <stdlib.h>
+#include "jpeg_encoder.h"
+
+bool frame2jpg(camera_fb_t* fb, uint8_t quality, uint8_t** out, size_t* outLength)
+{
+  JpegEncoder::Input input = JpegEncoder::RGB565;
+  if(fb->format == PIXFORMAT_YUV422)
+    input = JpegEncoder::YUV422;
+  if(fb->format == PIXFORMAT_GRAYSCALE)
+    input = JpegEncoder::GRAY8;
+  JpegEncoder* encoder = new JpegEncoder();
+  JpegEncoder::Buffer buffer = { nullptr, 0, 0 };
+  bool ok = encoder->begin(fb->width, fb->height, quality, JpegEncoder::memoryWriter, &buffer, input)
+    && encoder->addStripe(fb->buf, fb->height)
+    && encoder->finish();
+  delete encoder;
+  if(!ok)
+  {
+    free(buffer.data);
+    return false;
+  }
+  *out = buffer.data;
+  *outLength = buffer.size;
+  return true;
+}
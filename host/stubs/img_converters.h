@@ -0,0 +1,6 @@
+#pragma once
+#include "esp_camera.h"
+
+//frame2jpg of esp32-camera, encoded with the sketch's own JpegEncoder on the
+//host; the output is malloc()ed and freed by the caller as on the device
+bool frame2jpg(camera_fb_t* fb, uint8_t quality, uint8_t** out, size_t* outLength);
@@ -0,0 +1,4 @@
+#pragma once
+//lwIP's BSD socket API is the host's
+#include <errno.h>
+#include <sys/socket.h>
@@ -0,0 +1,8 @@
+#pragma once
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+//writes the terminating zero as mbedTLS does; olen excludes it, and on a
+//too small buffer holds the size needed
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen);
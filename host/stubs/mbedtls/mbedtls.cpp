@@ -0,0 +1,87 @@
+#include "sha1.h"
+#include "base64.h"
+#include <stdint.h>
+#include <string.h>
+
+static uint32_t rotate(uint32_t x, int n)
+{
+  return x << n | x >> (32 - n);
+}
+
+static void sha1Block(uint32_t* h, const unsigned char* block)
+{
+  uint32_t w[80];
+  for(int i = 0; i < 16; i++)
+    w[i] = (uint32_t)block[i * 4] << 24 | block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  for(int i = 16; i < 80; i++)
+    w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+  for(int i = 0; i < 80; i++)
+  {
+    uint32_t f, k;
+    if(i < 20)
+      f = (b & c) | (~b & d), k = 0x5a827999;
+    else if(i < 40)
+      f = b ^ c ^ d, k = 0x6ed9eba1;
+    else if(i < 60)
+      f = (b & c) | (b & d) | (c & d), k = 0x8f1bbcdc;
+    else
+      f = b ^ c ^ d, k = 0xca62c1d6;
+    uint32_t t = rotate(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotate(b, 30);
+    b = a;
+    a = t;
+  }
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+int mbedtls_sha1_ret(const unsigned char* input, size_t length, unsigned char output[20])
+{
+  uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+  size_t done = 0;
+  for(; length - done >= 64; done += 64)
+    sha1Block(h, input + done);
+  //the rest, 0x80, zeros and the length in bits, in one or two blocks
+  unsigned char tail[128] = {};
+  size_t rest = length - done;
+  memcpy(tail, input + done, rest);
+  tail[rest] = 0x80;
+  size_t blocks = rest < 56 ? 1 : 2;
+  uint64_t bits = (uint64_t)length * 8;
+  for(int i = 0; i < 8; i++)
+    tail[blocks * 64 - 1 - i] = bits >> (i * 8);
+  for(size_t i = 0; i < blocks; i++)
+    sha1Block(h, tail + i * 64);
+  for(int i = 0; i < 20; i++)
+    output[i] = h[i / 4] >> (24 - i % 4 * 8);
+  return 0;
+}
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen)
+{
+  static const char DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t needed = (slen + 2) / 3 * 4;
+  if(dlen < needed + 1)
+  {
+    *olen = needed + 1;
+    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+  unsigned char* p = dst;
+  for(size_t i = 0; i < slen; i += 3)
+  {
+    uint32_t v = src[i] << 16 | (i + 1 < slen ? src[i + 1] << 8 : 0) | (i + 2 < slen ? src[i + 2] : 0);
+    *p++ = DIGITS[v >> 18 & 63];
+    *p++ = DIGITS[v >> 12 & 63];
+    *p++ = i + 1 < slen ? DIGITS[v >> 6 & 63] : '=';
+    *p++ = i + 2 < slen ? DIGITS[v & 63] : '=';
+  }
+  *p = 0;
+  *olen = needed;
+  return 0;
+}
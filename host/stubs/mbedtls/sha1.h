@@ -0,0 +1,5 @@
+#pragma once
+#include <stddef.h>
+
+//the one mbedTLS SHA-1 call the WebSocket handshake makes
+int mbedtls_sha1_ret(const unsigned char* input, size_t length, unsigned char output[20]);
@@ -0,0 +1,13 @@
+#include "crc.h"
+
+uint32_t crc32_le(uint32_t crc, const uint8_t* buffer, size_t length)
+{
+  crc = ~crc;
+  for(size_t i = 0; i < length; i++)
+  {
+    crc ^= buffer[i];
+    for(int k = 0; k < 8; k++)
+      crc = crc & 1 ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+  }
+  return ~crc;
+}
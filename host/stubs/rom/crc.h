@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+//the ROM CRC32 (reflected 0xEDB88320), same results as on the device
+uint32_t crc32_le(uint32_t crc, const uint8_t* buffer, size_t length);
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+
+//DMA descriptor of the ESP32 ROM
+typedef struct lldesc_s
+{
+  volatile uint32_t size : 12, length : 12, offset : 5, sosf : 1, eof : 1, owner : 1;
+  volatile uint8_t* buf;
+  union
+  {
+    volatile uint32_t empty;
+    struct
+    {
+      struct lldesc_s* stqe_next;
+    } qe;
+  };
+} lldesc_t;
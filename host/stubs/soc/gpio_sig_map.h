@@ -0,0 +1,23 @@
+#pragma once
+
+//GPIO matrix input signals of I2S0 as in ESP-IDF
+#define I2S0I_DATA_IN0_IDX 140
+#define I2S0I_DATA_IN1_IDX 141
+#define I2S0I_DATA_IN2_IDX 142
+#define I2S0I_DATA_IN3_IDX 143
+#define I2S0I_DATA_IN4_IDX 144
+#define I2S0I_DATA_IN5_IDX 145
+#define I2S0I_DATA_IN6_IDX 146
+#define I2S0I_DATA_IN7_IDX 147
+#define I2S0I_DATA_IN8_IDX 148
+#define I2S0I_DATA_IN9_IDX 149
+#define I2S0I_DATA_IN10_IDX 150
+#define I2S0I_DATA_IN11_IDX 151
+#define I2S0I_DATA_IN12_IDX 152
+#define I2S0I_DATA_IN13_IDX 153
+#define I2S0I_DATA_IN14_IDX 154
+#define I2S0I_DATA_IN15_IDX 155
+#define I2S0I_V_SYNC_IDX 190
+#define I2S0I_H_SYNC_IDX 191
+#define I2S0I_H_ENABLE_IDX 192
+#define I2S0I_WS_IN_IDX 23
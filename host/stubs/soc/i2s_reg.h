@@ -0,0 +1,9 @@
+#pragma once
+
+#define I2S_IN_RST_M (1 << 3)
+#define I2S_AHBM_RST_M (1 << 5)
+#define I2S_AHBM_FIFO_RST_M (1 << 4)
+#define I2S_TX_RESET_M (1 << 0)
+#define I2S_RX_RESET_M (1 << 1)
+#define I2S_TX_FIFO_RESET_M (1 << 2)
+#define I2S_RX_FIFO_RESET_M (1 << 3)
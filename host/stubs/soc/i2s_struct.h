@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+
+//The I2S0 fields the camera driver touches. Every field is a word of its
+//own instead of the register's bit layout; in_link.addr holds a whole host
+//pointer. The emulated sensor (stubs/OV7670Sensor.cpp) reads them.
+typedef volatile struct i2s_dev_s
+{
+  struct
+  {
+    uint32_t val;
+    uint32_t rx_start;
+    uint32_t rx_slave_mod;
+    uint32_t rx_right_first;
+    uint32_t rx_msb_right;
+    uint32_t rx_msb_shift;
+    uint32_t rx_mono;
+    uint32_t rx_short_sync;
+  } conf;
+  struct
+  {
+    uint32_t lcd_en;
+    uint32_t camera_en;
+  } conf2;
+  struct
+  {
+    uint32_t val;
+  } lc_conf;
+  struct
+  {
+    uint32_t clkm_div_num;
+    uint32_t clkm_div_a;
+    uint32_t clkm_div_b;
+  } clkm_conf;
+  struct
+  {
+    uint32_t dscr_en;
+    uint32_t rx_fifo_mod;
+    uint32_t rx_fifo_mod_force_en;
+  } fifo_conf;
+  struct
+  {
+    uint32_t rx_chan_mod;
+  } conf_chan;
+  struct
+  {
+    uint32_t rx_bits_mod;
+  } sample_rate_conf;
+  struct
+  {
+    uint32_t val;
+  } timing;
+  struct
+  {
+    uint32_t rx_fifo_reset_back;
+  } state;
+  uint32_t rx_eof_num;
+  struct
+  {
+    uintptr_t addr;
+    uint32_t start;
+  } in_link;
+  struct
+  {
+    uint32_t val;
+  } int_clr, int_raw;
+  struct
+  {
+    uint32_t val;
+    uint32_t in_done;
+  } int_ena;
+} i2s_dev_t;
+
+extern i2s_dev_t I2S0;
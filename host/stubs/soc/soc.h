@@ -0,0 +1,2 @@
+#pragma once
+//the register addresses stay on the device, see soc/i2s_struct.h
@@ -0,0 +1,38 @@
+#include "allocations.h"
+#include <atomic>
+#include <stddef.h>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void __libc_free(void* p);
+
+static std::atomic<uint64_t> count{0};
+
+uint64_t allocations()
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+extern "C" void* malloc(size_t size)
+{
+  count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+  count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+  count.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p)
+{
+  __libc_free(p);
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+
+//Heap calls made by the process so far: malloc, calloc, realloc and through
+//them every operator new. Counted by the allocator in allocations.cpp, which
+//wraps the glibc one; linked into the benchmarks and tests only.
+uint64_t allocations();
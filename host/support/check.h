@@ -0,0 +1,25 @@
+#pragma once
+#include <stdio.h>
+
+//Minimal assertions for the host tests: a failed CHECK prints where and
+//what, the test goes on and main() returns checkResult(), 1 if any failed.
+static int checkFailures = 0;
+
+#define CHECK(condition)                                                   \
+  do                                                                       \
+  {                                                                        \
+    if(!(condition))                                                       \
+    {                                                                      \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      checkFailures++;                                                     \
+    }                                                                      \
+  } while(0)
+
+static inline int checkResult(const char* name)
+{
+  if(checkFailures)
+    fprintf(stderr, "%s: %d checks failed\n", name, checkFailures);
+  else
+    printf("%s: all checks passed\n", name);
+  return checkFailures ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+//AlertSpool on a directory standing in for LittleFS: records survive a
+//reboot, a torn last record is skipped, a rolled back batch comes again,
+//the oldest segments are evicted when the spool is full, and a reboot after
+//a full drain starts clean instead of following the old cursor. Batches are
+//runs of one kind, so a failed text after a delivered album sends only the
+//text again.
+
+#include <filesystem>
+#include <vector>
+#include "AlertSpool.h"
+#include "BufferPool.h"
+#include "check.h"
+
+static const char* ROOT = "alert_spool_test.flash";
+static std::vector<uint8_t> jpeg(30000);
+
+//takes every pending record, checks the JPEGs, returns their sequence numbers
+static std::vector<uint32_t> drain(AlertSpool& spool, bool keep)
+{
+  std::vector<uint32_t> sequences;
+  SpoolRecord record;
+  uint8_t* data;
+  while(spool.peek(record, &data))
+  {
+    CHECK(!record.jpegSize || !memcmp(data, jpeg.data(), record.jpegSize));
+    sequences.push_back(record.sequence);
+    bufferPool.give(data);
+    spool.consume();
+  }
+  if(keep)
+    spool.commit();
+  else
+    spool.rollback();
+  return sequences;
+}
+
+//one takeBatch() delivered as the sketch's drainSpool() does; send says
+//whether the request went through. Returns the sequence numbers of the batch
+//and appends them to sent when they were delivered
+static std::vector<uint32_t> deliver(AlertSpool& spool, bool send, std::vector<uint32_t>& sent)
+{
+  SpoolRecord records[4];
+  uint8_t* jpegs[4];
+  std::vector<uint32_t> batch;
+  int count = spool.takeBatch(records, jpegs, 4);
+  for(int i = 0; i < count; i++)
+  {
+    CHECK((records[i].jpegSize != 0) == (records[0].jpegSize != 0));
+    batch.push_back(records[i].sequence);
+    bufferPool.give(jpegs[i]);
+  }
+  if(send)
+  {
+    spool.commit();
+    sent.insert(sent.end(), batch.begin(), batch.end());
+  }
+  else
+    spool.rollback();
+  return batch;
+}
+
+static std::string lastSegmentFile()
+{
+  std::string last;
+  for(const auto& e : std::filesystem::directory_iterator(std::string(ROOT) + "/spool"))
+    if(e.path().extension() == ".log" && e.path().string() > last)
+      last = e.path().string();
+  return last;
+}
+
+int main()
+{
+  std::filesystem::remove_all(ROOT);
+  std::filesystem::create_directories(ROOT);
+  fs::FS flash(ROOT);
+  for(size_t i = 0; i < jpeg.size(); i++)
+    jpeg[i] = i * 7;
+  BufferPool::Class large = { BufferPool::LARGE, AlertSpool::SEGMENT_BYTES, 2 };
+  CHECK(bufferPool.begin(&large, 1));
+
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    for(int i = 0; i < 5; i++)
+      CHECK(spool.append(1000 + i, 100 + i, i, jpeg.data(), jpeg.size()));
+    CHECK(spool.append(2000, 50, 9, nullptr, 0));
+    CHECK(spool.pending() == 6);
+  }
+
+  //power loss in the middle of a record
+  {
+    FILE* f = fopen(lastSegmentFile().c_str(), "ab");
+    SpoolRecord torn = {};
+    torn.magic = SpoolRecord::MAGIC;
+    torn.jpegSize = 20000;
+    fwrite(&torn, 1, sizeof(torn), f);
+    fwrite(jpeg.data(), 1, 5000, f);
+    fclose(f);
+  }
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    CHECK(spool.pending() == 6);
+    CHECK(spool.append(3000, 1, 1, jpeg.data(), 1000));
+    CHECK(spool.pending() == 7);
+    CHECK(drain(spool, false).size() == 7);
+    CHECK(spool.pending() == 7);
+    SpoolRecord record;
+    uint8_t* data;
+    for(int i = 0; i < 3; i++)
+    {
+      CHECK(spool.peek(record, &data));
+      CHECK(record.sequence == (uint32_t)i);
+      bufferPool.give(data);
+      spool.consume();
+    }
+    spool.commit();
+  }
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    std::vector<uint32_t> rest = drain(spool, true);
+    CHECK((rest == std::vector<uint32_t>{ 3, 4, 5, 6 }));
+    CHECK(spool.pending() == 0);
+  }
+
+  //two records a segment: 40 of them keep the newest MAX_SEGMENTS segments
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    for(int i = 0; i < 40; i++)
+      spool.append(i, 0, 0, jpeg.data(), jpeg.size());
+    CHECK(spool.pending() == 2 * AlertSpool::MAX_SEGMENTS);
+    CHECK(spool.evicted() == 40 - 2 * AlertSpool::MAX_SEGMENTS);
+    CHECK((int)drain(spool, true).size() == 2 * AlertSpool::MAX_SEGMENTS);
+  }
+
+  //a full drain leaves no segment; the segments numbered from 1 again after
+  //the next reboot must all be read
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    CHECK(spool.pending() == 0);
+    for(int i = 0; i < 6; i++)
+      CHECK(spool.append(4000 + i, 0, 0, jpeg.data(), jpeg.size()));
+  }
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    CHECK(spool.pending() == 6);
+    CHECK(drain(spool, true).size() == 6);
+  }
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    CHECK(spool.pending() == 0);
+    for(int i = 0; i < 8; i++)
+      CHECK(spool.append(5000 + i, 0, 0, jpeg.data(), jpeg.size()));
+  }
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    CHECK(spool.pending() == 8);
+    CHECK(drain(spool, true).size() == 8);
+  }
+
+  //album, then the alerts without photo, then a single photo: the text send
+  //fails after the album went out and only the text comes again
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    CHECK(spool.pending() == 0);
+    std::vector<uint32_t> sent;
+    for(int i = 0; i < 2; i++)
+      CHECK(spool.append(6000 + i, 0, 0, jpeg.data(), 1000));
+    for(int i = 0; i < 2; i++)
+      CHECK(spool.append(6100 + i, 0, 0, nullptr, 0));
+    CHECK(spool.append(6200, 0, 0, jpeg.data(), 1000));
+    std::vector<uint32_t> album = deliver(spool, true, sent);
+    CHECK(album.size() == 2);
+    std::vector<uint32_t> text = deliver(spool, false, sent);
+    CHECK(text.size() == 2);
+    CHECK(spool.pending() == 3);
+    CHECK(deliver(spool, true, sent) == text);
+    CHECK(deliver(spool, true, sent).size() == 1);
+    CHECK(spool.pending() == 0);
+    //every alert delivered once
+    CHECK(sent.size() == 5);
+    for(size_t i = 1; i < sent.size(); i++)
+      CHECK(sent[i] == sent[i - 1] + 1);
+  }
+  //the photo slots run out before the batch is full, the rest is the next batch
+  {
+    AlertSpool spool;
+    CHECK(spool.begin(flash));
+    std::vector<uint32_t> sent;
+    for(int i = 0; i < 3; i++)
+      CHECK(spool.append(7000 + i, 0, 0, jpeg.data(), 1000));
+    CHECK(deliver(spool, true, sent).size() == 2);
+    CHECK(deliver(spool, true, sent).size() == 1);
+    CHECK(spool.pending() == 0);
+  }
+
+  std::filesystem::remove_all(ROOT);
+  return checkResult("alert_spool_test");
+}
@@ -0,0 +1,157 @@
+//captureBandedJPEG() on the emulated sensor (stubs/OV7670Sensor.h) with the
+//sketch's buffer pool: QVGA and VGA do not fit its frame buffer and go
+//through the band ring. Every stripe handed to the sink must be the sensor's
+//rows in photo order, bottom up on the wire with the flip, and the JPEG must
+//come out whole. Per resolution the capture and encode time and the pool's
+//high-water mark. Then the overrun path: a sink that holds a band while the
+//sensor fills the next two costs a retried frame, one that always does fails
+//the capture after BAND_ATTEMPTS frames. A JPEG that outgrows its slot fails
+//without a retry.
+
+#include <chrono>
+#include <thread>
+#include "banded_capture.h"
+#include "OV7670Sensor.h"
+#include "allocations.h"
+#include "check.h"
+
+#define PINS 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25
+
+static const OV7670::Mode IDLE = OV7670::QQQVGA_RGB565;
+static const OV7670::Mode FRAME_BUFFER_MODE = OV7670::QQVGA_RGB565;
+static const int FRAME_BUFFER_BYTES = max(OV7670::modeBytes(FRAME_BUFFER_MODE), bandRingBytes(640));
+static const size_t JPEG_SLOT_BYTES = 32 * 1024;
+static const int QUALITY = 12;
+
+struct Stripes
+{
+  int lineBytes;
+  int yres;
+  int next;        //photo row the next stripe has to start at
+  int wrong;       //rows that are not the sensor's or out of order
+  int retries;     //stripes that started over at row 0
+  int slowBands;   //bands to hold for holdMs before returning
+  int holdMs;
+};
+
+static void checkStripe(void* arg, const uint8_t* pixels, int first, int lines)
+{
+  Stripes& s = *(Stripes*)arg;
+  if(first == 0 && s.next)
+    s.retries++;
+  else if(first != s.next)
+    s.wrong++;
+  //photo row r is sensor row yres - 1 - r, the sensor reads bottom up
+  for(int y = 0; y < lines; y++)
+    for(int k = 0; k < s.lineBytes; k++)
+      if(pixels[y * s.lineBytes + k] != hostSensorByte(s.yres - 1 - (first + y), k))
+      {
+        s.wrong++;
+        break;
+      }
+  s.next = first + lines;
+  if(s.slowBands)
+  {
+    s.slowBands--;
+    std::this_thread::sleep_for(std::chrono::milliseconds(s.holdMs));
+  }
+}
+
+static bool wholeJpeg(const uint8_t* jpeg, size_t size)
+{
+  return size > 4 && jpeg[0] == 0xff && jpeg[1] == 0xd8 && jpeg[size - 2] == 0xff && jpeg[size - 1] == 0xd9;
+}
+
+static void capture(OV7670& camera, OV7670::Mode m, const char* name)
+{
+  CHECK(camera.setMode(m));
+  Stripes stripes = { camera.xres * camera.bytesPerPixel(), camera.yres, 0, 0, 0, 0, 0 };
+  bufferPool.resetHighWater();
+  uint64_t allocated = allocations();
+  auto start = std::chrono::steady_clock::now();
+  uint8_t* jpeg = nullptr;
+  size_t size = 0;
+  BandedCaptureStats stats = {};
+  bool ok = captureBandedJPEG(&camera, QUALITY, &jpeg, &size, &stats, checkStripe, &stripes);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  allocated = allocations() - allocated;
+  printf("{\"name\": \"banded_capture/%s\", \"bands\": %d, \"band_lines\": %d, \"frames\": %d, \"capture_ms\": %lu, \"encode_ms\": %lu, "
+         "\"overruns\": %d, \"total_ms\": %.1f, \"jpeg_bytes\": %zu, \"pool_high_water_bytes\": %zu, \"working_set_bytes\": %zu, \"allocations\": %lu}\n",
+         name, stats.bands, stats.bandLines, stats.frames, stats.captureMs, stats.encodeMs, stats.overruns, ms, size,
+         bufferPool.highWaterBytes(), stats.workingSetBytes, (unsigned long)allocated);
+  CHECK(ok);
+  //the encoder keeps up with a band in hand; a host thread that is not
+  //scheduled for a band's time can still cost a retried frame
+  CHECK(stats.frames == stats.overruns + 1);
+  CHECK(stats.bandLines < camera.yres && stats.bands * stats.bandLines >= camera.yres);
+  CHECK(stripes.wrong == 0 && stripes.retries == stats.overruns && stripes.next == camera.yres);
+  CHECK(wholeJpeg(jpeg, size));
+  //frame buffer, DMA lines and one JPEG slot, all taken at boot
+  CHECK(bufferPool.highWaterBytes() <= FRAME_BUFFER_BYTES + 2 * I2SCamera::MAX_XRES * 2 * 2 + JPEG_SLOT_BYTES);
+  CHECK(allocated == 0);
+  bufferPool.give(jpeg);
+}
+
+//slowBands of the sink each held for a band ring's worth of rows and more
+static void overrun(OV7670& camera, int slowBands, const char* name)
+{
+  CHECK(camera.setMode(OV7670::VGA_RGB565));
+  Stripes stripes = { camera.xres * camera.bytesPerPixel(), camera.yres, 0, 0, 0, slowBands, 100 };
+  uint8_t* jpeg = nullptr;
+  size_t size = 0;
+  BandedCaptureStats stats = {};
+  bool ok = captureBandedJPEG(&camera, QUALITY, &jpeg, &size, &stats, checkStripe, &stripes);
+  printf("{\"name\": \"banded_capture/%s\", \"captured\": %s, \"frames\": %d, \"overruns\": %d, \"retried_stripes\": %d}\n",
+         name, ok ? "true" : "false", stats.frames, stats.overruns, stripes.retries);
+  CHECK(stripes.wrong == 0);
+  if(slowBands < BAND_ATTEMPTS)
+  {
+    CHECK(ok && wholeJpeg(jpeg, size));
+    CHECK(stats.overruns == slowBands && stats.frames == slowBands + 1);
+    CHECK(stripes.retries == slowBands && stripes.next == camera.yres);
+  }
+  else
+  {
+    CHECK(!ok);
+    CHECK(stats.overruns == BAND_ATTEMPTS && stats.frames == BAND_ATTEMPTS);
+  }
+  if(ok)
+    bufferPool.give(jpeg);
+}
+
+//a JPEG larger than its slot fails the capture, it is not an overrun
+static void slotFull(OV7670& camera)
+{
+  CHECK(camera.setMode(OV7670::VGA_RGB565));
+  Stripes stripes = { camera.xres * camera.bytesPerPixel(), camera.yres, 0, 0, 0, 0, 0 };
+  uint8_t* jpeg = nullptr;
+  size_t size = 0;
+  BandedCaptureStats stats = {};
+  bool ok = captureBandedJPEG(&camera, 100, &jpeg, &size, &stats, checkStripe, &stripes);
+  printf("{\"name\": \"banded_capture/slot_full\", \"captured\": %s, \"frames\": %d, \"overruns\": %d}\n",
+         ok ? "true" : "false", stats.frames, stats.overruns);
+  CHECK(!ok);
+  CHECK(stats.frames == 1 && stats.overruns == 0);
+}
+
+int main()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, (size_t)FRAME_BUFFER_BYTES, 1 },
+    { BufferPool::LARGE, JPEG_SLOT_BYTES, 2 },
+  };
+  CHECK(bufferPool.begin(classes, 3));
+  OV7670 camera(IDLE, PINS, FRAME_BUFFER_MODE, FRAME_BUFFER_BYTES);
+  CHECK(camera.registerErrors == 0);
+
+  capture(camera, OV7670::QVGA_RGB565, "qvga_rgb565");
+  capture(camera, OV7670::VGA_RGB565, "vga_rgb565");
+  capture(camera, OV7670::VGA_YUV422, "vga_yuv422");
+  overrun(camera, 1, "overrun_once");
+  overrun(camera, BAND_ATTEMPTS, "overrun_always");
+  slotFull(camera);
+  //the camera is back to whole frames in its band afterwards
+  CHECK(camera.setMode(IDLE) && camera.oneFrame());
+  return checkResult("banded_capture_test");
+}
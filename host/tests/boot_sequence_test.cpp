@@ -0,0 +1,196 @@
+//BootSequence driven the way bootStep() and loop() drive it, on a simulated
+//clock: each local stage takes the time it takes on the board, Wi-Fi
+//associates in the background and the first Telegram hello fails. Checks the
+//stage order, that the radar arms before the camera and the recorder, that
+//the server waits for both the network and the camera, that the hello is the
+//first Telegram request, and that alerts raised before the node is online
+//are spooled and drained afterwards. Reports time-to-armed and
+//time-to-online; the stage times are estimates, not board measurements.
+
+#include <vector>
+#include "BootSequence.h"
+#include "check.h"
+
+//loop() pass: the radar read, serving and the delay at the end
+static const unsigned long PASS_MS = 25;
+//per stage, CAMERA_SETTLE per frame
+static const unsigned long STAGE_MS[] = { 40, 30, 250, 70, 1500, 0 };
+static const int SETTLE_FRAMES = 7;
+//the sketch's backoff after a failed request
+static const unsigned long SEND_BACKOFF = 30000;
+static const unsigned long REQUEST_MS = 800;
+//an alert holds the connection (triggerLock) this long
+static const unsigned long ALERT_MS = 3000;
+
+enum Request
+{
+  HELLO,
+  ALERT,
+  DRAIN,
+};
+
+struct Node
+{
+  BootSequence boot;
+  unsigned long now = 0;
+  unsigned long wifiAt;
+  int helloFailures;
+  int settleFrames = 0;
+  unsigned long retryAt = 0;
+  unsigned long lockedUntil = 0;
+  unsigned long serverAt = 0;
+  unsigned long cameraAt = 0;
+  std::vector<BootSequence::Stage> stages;
+  std::vector<Request> requests;
+  std::vector<unsigned long> spooled;  //raised at
+  std::vector<unsigned long> sent;
+  int drained = 0;
+
+  Node(unsigned long wifiAt, int helloFailures)
+    :wifiAt(wifiAt), helloFailures(helloFailures)
+  {
+  }
+
+  bool reachable() const
+  {
+    return now >= wifiAt && now >= retryAt;
+  }
+  bool telegramOnline() const
+  {
+    return boot.online() && reachable();
+  }
+
+  bool request(Request r)
+  {
+    requests.push_back(r);
+    now += REQUEST_MS;
+    if(r == HELLO && helloFailures > 0)
+    {
+      helloFailures--;
+      retryAt = now + SEND_BACKOFF;
+      return false;
+    }
+    return true;
+  }
+
+  void bootStep()
+  {
+    BootSequence::Stage stage = boot.stage();
+    if(stage != BootSequence::LOCAL_DONE)
+    {
+      now += STAGE_MS[stage];
+      if(stage != BootSequence::CAMERA_SETTLE || ++settleFrames == SETTLE_FRAMES)
+      {
+        stages.push_back(stage);
+        boot.stageDone(now);
+        if(stage == BootSequence::CAMERA)
+          cameraAt = now;
+      }
+    }
+    boot.wifi(now >= wifiAt, now);
+    if(boot.startServer())
+      serverAt = now;
+    if(boot.helloDue(now < lockedUntil) && reachable() && request(HELLO))
+      boot.helloSent(now);
+  }
+
+  //one loop() pass; presence raises an alert
+  void loop(bool presence)
+  {
+    bootStep();
+    //the radar is not read before it is armed
+    if(!boot.armed())
+    {
+      now += PASS_MS;
+      return;
+    }
+    if(presence && now >= lockedUntil)
+    {
+      unsigned long raised = now;
+      lockedUntil = now + ALERT_MS;
+      if(telegramOnline() && request(ALERT))
+        sent.push_back(raised);
+      else
+        spooled.push_back(raised);
+    }
+    if(drained < (int)spooled.size() && now >= lockedUntil && telegramOnline() && request(DRAIN))
+      drained = spooled.size();
+    now += PASS_MS;
+  }
+};
+
+static void run(Node& node, const std::vector<unsigned long>& presenceAt, unsigned long until, const char* name)
+{
+  size_t next = 0;
+  while(node.now < until)
+  {
+    bool presence = next < presenceAt.size() && node.now >= presenceAt[next];
+    if(presence)
+      next++;
+    node.loop(presence);
+  }
+  printf("{\"name\": \"boot_sequence/%s\", \"armed_ms\": %lu, \"camera_ms\": %lu, \"network_ms\": %lu, \"server_ms\": %lu, "
+         "\"online_ms\": %lu, \"alerts_spooled\": %zu, \"alerts_sent\": %zu, \"spool_drained\": %d}\n",
+         name, node.boot.armedMs, node.cameraAt, node.boot.networkMs, node.serverAt, node.boot.onlineMs,
+         node.spooled.size(), node.sent.size(), node.drained);
+}
+
+static void localOrder(const Node& node)
+{
+  std::vector<BootSequence::Stage> order = {
+    BootSequence::STORAGE, BootSequence::RADAR, BootSequence::CAMERA, BootSequence::CAMERA_SETTLE, BootSequence::RECORDER,
+  };
+  CHECK(node.stages == order);
+  CHECK(node.boot.stage() == BootSequence::LOCAL_DONE);
+  //armed in the second pass, after the spool and the radar only
+  CHECK(node.boot.armed() && node.boot.armedMs == STAGE_MS[0] + PASS_MS + STAGE_MS[1]);
+  CHECK(node.boot.armedMs < node.cameraAt);
+}
+
+int main()
+{
+  //Wi-Fi is up before the camera, the first hello fails; presence while the
+  //camera settles, during the backoff and after the hello went through
+  {
+    Node node(50, 1);
+    run(node, { 0, 400, 5000, 40000 }, 60000, "wifi_first_hello_fails");
+    localOrder(node);
+    CHECK(node.boot.networkUp() && node.boot.networkMs >= 50 && node.boot.networkMs < node.cameraAt);
+    //the server waits for the camera
+    CHECK(node.boot.serverStarted() && node.serverAt == node.cameraAt);
+    CHECK(node.boot.online() && node.boot.onlineMs > SEND_BACKOFF);
+    //the hello is the first request and the only one before online
+    CHECK(!node.requests.empty() && node.requests[0] == HELLO && node.requests[1] == HELLO);
+    //the presence at 0 ms came before the radar was armed; the next two
+    //were spooled and drained after the hello, the last one went out
+    CHECK(node.spooled.size() == 2 && node.sent.size() == 1);
+    for(unsigned long raised : node.spooled)
+      CHECK(raised < node.boot.onlineMs);
+    CHECK(node.sent[0] > node.boot.onlineMs);
+    CHECK(node.drained == 2);
+  }
+
+  //no Wi-Fi at all: the node still arms and takes every alert into the spool
+  {
+    Node node(~0UL, 0);
+    run(node, { 200, 5000, 20000 }, 30000, "offline");
+    localOrder(node);
+    CHECK(!node.boot.networkUp() && !node.boot.serverStarted() && !node.boot.online());
+    CHECK(node.requests.empty());
+    CHECK(node.spooled.size() == 3 && node.sent.empty());
+  }
+
+  //Wi-Fi comes up while the recorder is set up, the hello waits for the
+  //alert that holds the connection
+  {
+    Node node(2500, 0);
+    run(node, { 700 }, 10000, "wifi_late");
+    localOrder(node);
+    CHECK(node.boot.networkMs >= 2500 && node.serverAt == node.boot.networkMs);
+    CHECK(node.spooled.size() == 1 && node.sent.empty());
+    CHECK(node.boot.onlineMs >= node.spooled[0] + ALERT_MS);
+    CHECK(node.requests.size() == 2 && node.requests[0] == HELLO && node.requests[1] == DRAIN);
+    CHECK(node.drained == 1);
+  }
+  return checkResult("boot_sequence_test");
+}
@@ -0,0 +1,90 @@
+//The CPU time the capturing task spends in oneFrame() on the emulated
+//sensor (stubs/OV7670Sensor.h), blocked on the frame semaphore as it is now
+//and spinning on stopSignal as stop() used to. The line interrupts run on
+//the sensor's thread, so the caller's thread CPU time is its own wait. Then
+//a sensor in soft sleep: oneFrame() has to give up after timeoutMs, without
+//spinning either, and capture again once the sensor is back.
+
+#include <time.h>
+#include <chrono>
+#include "OV7670.h"
+#include "check.h"
+
+static const int FRAMES = 30;
+static const int TIMEOUT_MS = 100;
+
+static double threadMs()
+{
+  timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static double wallMs()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//stop() before the semaphores: the ISR clears stopSignal at the end of the
+//frame. i2sRun() also spun on the VSYNC pin then, left out here, it waits
+//on the semaphore as it does now
+static bool spinningFrame(OV7670& camera)
+{
+  if(!camera.start())
+    return false;
+  I2SCamera::stopSignal = true;
+  while(I2SCamera::stopSignal)
+    ;
+  return true;
+}
+
+//percent of the wall time the calling thread was on the CPU
+static double frames(OV7670& camera, bool spin, int& captured, double& msPerFrame)
+{
+  captured = 0;
+  double cpu = threadMs(), wall = wallMs();
+  for(int f = 0; f < FRAMES; f++)
+    captured += spin ? spinningFrame(camera) : camera.oneFrame();
+  cpu = threadMs() - cpu;
+  wall = wallMs() - wall;
+  msPerFrame = wall / FRAMES;
+  return 100 * cpu / wall;
+}
+
+int main()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, 160 * 120 * 2, 1 },
+  };
+  CHECK(bufferPool.begin(classes, 2));
+  OV7670 camera(OV7670::QQVGA_YUV422, 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25);
+  I2SCamera::timeoutMs = TIMEOUT_MS;
+
+  int blocked, spun;
+  double blockedMs, spunMs;
+  double blockedCpu = frames(camera, false, blocked, blockedMs);
+  double spunCpu = frames(camera, true, spun, spunMs);
+  printf("{\"name\": \"capture_wait/frames\", \"frames\": %d, \"ms_per_frame\": [%.2f, %.2f], \"caller_cpu_percent\": [%.1f, %.1f]}\n",
+         FRAMES, blockedMs, spunMs, blockedCpu, spunCpu);
+  CHECK(blocked == FRAMES && spun == FRAMES);
+  CHECK(blockedCpu < 20);
+  //with few cores the spin is preempted by the sensor's thread and its share varies
+  CHECK(spunCpu > 5 * blockedCpu);
+
+  //soft sleep, no VSYNC comes: the frame fails after the timeout
+  camera.park();
+  double cpu = threadMs(), wall = wallMs();
+  bool captured = camera.oneFrame();
+  cpu = threadMs() - cpu;
+  wall = wallMs() - wall;
+  camera.unpark();
+  bool recovered = camera.oneFrame();
+  printf("{\"name\": \"capture_wait/dead_sensor\", \"timeout_ms\": %d, \"gave_up_after_ms\": %.1f, \"caller_cpu_ms\": %.2f, \"recovered\": %s}\n",
+         TIMEOUT_MS, wall, cpu, recovered ? "true" : "false");
+  CHECK(!captured);
+  CHECK(wall >= TIMEOUT_MS && wall < 3 * TIMEOUT_MS);
+  CHECK(cpu < 10);
+  CHECK(recovered);
+  return checkResult("capture_wait_test");
+}
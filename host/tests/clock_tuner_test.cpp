@@ -0,0 +1,130 @@
+//ClockTuner on the emulated sensor (stubs/OV7670Sensor.h), whose frames take
+//as long as the pixel clock XCLK and CLKRC give. The candidates must come
+//fastest pixel clock first with the XCLK order kept on ties; tune() has to
+//measure every one of them and store the fastest clean one, which restore()
+//then applies again. With every candidate timing out the previous clock stays.
+//Per candidate the measured fps and whether it was clean.
+
+#include "ClockTuner.h"
+#include "OV7670Sensor.h"
+#include "check.h"
+
+#define PINS 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25
+
+static const OV7670::Mode MODE = OV7670::QQVGA_RGB565;
+//one frame per candidate keeps the run short, the table is still complete
+static const int FRAMES = 1;
+
+//the table tune() prints is not JSON, the results are printed instead
+class Discard: public Print
+{
+  public:
+  size_t write(uint8_t c) override
+  {
+    return 1;
+  }
+};
+
+static uint32_t pixelClock(const OV7670::Clock& c)
+{
+  return c.xclkHz / ((c.clkrc & 0x3f) + 1);
+}
+
+static bool same(const OV7670::Clock& a, const OV7670::Clock& b)
+{
+  return a.xclkHz == b.xclkHz && a.clkrc == b.clkrc;
+}
+
+static void ordering(OV7670::Mode m)
+{
+  OV7670::Clock list[ClockTuner::MAX_CANDIDATES];
+  int count = ClockTuner::candidates(m, list, ClockTuner::MAX_CANDIDATES);
+  CHECK(count == ClockTuner::MAX_CANDIDATES);
+  uint8_t keep = OV7670::defaultClock(m).clkrc & 0x80;
+  for(int i = 0; i < count; i++)
+  {
+    CHECK((list[i].clkrc & 0x80) == keep);
+    for(int j = 0; j < i; j++)
+      CHECK(!same(list[i], list[j]));
+    if(i == 0)
+      continue;
+    CHECK(pixelClock(list[i - 1]) >= pixelClock(list[i]));
+    //XCLK_HZ is fastest first, so a tie keeps the faster XCLK ahead
+    if(pixelClock(list[i - 1]) == pixelClock(list[i]))
+      CHECK(list[i - 1].xclkHz > list[i].xclkHz);
+  }
+  //a list too small for all of them is filled, not overrun
+  OV7670::Clock few[4];
+  CHECK(ClockTuner::candidates(m, few, 4) == 4);
+}
+
+int main()
+{
+  ordering(OV7670::QQVGA_RGB565);
+  ordering(OV7670::VGA_RGB565);
+
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, (size_t)OV7670::modeBytes(MODE), 1 },
+  };
+  CHECK(bufferPool.begin(classes, 2));
+  OV7670 camera(MODE, PINS);
+  CHECK(camera.registerErrors == 0);
+  Discard table;
+
+  //every candidate measured, the fastest clean one stored and applied
+  Preferences prefs;
+  ClockTuner tuner(prefs, FRAMES);
+  ClockTuner::Result results[ClockTuner::MAX_CANDIDATES];
+  bool tuned = tuner.tune(camera, MODE, table, results);
+  OV7670::Clock list[ClockTuner::MAX_CANDIDATES];
+  int count = ClockTuner::candidates(MODE, list, ClockTuner::MAX_CANDIDATES);
+  int best = -1;
+  for(int i = 0; i < count; i++)
+  {
+    const ClockTuner::Result& r = results[i];
+    printf("{\"name\": \"clock_tuner/%lu_khz_clkrc_%02x\", \"pclk_khz\": %lu, \"fps\": %.1f, \"frames\": %d, \"torn\": %d, "
+           "\"timeouts\": %d, \"isr_load_percent\": %d, \"clean\": %s}\n",
+           (unsigned long)(r.clock.xclkHz / 1000), r.clock.clkrc, (unsigned long)(pixelClock(r.clock) / 1000),
+           r.fps10() / 10.0, r.frames, r.shortFrames, r.timeouts, r.isrLoad, r.clean() ? "true" : "false");
+    CHECK(same(r.clock, list[i]));
+    CHECK(r.frames + r.timeouts > 0);
+    if(best < 0 && r.clean())
+      best = i;
+  }
+  //the emulated sensor keeps up at any clock
+  CHECK(tuned && best >= 0);
+  CHECK(same(camera.clock(MODE), list[best]));
+  //a slower clock takes longer per frame
+  CHECK(results[0].ms < results[count - 1].ms);
+
+  //the stored key comes back on the next boot, and only for the tuned mode
+  camera.setClock(MODE, OV7670::defaultClock(MODE));
+  ClockTuner boot(prefs);
+  CHECK(boot.restore(camera) == 1);
+  CHECK(same(camera.clock(MODE), list[best]));
+  CHECK(same(camera.clock(OV7670::VGA_RGB565), OV7670::defaultClock(OV7670::VGA_RGB565)));
+  boot.forget(MODE);
+  CHECK(boot.restore(camera) == 0);
+
+  //no candidate clean: every frame times out, the previous clock stays and
+  //nothing is stored
+  OV7670::Clock before = { 10000000, 0x81 };
+  camera.setClock(MODE, before);
+  int timeoutMs = I2SCamera::timeoutMs;
+  I2SCamera::timeoutMs = 5;
+  Preferences empty;
+  ClockTuner failing(empty, FRAMES);
+  bool failed = !failing.tune(camera, MODE, table, results);
+  I2SCamera::timeoutMs = timeoutMs;
+  CHECK(failed);
+  for(int i = 0; i < count; i++)
+    CHECK(!results[i].clean());
+  CHECK(same(camera.clock(MODE), before));
+  CHECK(failing.restore(camera) == 0);
+  //and the camera still captures at it
+  CHECK(camera.oneFrame() && camera.oneFrame());
+  printf("{\"name\": \"clock_tuner/none_clean\", \"kept_xclk_khz\": %lu, \"kept_clkrc\": %d}\n",
+         (unsigned long)(camera.clock(MODE).xclkHz / 1000), camera.clock(MODE).clkrc);
+  return checkResult("clock_tuner_test");
+}
@@ -0,0 +1,213 @@
+//Alert delivery latency under live view load, with and without the egress
+//scheduler, on a simulated link; then a recording download that an alert
+//has to cut off.
+//
+//The link moves its capacity every millisecond and shares it evenly between
+//the sockets that have bytes queued. Each socket queues up to SNDBUF bytes,
+//a write beyond that blocks the single threaded loop as it does on the
+//device. Viewers send a BULK update of UPDATE bytes every UPDATE_MS; the
+//alert is the radar trigger, PREP_MS of photos taken across loop passes,
+//during which the viewers are still served, and the upload. Its latency
+//runs from the trigger until the last byte is on the air.
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <filesystem>
+#include <vector>
+#include "EgressScheduler.h"
+#include "RecordingDownload.h"
+#include "check.h"
+
+static const long SNDBUF = 5744;
+static const long UPDATE = 8000;
+static const long UPDATE_MS = 250;
+static const long ALERT_BYTES = 60000;
+static const long PREP_MS = 300;
+static const long TRIGGER_MS = 2000;
+static const long LOOP_MS = 20;
+
+class Link
+{
+  public:
+  explicit Link(long bytesPerSecond, int sockets)
+    :rate(bytesPerSecond), queued(sockets, 0)
+  {
+  }
+
+  long now = 0;
+
+  void tick()
+  {
+    carry += rate / 1000.0;
+    long capacity = (long)carry;
+    carry -= capacity;
+    while(capacity > 0)
+    {
+      int busy = 0;
+      for(long q : queued)
+        busy += q > 0;
+      if(!busy)
+        break;
+      long share = std::max(1L, capacity / busy);
+      for(long& q : queued)
+      {
+        long n = std::min({ share, q, capacity });
+        q -= n;
+        capacity -= n;
+      }
+    }
+    now++;
+  }
+
+  void write(int socket, long bytes)
+  {
+    while(bytes)
+    {
+      long n = std::min(bytes, SNDBUF - queued[socket]);
+      queued[socket] += n;
+      bytes -= n;
+      if(bytes)
+        tick();
+    }
+  }
+
+  bool idle(int socket) const
+  {
+    return !queued[socket];
+  }
+
+  private:
+  long rate;
+  double carry = 0;
+  std::vector<long> queued;
+};
+
+//ms from the trigger until the alert is sent; socket 0 is the alert's
+static long alertLatency(long bytesPerSecond, int viewers, bool scheduled)
+{
+  Link link(bytesPerSecond, viewers + 1);
+  EgressScheduler egress(bytesPerSecond);
+  std::vector<long> lastUpdate(viewers, 0);
+  long triggered = -1;
+  for(;;)
+  {
+    if(triggered < 0 && link.now >= TRIGGER_MS)
+    {
+      triggered = link.now;
+      if(scheduled)
+        egress.alertPending(link.now);
+    }
+    if(triggered >= 0 && link.now - triggered >= PREP_MS)
+    {
+      link.write(0, ALERT_BYTES);
+      while(!link.idle(0))
+        link.tick();
+      if(scheduled)
+        egress.alertDone(link.now);
+      return link.now - triggered;
+    }
+    for(int v = 0; v < viewers; v++)
+    {
+      if(link.now - lastUpdate[v] < UPDATE_MS)
+        continue;
+      if(scheduled && !egress.admit(EgressScheduler::BULK, link.now))
+        continue;
+      lastUpdate[v] = link.now;
+      link.write(v + 1, UPDATE);
+      if(scheduled)
+        egress.sent(EgressScheduler::BULK, UPDATE, link.now);
+    }
+    for(long t = 0; t < LOOP_MS; t++)
+      link.tick();
+  }
+}
+
+static void latencies()
+{
+  for(long rate : { 20000L, 40000L, 100000L })
+  {
+    long alone = alertLatency(rate, 0, true);
+    for(int viewers : { 0, 2, 5 })
+    {
+      long unscheduled = alertLatency(rate, viewers, false);
+      long scheduled = alertLatency(rate, viewers, true);
+      printf("{\"name\": \"egress/alert_latency\", \"link_bytes_per_s\": %ld, \"viewers\": %d, "
+             "\"unscheduled_ms\": %ld, \"scheduled_ms\": %ld}\n",
+             rate, viewers, unscheduled, scheduled);
+      //what the viewers had queued before the trigger drains during the
+      //capture, the upload itself then has the link
+      CHECK(scheduled <= unscheduled);
+      CHECK(scheduled <= alone + (long)EgressScheduler::WINDOW_MS);
+    }
+  }
+}
+
+//a download of a 256 KB file through a socket pair, the reader takes what
+//arrived every pass; an alert pending after 32 KB ends it
+static void downloadCutOff()
+{
+  static const size_t FILE_BYTES = 256 * 1024;
+  const char* root = "egress_latency_test.flash";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  fs::FS flash(root);
+  File out = flash.open("/segment.avi", "w");
+  std::vector<uint8_t> data(FILE_BYTES);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = i * 13 >> 3;
+  out.write(data.data(), data.size());
+  out.close();
+
+  for(bool alert : { false, true })
+  {
+    int pair[2];
+    CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+    EgressScheduler egress(1000000);
+    RecordingDownload download(egress);
+    {
+      WiFiClient client(pair[0]);
+      File file = flash.open("/segment.avi", "r");
+      download.begin(client, file, FILE_BYTES);
+    }
+    std::vector<uint8_t> received;
+    uint8_t buffer[4096];
+    bool active = true;
+    for(unsigned long now = 0; active && now < 100000; now += 5)
+    {
+      if(alert && received.size() >= 32 * 1024 && !egress.alertActive(now))
+        egress.alertPending(now);
+      active = download.service(now);
+      ssize_t n;
+      while((n = recv(pair[1], buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+        received.insert(received.end(), buffer, buffer + n);
+    }
+    CHECK(!download.active());
+    //the socket is closed once the download ends
+    ssize_t n;
+    while((n = recv(pair[1], buffer, sizeof(buffer), 0)) > 0)
+      received.insert(received.end(), buffer, buffer + n);
+    CHECK(n == 0);
+    CHECK(!memcmp(received.data(), data.data(), received.size()));
+    if(alert)
+    {
+      CHECK(download.cutOffs == 1);
+      //what was in the socket when the alert came, and no more
+      CHECK(received.size() < 32 * 1024 + RecordingDownload::CHUNK * RecordingDownload::CHUNKS);
+    }
+    else
+      CHECK(received.size() == FILE_BYTES);
+    printf("{\"name\": \"egress/download\", \"alert\": %s, \"received\": %u, \"cut_offs\": %lu}\n",
+           alert ? "true" : "false", (unsigned)received.size(), download.cutOffs);
+    close(pair[1]);
+  }
+  std::filesystem::remove_all(root);
+}
+
+int main()
+{
+  signal(SIGPIPE, SIG_IGN);
+  latencies();
+  downloadCutOff();
+  return checkResult("egress_latency_test");
+}
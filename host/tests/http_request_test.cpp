@@ -0,0 +1,62 @@
+//HttpRequest, the request head parsing of serve(): request line, the Range
+//and Sec-WebSocket-Key headers and the byte ranges /recordings serves.
+
+#include "HttpRequest.h"
+#include "check.h"
+
+static bool feed(HttpRequest& request, const char* text)
+{
+  bool complete = false;
+  for(const char* c = text; *c; c++)
+    complete = request.add(*c);
+  return complete;
+}
+
+static HttpRequest::RangeResult range(const char* header, size_t length, size_t& first, size_t& last)
+{
+  HttpRequest request;
+  std::string text = std::string("GET /recordings/3.avi HTTP/1.1\r\n") + header + "\r\n\r\n";
+  feed(request, text.c_str());
+  return request.byteRange(length, first, last);
+}
+
+int main()
+{
+  {
+    HttpRequest request;
+    CHECK(!feed(request, "GET /live HTTP/1.1\r\nHost: cam\r\n"));
+    CHECK(!request.complete());
+    CHECK(feed(request, "\r\n"));
+    CHECK(request.requestLine == "GET /live HTTP/1.1");
+    CHECK(request.range.length() == 0);
+    CHECK(request.webSocketKey.length() == 0);
+  }
+  {
+    //bare \n line ends, headers of both spellings
+    HttpRequest request;
+    CHECK(feed(request, "GET /telemetry HTTP/1.1\nUpgrade: websocket\nSec-WebSocket-Key:  dGhlIHNhbXBsZSBub25jZQ== \nrange: bytes=5-\n\n"));
+    CHECK(request.requestLine == "GET /telemetry HTTP/1.1");
+    CHECK(request.webSocketKey == "dGhlIHNhbXBsZSBub25jZQ==");
+    CHECK(request.range == "range: bytes=5-");
+  }
+  {
+    //what follows the head is left alone
+    HttpRequest request;
+    CHECK(feed(request, "GET /boot HTTP/1.1\r\n\r\n"));
+    CHECK(feed(request, "ignored after the head"));
+    CHECK(request.requestLine == "GET /boot HTTP/1.1");
+  }
+
+  size_t first, last;
+  CHECK(range("Host: cam", 1000, first, last) == HttpRequest::WHOLE && first == 0 && last == 999);
+  CHECK(range("Range: bytes=0-99", 1000, first, last) == HttpRequest::PARTIAL && first == 0 && last == 99);
+  CHECK(range("Range: bytes=500-", 1000, first, last) == HttpRequest::PARTIAL && first == 500 && last == 999);
+  CHECK(range("Range: bytes=900-5000", 1000, first, last) == HttpRequest::PARTIAL && first == 900 && last == 999);
+  CHECK(range("Range: bytes=-100", 1000, first, last) == HttpRequest::PARTIAL && first == 900 && last == 999);
+  CHECK(range("Range: bytes=-5000", 1000, first, last) == HttpRequest::PARTIAL && first == 0 && last == 999);
+  CHECK(range("Range: bytes=10-20, 30-40", 1000, first, last) == HttpRequest::PARTIAL && first == 10 && last == 20);
+  CHECK(range("Range: bytes=1000-", 1000, first, last) == HttpRequest::UNSATISFIABLE);
+  CHECK(range("Range: bytes=50-10", 1000, first, last) == HttpRequest::UNSATISFIABLE);
+  CHECK(range("Range: bytes=abc", 1000, first, last) == HttpRequest::UNSATISFIABLE);
+  return checkResult("http_request_test");
+}
@@ -0,0 +1,206 @@
+//LiveView on generated QQVGA sequences: a static room with sensor noise and
+//the same room with a person walking through. A local client parses every
+//message, keeps the tiles it was sent and must end up with the last frame.
+//The bandwidth is compared with a full JPEG per update at the same quality,
+//what the <img> dashboard fetched; the static scene has to save over 90%.
+
+#include <math.h>
+#include <random>
+#include <vector>
+#include "LiveView.h"
+#include "BufferPool.h"
+#include "check.h"
+
+static const int WIDTH = 160;
+static const int HEIGHT = 120;
+static const int TILES_X = WIDTH / LiveView::TILE;
+static const int TILES_Y = HEIGHT / LiveView::TILE + (HEIGHT % LiveView::TILE ? 1 : 0);
+//30 s of updates, three keyframes
+static const int FRAMES = 120;
+
+//U Y V Y, bottom up like the camera stores it; a textured room with two
+//objects, optionally a dark person sized block at x
+struct Room
+{
+  std::mt19937 random{44};
+  std::normal_distribution<double> noise{0, 2};
+  uint8_t frame[WIDTH * HEIGHT * 2];
+
+  int luma(int x, int y)
+  {
+    double v = 60 + 80 * x / WIDTH + 30 * sin(y / 9.0) + (x * 13 + y * 7) % 20;
+    if(x >= 20 && x < 50 && y >= 30 && y < 70)
+      v = 170;
+    if(x >= 100 && x < 150 && y >= 80 && y < 110)
+      v = 40;
+    return (int)lround(v + noise(random));
+  }
+
+  const uint8_t* render(int person = -1)
+  {
+    for(int y = 0; y < HEIGHT; y++)
+    {
+      uint8_t* p = frame + (HEIGHT - 1 - y) * WIDTH * 2;
+      for(int x = 0; x < WIDTH; x++, p += 2)
+      {
+        int v = person >= 0 && x >= person && x < person + 18 && y >= 40 && y < 100 ? 25 + (int)noise(random) : luma(x, y);
+        p[0] = x & 1 ? 135 : 120;
+        p[1] = v < 0 ? 0 : v > 255 ? 255 : v;
+      }
+    }
+    return frame;
+  }
+};
+
+//4x4 block mean luma of a tile, as the viewer sees it
+static void blockMeans(const uint8_t* frame, int tx, int ty, uint8_t* means)
+{
+  for(int b = 0; b < 16; b++)
+  {
+    int sum = 0;
+    for(int y = 0; y < 4; y++)
+    {
+      int row = std::min(ty * 16 + b / 4 * 4 + y, HEIGHT - 1);
+      const uint8_t* p = frame + (HEIGHT - 1 - row) * WIDTH * 2 + (tx * 16 + b % 4 * 4) * 2;
+      for(int x = 0; x < 4; x++)
+        sum += p[x * 2 + 1];
+    }
+    means[b] = sum >> 4;
+  }
+}
+
+//parses the stream and keeps the block means of every tile it was sent
+struct Viewer : public Print
+{
+  std::vector<uint8_t> pending;
+  const uint8_t* frame = nullptr;
+  uint8_t canvas[TILES_X * TILES_Y][16];
+  bool painted[TILES_X * TILES_Y] = {};
+  size_t bytes = 0;
+  int messages = 0;
+  int keyframes = 0;
+  bool valid = true;
+
+  size_t write(uint8_t c) override
+  {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* data, size_t size) override
+  {
+    pending.insert(pending.end(), data, data + size);
+    bytes += size;
+    return size;
+  }
+
+  static unsigned u16(const uint8_t* p)
+  {
+    return p[0] | p[1] << 8;
+  }
+
+  //after every update: one whole message or none
+  void receive()
+  {
+    if(pending.empty())
+      return;
+    const uint8_t* m = pending.data();
+    unsigned count = pending.size() >= 10 ? u16(m + 8) : 0;
+    size_t head = 10 + count * 2 + 4;
+    valid = valid && count && pending.size() >= head && m[0] == 'L' && m[1] == 'V'
+         && u16(m + 4) == WIDTH && u16(m + 6) == HEIGHT && m[3] == std::min<unsigned>(count, LiveView::MOSAIC_TILES);
+    if(!valid)
+      return;
+    const uint8_t* tiles = m + 10;
+    size_t jpeg = m[head - 4] | m[head - 3] << 8 | m[head - 2] << 16 | (size_t)m[head - 1] << 24;
+    const uint8_t* j = m + head;
+    valid = pending.size() == head + jpeg && jpeg > 4 && j[0] == 0xff && j[1] == 0xd8 && j[jpeg - 2] == 0xff && j[jpeg - 1] == 0xd9;
+    for(unsigned i = 0; i < count && valid; i++)
+    {
+      int tx = tiles[i * 2], ty = tiles[i * 2 + 1];
+      valid = tx < TILES_X && ty < TILES_Y;
+      if(valid)
+      {
+        blockMeans(frame, tx, ty, canvas[ty * TILES_X + tx]);
+        painted[ty * TILES_X + tx] = true;
+      }
+    }
+    if(m[2] & 1)
+    {
+      keyframes++;
+      valid = valid && count == (unsigned)(TILES_X * TILES_Y);
+    }
+    messages++;
+    pending.clear();
+  }
+
+  //the largest block mean step between the canvas and frame
+  int difference(const uint8_t* frame) const
+  {
+    int worst = 0;
+    for(int t = 0; t < TILES_X * TILES_Y; t++)
+    {
+      uint8_t means[16];
+      blockMeans(frame, t % TILES_X, t / TILES_X, means);
+      for(int b = 0; b < 16; b++)
+        worst = std::max(worst, painted[t] ? abs(means[b] - canvas[t][b]) : 255);
+    }
+    return worst;
+  }
+};
+
+static size_t fullJpeg(const uint8_t* frame)
+{
+  static JpegEncoder encoder;
+  JpegEncoder::Buffer jpeg = { nullptr, 0, 0 };
+  bool ok = encoder.begin(WIDTH, HEIGHT, LiveView::QUALITY, JpegEncoder::memoryWriter, &jpeg, JpegEncoder::YUV422);
+  for(int y = HEIGHT; y > 0 && ok; y -= 16)
+    ok = encoder.addStripe(frame + (y - std::min(y, 16)) * WIDTH * 2, std::min(y, 16), true);
+  ok = ok && encoder.finish();
+  free(jpeg.data);
+  return ok ? jpeg.size : 0;
+}
+
+//returns the savings in percent
+static double sequence(const char* name, bool walker)
+{
+  Room room;
+  LiveView live;
+  static Viewer viewer;
+  viewer = Viewer();
+  size_t full = 0;
+  bool updated = true;
+  for(int f = 0; f < FRAMES; f++)
+  {
+    //the person crosses the frame in 30 updates and leaves it
+    int person = walker && f >= 40 && f < 70 ? (f - 40) * 5 : -1;
+    viewer.frame = room.render(person);
+    updated = live.update(viewer.frame, WIDTH, HEIGHT, viewer) && updated;
+    viewer.receive();
+    full += fullJpeg(viewer.frame);
+    hostClockSkipMs += LiveView::INTERVAL;
+  }
+  double seconds = FRAMES * LiveView::INTERVAL / 1000.0;
+  double saved = 100.0 - 100.0 * viewer.bytes / full;
+  int difference = viewer.difference(viewer.frame);
+  printf("{\"name\": \"live_view/%s\", \"frames\": %d, \"full_jpeg_bytes_per_s\": %.0f, \"tile_bytes_per_s\": %.0f, "
+         "\"saved_percent\": %.1f, \"updates\": %lu, \"keyframes\": %lu, \"tiles\": %lu, \"canvas_difference\": %d}\n",
+         name, FRAMES, full / seconds, viewer.bytes / seconds, saved, live.updates, live.keyframes, live.tilesSent, difference);
+  CHECK(updated);
+  CHECK(viewer.valid);
+  CHECK(viewer.messages == (int)live.updates);
+  CHECK(viewer.keyframes == (int)live.keyframes);
+  CHECK(live.keyframes == (unsigned long)(FRAMES * LiveView::INTERVAL / LiveView::KEYFRAME_INTERVAL));
+  CHECK(viewer.bytes == live.bytesSent);
+  //every tile the viewer has is within the change threshold of the last frame
+  CHECK(difference <= LiveView::CHANGE_THRESHOLD);
+  return saved;
+}
+
+int main()
+{
+  BufferPool::Class large = { BufferPool::LARGE, 32 * 1024, 1 };
+  CHECK(bufferPool.begin(&large, 1));
+  CHECK(sequence("static", false) > 90);
+  CHECK(sequence("walker", true) > 50);
+  return checkResult("live_view_test");
+}
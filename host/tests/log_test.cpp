@@ -0,0 +1,201 @@
+//Logger with its drain task running: the formatting of every argument type,
+//a mismatched argument, the history /log serves, a level above LOGLEVEL
+//leaving no record; then the cost of a call, alone and with four threads
+//logging at once, where every record must come out whole and in order per
+//thread or be counted as dropped. The threads log flat out, most of it
+//dropped, and paced to what the drain keeps up with.
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Log.h"
+#include "check.h"
+
+static const int CALLS = 50000;
+static const int PRODUCERS = 4;
+static const int PER_PRODUCER = 4000;
+//about 6 KB of the records below, what the ring holds with room to spare
+static const int BATCH = 128;
+
+//what the drain task writes, read by the test thread
+class Capture : public Print
+{
+  public:
+  size_t write(uint8_t c) override
+  {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* data, size_t size) override
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    text.append((const char*)data, size);
+    return size;
+  }
+
+  std::string take()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string taken;
+    taken.swap(text);
+    return taken;
+  }
+
+  private:
+  std::mutex mutex;
+  std::string text;
+};
+
+static Capture capture;
+
+static double nanosSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+//until the drain task has taken everything committed or dropped; settle
+//for the last line to be written too
+static void drained(unsigned long expected, bool settle = true)
+{
+  for(int i = 0; i < 5000 && logger.records + logger.dropped < expected; i++)
+    delay(1);
+  if(settle)
+    delay(20);
+}
+
+static bool contains(const std::string& text, const char* part)
+{
+  return text.find(part) != std::string::npos;
+}
+
+static void formatting()
+{
+  unsigned long before = logger.records;
+  const char* host = "api.telegram.org";
+  LOGI("main", "Sent %u bytes: delivered in %lu ms, target %lu ms\n", 23456u, 812ul, 4000ul);
+  LOGW("net", "%s:%d -> %-6s|%5.2f|%x|%lld|%c|%p|100%%", host, 443, "ok", 3.14159f, 255, -12345678901LL, 'Z', (void*)0x1234);
+  LOGD("main", "debug %d", 1);
+  LOGE("main", "mismatch %s", 42);
+  drained(before + 3);
+  std::string out = capture.take();
+  CHECK(logger.records == before + 3);
+  CHECK(contains(out, " I main: Sent 23456 bytes: delivered in 812 ms, target 4000 ms\n"));
+  CHECK(contains(out, " W net: api.telegram.org:443 -> ok    | 3.14|ff|-12345678901|Z|0x1234|100%\n"));
+  CHECK(contains(out, " E main: mismatch <?>\n"));
+  CHECK(!contains(out, "debug"));
+
+  //the history GET /log serves ends with the same lines
+  struct : public Print
+  {
+    std::string text;
+    size_t write(uint8_t c) override
+    {
+      text += (char)c;
+      return 1;
+    }
+  } history;
+  logger.printHistory(history);
+  CHECK(contains(history.text, "E main: mismatch <?>\n"));
+}
+
+static void cost()
+{
+  const char* lock = "Open";
+  unsigned long expected = logger.records + logger.dropped;
+  double total = 0;
+  for(int done = 0; done < CALLS; done += BATCH)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < BATCH; i++)
+      LOGI("main", "Distance: %d cm | Count: %d | Lock: %s", i, done, lock);
+    total += nanosSince(start);
+    expected += BATCH;
+    drained(expected, false);
+  }
+  double perCall = total / CALLS;
+  drained(expected);
+  capture.take();
+
+  unsigned long records = logger.records;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < CALLS; i++)
+    LOGD("main", "Distance: %d cm", i);
+  double stripped = nanosSince(start) / CALLS;
+
+  char line[Logger::MAX_LINE];
+  start = std::chrono::steady_clock::now();
+  for(int i = 0; i < CALLS / 10; i++)
+    snprintf(line, sizeof(line), "Distance: %d cm | Count: %d | Lock: %s\n", i, i, lock);
+  double formatted = nanosSince(start) / (CALLS / 10);
+
+  printf("{\"name\": \"log/cost\", \"logi_ns\": %.0f, \"logd_stripped_ns\": %.2f, \"snprintf_ns\": %.0f, \"dropped\": %lu}\n",
+         perCall, stripped, formatted, logger.dropped);
+  CHECK(logger.dropped == 0);
+  CHECK(logger.records == records);
+  CHECK(perCall < 1000);
+  CHECK(stripped < 5);
+}
+
+//pauseMs after every 16 records per thread, 0 for none
+static void contention(const char* name, int pauseMs)
+{
+  capture.take();
+  unsigned long before = logger.records;
+  unsigned long droppedBefore = logger.dropped;
+  double nanos[PRODUCERS] = {};
+  std::vector<std::thread> producers;
+  for(int p = 0; p < PRODUCERS; p++)
+    producers.emplace_back([p, pauseMs, &nanos]() {
+      for(int i = 0; i < PER_PRODUCER; i++)
+      {
+        auto start = std::chrono::steady_clock::now();
+        LOGI("mt", "p%d seq %d tag %s", p, i, "xyzzy");
+        nanos[p] += nanosSince(start);
+        if(pauseMs && i % 16 == 15)
+          std::this_thread::sleep_for(std::chrono::milliseconds(pauseMs));
+      }
+    });
+  for(std::thread& t : producers)
+    t.join();
+  drained(before + droppedBefore + PRODUCERS * PER_PRODUCER);
+  unsigned long records = logger.records - before;
+  unsigned long dropped = logger.dropped - droppedBefore;
+
+  std::string out = capture.take();
+  int last[PRODUCERS] = { -1, -1, -1, -1 };
+  long lines = 0, bad = 0;
+  for(size_t at = 0; (at = out.find(" mt: ", at)) != std::string::npos; at++)
+  {
+    int p, i;
+    char tag[8];
+    if(sscanf(out.c_str() + at, " mt: p%d seq %d tag %7s", &p, &i, tag) != 3 || p < 0 || p >= PRODUCERS
+       || strcmp(tag, "xyzzy") || i <= last[p])
+      bad++;
+    else
+      last[p] = i;
+    lines++;
+  }
+  double perCall = 0;
+  for(double n : nanos)
+    perCall += n / (PRODUCERS * PER_PRODUCER);
+  printf("{\"name\": \"log/contention_%s\", \"producers\": %d, \"records\": %lu, \"dropped\": %lu, \"lines\": %ld, "
+         "\"corrupt\": %ld, \"logi_ns\": %.0f}\n",
+         name, PRODUCERS, records, dropped, lines, bad, perCall);
+  CHECK(records + dropped == (unsigned long)(PRODUCERS * PER_PRODUCER));
+  CHECK(lines == (long)records);
+  CHECK(bad == 0);
+  CHECK(perCall < 1000);
+}
+
+int main()
+{
+  logger.begin(capture);
+  formatting();
+  cost();
+  contention("flat_out", 0);
+  //8 records per ms in all, some 3.5 KB per 10 ms drain pass
+  contention("paced", 8);
+  return checkResult("log_test");
+}
@@ -0,0 +1,96 @@
+//OV7670::setMode() on the emulated sensor (stubs/OV7670Sensor.h). A camera
+//built the way the sketch used to build it, with no largest mode, must still
+//hold its own mode's frame. Then idle -> VGA -> idle with the sketch's
+//QQVGA sized frame buffer, VGA captured in bands of it: per switch the SCCB
+//writes and their time at 400 kHz, the switch latency, the sensor frames
+//from the switch until the first frame of the new mode is captured, and
+//that frame, which must have the new geometry and be the sensor's lines.
+
+#include <algorithm>
+#include "OV7670.h"
+#include "OV7670Sensor.h"
+#include "check.h"
+
+#define PINS 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25
+
+static const OV7670::Mode IDLE = OV7670::QQQVGA_RGB565;
+static const OV7670::Mode ALERT = OV7670::VGA_RGB565;
+static const OV7670::Mode FRAME_BUFFER_MODE = OV7670::QQVGA_RGB565;
+
+//the frame band by band; false if a band was not captured or a line is not
+//the sensor's
+static bool cleanFrame(OV7670& camera)
+{
+  int lineBytes = camera.xres * camera.bytesPerPixel();
+  if(hostSensorLines() != camera.yres || hostSensorLineBytes() != lineBytes)
+    return false;
+  int bandLines = std::min(camera.maxBandLines(), camera.yres);
+  for(int first = 0; first < camera.yres; first += bandLines)
+  {
+    int lines = std::min(bandLines, camera.yres - first);
+    if(!camera.setBand(first, lines) || !camera.oneFrame())
+      return false;
+    for(int y = 0; y < lines; y++)
+      for(int k = 0; k < lineBytes; k++)
+        if(camera.frame[y * lineBytes + k] != hostSensorByte(first + y, k))
+          return false;
+  }
+  return true;
+}
+
+static void release()
+{
+  I2SCamera::dmaBufferDeinit();
+  bufferPool.give(I2SCamera::frame);
+  I2SCamera::frame = nullptr;
+}
+
+static void switchTo(OV7670& camera, OV7670::Mode m, const char* name)
+{
+  unsigned long transactions = Wire.transactions, bits = Wire.bits;
+  unsigned long frames = hostSensorFrames();
+  bool switched = camera.setMode(m);
+  transactions = Wire.transactions - transactions;
+  bits = Wire.bits - bits;
+  camera.setBand(0, std::min(camera.maxBandLines(), camera.yres));
+  bool captured = camera.oneFrame();
+  //the frame the capture came from is the last one streamed
+  unsigned long resync = hostSensorFrames() - frames;
+  bool clean = cleanFrame(camera);
+  printf("{\"name\": \"mode_switch/%s\", \"xres\": %d, \"yres\": %d, \"band_lines\": %d, \"sccb_writes\": %lu, \"sccb_ms\": %.2f, "
+         "\"switch_us\": %lu, \"frames_to_capture\": %lu}\n",
+         name, camera.xres, camera.yres, std::min(camera.maxBandLines(), camera.yres), transactions, bits / 400.0,
+         camera.modeSwitchMicros, resync);
+  CHECK(switched && captured);
+  CHECK(camera.currentMode() == m);
+  CHECK(camera.xres == OV7670::modeXres(m) && camera.yres == OV7670::modeYres(m));
+  CHECK(clean);
+  //the frame in flight during the writes and the one setMode() waits out
+  CHECK(resync <= 3);
+}
+
+int main()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, OV7670::modeBytes(FRAME_BUFFER_MODE), 1 },
+  };
+  CHECK(bufferPool.begin(classes, 2));
+
+  {
+    OV7670 camera(FRAME_BUFFER_MODE, PINS);
+    CHECK(camera.registerErrors == 0);
+    CHECK(camera.maxBandLines() >= camera.yres);
+    CHECK(cleanFrame(camera));
+    release();
+  }
+
+  OV7670 camera(IDLE, PINS, FRAME_BUFFER_MODE);
+  CHECK(camera.registerErrors == 0);
+  CHECK(cleanFrame(camera));
+  switchTo(camera, ALERT, "idle_to_vga");
+  switchTo(camera, IDLE, "vga_to_idle");
+  CHECK(camera.registerErrors == 0);
+  release();
+  return checkResult("mode_switch_test");
+}
@@ -0,0 +1,163 @@
+//MotionDetector on generated thumbnail sequences: a still scene with sensor
+//noise, an exposure step, a person sized block walking through, a burst
+//ranked with evaluate(), an object that stays and is absorbed; then the
+//time per update at the QQVGA and QVGA thumbnail sizes.
+
+#include <chrono>
+#include <random>
+#include "MotionDetector.h"
+#include "check.h"
+
+//a textured background, gain and offset for exposure, an optional block of
+//w x h tiles at x, y
+struct Scene
+{
+  int width;
+  int height;
+  std::mt19937 random{7};
+
+  void render(FrameStats& stats, int offset, int bx = -1, int by = 0, int bw = 0, int bh = 0)
+  {
+    stats.thumbWidth = width;
+    stats.thumbHeight = height;
+    for(int y = 0; y < height; y++)
+      for(int x = 0; x < width; x++)
+      {
+        int v = 60 + x * 100 / width + (y * 7 % 23) + offset + (int)(random() % 5) - 2;
+        if(x >= bx && x < bx + bw && y >= by && y < by + bh)
+          v = 200 + (int)(random() % 5);
+        stats.thumbnail[y * width + x] = v < 0 ? 0 : v > 255 ? 255 : v;
+      }
+  }
+};
+
+static FrameStats stats;
+
+static void stillAndExposure()
+{
+  Scene scene = { 20, 15 };
+  MotionDetector detector;
+  int worst = 0;
+  for(int f = 0; f < 100; f++)
+  {
+    scene.render(stats, f >= 50 ? 25 : 0);
+    MotionResult r = detector.update(stats);
+    CHECK(r.valid == (f >= MotionDetector::WARMUP_FRAMES));
+    if(r.valid)
+      worst = std::max(worst, r.score);
+  }
+  printf("{\"name\": \"motion/still_and_exposure_step\", \"worst_score_permille\": %d}\n", worst);
+  CHECK(worst <= 10);
+}
+
+static void walker()
+{
+  Scene scene = { 20, 15 };
+  MotionDetector detector;
+  for(int f = 0; f < 30; f++)
+  {
+    scene.render(stats, 0);
+    detector.update(stats);
+  }
+  int missed = 0;
+  for(int x = 0; x + 4 <= 20; x++)
+  {
+    scene.render(stats, 0, x, 5, 4, 8);
+    MotionResult r = detector.update(stats);
+    //the box holds the block, in frame pixels
+    bool inside = r.changedTiles >= 4 * 8 / 2 && r.x0 <= x * FrameStats::THUMB_SCALE && r.x1 >= (x + 4) * FrameStats::THUMB_SCALE
+               && r.y0 <= 5 * FrameStats::THUMB_SCALE && r.y1 >= 13 * FrameStats::THUMB_SCALE;
+    missed += !inside;
+  }
+  printf("{\"name\": \"motion/walker\", \"frames\": 17, \"missed\": %d}\n", missed);
+  CHECK(missed == 0);
+}
+
+static void burst()
+{
+  Scene scene = { 20, 15 };
+  MotionDetector detector;
+  for(int f = 0; f < 30; f++)
+  {
+    scene.render(stats, 0);
+    detector.update(stats);
+  }
+  //the frame with the largest block wins, scoring leaves the model alone
+  static const int SIZES[] = { 2, 6, 4 };
+  int best = -1, bestScore = -1;
+  for(int i = 0; i < 3; i++)
+  {
+    scene.render(stats, 0, 8, 4, SIZES[i], SIZES[i]);
+    MotionResult a = detector.evaluate(stats);
+    MotionResult b = detector.evaluate(stats);
+    CHECK(a.score == b.score && a.changedTiles == b.changedTiles);
+    if(a.score > bestScore)
+    {
+      bestScore = a.score;
+      best = i;
+    }
+  }
+  CHECK(best == 1);
+}
+
+static void absorbed()
+{
+  Scene scene = { 20, 15 };
+  MotionDetector detector;
+  for(int f = 0; f < 30; f++)
+  {
+    scene.render(stats, 0);
+    detector.update(stats);
+  }
+  int first = 0, last = 0, frames = 0;
+  for(; frames < 1000; frames++)
+  {
+    scene.render(stats, 0, 3, 3, 5, 5);
+    MotionResult r = detector.update(stats);
+    if(!frames)
+      first = r.changedTiles;
+    last = r.changedTiles;
+    if(!last)
+      break;
+  }
+  printf("{\"name\": \"motion/parked_object\", \"changed_tiles_at_first\": %d, \"frames_to_absorb\": %d}\n", first, frames);
+  CHECK(first == 25);
+  CHECK(last == 0);
+}
+
+static void timing()
+{
+  static const struct
+  {
+    const char* name;
+    int width;
+    int height;
+  } SIZES[] = { { "qqvga", 20, 15 }, { "qvga", 40, 30 } };
+  for(const auto& s : SIZES)
+  {
+    Scene scene = { s.width, s.height };
+    MotionDetector detector;
+    static const int FRAMES = 64;
+    static FrameStats frames[FRAMES];
+    for(int f = 0; f < FRAMES; f++)
+      scene.render(frames[f], f % 16 ? 0 : 10, f % 20, 4, 3, 6);
+    int n = 20000;
+    int changed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < n; i++)
+      changed += detector.update(frames[i % FRAMES]).changedTiles;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+    printf("{\"name\": \"motion/update/%s\", \"tiles\": %d, \"ns_per_frame\": %.0f, \"changed\": %d}\n",
+           s.name, s.width * s.height, ns, changed);
+  }
+}
+
+int main()
+{
+  stillAndExposure();
+  walker();
+  burst();
+  absorbed();
+  timing();
+  return checkResult("motion_detector_test");
+}
@@ -0,0 +1,189 @@
+//OV7670Fixed against the runtime OV7670 on the emulated sensor
+//(stubs/OV7670Sensor.h) in the idle mode, the live mode and VGA in bands of
+//a QQVGA sized buffer. Per mode: the SCCB traffic and time of the sensor
+//setup and the registers it leaves, which must be the same for both; the
+//frames each captures, which must be the sensor's lines; the line ISR's
+//time called back to back on a captured frame's DMA buffers, and its size
+//in this executable's symbol table.
+
+#include <elf.h>
+#include <chrono>
+#include <vector>
+#include "OV7670Fixed.h"
+#include "OV7670Sensor.h"
+#include "check.h"
+
+typedef OV7670Pins<21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25> Pins;
+static const int FRAMES = 3;
+static const int ISR_FRAMES = 200;
+//the live mode's frame, VGA is captured in 30 line bands of it
+static const int BAND_CAPACITY = 160 * 120 * 2;
+
+struct Result
+{
+  unsigned long initMicros = 0;
+  int registerErrors = 0;
+  unsigned long transactions = 0;
+  unsigned long bits = 0;
+  uint8_t registers[256];
+  std::vector<uint8_t> frame;
+  int bandLines = 0;
+  bool captured = true;
+  uint32_t lumaSum = 0;
+  double isrNsPerLine = 0;
+  size_t isrBytes = 0;
+};
+
+//st_size of the function named name in /proc/self/exe, 0 if not found
+static size_t symbolSize(const char* name)
+{
+  std::vector<char> image;
+  if(FILE* f = fopen("/proc/self/exe", "rb"))
+  {
+    char buffer[1 << 16];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+      image.insert(image.end(), buffer, buffer + n);
+    fclose(f);
+  }
+  const Elf64_Ehdr* header = (const Elf64_Ehdr*)image.data();
+  if(image.size() < sizeof(Elf64_Ehdr) || memcmp(header->e_ident, ELFMAG, SELFMAG) || header->e_ident[EI_CLASS] != ELFCLASS64)
+    return 0;
+  const Elf64_Shdr* sections = (const Elf64_Shdr*)(image.data() + header->e_shoff);
+  for(int s = 0; s < header->e_shnum; s++)
+  {
+    if(sections[s].sh_type != SHT_SYMTAB)
+      continue;
+    const Elf64_Sym* symbols = (const Elf64_Sym*)(image.data() + sections[s].sh_offset);
+    const char* names = image.data() + sections[sections[s].sh_link].sh_offset;
+    for(size_t i = 0; i < sections[s].sh_size / sizeof(Elf64_Sym); i++)
+      if(ELF64_ST_TYPE(symbols[i].st_info) == STT_FUNC && !strcmp(names + symbols[i].st_name, name))
+        return symbols[i].st_size;
+  }
+  return 0;
+}
+
+static void setup(const OV7670& camera, Result& r, unsigned long transactions, unsigned long bits)
+{
+  r.initMicros = camera.initMicros;
+  r.registerErrors = camera.registerErrors;
+  r.transactions = Wire.transactions - transactions;
+  r.bits = Wire.bits - bits;
+  for(int reg = 0; reg < 256; reg++)
+    r.registers[reg] = hostSensorRegister(reg);
+}
+
+//FRAMES frames band by band, one if it takes bands, each a sensor frame;
+//then the ISR alone on the last band's buffers. In bands the lines outside
+//the first are only counted
+static void capture(OV7670& camera, I2SCamera::LineInterrupt isr, Result& r)
+{
+  int lineBytes = camera.xres * camera.bytesPerPixel();
+  r.bandLines = std::min(camera.maxBandLines(), camera.yres);
+  r.frame.assign(lineBytes * camera.yres, 0);
+  int frames = r.bandLines < camera.yres ? 1 : FRAMES;
+  for(int f = 0; f < frames; f++)
+    for(int first = 0; first < camera.yres; first += r.bandLines)
+    {
+      int lines = std::min(r.bandLines, camera.yres - first);
+      bool ok = camera.setBand(first, lines) && camera.oneFrame();
+      r.captured = r.captured && ok;
+      if(ok)
+        memcpy(r.frame.data() + first * lineBytes, camera.frame, lines * lineBytes);
+    }
+  r.lumaSum = camera.lastStats().lumaSum;
+
+  //oneFrame() left the interrupt disabled, the sensor delivers no more lines
+  camera.setBand(0, r.bandLines);
+  I2SCamera::blocksReceived = 0;
+  I2SCamera::dmaBufferActive = 0;
+  I2SCamera::framePointer = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(int f = 0; f < ISR_FRAMES; f++)
+    for(int y = 0; y < camera.yres; y++)
+      isr(nullptr);
+  double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  r.isrNsPerLine = nanos / (ISR_FRAMES * camera.yres);
+}
+
+//the buffers go back to the pool for the next camera
+static void release()
+{
+  I2SCamera::dmaBufferDeinit();
+  bufferPool.give(I2SCamera::frame);
+  I2SCamera::frame = nullptr;
+}
+
+//every line of the frame as the sensor put it on the wire
+static bool sensorLines(const Result& r, int xres, int yres)
+{
+  int lineBytes = xres * 2;
+  if(hostSensorLines() != yres || hostSensorLineBytes() != lineBytes)
+    return false;
+  for(int y = 0; y < yres; y++)
+    for(int k = 0; k < lineBytes; k++)
+      if(r.frame[y * lineBytes + k] != hostSensorByte(y, k))
+        return false;
+  return true;
+}
+
+template<OV7670::Mode M, int CAPACITY> static void compare(const char* name)
+{
+  typedef OV7670Fixed<M, Pins, CAPACITY> Fixed;
+  Result runtime, fixed;
+  {
+    unsigned long transactions = Wire.transactions, bits = Wire.bits;
+    //the runtime class holds at least its first mode's frame: a mode that
+    //only fits in bands is reached from a smaller one of its format
+    OV7670::Mode first = M;
+    while(OV7670::modeBytes(first) > CAPACITY && first % 4)
+      first = (OV7670::Mode)(first - 1);
+    OV7670 camera(first, Pins::SIOD, Pins::SIOC, Pins::VSYNC, Pins::HREF, Pins::XCLK, Pins::PCLK, Pins::D0, Pins::D1, Pins::D2, Pins::D3,
+                  Pins::D4, Pins::D5, Pins::D6, Pins::D7, OV7670::QQQVGA_RGB565, CAPACITY);
+    CHECK(camera.setMode(M));
+    setup(camera, runtime, transactions, bits);
+    capture(camera, &I2SCamera::i2sInterrupt, runtime);
+    CHECK(sensorLines(runtime, Fixed::XRES, Fixed::YRES));
+    release();
+  }
+  {
+    unsigned long transactions = Wire.transactions, bits = Wire.bits;
+    Fixed camera;
+    setup(camera, fixed, transactions, bits);
+    CHECK(!camera.setMode(M == OV7670::QQQVGA_RGB565 ? OV7670::QQVGA_RGB565 : OV7670::QQQVGA_RGB565));
+    capture(camera, &I2SCamera::fixedInterrupt<Fixed::FORMAT, Fixed::XRES, Fixed::YRES>, fixed);
+    CHECK(sensorLines(fixed, Fixed::XRES, Fixed::YRES));
+    release();
+  }
+  runtime.isrBytes = symbolSize("_ZN9I2SCamera12i2sInterruptEPv");
+  char symbol[80];
+  snprintf(symbol, sizeof(symbol), "_ZN9I2SCamera14fixedInterruptILi%dELi%dELi%dEEEvPv", (int)Fixed::FORMAT, Fixed::XRES, Fixed::YRES);
+  fixed.isrBytes = symbolSize(symbol);
+
+  //SCCB at the 400 kHz I2C sets
+  printf("{\"name\": \"ov7670/%s\", \"band_lines\": %d, \"sccb_transactions\": [%lu, %lu], \"sccb_ms\": [%.1f, %.1f], "
+         "\"init_us\": [%lu, %lu], \"isr_ns_per_line\": [%.1f, %.1f], \"isr_bytes\": [%zu, %zu]}\n",
+         name, fixed.bandLines, runtime.transactions, fixed.transactions, runtime.bits / 400.0, fixed.bits / 400.0,
+         runtime.initMicros, fixed.initMicros, runtime.isrNsPerLine, fixed.isrNsPerLine, runtime.isrBytes, fixed.isrBytes);
+  CHECK(runtime.registerErrors == 0);
+  CHECK(fixed.registerErrors == 0);
+  CHECK(!memcmp(runtime.registers, fixed.registers, sizeof(runtime.registers)));
+  CHECK(runtime.captured && fixed.captured);
+  CHECK(runtime.frame == fixed.frame);
+  CHECK(runtime.lumaSum == fixed.lumaSum);
+  CHECK(runtime.bandLines == fixed.bandLines);
+  CHECK(runtime.isrBytes > 0 && fixed.isrBytes > 0);
+}
+
+int main()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, BAND_CAPACITY, 1 },
+  };
+  CHECK(bufferPool.begin(classes, 2));
+  compare<OV7670::QQQVGA_RGB565, OV7670Fixed<OV7670::QQQVGA_RGB565, Pins>::FRAME_BYTES>("idle_qqqvga_rgb565");
+  compare<OV7670::QQVGA_YUV422, OV7670Fixed<OV7670::QQVGA_YUV422, Pins>::FRAME_BYTES>("live_qqvga_yuv422");
+  compare<OV7670::VGA_YUV422, BAND_CAPACITY>("banded_vga_yuv422");
+  return checkResult("ov7670_fixed_test");
+}
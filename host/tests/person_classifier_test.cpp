@@ -0,0 +1,511 @@
+//PersonClassifier with a model generated here, as no trained one ships: a
+//designed edge and blur front end and a small fully connected head trained
+//in float on rendered scenes, then quantized the way PersonModel.h lays it
+//out. The labelled set is synthetic, upright people against pets,
+//curtains and empty rooms with the lighting, contrast and noise varied.
+//Reports the int8 accuracy on held out scenes, how often the int8 net agrees
+//with the float one it came from, the latency of classify() and of cropping
+//a VGA frame band by band, and checks that none of it allocates. The
+//accuracy shows the kernels and the quantization work, it says nothing about
+//a real model on real alerts.
+
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "PersonClassifier.h"
+#include "allocations.h"
+#include "person_model_data.h"
+#include "check.h"
+
+//rendered scenes, cropped 2:1 to the input like a 192 pixel crop of a photo
+static const int SCENE = 192;
+static const int TRAIN = 800;
+static const int TEST = 400;
+//the designed front end's output, then the trained head
+static const int FRONT_END = 6;
+static const int FEATURES = 6 * 6 * 6;
+static const int HIDDEN = 32;
+static const int LAYERS = FRONT_END + 2;
+static const int EPOCHS = 60;
+static const int BATCH = 16;
+static const float RATE = 0.02f;
+//logits of +-32, the trained head reaches about half of that
+static const float LOGIT_SCALE = 1.0f / 4;
+
+static PersonLayer layers[LAYERS];
+const PersonModel personModel = { PersonClassifier::INPUT_SIZE, layers, LAYERS, LOGIT_SCALE, 1 };
+
+struct FloatLayer
+{
+  PersonLayer::Type type;
+  int kernel;
+  int stride;
+  int outChannels;
+  std::vector<float> weights;
+  std::vector<float> bias;
+};
+
+struct Tensor
+{
+  int h, w, c;
+  std::vector<float> v;
+};
+
+struct Scene
+{
+  std::vector<uint8_t> pixels;
+  bool person;
+};
+
+static std::vector<FloatLayer> net;
+static std::vector<int8_t> weightData[LAYERS];
+static std::vector<int32_t> biasData[LAYERS];
+
+static int samePadding(int in, int kernel, int stride, int& out)
+{
+  out = (in + stride - 1) / stride;
+  int total = (out - 1) * stride + kernel - in;
+  return total > 0 ? total / 2 : 0;
+}
+
+//the float net the int8 one is quantized from, same layouts and padding
+static Tensor forward(const FloatLayer& l, const Tensor& in, bool relu)
+{
+  Tensor out = { 1, 1, l.outChannels, {} };
+  int padY = 0, padX = 0;
+  if(l.type == PersonLayer::POINTWISE)
+  {
+    out.h = in.h;
+    out.w = in.w;
+  }
+  else if(l.type != PersonLayer::FULLY)
+  {
+    padY = samePadding(in.h, l.kernel, l.stride, out.h);
+    padX = samePadding(in.w, l.kernel, l.stride, out.w);
+  }
+  if(l.type == PersonLayer::DEPTHWISE)
+    out.c = in.c;
+  out.v.assign(out.h * out.w * out.c, 0);
+  int k = l.kernel;
+  for(int oy = 0; oy < out.h; oy++)
+    for(int ox = 0; ox < out.w; ox++)
+      for(int o = 0; o < out.c; o++)
+      {
+        float acc = l.bias[o];
+        if(l.type == PersonLayer::FULLY)
+          for(size_t i = 0; i < in.v.size(); i++)
+            acc += in.v[i] * l.weights[o * in.v.size() + i];
+        else if(l.type == PersonLayer::POINTWISE)
+          for(int i = 0; i < in.c; i++)
+            acc += in.v[(oy * in.w + ox) * in.c + i] * l.weights[o * in.c + i];
+        else
+          for(int ky = 0; ky < k; ky++)
+            for(int kx = 0; kx < k; kx++)
+            {
+              int iy = oy * l.stride - padY + ky;
+              int ix = ox * l.stride - padX + kx;
+              if(iy < 0 || iy >= in.h || ix < 0 || ix >= in.w)
+                continue;
+              const float* px = &in.v[(iy * in.w + ix) * in.c];
+              if(l.type == PersonLayer::DEPTHWISE)
+                acc += px[o] * l.weights[(ky * k + kx) * in.c + o];
+              else
+                for(int i = 0; i < in.c; i++)
+                  acc += px[i] * l.weights[((o * k + ky) * k + kx) * in.c + i];
+            }
+        out.v[(oy * out.w + ox) * out.c + o] = relu && acc < 0 ? 0 : acc;
+      }
+  return out;
+}
+
+//the front end is designed, not trained: edges in three orientations and a
+//blob detector in both signs, their magnitudes, binomial blurs that halve
+//the size, then the magnitudes and how vertical or horizontal the edges run
+static void frontEnd()
+{
+  static const float EDGES[4][9] = {
+    { -1, 0, 1, -2, 0, 2, -1, 0, 1 },
+    { -1, -2, -1, 0, 0, 0, 1, 2, 1 },
+    { -2, -1, 0, -1, 0, 1, 0, 1, 2 },
+    { -1, -1, -1, -1, 8, -1, -1, -1, -1 },
+  };
+  static const float BLUR[9] = { 1, 2, 1, 2, 4, 2, 1, 2, 1 };
+  //magnitude of every pair, then |x|, |y|, |diagonal|, |blob|, x over y, y over x
+  static const float MIX[2][6][8] = {
+    { { 1, 1 }, { 0, 0, 1, 1 }, { 0, 0, 0, 0, 1, 1 }, { 0, 0, 0, 0, 0, 0, 1, 1 } },
+    { { 1 }, { 0, 1 }, { 0, 0, 1 }, { 0, 0, 0, 1 }, { 1, -1 }, { -1, 1 } },
+  };
+  static const int CHANNELS[3] = { 8, 4, 6 };
+
+  FloatLayer edges = { PersonLayer::CONV, 3, 2, 8, {}, std::vector<float>(8, 0) };
+  for(int o = 0; o < 8; o++)
+    for(int t = 0; t < 9; t++)
+      edges.weights.push_back((o & 1 ? -1 : 1) * EDGES[o / 2][t] / 8);
+  net.push_back(edges);
+  for(int stage = 0; stage < 3; stage++)
+  {
+    int channels = CHANNELS[stage];
+    FloatLayer blur = { PersonLayer::DEPTHWISE, 3, 2, channels, {}, std::vector<float>(channels, 0) };
+    for(int t = 0; t < 9; t++)
+      for(int c = 0; c < channels; c++)
+        blur.weights.push_back(BLUR[t] / 16);
+    net.push_back(blur);
+    if(stage == 2)
+      break;
+    int mixed = CHANNELS[stage + 1];
+    FloatLayer mix = { PersonLayer::POINTWISE, 1, 1, mixed, {}, std::vector<float>(mixed, 0) };
+    for(int o = 0; o < mixed; o++)
+      for(int i = 0; i < channels; i++)
+        mix.weights.push_back(MIX[stage][o][i]);
+    net.push_back(mix);
+  }
+}
+
+//the classifier's input: 2x2 box means, pixel - 128
+static Tensor input(const Scene& s)
+{
+  Tensor t = { PersonClassifier::INPUT_SIZE, PersonClassifier::INPUT_SIZE, 1, {} };
+  for(int y = 0; y < t.h; y++)
+    for(int x = 0; x < t.w; x++)
+    {
+      const uint8_t* p = &s.pixels[y * 2 * SCENE + x * 2];
+      t.v.push_back((int)((p[0] + p[1] + p[SCENE] + p[SCENE + 1] + 2) / 4) - 128);
+    }
+  return t;
+}
+
+//front end output; the largest activation of every layer into peaks
+static Tensor features(const Scene& s, float* peaks = nullptr)
+{
+  Tensor t = input(s);
+  for(int i = 0; i < FRONT_END; i++)
+  {
+    t = forward(net[i], t, true);
+    for(float v : t.v)
+      if(peaks && v > peaks[i])
+        peaks[i] = v;
+  }
+  return t;
+}
+
+static void ellipse(std::vector<float>& image, float cx, float cy, float rx, float ry, float value)
+{
+  for(int y = std::max(0, (int)(cy - ry)); y <= std::min(SCENE - 1, (int)(cy + ry)); y++)
+    for(int x = std::max(0, (int)(cx - rx)); x <= std::min(SCENE - 1, (int)(cx + rx)); x++)
+      if((x - cx) * (x - cx) / (rx * rx) + (y - cy) * (y - cy) / (ry * ry) <= 1)
+        image[y * SCENE + x] = value;
+}
+
+static void box(std::vector<float>& image, float x0, float y0, float x1, float y1, float value)
+{
+  for(int y = std::max(0, (int)y0); y < std::min(SCENE, (int)y1); y++)
+    for(int x = std::max(0, (int)x0); x < std::min(SCENE, (int)x1); x++)
+      image[y * SCENE + x] = value;
+}
+
+//half people; the rest pets, curtains in a draft and empty rooms
+static Scene render(std::mt19937& random)
+{
+  std::uniform_real_distribution<float> u(0, 1);
+  std::normal_distribution<float> noise(0, 4);
+  std::vector<float> image(SCENE * SCENE);
+  float base = 60 + 120 * u(random);
+  float slopeX = (u(random) - 0.5f) * 60, slopeY = (u(random) - 0.5f) * 60;
+  for(int y = 0; y < SCENE; y++)
+    for(int x = 0; x < SCENE; x++)
+      image[y * SCENE + x] = base + slopeX * x / SCENE + slopeY * y / SCENE;
+  for(int i = 0; i < 2; i++)
+  {
+    float x = u(random) * SCENE, y = u(random) * SCENE;
+    box(image, x, y, x + 20 + 60 * u(random), y + 10 + 40 * u(random), base + (u(random) - 0.5f) * 100);
+  }
+  float object = base + (u(random) < 0.5f ? -1 : 1) * (40 + 50 * u(random));
+  int kind = u(random) < 0.5f ? 0 : 1 + (int)(u(random) * 3);
+  if(kind == 0)
+  {
+    float h = SCENE * (0.5f + 0.4f * u(random));
+    float cx = SCENE * (0.2f + 0.6f * u(random));
+    float top = (SCENE - h) * u(random);
+    float r = h / 14;
+    ellipse(image, cx, top + r, r, r * 1.2f, object);
+    ellipse(image, cx, top + 2 * r + h * 0.2f, h * 0.13f, h * 0.2f, object);
+    box(image, cx - h * 0.08f, top + 2 * r + h * 0.3f, cx - h * 0.02f, top + h, object);
+    box(image, cx + h * 0.02f, top + 2 * r + h * 0.3f, cx + h * 0.08f, top + h, object);
+  }
+  else if(kind == 1)
+  {
+    float w = SCENE * (0.25f + 0.2f * u(random));
+    float cx = SCENE * (0.25f + 0.5f * u(random));
+    float cy = SCENE * (0.7f + 0.15f * u(random));
+    float side = u(random) < 0.5f ? -1 : 1;
+    for(int leg = 0; leg < 4; leg++)
+    {
+      float x = cx + (leg - 1.5f) * w * 0.25f;
+      box(image, x - w * 0.04f, cy, x + w * 0.04f, cy + w * 0.35f, object);
+    }
+    ellipse(image, cx, cy, w / 2, w * 0.2f, object);
+    ellipse(image, cx + side * w * 0.55f, cy - w * 0.15f, w * 0.15f, w * 0.13f, object);
+  }
+  else if(kind == 2)
+  {
+    float x0 = u(random) < 0.5f ? 0 : SCENE * (0.5f + 0.25f * u(random));
+    float w = SCENE * (0.25f + 0.25f * u(random));
+    float period = 8 + 12 * u(random), phase = 6.3f * u(random);
+    for(int y = 0; y < SCENE; y++)
+      for(int x = (int)x0; x < std::min(SCENE, (int)(x0 + w)); x++)
+        image[y * SCENE + x] = (base + object) / 2 + (object - base) / 2 * sinf((x - x0 + 3 * sinf(y / 30.0f + phase)) * 6.283f / period);
+  }
+  Scene s = { std::vector<uint8_t>(SCENE * SCENE), kind == 0 };
+  for(int i = 0; i < SCENE * SCENE; i++)
+    s.pixels[i] = (uint8_t)std::min(255.0f, std::max(0.0f, image[i] + noise(random)));
+  return s;
+}
+
+//HIDDEN rectified units and a logit z, trained with minibatch SGD on the
+//standardized features. The standardization is folded into the first layer
+//and z into two logits, -z/2 for the other class and z/2 for a person.
+static void trainHead(const std::vector<Tensor>& f, const std::vector<Scene>& scenes)
+{
+  std::vector<float> mean(FEATURES, 0), deviation(FEATURES, 0);
+  for(const Tensor& t : f)
+    for(int i = 0; i < FEATURES; i++)
+      mean[i] += t.v[i] / f.size();
+  for(const Tensor& t : f)
+    for(int i = 0; i < FEATURES; i++)
+      deviation[i] += (t.v[i] - mean[i]) * (t.v[i] - mean[i]) / f.size();
+  for(float& d : deviation)
+    d = sqrtf(d) + 1e-3f;
+  std::vector<std::vector<float>> x(f.size(), std::vector<float>(FEATURES));
+  for(size_t n = 0; n < f.size(); n++)
+    for(int i = 0; i < FEATURES; i++)
+      x[n][i] = (f[n].v[i] - mean[i]) / deviation[i];
+
+  std::mt19937 random(33);
+  std::normal_distribution<float> normal(0, 1);
+  std::vector<float> w1(HIDDEN * FEATURES), b1(HIDDEN, 0.1f), w2(HIDDEN);
+  for(float& w : w1)
+    w = normal(random) * sqrtf(2.0f / FEATURES);
+  for(float& w : w2)
+    w = normal(random) * sqrtf(1.0f / HIDDEN);
+  float b2 = 0;
+  std::vector<float> vw1(w1.size(), 0), vb1(HIDDEN, 0), vw2(HIDDEN, 0);
+  float vb2 = 0;
+  std::vector<float> gw1(w1.size()), gb1(HIDDEN), gw2(HIDDEN), h(HIDDEN);
+  std::vector<int> order(f.size());
+  for(size_t n = 0; n < f.size(); n++)
+    order[n] = n;
+  for(int epoch = 0; epoch < EPOCHS; epoch++)
+  {
+    std::shuffle(order.begin(), order.end(), random);
+    for(size_t first = 0; first < order.size(); first += BATCH)
+    {
+      std::fill(gw1.begin(), gw1.end(), 0);
+      std::fill(gb1.begin(), gb1.end(), 0);
+      std::fill(gw2.begin(), gw2.end(), 0);
+      float gb2 = 0;
+      size_t last = std::min(order.size(), first + BATCH);
+      for(size_t b = first; b < last; b++)
+      {
+        const std::vector<float>& in = x[order[b]];
+        float z = b2;
+        for(int j = 0; j < HIDDEN; j++)
+        {
+          float a = b1[j];
+          for(int i = 0; i < FEATURES; i++)
+            a += w1[j * FEATURES + i] * in[i];
+          h[j] = a > 0 ? a : 0;
+          z += w2[j] * h[j];
+        }
+        float e = 1 / (1 + expf(-z)) - (scenes[order[b]].person ? 1 : 0);
+        gb2 += e;
+        for(int j = 0; j < HIDDEN; j++)
+        {
+          gw2[j] += e * h[j];
+          if(h[j] <= 0)
+            continue;
+          float d = e * w2[j];
+          gb1[j] += d;
+          for(int i = 0; i < FEATURES; i++)
+            gw1[j * FEATURES + i] += d * in[i];
+        }
+      }
+      float scale = 1.0f / (last - first);
+      for(size_t i = 0; i < w1.size(); i++)
+      {
+        vw1[i] = 0.9f * vw1[i] - RATE * (gw1[i] * scale + 1e-4f * w1[i]);
+        w1[i] += vw1[i];
+      }
+      for(int j = 0; j < HIDDEN; j++)
+      {
+        vb1[j] = 0.9f * vb1[j] - RATE * gb1[j] * scale;
+        b1[j] += vb1[j];
+        vw2[j] = 0.9f * vw2[j] - RATE * (gw2[j] * scale + 1e-4f * w2[j]);
+        w2[j] += vw2[j];
+      }
+      vb2 = 0.9f * vb2 - RATE * gb2 * scale;
+      b2 += vb2;
+    }
+  }
+
+  FloatLayer hidden = { PersonLayer::FULLY, 1, 1, HIDDEN, std::vector<float>(HIDDEN * FEATURES), b1 };
+  for(int j = 0; j < HIDDEN; j++)
+    for(int i = 0; i < FEATURES; i++)
+    {
+      hidden.weights[j * FEATURES + i] = w1[j * FEATURES + i] / deviation[i];
+      hidden.bias[j] -= w1[j * FEATURES + i] * mean[i] / deviation[i];
+    }
+  net.push_back(hidden);
+  FloatLayer logits = { PersonLayer::FULLY, 1, 1, 2, std::vector<float>(2 * HIDDEN), { -b2 / 2, b2 / 2 } };
+  for(int j = 0; j < HIDDEN; j++)
+  {
+    logits.weights[j] = -w2[j] / 2;
+    logits.weights[HIDDEN + j] = w2[j] / 2;
+  }
+  net.push_back(logits);
+}
+
+//symmetric per tensor weights, the rescale as multiplier and shift
+static void quantize(int i, float inScale, int inZero, float outScale, int outZero, bool relu)
+{
+  const FloatLayer& f = net[i];
+  float largest = 1e-9f;
+  for(float w : f.weights)
+    largest = std::max(largest, fabsf(w));
+  float weightScale = largest / 127;
+  for(float w : f.weights)
+    weightData[i].push_back((int8_t)lroundf(w / weightScale));
+  for(float b : f.bias)
+    biasData[i].push_back((int32_t)lroundf(b / (inScale * weightScale)));
+  int exponent;
+  double fraction = frexp((double)inScale * weightScale / outScale, &exponent);
+  int64_t multiplier = llround(fraction * (1LL << 31));
+  if(multiplier == 1LL << 31)
+  {
+    multiplier /= 2;
+    exponent++;
+  }
+  PersonLayer& l = layers[i];
+  l.type = f.type;
+  l.kernel = f.kernel;
+  l.stride = f.stride;
+  l.outChannels = f.outChannels;
+  l.weights = weightData[i].data();
+  l.bias = biasData[i].data();
+  l.multiplier = (int32_t)multiplier;
+  l.shift = (int8_t)-exponent;
+  l.inputZero = (int8_t)inZero;
+  l.outputZero = (int8_t)outZero;
+  l.actMin = relu ? (int8_t)outZero : -128;
+  l.actMax = 127;
+}
+
+//the hidden activations are rectified, their range maps onto -128..127
+static void quantizeNet(const float* peaks)
+{
+  float inScale = 1;
+  int inZero = 0;
+  for(int i = 0; i < LAYERS - 1; i++)
+  {
+    float outScale = std::max(peaks[i], 1e-3f) / 255;
+    quantize(i, inScale, inZero, outScale, -128, true);
+    inScale = outScale;
+    inZero = -128;
+  }
+  quantize(LAYERS - 1, inScale, inZero, LOGIT_SCALE, 0, false);
+}
+
+static int classify(PersonClassifier& classifier, const Scene& s)
+{
+  classifier.beginCrop(0, 0, SCENE, SCENE, SCENE, I2SCamera::PIXEL_Y8);
+  classifier.addBand(s.pixels.data(), 0, SCENE);
+  return classifier.classify();
+}
+
+static void accuracy(PersonClassifier& classifier)
+{
+  std::mt19937 random(3201);
+  std::vector<Scene> train;
+  std::vector<Tensor> trainFeatures;
+  float peaks[LAYERS] = {};
+  frontEnd();
+  for(int n = 0; n < TRAIN; n++)
+  {
+    train.push_back(render(random));
+    trainFeatures.push_back(features(train.back(), peaks));
+  }
+  trainHead(trainFeatures, train);
+  for(const Tensor& t : trainFeatures)
+  {
+    Tensor hidden = forward(net[FRONT_END], t, true);
+    for(float v : hidden.v)
+      peaks[FRONT_END] = std::max(peaks[FRONT_END], v);
+    for(float v : forward(net.back(), hidden, false).v)
+      peaks[LAYERS - 1] = std::max(peaks[LAYERS - 1], fabsf(v));
+  }
+  quantizeNet(peaks);
+
+  std::vector<Scene> test;
+  for(int n = 0; n < TEST; n++)
+    test.push_back(render(random));
+  int correct = 0, floatCorrect = 0, agree = 0, people = 0;
+  double worstDifference = 0, micros = 0;
+  uint64_t allocated = 0;
+  for(const Scene& s : test)
+  {
+    uint64_t before = allocations();
+    int confidence = classify(classifier, s);
+    allocated += allocations() - before;
+    micros += classifier.lastMicros;
+    people += s.person;
+    correct += (confidence >= 50) == s.person;
+    Tensor logits = forward(net.back(), forward(net[FRONT_END], features(s), true), false);
+    float expected = 100 / (1 + expf(logits.v[0] - logits.v[1]));
+    floatCorrect += (expected >= 50) == s.person;
+    agree += (confidence >= 50) == (expected >= 50);
+    worstDifference = std::max(worstDifference, (double)fabsf(confidence - expected));
+  }
+
+  printf("{\"name\": \"person_classifier/accuracy\", \"scenes\": %d, \"people\": %d, \"int8_accuracy\": %.3f, \"float_accuracy\": %.3f, "
+         "\"agreement\": %.3f, \"worst_confidence_difference\": %.1f, \"classify_us\": %.0f, \"allocations\": %lu, \"peak_logit\": %.2f}\n",
+         TEST, people, (double)correct / TEST, (double)floatCorrect / TEST, (double)agree / TEST, worstDifference, micros / TEST,
+         (unsigned long)allocated, peaks[LAYERS - 1]);
+  CHECK(peaks[LAYERS - 1] < 127 * LOGIT_SCALE);
+  CHECK(correct >= TEST * 9 / 10);
+  CHECK(agree >= TEST * 97 / 100);
+  CHECK(allocated == 0);
+}
+
+//a 288 pixel crop of an RGB565 VGA frame delivered in 30 line bands, as the
+//banded capture hands them over at the alert resolution
+static void vgaCrop(PersonClassifier& classifier)
+{
+  static const int WIDTH = 640, HEIGHT = 480, BAND = 30, RUNS = 20;
+  std::vector<uint8_t> frame(WIDTH * HEIGHT * 2);
+  std::mt19937 random(4);
+  for(uint8_t& b : frame)
+    b = (uint8_t)random();
+  double cropMicros = 0, classifyMicros = 0;
+  int confidence = 0;
+  for(int run = 0; run < RUNS; run++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    classifier.beginCrop(176, 96, 288, WIDTH, HEIGHT, I2SCamera::PIXEL_RGB565);
+    for(int first = 0; first < HEIGHT; first += BAND)
+      classifier.addBand(frame.data() + first * WIDTH * 2, first, BAND);
+    cropMicros += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    confidence = classifier.classify();
+    classifyMicros += classifier.lastMicros;
+  }
+  printf("{\"name\": \"person_classifier/vga_crop\", \"crop_us\": %.0f, \"classify_us\": %.0f, \"arena_bytes\": %zu}\n",
+         cropMicros / RUNS, classifyMicros / RUNS, sizeof(PersonClassifier) + 2 * PersonClassifier::TENSOR_BYTES);
+  CHECK(confidence >= 0 && confidence <= 100);
+}
+
+int main()
+{
+  static PersonClassifier classifier;
+  accuracy(classifier);
+  vgaCrop(classifier);
+  return checkResult("person_classifier_test");
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include "PersonModel.h"
+
+//Stand-in for the exported model in the host build: person_classifier_test
+//generates the weights and fills the layers before the first classify().
+extern const PersonModel personModel;
@@ -0,0 +1,163 @@
+//PowerScheduler driven the way loop() drives it, on a simulated clock: hours
+//of radar presence episodes with the CPU polling while awake and sleeping in
+//slices while parked, woken early by the radar UART. Reports the CPU and
+//camera duty cycle and the wake-to-frame latency; then a wake whose frames
+//never get usable, and a connected client that keeps the node up.
+
+#include <random>
+#include <vector>
+#include "PowerScheduler.h"
+#include "check.h"
+
+//loop() pass while awake: its own work and the delay(20) at the end
+static const unsigned long POLL_MS = 25;
+//a loop pass after a light sleep slice before the next one
+static const unsigned long SLICE_PASS_MS = 3;
+//the radar report that wakes the CPU is lost, the next one is read
+static const unsigned long REPORT_MS = 100;
+//idle mode frame time and the frames until the exposure gives a usable one
+static const unsigned long FRAME_MS = 70;
+
+struct Episode
+{
+  unsigned long start;
+  unsigned long end;
+};
+
+struct Node
+{
+  PowerScheduler power;
+  unsigned long now = 0;
+  bool cameraParked = false;
+  int framesToUsable = 4;
+  unsigned long worstPresenceToFrameMs = 0;
+  bool parkedDuringPresence = false;
+
+  //one loop() pass; presence as the radar reports it, busy for pending work
+  //or connected clients
+  void pass(bool presence, bool busy, unsigned long presenceSince, unsigned long nextReport)
+  {
+    busy = busy || presence;
+    if(busy)
+      power.activity(now);
+    if(presence && cameraParked)
+      wake(presenceSince);
+    if(power.shouldPark(now))
+    {
+      if(presence)
+        parkedDuringPresence = true;
+      cameraParked = true;
+      power.parked(now);
+    }
+    unsigned long budget = !busy ? power.sleepBudget() : 0;
+    if(!budget)
+    {
+      now += POLL_MS;
+      return;
+    }
+    unsigned long until = now + budget < nextReport ? now + budget : nextReport;
+    power.slept(until - now);
+    now = until + SLICE_PASS_MS;
+  }
+
+  void wake(unsigned long presenceSince)
+  {
+    power.activity(now);
+    cameraParked = false;
+    power.waking(now);
+    bool usable = false;
+    for(int frames = 0; !usable && !power.wakeExpired(now); )
+    {
+      now += FRAME_MS;
+      usable = ++frames >= framesToUsable;
+    }
+    power.frameReady(now, usable);
+    if(now - presenceSince > worstPresenceToFrameMs)
+      worstPresenceToFrameMs = now - presenceSince;
+  }
+};
+
+static void episodes()
+{
+  static const unsigned long HOURS = 6;
+  static const unsigned long DURATION = HOURS * 3600 * 1000UL;
+  std::mt19937 random(41);
+  std::vector<Episode> episodes;
+  for(unsigned long t = 60000; t < DURATION; )
+  {
+    unsigned long length = 5000 + random() % 55000;
+    episodes.push_back({ t, t + length });
+    t += length + 120000 + random() % 900000;
+  }
+
+  Node node;
+  size_t next = 0;
+  while(node.now < DURATION)
+  {
+    while(next < episodes.size() && episodes[next].end <= node.now)
+      next++;
+    bool inEpisode = next < episodes.size() && node.now >= episodes[next].start;
+    //presence is read from the report after the one that woke the CPU
+    bool presence = inEpisode && node.now >= episodes[next].start + REPORT_MS;
+    unsigned long nextReport = next < episodes.size() && !inEpisode ? episodes[next].start : DURATION;
+    node.framesToUsable = 2 + random() % 8;
+    node.pass(presence, false, inEpisode ? episodes[next].start : node.now, nextReport);
+  }
+
+  PowerScheduler& p = node.power;
+  int cpu = p.cpuDutyPermille(node.now);
+  int camera = p.cameraDutyPermille(node.now);
+  printf("{\"name\": \"power/episodes\", \"hours\": %lu, \"episodes\": %zu, \"cpu_duty_permille\": %d, "
+         "\"camera_duty_permille\": %d, \"wakes\": %d, \"max_wake_to_frame_ms\": %lu, "
+         "\"max_presence_to_frame_ms\": %lu, \"wake_timeouts\": %d}\n",
+         HOURS, episodes.size(), cpu, camera, p.wakes, p.maxWakeToFrameMs, node.worstPresenceToFrameMs, p.wakeTimeouts);
+  CHECK(!node.parkedDuringPresence);
+  CHECK(p.wakes == (int)episodes.size());
+  CHECK(p.wakeTimeouts == 0);
+  CHECK(p.maxWakeToFrameMs <= PowerScheduler::WAKE_TIMEOUT_MS);
+  CHECK(node.worstPresenceToFrameMs <= REPORT_MS + PowerScheduler::WAKE_TIMEOUT_MS);
+  //presence about 4% of the time, each episode kept up PARK_AFTER_MS longer
+  CHECK(cpu < 150);
+  CHECK(camera < 150);
+  CHECK(camera <= cpu);
+}
+
+//frames that never get usable give up after WAKE_TIMEOUT_MS and count it
+static void darkWake()
+{
+  Node node;
+  while(!node.cameraParked)
+    node.pass(false, false, 0, ~0UL);
+  CHECK(node.now >= PowerScheduler::PARK_AFTER_MS);
+  CHECK(node.power.state() == PowerScheduler::PARKED);
+  node.framesToUsable = 1000;
+  node.pass(true, false, node.now, ~0UL);
+  printf("{\"name\": \"power/dark_wake\", \"wake_to_frame_ms\": %lu, \"wake_timeouts\": %d}\n",
+         node.power.lastWakeToFrameMs, node.power.wakeTimeouts);
+  CHECK(node.power.state() == PowerScheduler::AWAKE);
+  CHECK(node.power.wakeTimeouts == 1);
+  CHECK(node.power.lastWakeToFrameMs >= PowerScheduler::WAKE_TIMEOUT_MS);
+  CHECK(node.power.lastWakeToFrameMs < PowerScheduler::WAKE_TIMEOUT_MS + FRAME_MS);
+}
+
+//a connected telemetry or live view client: no parking, no sleep
+static void connectedClient()
+{
+  Node node;
+  while(node.now < 10 * 60 * 1000UL)
+    node.pass(false, true, 0, ~0UL);
+  int cpu = node.power.cpuDutyPermille(node.now);
+  printf("{\"name\": \"power/connected_client\", \"cpu_duty_permille\": %d, \"camera_duty_permille\": %d}\n",
+         cpu, node.power.cameraDutyPermille(node.now));
+  CHECK(!node.cameraParked);
+  CHECK(cpu == 1000);
+  CHECK(node.power.cameraDutyPermille(node.now) == 1000);
+}
+
+int main()
+{
+  episodes();
+  darkWake();
+  connectedClient();
+  return checkResult("power_scheduler_test");
+}
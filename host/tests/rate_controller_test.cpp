@@ -0,0 +1,214 @@
+//RateController against a throttled stand-in for api.telegram.org: each
+//alert photo is encoded at the quality the controller picks for the target,
+//sent with sendPhotoToTelegram() over loopback to a server that reads at a
+//set byte rate and answers after a set round trip, and the measured upload
+//is fed back. The link changes between phases; per upload the test reports
+//the predicted and the achieved delivery time against the target.
+//
+//The target is scaled down from the firmware's so the test runs in seconds;
+//the rates are scaled with it, which keeps the photo sizes realistic.
+
+#include <math.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "RateController.h"
+#include "jpeg_encoder.h"
+#include "send_photobmp.h"
+#include "check.h"
+
+const char* BOT_TOKEN = "123456789:host-test-token";
+const char* CHAT_ID = "123456789";
+const char* TELEGRAM_CERTIFICATE_ROOT = "";
+WiFiClientSecure secureClient;
+
+//reads every request at bytesPerSecond through a small receive buffer, so
+//the sender is held back as by a slow uplink, then answers after rttMs
+class ThrottledServer
+{
+  public:
+  std::atomic<long> bytesPerSecond{40000};
+  std::atomic<long> rttMs{50};
+
+  uint16_t start()
+  {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    int small = 4096;
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(bind(listener, (sockaddr*)&address, sizeof(address)) || listen(listener, 4)
+       || getsockname(listener, (sockaddr*)&address, &length))
+      return 0;
+    thread = std::thread(&ThrottledServer::run, this);
+    return ntohs(address.sin_port);
+  }
+
+  void stop()
+  {
+    running = false;
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    thread.join();
+  }
+
+  private:
+  int listener = -1;
+  std::atomic<bool> running{true};
+  std::thread thread;
+
+  void run()
+  {
+    static const char ANSWER[] =
+      "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 57\r\n"
+      "Connection: close\r\n\r\n{\"ok\":true,\"result\":{\"message_id\":1,\"date\":1700000000}}";
+    while(running)
+    {
+      int connection = accept(listener, nullptr, nullptr);
+      if(connection < 0)
+        continue;
+      //10 ms slices of the byte rate until the request is in
+      long expected = -1;
+      long received = 0;
+      std::string head;
+      bool open = true;
+      while(open && (expected < 0 || received < expected))
+      {
+        long slice = std::max(1L, bytesPerSecond / 100);
+        for(long got = 0; open && got < slice && (expected < 0 || received < expected);)
+        {
+          char buffer[4096];
+          long wanted = std::min((long)sizeof(buffer), slice - got);
+          if(expected >= 0)
+            wanted = std::min(wanted, expected - received);
+          ssize_t n = recv(connection, buffer, wanted, 0);
+          open = n > 0;
+          if(!open)
+            break;
+          got += n;
+          received += n;
+          if(expected < 0)
+          {
+            head.append(buffer, n);
+            size_t end = head.find("\r\n\r\n");
+            size_t length = head.find("Content-Length: ");
+            if(end != std::string::npos)
+              expected = end + 4 + (length != std::string::npos ? atol(head.c_str() + length + 16) : 0);
+          }
+        }
+        if(expected < 0 || received < expected)
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(rttMs));
+      send(connection, ANSWER, sizeof(ANSWER) - 1, MSG_NOSIGNAL);
+      close(connection);
+    }
+  }
+};
+
+//a scene with detail from 0 (flat) to 3 (busy texture) as U Y V Y, and the
+//statistics the line ISR would gather from it
+static std::vector<uint8_t> scene(int width, int height, int detail, FrameStats& stats, std::mt19937& random)
+{
+  std::vector<uint8_t> pixels(width * height * 2);
+  double frequency = 0.03 + detail * 0.08;
+  stats.reset();
+  for(int y = 0; y < height; y++)
+  {
+    int prev = 0;
+    for(int x = 0; x < width; x++)
+    {
+      double v = 100 + 60 * sin(x * frequency) * cos(y * frequency * 0.7) + (detail > 2 && x / 8 % 7 == 0 ? 30 : 0)
+               + detail * 6 * ((int)(random() % 1000) / 500.0 - 1);
+      int luma = v < 0 ? 0 : v > 255 ? 255 : (int)v;
+      pixels[(y * width + x) * 2] = 128;
+      pixels[(y * width + x) * 2 + 1] = luma;
+      if(x & 1)
+        continue;
+      stats.lumaSum += luma;
+      int d = luma - prev;
+      stats.gradientEnergy += (d * d) >> 4;
+      prev = luma;
+      stats.samples++;
+    }
+  }
+  return pixels;
+}
+
+int main()
+{
+  ThrottledServer server;
+  uint16_t port = server.start();
+  if(!port)
+  {
+    fprintf(stderr, "no loopback server\n");
+    return 1;
+  }
+  WiFiClient::redirect("127.0.0.1", port);
+
+  static const int WIDTH = 320;
+  static const int HEIGHT = 240;
+  static const struct
+  {
+    long bytesPerSecond;
+    long rttMs;
+  } PHASES[] = { { 40000, 40 }, { 15000, 120 }, { 120000, 20 } };
+  static const int UPLOADS = 5;
+  RateController rate(1000);
+  static JpegEncoder encoder;
+  std::mt19937 random(5);
+  int settled = 0;
+  int settledInTarget = 0;
+  for(const auto& phase : PHASES)
+  {
+    server.bytesPerSecond = phase.bytesPerSecond;
+    server.rttMs = phase.rttMs;
+    for(int u = 0; u < UPLOADS; u++)
+    {
+      FrameStats stats;
+      std::vector<uint8_t> pixels = scene(WIDTH, HEIGHT, 1 + (u & 1) * 2, stats, random);
+      int quality = rate.chooseQuality(stats, WIDTH, HEIGHT);
+      if(!quality)
+        quality = RateController::MIN_QUALITY;
+      size_t predicted = rate.predictBytes(stats, WIDTH, HEIGHT, quality);
+      JpegEncoder::Buffer jpeg = { nullptr, 0, 0 };
+      encoder.begin(WIDTH, HEIGHT, quality, JpegEncoder::memoryWriter, &jpeg, JpegEncoder::YUV422);
+      encoder.addStripe(pixels.data(), HEIGHT);
+      CHECK(encoder.finish());
+      rate.addEncode(predicted, jpeg.size);
+
+      UploadTiming timing = {};
+      CHECK(sendPhotoToTelegram(jpeg.data, jpeg.size, &timing));
+      unsigned long achieved = timing.connectMs + timing.transferMs;
+      printf("{\"name\": \"rate/upload\", \"link_bytes_per_s\": %ld, \"rtt_ms\": %ld, \"quality\": %d, "
+             "\"predicted_bytes\": %u, \"bytes\": %u, \"predicted_ms\": %lu, \"achieved_ms\": %lu, \"target_ms\": %lu}\n",
+             phase.bytesPerSecond, phase.rttMs, quality, (unsigned)predicted, (unsigned)jpeg.size,
+             rate.predictMs(predicted), achieved, rate.targetMs);
+      rate.addUpload(jpeg.size, timing.connectMs, timing.transferMs);
+      //the first uploads of a phase find the link changed, the averages
+      //follow within two; at MIN_QUALITY the target is out of reach
+      if(u >= 2 && quality > RateController::MIN_QUALITY)
+      {
+        settled++;
+        settledInTarget += achieved <= rate.targetMs * 5 / 4;
+      }
+      free(jpeg.data);
+    }
+  }
+  printf("{\"name\": \"rate/summary\", \"settled_uploads\": %d, \"within_target\": %d}\n", settled, settledInTarget);
+  CHECK(settled > 0);
+  CHECK(settledInTarget * 10 >= settled * 8);
+
+  WiFiClient::redirect(nullptr, 0);
+  server.stop();
+  return checkResult("rate_controller_test");
+}
@@ -0,0 +1,281 @@
+//RequestBuffer, the fixed buffer the Telegram requests are built in: form
+//and JSON encoding against reference encoders and known vectors, the part
+//headers and the request head, overflow; then whole alerts (text, photo and
+//a media group) against a loopback stand-in for api.telegram.org, which
+//must not allocate once the first one has gone out.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "RequestBuffer.h"
+#include "send_text.h"
+#include "send_media_group.h"
+#include "send_photobmp.h"
+#include "allocations.h"
+#include "check.h"
+
+const char* BOT_TOKEN = "123456789:host-test-token";
+const char* CHAT_ID = "123456789";
+const char* TELEGRAM_CERTIFICATE_ROOT = "";
+WiFiClientSecure secureClient;
+
+//RFC 3986 unreserved characters stay, space becomes '+', every other byte %XX
+static std::string formReference(const std::string& text)
+{
+  static const std::string UNRESERVED =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~";
+  std::string out;
+  for(unsigned char c : text)
+  {
+    char escaped[4];
+    if(UNRESERVED.find(c) != std::string::npos)
+      out += c;
+    else if(c == ' ')
+      out += '+';
+    else
+    {
+      snprintf(escaped, sizeof(escaped), "%%%02X", c);
+      out += escaped;
+    }
+  }
+  return out;
+}
+
+//what a server does with the field
+static std::string formDecode(const std::string& text)
+{
+  std::string out;
+  for(size_t i = 0; i < text.size(); i++)
+  {
+    if(text[i] == '+')
+      out += ' ';
+    else if(text[i] == '%' && i + 2 < text.size() && isxdigit(text[i + 1]) && isxdigit(text[i + 2]))
+    {
+      out += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    }
+    else
+      out += text[i];
+  }
+  return out;
+}
+
+//RFC 8259: quote and backslash escaped, control characters as short or \u escapes
+static std::string jsonReference(const std::string& text)
+{
+  std::string out;
+  for(unsigned char c : text)
+  {
+    char escaped[8];
+    if(c == '"' || c == '\\')
+      (out += '\\') += c;
+    else if(c == '\n')
+      out += "\\n";
+    else if(c == '\r')
+      out += "\\r";
+    else if(c == '\t')
+      out += "\\t";
+    else if(c < 0x20)
+    {
+      snprintf(escaped, sizeof(escaped), "\\u%04X", c);
+      out += escaped;
+    }
+    else
+      out += c;
+  }
+  return out;
+}
+
+static RequestBuffer request;
+
+static std::string body()
+{
+  return std::string(request.data() + request.length() - request.bodyLength(), request.bodyLength());
+}
+
+static std::string formEncoded(const std::string& text)
+{
+  request.clear();
+  request.addFormEncoded(text.c_str());
+  return body();
+}
+
+static std::string jsonEscaped(const std::string& text)
+{
+  request.clear();
+  request.addJsonEscaped(text.c_str());
+  return body();
+}
+
+static void encoding()
+{
+  //every byte on its own, then mixed text
+  for(int c = 1; c < 256; c++)
+  {
+    std::string one(1, (char)c);
+    CHECK(formEncoded(one) == formReference(one));
+    CHECK(formDecode(formEncoded(one)) == one);
+    CHECK(jsonEscaped(one) == jsonReference(one));
+  }
+  static const char* TEXTS[] = {
+    "🚨 Person detected at 2.4 m\nConfidence 87%, motion 3.1% of the frame\n2025-07-22 03:14:07 & still there?",
+    "a+b=c&d=e;f/g?h#i", "tab\there \"quoted\" back\\slash", "Ünïcödé ✓ 日本語", "",
+  };
+  for(const char* t : TEXTS)
+  {
+    CHECK(formEncoded(t) == formReference(t));
+    CHECK(formDecode(formEncoded(t)) == t);
+    CHECK(jsonEscaped(t) == jsonReference(t));
+  }
+  CHECK(formEncoded("a b&c=d") == "a+b%26c%3Dd");
+  CHECK(formEncoded("🚨") == "%F0%9F%9A%A8");
+  CHECK(formEncoded("100%") == "100%25");
+  CHECK(jsonEscaped("say \"hi\"\n") == "say \\\"hi\\\"\\n");
+  CHECK(jsonEscaped("\x01") == "\\u0001");
+}
+
+static void framing()
+{
+  request.clear();
+  request.addPartHeader("----b", "photo", "photo.jpg", "image/jpeg");
+  CHECK(body() == "------b\r\nContent-Disposition: form-data; name=\"photo\"; filename=\"photo.jpg\"\r\n"
+                  "Content-Type: image/jpeg\r\n\r\n");
+  request.clear();
+  request.addPartHeader("----b", "chat_id");
+  CHECK(body() == "------b\r\nContent-Disposition: form-data; name=\"chat_id\"\r\n\r\n");
+
+  request.clear();
+  request.add("chat_id=");
+  request.add(42UL);
+  request.finish("TOKEN", "sendMessage", "application/x-www-form-urlencoded", 100);
+  std::string whole(request.data(), request.length());
+  CHECK(whole == "POST /botTOKEN/sendMessage HTTP/1.1\r\nHost: api.telegram.org\r\n"
+                 "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: 110\r\n"
+                 "Connection: close\r\n\r\nchat_id=42");
+  CHECK(!request.overflowed());
+
+  //the add that does not fit is dropped, and every one after it
+  request.clear();
+  std::string large(RequestBuffer::CAPACITY - 2, 'x');
+  request.add(large.c_str());
+  request.addFormEncoded("&");
+  request.add("y");
+  CHECK(request.overflowed());
+  CHECK(request.bodyLength() == large.size());
+}
+
+//answers every request after reading it, from a fixed buffer
+class TelegramServer
+{
+  public:
+  uint16_t start()
+  {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(bind(listener, (sockaddr*)&address, sizeof(address)) || listen(listener, 4)
+       || getsockname(listener, (sockaddr*)&address, &length))
+      return 0;
+    thread = std::thread(&TelegramServer::run, this);
+    return ntohs(address.sin_port);
+  }
+
+  void stop()
+  {
+    running = false;
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    thread.join();
+  }
+
+  private:
+  int listener = -1;
+  std::atomic<bool> running{true};
+  std::thread thread;
+  char request[1 << 18];
+
+  void run()
+  {
+    static const char ANSWER[] =
+      "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 57\r\n"
+      "Connection: close\r\n\r\n{\"ok\":true,\"result\":{\"message_id\":1,\"date\":1700000000}}";
+    while(running)
+    {
+      int connection = accept(listener, nullptr, nullptr);
+      if(connection < 0)
+        continue;
+      size_t received = 0;
+      long expected = -1;
+      while(received < sizeof(request) - 1)
+      {
+        ssize_t n = recv(connection, request + received, sizeof(request) - 1 - received, 0);
+        if(n <= 0)
+          break;
+        received += n;
+        request[received] = 0;
+        const char* end = strstr(request, "\r\n\r\n");
+        const char* length = strstr(request, "Content-Length: ");
+        if(end)
+          expected = (end - request) + 4 + (length ? atol(length + 16) : 0);
+        if(expected >= 0 && (long)received >= expected)
+          break;
+      }
+      send(connection, ANSWER, sizeof(ANSWER) - 1, MSG_NOSIGNAL);
+      close(connection);
+    }
+  }
+};
+
+static void allocationFreeAlerts()
+{
+  static TelegramServer server;
+  uint16_t port = server.start();
+  CHECK(port);
+  if(!port)
+    return;
+  WiFiClient::redirect("127.0.0.1", port);
+
+  static uint8_t jpeg[8000];
+  for(size_t i = 0; i < sizeof(jpeg); i++)
+    jpeg[i] = i * 31;
+  jpeg[0] = 0xff;
+  jpeg[1] = 0xd8;
+  uint8_t* jpegs[3] = { jpeg, jpeg, jpeg };
+  size_t sizes[3] = { sizeof(jpeg), sizeof(jpeg), sizeof(jpeg) };
+  const char* captions[3] = { "🚨 Person at 2.4 m & moving", "", nullptr };
+  auto alert = [&]() {
+    char text[160];
+    snprintf(text, sizeof(text), "🚨 Motion detected at %d cm\n%s", 240, "2025-07-22 03:14:07 & still there?");
+    return sendTextToTelegram(text) && sendPhotoToTelegram(jpeg, sizeof(jpeg))
+        && sendMediaGroupToTelegram(captions, jpegs, sizes, 3);
+  };
+  //the first one may set up the stdio and thread state of the host
+  CHECK(alert());
+  static const int ALERTS = 20;
+  uint64_t before = allocations();
+  bool ok = true;
+  for(int i = 0; i < ALERTS; i++)
+    ok = alert() && ok;
+  uint64_t allocated = allocations() - before;
+  CHECK(ok);
+  printf("{\"name\": \"request/alert\", \"alerts\": %d, \"allocations_per_alert\": %.2f}\n", ALERTS, (double)allocated / ALERTS);
+  CHECK(allocated == 0);
+
+  WiFiClient::redirect(nullptr, 0);
+  server.stop();
+}
+
+int main()
+{
+  encoding();
+  framing();
+  allocationFreeAlerts();
+  return checkResult("request_buffer_test");
+}
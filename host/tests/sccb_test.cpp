@@ -0,0 +1,73 @@
+//The OV7670's register traffic on the emulated sensor (stubs/OV7670Sensor.h):
+//configure() in the constructor, every table written and read back, then a
+//switch to VGA, written only. Per phase the register writes and reads, their
+//time on the I2C controller at 400 kHz, and the delays the bit-banged driver
+//it replaced spent on the same transactions: 4 us per clocked bit (address,
+//data and acknowledge) plus 6 us for start and stop. That driver's pin
+//writes came on top, so its figure is a lower bound.
+
+#include "OV7670.h"
+#include "OV7670Sensor.h"
+#include "check.h"
+
+#define PINS 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25
+
+struct Traffic
+{
+  unsigned long transactions;
+  unsigned long bits;
+  unsigned long reads;
+};
+
+static Traffic traffic()
+{
+  return { Wire.transactions, Wire.bits, Wire.reads };
+}
+
+static Traffic since(const Traffic& t)
+{
+  return { Wire.transactions - t.transactions, Wire.bits - t.bits, Wire.reads - t.reads };
+}
+
+static void report(const char* name, const Traffic& t)
+{
+  //a read is two transactions, the pointer write and the read itself
+  unsigned long writes = t.transactions - 2 * t.reads;
+  double sccbMs = t.bits * 1000.0 / I2C::FREQUENCY;
+  double bitBangMs = (4.0 * t.bits - 2.0 * t.transactions) / 1000;
+  printf("{\"name\": \"sccb/%s\", \"writes\": %lu, \"reads\": %lu, \"bits\": %lu, \"sccb_400khz_ms\": %.2f, "
+         "\"bit_banged_ms\": %.2f, \"speedup\": %.1f}\n",
+         name, writes, t.reads, t.bits, sccbMs, bitBangMs, bitBangMs / sccbMs);
+}
+
+int main()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, (size_t)OV7670::modeBytes(OV7670::QQVGA_RGB565), 1 },
+  };
+  CHECK(bufferPool.begin(classes, 2));
+
+  Traffic t = traffic();
+  OV7670 camera(OV7670::QQQVGA_RGB565, PINS, OV7670::QQVGA_RGB565);
+  Traffic configure = since(t);
+  report("configure", configure);
+  CHECK(Wire.frequency == I2C::FREQUENCY);
+  CHECK(camera.registerErrors == 0);
+  //the constructor reads back what it wrote, at most once per register
+  CHECK(configure.reads > 0 && configure.reads <= configure.transactions - 2 * configure.reads);
+
+  t = traffic();
+  CHECK(camera.setMode(OV7670::VGA_RGB565));
+  Traffic vga = since(t);
+  report("set_mode_vga", vga);
+  CHECK(camera.registerErrors == 0);
+  CHECK(vga.reads == 0 && vga.transactions > 0);
+
+  //the read back finds a register that differs from its table
+  unsigned char com7;
+  CHECK(camera.getRegister(OV7670::REG_COM7, com7));
+  RegisterValue wrong[] = { { OV7670::REG_COM7, (unsigned char)(com7 ^ 1) } };
+  CHECK(camera.verifyRegisters(wrong, 1) == 1);
+  return checkResult("sccb_test");
+}
@@ -0,0 +1,160 @@
+//SensorProfile with the in-memory Preferences and the emulated sensor's
+//registers (stubs/OV7670Sensor.h). The frames are synthetic FrameStats from
+//a model of the sensor's exposure control: the mean luma follows REG_AECH,
+//which moves half way to the exposure of the scene's target luma every
+//frame. Frames to a settled picture from the COM7 defaults and from the
+//profile the idle loop stored, then the ways a profile is dropped or not
+//applied: a lighting jump in observe(), an unusable first frame after a
+//restore, a restore in another mode and a restore that never settles. The
+//frame counts are the model's, not the OV7670's.
+
+#include "SensorProfile.h"
+#include "OV7670Sensor.h"
+#include "check.h"
+
+#define PINS 21, 22, 34, 35, 32, 33, 19, 23, 13, 12, 14, 27, 26, 25
+
+static const OV7670::Mode MODE = OV7670::QQVGA_RGB565;
+static const int TARGET_LUMA = 128;
+static const char* PROFILE_KEY = "sensor";
+
+static FrameStats stats(int luma, bool usable = true)
+{
+  FrameStats s = {};
+  s.samples = 1000;
+  s.lumaSum = luma * s.samples;
+  //a covered lens is featureless
+  s.gradientEnergy = usable ? s.samples : 0;
+  return s;
+}
+
+//one frame of the modelled exposure control: the luma of the current
+//exposure, then the exposure steps towards the target
+static FrameStats expose(OV7670& camera)
+{
+  uint8_t aech = hostSensorRegister(OV7670::REG_AECH);
+  camera.setRegister(OV7670::REG_AECH, aech + (TARGET_LUMA - aech) / 2);
+  return stats(aech, aech >= FrameStats::MIN_MEAN_LUMA);
+}
+
+static int settle(OV7670& camera, SensorProfile& profile)
+{
+  for(int i = 0; i <= SensorProfile::MAX_CONVERGE_FRAMES; i++)
+  {
+    int frames = profile.settle(true, expose(camera));
+    if(frames)
+      return frames;
+  }
+  return 0;
+}
+
+//the registers after a reset, as far as the model is concerned
+static void coldRegisters(OV7670& camera)
+{
+  camera.setRegister(OV7670::REG_AECH, 0);
+}
+
+static bool hasProfile(Preferences& prefs)
+{
+  uint8_t blob[32];
+  return prefs.getBytes(PROFILE_KEY, blob, sizeof(blob)) > 0;
+}
+
+//idle frames until the profile is stored
+static void snapshot(OV7670& camera, SensorProfile& profile)
+{
+  for(int i = 0; i < 4; i++)
+    profile.observe(camera, expose(camera));
+}
+
+int main()
+{
+  static const BufferPool::Class classes[] = {
+    { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },
+    { BufferPool::INTERNAL, (size_t)OV7670::modeBytes(MODE), 1 },
+  };
+  CHECK(bufferPool.begin(classes, 2));
+  OV7670 camera(MODE, PINS);
+  CHECK(camera.registerErrors == 0);
+  Preferences prefs;
+
+  //first boot: nothing stored, the exposure starts from the defaults
+  coldRegisters(camera);
+  int coldFrames;
+  {
+    SensorProfile profile(prefs);
+    CHECK(!profile.restore(camera));
+    coldFrames = settle(camera, profile);
+    snapshot(camera, profile);
+    CHECK(hasProfile(prefs));
+  }
+  uint8_t converged = hostSensorRegister(OV7670::REG_AECH);
+
+  //warm boot: the profile brings the exposure back before the first frame
+  coldRegisters(camera);
+  int warmFrames;
+  {
+    SensorProfile profile(prefs);
+    CHECK(profile.restore(camera) && profile.restored);
+    CHECK(hostSensorRegister(OV7670::REG_AECH) == converged);
+    warmFrames = settle(camera, profile);
+    CHECK(profile.restored && hasProfile(prefs));
+  }
+  printf("{\"name\": \"sensor_profile/converge\", \"cold_frames\": %d, \"warm_frames\": %d}\n", coldFrames, warmFrames);
+  CHECK(coldFrames > 0 && warmFrames > 0);
+  CHECK(warmFrames < coldFrames);
+
+  //another mode: the profile is not applied, and kept for its own mode
+  CHECK(camera.setMode(OV7670::QVGA_RGB565));
+  coldRegisters(camera);
+  {
+    SensorProfile profile(prefs);
+    CHECK(!profile.restore(camera) && !profile.restored);
+    CHECK(hostSensorRegister(OV7670::REG_AECH) == 0);
+    CHECK(hasProfile(prefs));
+  }
+  CHECK(camera.setMode(MODE));
+
+  //the first frame after the restore is unusable: the light is not the one
+  //the profile was taken in
+  {
+    SensorProfile profile(prefs);
+    CHECK(profile.restore(camera));
+    CHECK(profile.settle(true, stats(4, false)) == 0);
+    bool dropped = !profile.restored && !hasProfile(prefs);
+    printf("{\"name\": \"sensor_profile/unusable_first_frame\", \"dropped\": %s}\n", dropped ? "true" : "false");
+    CHECK(dropped);
+  }
+
+  //a step in the mean luma up to LIGHTING_JUMP keeps the profile, a sharper
+  //one drops it; the next settled frames take a new one
+  {
+    SensorProfile profile(prefs);
+    snapshot(camera, profile);
+    CHECK(hasProfile(prefs));
+    int luma = hostSensorRegister(OV7670::REG_AECH);
+    profile.observe(camera, stats(luma + SensorProfile::LIGHTING_JUMP));
+    bool kept = hasProfile(prefs);
+    luma += 2 * SensorProfile::LIGHTING_JUMP + 1;
+    profile.observe(camera, stats(luma));
+    bool dropped = !hasProfile(prefs);
+    for(int i = 0; i < 3; i++)
+      profile.observe(camera, stats(luma));
+    bool resnapshot = hasProfile(prefs);
+    printf("{\"name\": \"sensor_profile/lighting_jump\", \"kept_on_small_step\": %s, \"dropped\": %s, \"resnapshot\": %s}\n",
+           kept ? "true" : "false", dropped ? "true" : "false", resnapshot ? "true" : "false");
+    CHECK(kept && dropped && resnapshot);
+  }
+
+  //a restored profile that never settles is dropped after MAX_CONVERGE_FRAMES
+  {
+    SensorProfile profile(prefs);
+    CHECK(profile.restore(camera));
+    int frames = 0;
+    for(int i = 0; i <= SensorProfile::MAX_CONVERGE_FRAMES && !frames; i++)
+      frames = profile.settle(true, stats(i & 1 ? 60 : 180));
+    CHECK(frames == -1);
+    CHECK(!profile.restored && !hasProfile(prefs));
+  }
+  return checkResult("sensor_profile_test");
+}
@@ -0,0 +1,262 @@
+//TelegramCommands against a local stand-in for the Bot API: getUpdates long
+//polls on a kept-alive connection, answered as soon as a message is queued
+//and empty after POLL_MS otherwise. Messages go in one at a time while the
+//loop polls every LOOP_MS; each command must come out of poll() within a
+//bounded time, in order, with other chats dropped, and no poll() pass may
+//wait. A second client on the same Preferences must not see them again.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "TelegramCommands.h"
+#include "WiFiClientSecure.h"
+#include "check.h"
+
+static const char* CHAT_ID = "4242";
+static const long OTHER_CHAT = 999;
+//the real API holds a poll for its timeout, 25 s; short here for empty answers
+static const int POLL_MS = 300;
+static const unsigned long LOOP_MS = 20;
+//a loop pass and a round trip on loopback, with room for a loaded host
+static const unsigned long MAX_LATENCY_MS = 150;
+
+class BotApi
+{
+  public:
+  uint16_t start()
+  {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(bind(listener, (sockaddr*)&address, sizeof(address)) || listen(listener, 4)
+       || getsockname(listener, (sockaddr*)&address, &length))
+      return 0;
+    acceptor = std::thread(&BotApi::accepting, this);
+    return ntohs(address.sin_port);
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    changed.notify_all();
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    acceptor.join();
+    for(std::thread& t : connections)
+      t.join();
+  }
+
+  //text as typed, the answer escapes '/' as Telegram does
+  void message(long chat, const char* text)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    updates.push_back({ nextId++, chat, text });
+    changed.notify_all();
+  }
+
+  int accepted = 0;
+  int delivered = 0;
+  //offset of the first poll on the latest connection
+  unsigned long firstOffset = 0;
+
+  private:
+  struct Update
+  {
+    unsigned long id;
+    long chat;
+    std::string text;
+  };
+
+  int listener = -1;
+  std::thread acceptor;
+  std::vector<std::thread> connections;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<Update> updates;
+  unsigned long nextId = 500;
+  bool stopping = false;
+
+  void accepting()
+  {
+    while(true)
+    {
+      int connection = accept(listener, nullptr, nullptr);
+      if(connection < 0)
+        return;
+      std::lock_guard<std::mutex> lock(mutex);
+      accepted++;
+      connections.emplace_back(&BotApi::serve, this, connection, accepted);
+    }
+  }
+
+  void serve(int connection, int number)
+  {
+    std::string request;
+    char buffer[512];
+    bool first = true;
+    while(true)
+    {
+      size_t end;
+      while((end = request.find("\r\n\r\n")) == std::string::npos)
+      {
+        ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+        if(n <= 0)
+        {
+          close(connection);
+          return;
+        }
+        request.append(buffer, n);
+      }
+      size_t at = request.find("offset=");
+      unsigned long offset = at == std::string::npos ? 0 : strtoul(request.c_str() + at + 7, nullptr, 10);
+      request.erase(0, end + 4);
+
+      std::string result;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(first && number == accepted)
+          firstOffset = offset;
+        first = false;
+        auto pending = [&]() {
+          for(const Update& u : updates)
+            if(u.id >= offset)
+              return &u;
+          return (const Update*)nullptr;
+        };
+        changed.wait_for(lock, std::chrono::milliseconds(POLL_MS), [&]() { return stopping || pending(); });
+        if(const Update* u = pending())
+        {
+          std::string text;
+          for(char c : u->text)
+            c == '/' ? text += "\\/" : text += c;
+          char update[512];
+          snprintf(update, sizeof(update),
+                   "{\"update_id\":%lu,\"message\":{\"message_id\":%lu,\"from\":{\"id\":7,\"is_bot\":false,\"first_name\":\"Test\"},"
+                   "\"chat\":{\"id\":%ld,\"type\":\"private\"},\"date\":%ld,\"text\":\"%s\"}}",
+                   u->id, u->id - 400, u->chat, (long)time(nullptr), text.c_str());
+          result = update;
+          delivered++;
+        }
+      }
+      std::string body = "{\"ok\":true,\"result\":[" + result + "]}";
+      std::string answer = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size())
+                         + "\r\nConnection: keep-alive\r\n\r\n" + body;
+      if(send(connection, answer.data(), answer.size(), MSG_NOSIGNAL) != (ssize_t)answer.size())
+      {
+        close(connection);
+        return;
+      }
+    }
+  }
+};
+
+struct Step
+{
+  long chat;
+  const char* text;
+  TelegramCommands::Command expected;
+};
+
+static BotApi api;
+static Preferences prefs;
+static unsigned long worstPassMs = 0;
+
+//polls like loop() until a command comes out or wait ms have passed
+static TelegramCommands::Command loopUntil(TelegramCommands& commands, unsigned long wait, unsigned long& latency)
+{
+  unsigned long start = millis();
+  while(millis() - start < wait)
+  {
+    unsigned long before = millis();
+    TelegramCommands::Command c = commands.poll(millis());
+    worstPassMs = std::max(worstPassMs, millis() - before);
+    latency = millis() - start;
+    if(c != TelegramCommands::NONE)
+      return c;
+    delay(LOOP_MS);
+  }
+  return TelegramCommands::NONE;
+}
+
+static void commandsInOrder(uint16_t port)
+{
+  static const Step STEPS[] = {
+    { 4242, "/status", TelegramCommands::STATUS },
+    { 4242, "/snap@CamBot", TelegramCommands::SNAP },
+    { 4242, "/disarm", TelegramCommands::DISARM },
+    { OTHER_CHAT, "/arm", TelegramCommands::NONE },
+    { 4242, "hello", TelegramCommands::UNKNOWN },
+    { 4242, "/arm", TelegramCommands::ARM },
+    { 4242, "/stats", TelegramCommands::STATS },
+  };
+  WiFiClientSecure client;
+  TelegramCommands commands(client, prefs);
+  commands.begin("127.0.0.1", port, "123:abc", CHAT_ID);
+  unsigned long latency;
+  //the first poll connects and goes out, then comes back empty
+  loopUntil(commands, POLL_MS + 100, latency);
+
+  unsigned long worstLatency = 0;
+  for(const Step& s : STEPS)
+  {
+    api.message(s.chat, s.text);
+    TelegramCommands::Command c = loopUntil(commands, s.expected == TelegramCommands::NONE ? 200 : 1000, latency);
+    CHECK(c == s.expected);
+    if(c != TelegramCommands::NONE)
+      worstLatency = std::max(worstLatency, latency);
+  }
+  //an empty poll comes back and the next goes out on the same connection
+  loopUntil(commands, 2 * POLL_MS, latency);
+
+  printf("{\"name\": \"commands/latency\", \"commands\": %lu, \"dropped\": %lu, \"polls\": %lu, \"connections\": %d, "
+         "\"worst_command_ms\": %lu, \"worst_poll_pass_ms\": %lu}\n",
+         commands.commands, commands.dropped, commands.polls, api.accepted, worstLatency, worstPassMs);
+  CHECK(commands.commands == 6);
+  CHECK(commands.dropped == 1);
+  CHECK(commands.failures == 0);
+  CHECK(api.accepted == 1);
+  CHECK(commands.polls > (unsigned long)api.delivered);
+  CHECK(worstLatency <= MAX_LATENCY_MS);
+  CHECK(worstPassMs <= 5);
+  CHECK(prefs.getULong("tgoffset", 0) == 507);
+  commands.stop();
+}
+
+//after a reset the stored offset is asked for, nothing comes twice
+static void offsetKept(uint16_t port)
+{
+  WiFiClientSecure client;
+  TelegramCommands commands(client, prefs);
+  commands.begin("127.0.0.1", port, "123:abc", CHAT_ID);
+  unsigned long latency;
+  CHECK(loopUntil(commands, 2 * POLL_MS, latency) == TelegramCommands::NONE);
+  CHECK(api.accepted == 2);
+  CHECK(api.firstOffset == 507);
+  CHECK(commands.commands == 0);
+  commands.stop();
+}
+
+int main()
+{
+  uint16_t port = api.start();
+  CHECK(port);
+  if(port)
+  {
+    commandsInOrder(port);
+    offsetKept(port);
+    api.stop();
+  }
+  return checkResult("telegram_commands_test");
+}
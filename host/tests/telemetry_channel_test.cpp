@@ -0,0 +1,199 @@
+//TelemetryChannel with a fast and a slow client on local sockets: the
+//handshake key, then radar samples at the LD2420's native rate. The fast
+//client reads every pass and must get every sample in order, batched; the
+//slow one stops reading and later reads a little per pass, it must get the
+//newest samples and the count of the dropped ones. service() must never
+//block and the channel must not allocate. Then a client that sends a pong
+//in pieces and a close.
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "TelemetryChannel.h"
+#include "allocations.h"
+#include "check.h"
+
+//LD2420 reports every 50 ms or so in its default mode
+static const unsigned long SAMPLE_MS = 50;
+static const int SAMPLES = 2000;
+
+//the browser side: reads the messages off its end of the socket
+struct Browser
+{
+  int fd = -1;
+  std::vector<uint8_t> stream;
+  int messages = 0;
+  int samples = 0;
+  uint32_t dropped = 0;
+  uint32_t lastMs = 0;
+  bool ordered = true;
+  bool framed = true;
+
+  void read(size_t most = SIZE_MAX)
+  {
+    uint8_t buffer[4096];
+    while(most > 0)
+    {
+      ssize_t n = recv(fd, buffer, std::min(most, sizeof(buffer)), MSG_DONTWAIT);
+      if(n <= 0)
+        break;
+      stream.insert(stream.end(), buffer, buffer + n);
+      most -= n;
+    }
+    parse();
+  }
+
+  void parse()
+  {
+    size_t at = 0;
+    while(stream.size() - at >= 2)
+    {
+      const uint8_t* m = stream.data() + at;
+      size_t length = m[1] & 0x7f;
+      size_t head = 2;
+      if(length == 126)
+      {
+        if(stream.size() - at < 4)
+          break;
+        length = m[2] << 8 | m[3];
+        head = 4;
+      }
+      if(stream.size() - at < head + length)
+        break;
+      framed = framed && m[0] == 0x82 && !(m[1] & 0x80) && length >= 4 && (length - 4) % sizeof(TelemetryRecord) == 0;
+      uint32_t reported;
+      memcpy(&reported, m + head, 4);
+      ordered = ordered && reported >= dropped;
+      dropped = reported;
+      for(size_t r = head + 4; r + sizeof(TelemetryRecord) <= head + length; r += sizeof(TelemetryRecord))
+      {
+        TelemetryRecord record;
+        memcpy(&record, m + r, sizeof(record));
+        ordered = ordered && record.ms > lastMs;
+        lastMs = record.ms;
+        samples++;
+      }
+      messages++;
+      at += head + length;
+    }
+    stream.erase(stream.begin(), stream.begin() + at);
+  }
+};
+
+static bool connect(TelemetryChannel& channel, Browser& browser, int sendBuffer = 0)
+{
+  int pair[2];
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
+    return false;
+  if(sendBuffer)
+  {
+    setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+    setsockopt(pair[1], SOL_SOCKET, SO_RCVBUF, &sendBuffer, sizeof(sendBuffer));
+  }
+  browser.fd = pair[1];
+  //the counted allocations are the channel's
+  browser.stream.reserve(1 << 16);
+  WiFiClient socket(pair[0]);
+  return channel.add(socket);
+}
+
+static void handshake()
+{
+  //RFC 6455 section 1.3
+  char accept[29];
+  TelemetryChannel::acceptKey("dGhlIHNhbXBsZSBub25jZQ==", accept);
+  CHECK(!strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+}
+
+static void fastAndSlow()
+{
+  static TelemetryChannel channel;
+  Browser fast, slow;
+  CHECK(connect(channel, fast));
+  CHECK(connect(channel, slow, 4096));
+  Browser third;
+  CHECK(!connect(channel, third));
+  close(third.fd);
+
+  uint64_t allocated = allocations();
+  double worstServiceMs = 0;
+  int slowPasses = 0;
+  for(int i = 0; i < SAMPLES; i++)
+  {
+    hostClockSkipMs += SAMPLE_MS;
+    uint8_t flags = i % 100 < 30 ? TelemetryRecord::PRESENCE : 0;
+    channel.push({ (uint32_t)millis(), (int16_t)(i % 600), flags, (uint8_t)(flags ? 1 : 0) });
+    auto start = std::chrono::steady_clock::now();
+    channel.service();
+    double serviceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    worstServiceMs = std::max(worstServiceMs, serviceMs);
+    slowPasses += serviceMs >= 5;
+    fast.read();
+    //the slow client stalls for the first half, then takes 64 bytes per sample
+    if(i >= SAMPLES / 2)
+      slow.read(64);
+  }
+  allocated = allocations() - allocated;
+  //what is still queued or in flight
+  for(int i = 0; i < 20; i++)
+  {
+    hostClockSkipMs += TelemetryChannel::BATCH_MS;
+    channel.service();
+    fast.read();
+    slow.read();
+  }
+
+  printf("{\"name\": \"telemetry/fast\", \"samples\": %d, \"messages\": %d, \"dropped\": %u}\n", fast.samples, fast.messages, fast.dropped);
+  printf("{\"name\": \"telemetry/slow\", \"samples\": %d, \"messages\": %d, \"dropped\": %u, \"worst_service_ms\": %.3f, "
+         "\"service_passes_over_5ms\": %d, \"allocations\": %lu, \"channel_bytes\": %zu}\n",
+         slow.samples, slow.messages, slow.dropped, worstServiceMs, slowPasses, (unsigned long)allocated, sizeof(TelemetryChannel));
+  CHECK(fast.framed && fast.ordered);
+  CHECK(fast.samples == SAMPLES);
+  CHECK(fast.dropped == 0);
+  //batched: BATCH samples or BATCH_MS worth per message, not one each
+  CHECK(fast.messages <= SAMPLES * (int)SAMPLE_MS / (int)TelemetryChannel::BATCH_MS + 1);
+  CHECK(slow.framed && slow.ordered);
+  CHECK(slow.dropped > 0);
+  //every sample either arrived or was counted as dropped
+  CHECK(slow.samples + (int)slow.dropped == SAMPLES);
+  CHECK(slow.lastMs == fast.lastMs);
+  CHECK(channel.clients() == 2);
+  //a send that blocked on the stalled client would stall every pass after it;
+  //a pass or two the scheduler took the CPU from is not that
+  CHECK(slowPasses <= 2);
+  CHECK(allocated == 0);
+
+  close(fast.fd);
+  close(slow.fd);
+  channel.service();
+  CHECK(channel.clients() == 0);
+}
+
+//a masked pong arriving in pieces over several passes, then a close
+static void controlFrames()
+{
+  static TelemetryChannel channel;
+  Browser browser;
+  CHECK(connect(channel, browser));
+  static const uint8_t PONG[] = { 0x8a, 0x84, 1, 2, 3, 4, 'p' ^ 1, 'o' ^ 2, 'n' ^ 3, 'g' ^ 4 };
+  for(size_t i = 0; i < sizeof(PONG); i += 3)
+  {
+    send(browser.fd, PONG + i, std::min<size_t>(3, sizeof(PONG) - i), 0);
+    channel.service();
+    CHECK(channel.clients() == 1);
+  }
+  static const uint8_t CLOSE[] = { 0x88, 0x80, 1, 2, 3, 4 };
+  send(browser.fd, CLOSE, sizeof(CLOSE), 0);
+  channel.service();
+  CHECK(channel.clients() == 0);
+  close(browser.fd);
+}
+
+int main()
+{
+  handshake();
+  fastAndSlow();
+  controlFrames();
+  return checkResult("telemetry_channel_test");
+}
@@ -0,0 +1,320 @@
+#include "AlertSpool.h"
+#include <rom/crc.h>
+#include "BufferPool.h"
+
+static uint32_t headerCrc(const SpoolRecord& record)
+{
+  SpoolRecord h = record;
+  h.crc = 0;
+  return crc32_le(0, (const uint8_t*)&h, sizeof(h));
+}
+
+String AlertSpool::segmentPath(uint32_t segment) const
+{
+  char name[16];
+  snprintf(name, sizeof(name), "/%08lu.log", (unsigned long)segment);
+  return dir + name;
+}
+
+//reads and verifies the record at the file position; the JPEG goes to jpeg,
+//or is only checked in small chunks when jpeg is nullptr
+bool AlertSpool::readRecord(File& file, SpoolRecord& record, uint8_t* jpeg)
+{
+  if(file.read((uint8_t*)&record, sizeof(record)) != sizeof(record))
+    return false;
+  if(record.magic != SpoolRecord::MAGIC || record.jpegSize > SEGMENT_BYTES)
+    return false;
+  uint32_t crc = headerCrc(record);
+  if(jpeg)
+  {
+    if(file.read(jpeg, record.jpegSize) != record.jpegSize)
+      return false;
+    crc = crc32_le(crc, jpeg, record.jpegSize);
+  }
+  else
+  {
+    uint8_t chunk[256];
+    for(size_t left = record.jpegSize; left > 0;)
+    {
+      size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+      if(file.read(chunk, n) != n)
+        return false;
+      crc = crc32_le(crc, chunk, n);
+      left -= n;
+    }
+  }
+  return crc == record.crc;
+}
+
+size_t AlertSpool::scan(uint32_t segment, size_t offset, int& records, uint32_t& lastSequence)
+{
+  File file = fs->open(segmentPath(segment), "r");
+  if(!file)
+    return 0;
+  file.seek(offset);
+  SpoolRecord record;
+  while(readRecord(file, record, nullptr))
+  {
+    offset += sizeof(record) + record.jpegSize;
+    lastSequence = record.sequence;
+    records++;
+  }
+  file.close();
+  return offset;
+}
+
+bool AlertSpool::begin(fs::FS& fs, const char* dir)
+{
+  this->fs = &fs;
+  this->dir = dir;
+  pendingRecords = 0;
+  evictedRecords = 0;
+  peekedBytes = 0;
+  nextSequence = 0;
+  lastSealed = false;
+  lastSize = 0;
+  if(!fs.exists(dir) && !fs.mkdir(dir))
+    return false;
+
+  //segments are numbered, the spool is the range between the lowest and the highest
+  bool any = false;
+  firstSegment = 0;
+  lastSegment = 0;
+  File root = fs.open(dir);
+  for(File f = root.openNextFile(); f; f = root.openNextFile())
+  {
+    unsigned long n;
+    const char* name = strrchr(f.name(), '/');
+    name = name ? name + 1 : f.name();
+    if(sscanf(name, "%lu.log", &n) == 1)
+    {
+      if(!any || n < firstSegment) firstSegment = n;
+      if(!any || n > lastSegment) lastSegment = n;
+      any = true;
+    }
+    f.close();
+  }
+  root.close();
+  if(!any)
+  {
+    //a cursor left by a full drain points into segments that are gone; once
+    //the numbering reached it again it would skip records
+    fs.remove(this->dir + "/cursor");
+    firstSegment = 1;
+    lastSegment = 0;
+    readSegment = 1;
+    readOffset = 0;
+    rememberCursor();
+    return true;
+  }
+
+  loadCursor();
+  for(uint32_t s = readSegment; s <= lastSegment; s++)
+  {
+    int records = 0;
+    uint32_t sequence = nextSequence;
+    size_t end = scan(s, s == readSegment ? readOffset : 0, records, sequence);
+    pendingRecords += records;
+    if(records)
+      nextSequence = sequence + 1;
+    if(s == lastSegment)
+    {
+      File file = fs.open(segmentPath(s), "r");
+      lastSize = file ? file.size() : 0;
+      file.close();
+      //a torn write at the end, the damaged bytes stay but nothing is appended after them
+      lastSealed = end != lastSize;
+    }
+  }
+  rememberCursor();
+  return true;
+}
+
+void AlertSpool::rememberCursor()
+{
+  committedSegment = readSegment;
+  committedOffset = readOffset;
+  committedPending = pendingRecords;
+}
+
+void AlertSpool::rollback()
+{
+  readSegment = committedSegment;
+  readOffset = committedOffset;
+  pendingRecords = committedPending;
+  peekedBytes = 0;
+}
+
+void AlertSpool::loadCursor()
+{
+  readSegment = firstSegment;
+  readOffset = 0;
+  File file = fs->open(dir + "/cursor", "r");
+  if(!file)
+    return;
+  uint32_t cursor[3];
+  if(file.read((uint8_t*)cursor, sizeof(cursor)) == sizeof(cursor)
+     && crc32_le(0, (const uint8_t*)cursor, 8) == cursor[2]
+     && cursor[0] >= firstSegment && cursor[0] <= lastSegment)
+  {
+    readSegment = cursor[0];
+    readOffset = cursor[1];
+  }
+  file.close();
+}
+
+void AlertSpool::commit()
+{
+  uint32_t cursor[3] = { readSegment, (uint32_t)readOffset, 0 };
+  cursor[2] = crc32_le(0, (const uint8_t*)cursor, 8);
+  String tmp = dir + "/cursor.tmp";
+  File file = fs->open(tmp, "w");
+  if(!file)
+    return;
+  file.write((const uint8_t*)cursor, sizeof(cursor));
+  file.close();
+  fs->rename(tmp, dir + "/cursor");
+
+  //drained segments; the one being read stays until it is passed
+  while(firstSegment < readSegment)
+    fs->remove(segmentPath(firstSegment++));
+  if(!pendingRecords && readSegment == lastSegment && lastSize > 0)
+  {
+    //everything is out, start over with an empty segment
+    fs->remove(segmentPath(lastSegment));
+    firstSegment = readSegment = ++lastSegment;
+    lastSegment = firstSegment - 1;
+    readOffset = 0;
+    lastSize = 0;
+    lastSealed = false;
+  }
+  rememberCursor();
+}
+
+void AlertSpool::evictOldest()
+{
+  if(readSegment == firstSegment)
+  {
+    int records = 0;
+    uint32_t sequence;
+    scan(firstSegment, readOffset, records, sequence);
+    pendingRecords -= records;
+    evictedRecords += records;
+    readSegment++;
+    readOffset = 0;
+    peekedBytes = 0;
+    rememberCursor();
+  }
+  fs->remove(segmentPath(firstSegment++));
+}
+
+bool AlertSpool::append(uint32_t timestamp, int distance, int count, const uint8_t* jpeg, size_t jpegSize)
+{
+  if(!fs || jpegSize + sizeof(SpoolRecord) > SEGMENT_BYTES)
+  {
+    //too large for a segment, keep the event without its photo
+    jpeg = nullptr;
+    jpegSize = 0;
+  }
+  if(!fs)
+    return false;
+  size_t bytes = sizeof(SpoolRecord) + jpegSize;
+  if(lastSegment < firstSegment || lastSealed || lastSize + bytes > SEGMENT_BYTES)
+  {
+    lastSegment++;
+    lastSize = 0;
+    lastSealed = false;
+    while(lastSegment - firstSegment + 1 > (uint32_t)MAX_SEGMENTS)
+      evictOldest();
+  }
+
+  SpoolRecord record;
+  record.magic = SpoolRecord::MAGIC;
+  record.sequence = nextSequence;
+  record.timestamp = timestamp;
+  record.distance = distance;
+  record.count = count;
+  record.jpegSize = jpegSize;
+  record.crc = 0;
+  record.crc = crc32_le(headerCrc(record), jpeg, jpegSize);
+
+  File file = fs->open(segmentPath(lastSegment), "a");
+  if(!file)
+    return false;
+  bool ok = file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record)
+         && file.write(jpeg, jpegSize) == jpegSize;
+  file.close();
+  lastSize += bytes;
+  if(!ok)
+  {
+    lastSealed = true;
+    return false;
+  }
+  nextSequence++;
+  pendingRecords++;
+  committedPending++;
+  return true;
+}
+
+bool AlertSpool::peek(SpoolRecord& record, uint8_t** jpeg)
+{
+  *jpeg = nullptr;
+  while(pendingRecords > 0 && readSegment <= lastSegment)
+  {
+    File file = fs->open(segmentPath(readSegment), "r");
+    if(file && file.seek(readOffset) && file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)
+       && record.magic == SpoolRecord::MAGIC && record.jpegSize <= SEGMENT_BYTES)
+    {
+      file.seek(readOffset);
+      uint8_t* data = record.jpegSize ? (uint8_t*)bufferPool.take(record.jpegSize, BufferPool::LARGE) : nullptr;
+      if(record.jpegSize && !data)
+      {
+        file.close();
+        return false;
+      }
+      bool ok = readRecord(file, record, data);
+      file.close();
+      if(ok)
+      {
+        *jpeg = data;
+        peekedBytes = sizeof(record) + record.jpegSize;
+        return true;
+      }
+      bufferPool.give(data);
+    }
+    else if(file)
+      file.close();
+    //end of the segment or a damaged record, continue with the next segment
+    if(readSegment == lastSegment)
+      break;
+    readSegment++;
+    readOffset = 0;
+  }
+  return false;
+}
+
+void AlertSpool::consume()
+{
+  if(!peekedBytes)
+    return;
+  readOffset += peekedBytes;
+  peekedBytes = 0;
+  pendingRecords--;
+}
+
+int AlertSpool::takeBatch(SpoolRecord* records, uint8_t** jpegs, int max)
+{
+  int count = 0;
+  while(count < max && peek(records[count], &jpegs[count]))
+  {
+    //the first record of the other kind starts the next batch
+    if(count && (records[count].jpegSize != 0) != (records[0].jpegSize != 0))
+    {
+      bufferPool.give(jpegs[count]);
+      break;
+    }
+    consume();
+    count++;
+  }
+  return count;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+//one spooled alert, the JPEG follows the header in the segment file
+struct SpoolRecord
+{
+  static const uint32_t MAGIC = 0x4c505341;  //"ASPL"
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t timestamp;  //epoch seconds, 0 if the clock was not set
+  int16_t distance;
+  uint16_t count;
+  uint32_t jpegSize;
+  uint32_t crc;        //CRC32 of the header with crc = 0, then the JPEG
+};
+
+//Append-only alert queue for the time Telegram is out of reach. Records are
+//appended to numbered segment files that are never rewritten; a segment is
+//deleted as a whole once it is drained, or when the spool is over MAX_SEGMENTS
+//and the oldest alerts are evicted. A record cut short by a power loss fails
+//its CRC, the rest of that segment is skipped and new records go to a fresh
+//segment. The drain position lives in a small cursor file that is replaced
+//(written and renamed) once per batch, so delivery is at least once.
+class AlertSpool
+{
+  public:
+  static const size_t SEGMENT_BYTES = 64 * 1024;
+  static const int MAX_SEGMENTS = 8;
+
+  bool begin(fs::FS& fs, const char* dir = "/spool");
+
+  bool append(uint32_t timestamp, int distance, int count, const uint8_t* jpeg, size_t jpegSize);
+
+  //reads the record at the drain position into a LARGE bufferPool slot, give
+  //jpeg back there (nullptr without a photo); false when no slot is free
+  bool peek(SpoolRecord& record, uint8_t** jpeg);
+  //moves past the record returned by peek()
+  void consume();
+  //peeks and consumes the next run of records of one kind, all with a photo
+  //or all without, at most max; one run is one delivery, so commit() or
+  //rollback() after each. Returns the count, jpegs as from peek()
+  int takeBatch(SpoolRecord* records, uint8_t** jpegs, int max);
+  //makes the drain position persistent and deletes the drained segments
+  void commit();
+  //back to the last committed position, after a failed delivery
+  void rollback();
+
+  int pending() const
+  {
+    return pendingRecords;
+  }
+
+  int evicted() const
+  {
+    return evictedRecords;
+  }
+
+  private:
+  fs::FS* fs;
+  String dir;
+  uint32_t firstSegment;
+  uint32_t lastSegment;   //firstSegment - 1 while empty
+  size_t lastSize;
+  bool lastSealed;        //ends with a damaged record, append to a new segment
+  uint32_t readSegment;
+  size_t readOffset;
+  uint32_t committedSegment;
+  size_t committedOffset;
+  int committedPending;
+  size_t peekedBytes;
+  uint32_t nextSequence;
+  int pendingRecords;
+  int evictedRecords;
+
+  String segmentPath(uint32_t segment) const;
+  //counts the valid records from offset on, returns the end of the last one
+  size_t scan(uint32_t segment, size_t offset, int& records, uint32_t& lastSequence);
+  static bool readRecord(File& file, SpoolRecord& record, uint8_t* jpeg);
+  void loadCursor();
+  void rememberCursor();
+  void evictOldest();
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <stdint.h>
+#include <string.h>
 
 //assuming pixel lines have multiples of 4 bytes sizes
 class BMP
@@ -6,17 +8,18 @@ class BMP
 
   static void setChar(void *buffer, int pos, char ch)
   {
-    *(char*)(buffer+pos) = ch;
+    ((char*)buffer)[pos] = ch;
   }
 
-  static void setLong(void *buffer, int pos, long l)
+  //the fields are little endian and unaligned, 4 and 2 bytes whatever long is
+  static void setLong(void *buffer, int pos, int32_t l)
   {
-    *(long*)(buffer+pos) = l;
+    memcpy((char*)buffer + pos, &l, sizeof(l));
   }
   
-  static void setShort(void *buffer, int pos, short s)
+  static void setShort(void *buffer, int pos, int16_t s)
   {
-    *(short*)(buffer+pos) = s;
+    memcpy((char*)buffer + pos, &s, sizeof(s));
   }
   
 public:  
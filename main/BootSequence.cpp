@@ -0,0 +1,44 @@
+#include "BootSequence.h"
+
+void BootSequence::stageDone(unsigned long now)
+{
+  switch(current)
+  {
+    case RADAR:
+      isArmed = true;
+      armedMs = now;
+      break;
+    case CAMERA:
+      hasCamera = true;
+      break;
+    default:
+      break;
+  }
+  if(current != LOCAL_DONE)
+    current = (Stage)(current + 1);
+}
+
+bool BootSequence::wifi(bool connected, unsigned long now)
+{
+  if(hasNetwork || !connected)
+    return false;
+  hasNetwork = true;
+  networkMs = now;
+  return true;
+}
+
+bool BootSequence::startServer()
+{
+  if(hasServer || !hasNetwork || !hasCamera)
+    return false;
+  hasServer = true;
+  return true;
+}
+
+void BootSequence::helloSent(unsigned long now)
+{
+  if(isOnline)
+    return;
+  isOnline = true;
+  onlineMs = now;
+}
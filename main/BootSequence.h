@@ -0,0 +1,81 @@
+#pragma once
+
+//The order the sketch comes up in, one step per loop() pass so the radar is
+//served in between. Pure logic on a millisecond clock passed in by the
+//caller, like PowerScheduler, so the order and the milestones can be checked
+//on the host.
+//
+//The local stages run in dependency order: the spool first so alerts can be
+//queued, then the radar, which arms the system, then the camera and its
+//settling frames, then the recorder. The network side comes up next to them
+//once Wi-Fi is associated: the web server when the camera is there too, then
+//the Telegram hello, the first request, which puts the node online. Until
+//then alerts go to the spool.
+class BootSequence
+{
+  public:
+  enum Stage
+  {
+    STORAGE,
+    RADAR,
+    CAMERA,
+    CAMERA_SETTLE,
+    RECORDER,
+    LOCAL_DONE,
+  };
+
+  Stage stage() const
+  {
+    return current;
+  }
+  //the current stage is finished, the next pass runs the next one
+  void stageDone(unsigned long now);
+
+  //radar readings are acted on from here on
+  bool armed() const
+  {
+    return isArmed;
+  }
+  bool cameraReady() const
+  {
+    return hasCamera;
+  }
+
+  //Wi-Fi state of this pass; true in the pass the network came up
+  bool wifi(bool connected, unsigned long now);
+  bool networkUp() const
+  {
+    return hasNetwork;
+  }
+  //true once, in the first pass with both the network and the camera
+  bool startServer();
+  bool serverStarted() const
+  {
+    return hasServer;
+  }
+  //the hello is due, unless an alert holds the connection (busy)
+  bool helloDue(bool busy) const
+  {
+    return hasNetwork && !isOnline && !busy;
+  }
+  //Telegram answered the hello
+  void helloSent(unsigned long now);
+  //alerts, commands and the spool drain go to Telegram only from here on
+  bool online() const
+  {
+    return isOnline;
+  }
+
+  //millis() of the milestones, 0 while pending
+  unsigned long armedMs = 0;
+  unsigned long networkMs = 0;
+  unsigned long onlineMs = 0;
+
+  private:
+  Stage current = STORAGE;
+  bool isArmed = false;
+  bool hasCamera = false;
+  bool hasNetwork = false;
+  bool hasServer = false;
+  bool isOnline = false;
+};
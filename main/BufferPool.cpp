@@ -0,0 +1,152 @@
+#include "BufferPool.h"
+#include <esp_heap_caps.h>
+#include "Log.h"
+
+BufferPool bufferPool;
+
+static const char* capsName(BufferPool::Caps caps)
+{
+  return caps == BufferPool::DMA ? "dma" : caps == BufferPool::INTERNAL ? "internal" : "large";
+}
+
+//the most slots of a LARGE class internal RAM holds while keeping reserve free
+static uint8_t* reserveInternal(BufferPool::Class& config, size_t reserve)
+{
+  size_t free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  int fit = free > reserve ? (int)((free - reserve) / config.slotBytes) : 0;
+  for(int slots = min(config.slots, fit); slots > 0; slots--)
+  {
+    uint8_t* block = (uint8_t*)heap_caps_malloc(config.slotBytes * slots, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if(!block)
+      continue;
+    if(slots < config.slots)
+      LOGW("pool", "Buffer pool: only %d of %d x %u bytes large fit in internal RAM next to %u bytes reserved",
+           slots, config.slots, (unsigned)config.slotBytes, (unsigned)reserve);
+    config.slots = slots;
+    return block;
+  }
+  return nullptr;
+}
+
+bool BufferPool::begin(const Class* classes, int count, size_t internalReserve)
+{
+  bool ok = true;
+  for(int i = 0; i < count && poolCount < MAX_CLASSES; i++)
+  {
+    Pool& p = pools[poolCount];
+    p.config = classes[i];
+    if(p.config.slots > MAX_SLOTS)
+      p.config.slots = MAX_SLOTS;
+    //slots stay word aligned, DMA descriptors need that
+    p.config.slotBytes = (p.config.slotBytes + 3) & ~(size_t)3;
+    size_t bytes = p.config.slotBytes * p.config.slots;
+    p.psram = false;
+    p.block = nullptr;
+    if(p.config.caps == DMA)
+      p.block = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+    else if(p.config.caps == INTERNAL)
+      p.block = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    else
+    {
+      p.block = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      p.psram = p.block != nullptr;
+      if(!p.block)
+        p.block = reserveInternal(p.config, internalReserve);
+    }
+    if(!p.block)
+    {
+      LOGE("pool", "Buffer pool: no room for %d x %u bytes %s", p.config.slots, (unsigned)p.config.slotBytes, capsName(p.config.caps));
+      ok = false;
+      continue;
+    }
+    p.used = 0;
+    p.inUse = 0;
+    p.highWater = 0;
+    p.failures = 0;
+    poolCount++;
+  }
+  return ok;
+}
+
+void* BufferPool::take(size_t bytes, Caps caps, size_t* capacity)
+{
+  Pool* fallback = nullptr;
+  void* buffer = nullptr;
+  portENTER_CRITICAL(&lock);
+  Pool* best = nullptr;
+  for(int i = 0; i < poolCount; i++)
+  {
+    Pool& p = pools[i];
+    if(p.config.caps != caps || p.config.slotBytes < bytes)
+      continue;
+    if(!fallback || p.config.slotBytes < fallback->config.slotBytes)
+      fallback = &p;
+    if(p.inUse < p.config.slots && (!best || p.config.slotBytes < best->config.slotBytes))
+      best = &p;
+  }
+  if(best)
+  {
+    int slot = 0;
+    while(best->used & (1u << slot))
+      slot++;
+    best->used |= 1u << slot;
+    if(++best->inUse > best->highWater)
+      best->highWater = best->inUse;
+    buffer = best->block + slot * best->config.slotBytes;
+    if(capacity)
+      *capacity = best->config.slotBytes;
+  }
+  else if(fallback)
+    fallback->failures++;
+  portEXIT_CRITICAL(&lock);
+  return buffer;
+}
+
+void BufferPool::give(void* buffer)
+{
+  if(!buffer)
+    return;
+  portENTER_CRITICAL(&lock);
+  for(int i = 0; i < poolCount; i++)
+  {
+    Pool& p = pools[i];
+    uint8_t* b = (uint8_t*)buffer;
+    if(b < p.block || b >= p.block + p.config.slotBytes * p.config.slots)
+      continue;
+    uint32_t bit = 1u << ((b - p.block) / p.config.slotBytes);
+    if(p.used & bit)
+    {
+      p.used &= ~bit;
+      p.inUse--;
+    }
+    break;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+void BufferPool::printStats(Print& out) const
+{
+  for(int i = 0; i < poolCount; i++)
+  {
+    const Pool& p = pools[i];
+    out.printf("Buffer pool %s%s %u bytes: %d/%d in use, high water %d, %d failed\n",
+               capsName(p.config.caps), p.psram ? " (psram)" : "", (unsigned)p.config.slotBytes,
+               p.inUse, p.config.slots, p.highWater, p.failures);
+  }
+}
+
+size_t BufferPool::highWaterBytes() const
+{
+  size_t bytes = 0;
+  for(int i = 0; i < poolCount; i++)
+    bytes += pools[i].highWater * pools[i].config.slotBytes;
+  return bytes;
+}
+
+void BufferPool::resetHighWater()
+{
+  portENTER_CRITICAL(&lock);
+  for(int i = 0; i < poolCount; i++)
+    pools[i].highWater = pools[i].inUse;
+  portEXIT_CRITICAL(&lock);
+}
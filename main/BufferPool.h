@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+
+//All large buffers of the pipeline come from here. Each size class is one
+//block reserved at boot with the heap capabilities it needs and cut into
+//equal slots, so nothing on the capture, alert or upload path allocates from
+//the heap later and days of uptime cannot fragment it into failing. A take()
+//that finds no free slot fails instead of falling back to malloc.
+class BufferPool
+{
+  public:
+  enum Caps
+  {
+    DMA,       //internal RAM the I2S DMA can reach
+    INTERNAL,  //internal RAM, safe for the ISR while the flash cache is off
+    LARGE,     //PSRAM when the board has it, internal RAM otherwise
+  };
+
+  struct Class
+  {
+    Caps caps;
+    size_t slotBytes;
+    int slots;
+  };
+
+  static const int MAX_CLASSES = 8;
+  static const int MAX_SLOTS = 32;
+
+  //reserves all classes, false if one of them does not fit (the others stay).
+  //Without PSRAM a LARGE class gets as many of its slots as internal RAM holds
+  //with internalReserve bytes left over; none fitting fails the class
+  bool begin(const Class* classes, int count, size_t internalReserve = 0);
+
+  //a free slot of the smallest class with these caps that holds bytes;
+  //capacity receives the slot size
+  void* take(size_t bytes, Caps caps, size_t* capacity = nullptr);
+  void give(void* buffer);
+
+  //slots in use, high-water marks and failed takes per class
+  void printStats(Print& out) const;
+  //bytes of the slots of every class in use at once at most, since begin()
+  //or resetHighWater()
+  size_t highWaterBytes() const;
+  void resetHighWater();
+
+  private:
+  struct Pool
+  {
+    Class config;
+    uint8_t* block;
+    uint32_t used;      //one bit per slot
+    int inUse;
+    int highWater;
+    int failures;
+    bool psram;
+  };
+
+  Pool pools[MAX_CLASSES];
+  int poolCount = 0;
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern BufferPool bufferPool;
@@ -0,0 +1,112 @@
+#include "ClockTuner.h"
+
+//integer dividers of the 40 MHz LEDC counter, no fractional divider jitter
+static const uint32_t XCLK_HZ[] = { 20000000, 13333333, 10000000 };
+static const int PRESCALERS[] = { 1, 2, 3, 4, 6, 8 };
+static_assert(ClockTuner::MAX_CANDIDATES == sizeof(XCLK_HZ) / sizeof(XCLK_HZ[0]) * sizeof(PRESCALERS) / sizeof(PRESCALERS[0]),
+              "one candidate per XCLK and prescaler");
+
+void ClockTuner::key(char* out, OV7670::Mode m)
+{
+  sprintf(out, "clk%d", (int)m);
+}
+
+int ClockTuner::restore(OV7670& camera)
+{
+  int restored = 0;
+  for(int i = 0; i < OV7670::MODE_COUNT; i++)
+  {
+    char name[8];
+    Stored stored;
+    key(name, (OV7670::Mode)i);
+    if(prefs.getBytes(name, &stored, sizeof(stored)) != sizeof(stored) || stored.version != STORE_VERSION)
+      continue;
+    camera.setClock((OV7670::Mode)i, { stored.xclkHz, stored.clkrc });
+    restored++;
+  }
+  return restored;
+}
+
+void ClockTuner::forget(OV7670::Mode m)
+{
+  char name[8];
+  key(name, m);
+  prefs.remove(name);
+}
+
+int ClockTuner::candidates(OV7670::Mode m, OV7670::Clock* out, int size)
+{
+  //bit 7 of the default CLKRC is kept as it was
+  uint8_t keep = OV7670::defaultClock(m).clkrc & 0x80;
+  int count = 0;
+  for(uint32_t xclk : XCLK_HZ)
+    for(int prescaler : PRESCALERS)
+      if(count < size)
+        out[count++] = { xclk, (uint8_t)(keep | (prescaler - 1)) };
+  //fastest internal clock first, insertion sort keeps the XCLK order on ties
+  for(int i = 1; i < count; i++)
+  {
+    OV7670::Clock c = out[i];
+    uint32_t rate = c.xclkHz / ((c.clkrc & 0x3f) + 1);
+    int j = i - 1;
+    for(; j >= 0 && out[j].xclkHz / ((out[j].clkrc & 0x3f) + 1) < rate; j--)
+      out[j + 1] = out[j];
+    out[j + 1] = c;
+  }
+  return count;
+}
+
+void ClockTuner::measure(OV7670& camera, OV7670::Mode m, const OV7670::Clock& c, Result& r)
+{
+  camera.setClock(m, c);
+  //the frame in flight during the change is mixed
+  camera.oneFrame();
+  camera.resetHealth();
+  r = { c, 0, 0, 0, 0, 0 };
+  unsigned long start = millis();
+  for(int i = 0; i < frames && r.timeouts < MAX_TIMEOUTS; i++)
+    if(camera.oneFrame())
+      r.frames++;
+    else
+      r.timeouts++;
+  r.ms = millis() - start;
+  r.shortFrames = camera.shortFrames;
+  r.isrLoad = camera.isrLoadPercent();
+}
+
+bool ClockTuner::tune(OV7670& camera, OV7670::Mode m, Print& out, Result* results)
+{
+  OV7670::Clock list[MAX_CANDIDATES];
+  int count = candidates(m, list, MAX_CANDIDATES);
+  OV7670::Clock before = camera.clock(m);
+  camera.setMode(m);
+
+  out.printf("mode %d (%dx%d)\n", (int)m, OV7670::modeXres(m), OV7670::modeYres(m));
+  out.printf("  xclk_khz clkrc   fps  frames  torn  timeouts  isr_load\n");
+  //the list is fastest first, the first clean candidate is the one to keep
+  int best = -1;
+  for(int i = 0; i < count; i++)
+  {
+    Result r;
+    measure(camera, m, list[i], r);
+    if(best < 0 && r.clean())
+      best = i;
+    out.printf("  %8lu  0x%02x %3d.%d  %6d  %4d  %8d  %7d%%%s\n",
+               (unsigned long)(r.clock.xclkHz / 1000), r.clock.clkrc, r.fps10() / 10, r.fps10() % 10,
+               r.frames, r.shortFrames, r.timeouts, r.isrLoad, best == i ? "  <- stored" : "");
+    if(results)
+      results[i] = r;
+  }
+  if(best < 0)
+  {
+    out.printf("  no clean clock, keeping xclk %lu kHz clkrc 0x%02x\n", (unsigned long)(before.xclkHz / 1000), before.clkrc);
+    camera.setClock(m, before);
+    return false;
+  }
+  char name[8];
+  Stored stored = { STORE_VERSION, list[best].clkrc, list[best].xclkHz };
+  key(name, m);
+  prefs.putBytes(name, &stored, sizeof(stored));
+  camera.setClock(m, list[best]);
+  return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include "OV7670.h"
+
+//Finds the fastest sensor clock a mode captures cleanly at on this board.
+//Candidates (XCLK times CLKRC prescaler) are measured from the highest pixel
+//clock down; each gets FRAMES frames and is rejected on a torn frame, a
+//timeout or a line ISR above MAX_ISR_LOAD percent of the line period. Every
+//candidate is measured and printed as a table row, then the fastest clean
+//one is stored in Preferences per mode and written back by restore() at boot.
+class ClockTuner
+{
+  public:
+  static const int FRAMES = 12;
+  static const int MAX_ISR_LOAD = 90;
+  //a candidate that times out this often is not worth the rest of its frames
+  static const int MAX_TIMEOUTS = 2;
+
+  struct Result
+  {
+    OV7670::Clock clock;
+    int frames;
+    int shortFrames;
+    int timeouts;
+    int isrLoad;
+    unsigned long ms;
+
+    int errors() const
+    {
+      return shortFrames + timeouts;
+    }
+    bool clean() const
+    {
+      return !errors() && isrLoad < MAX_ISR_LOAD;
+    }
+    //frames per second times 10
+    int fps10() const
+    {
+      return ms ? (int)(frames * 10000UL / ms) : 0;
+    }
+  };
+
+  static const int MAX_CANDIDATES = 18;
+
+  ClockTuner(Preferences& prefs, int frames = FRAMES)
+    :prefs(prefs), frames(frames)
+  {
+  }
+
+  //applies the stored clock of every mode, returns how many there were
+  int restore(OV7670& camera);
+  //measures the candidates for m, stores and applies the fastest clean one;
+  //false (previous clock kept) if none was clean. Leaves the camera in m.
+  //results, if given, gets one per candidate in candidates() order
+  bool tune(OV7670& camera, OV7670::Mode m, Print& out, Result* results = nullptr);
+  void forget(OV7670::Mode m);
+  //the clocks tune() measures for m, fastest pixel clock first, the XCLK
+  //order kept on ties; returns how many, at most MAX_CANDIDATES
+  static int candidates(OV7670::Mode m, OV7670::Clock* out, int size);
+
+  private:
+  static const uint8_t STORE_VERSION = 1;
+  struct Stored
+  {
+    uint8_t version;
+    uint8_t clkrc;
+    uint32_t xclkHz;
+  };
+
+  Preferences& prefs;
+  int frames;
+
+  static void key(char* out, OV7670::Mode m);
+  void measure(OV7670& camera, OV7670::Mode m, const OV7670::Clock& c, Result& r);
+};
@@ -1,14 +1,17 @@
 #include <multi_heap.h> //added by me
 #pragma once
+#include "BufferPool.h"
 
 class DMABuffer
 {
   public:
   lldesc_t descriptor;
   unsigned char* buffer;
+  int capacity;
   DMABuffer(int bytes)
   {
-    buffer = (unsigned char *)malloc(bytes);
+    buffer = (unsigned char *)bufferPool.take(bytes, BufferPool::DMA);
+    capacity = bytes;
     descriptor.length = bytes;
     descriptor.size = descriptor.length;
     descriptor.owner = 1;
@@ -25,6 +28,16 @@ class DMABuffer
     descriptor.qe.stqe_next = &(next->descriptor);
   }
 
+  //shrinks the transfer to the first bytes of the buffer, no reallocation
+  bool resize(int bytes)
+  {
+    if(bytes > capacity)
+      return false;
+    descriptor.length = bytes;
+    descriptor.size = bytes;
+    return true;
+  }
+
   int sampleCount() const
   {
     return descriptor.length / 4;
@@ -32,8 +45,7 @@ class DMABuffer
 
   ~DMABuffer()
   {
-    if(buffer)
-      delete(buffer);
+    bufferPool.give(buffer);
   }
 };
 
@@ -0,0 +1,87 @@
+#include "EgressScheduler.h"
+
+EgressScheduler egress;
+
+EgressScheduler::EgressScheduler(unsigned long bytesPerSecond)
+  :link(bytesPerSecond)
+{
+}
+
+void EgressScheduler::setLinkRate(unsigned long bytesPerSecond)
+{
+  if(bytesPerSecond)
+    link = bytesPerSecond;
+}
+
+void EgressScheduler::alertPending(unsigned long now)
+{
+  if(alert)
+    return;
+  alert = true;
+  alertSince = now;
+  //what BULK saved up must not go out in front of the alert
+  if(tokens[BULK] > 0)
+    tokens[BULK] = 0;
+}
+
+void EgressScheduler::alertDone(unsigned long now)
+{
+  if(!alert)
+    return;
+  alert = false;
+  lastAlertMs = now - alertSince;
+  if(lastAlertMs > maxAlertMs)
+    maxAlertMs = lastAlertMs;
+}
+
+bool EgressScheduler::alertActive(unsigned long now) const
+{
+  return alert && now - alertSince < MAX_ALERT_MS;
+}
+
+int EgressScheduler::share(Class c, unsigned long now) const
+{
+  bool alerting = alertActive(now);
+  switch(c)
+  {
+    case CONTROL: return alerting ? CONTROL_ALERT_SHARE : CONTROL_SHARE;
+    case BULK: return alerting ? 0 : BULK_SHARE;
+    default: return 100;
+  }
+}
+
+void EgressScheduler::refill(unsigned long now)
+{
+  unsigned long windows = (now - windowStart) / WINDOW_MS;
+  if(!windows)
+    return;
+  windowStart += windows * WINDOW_MS;
+  for(int c = CONTROL; c < CLASS_COUNT; c++)
+  {
+    //one window's worth at most, a quiet class cannot save up a burst
+    long perWindow = (long)(link * WINDOW_MS / 1000 * share((Class)c, now) / 100);
+    long added = tokens[c] + perWindow * (long)(windows < 100 ? windows : 100);
+    tokens[c] = added < perWindow ? added : perWindow;
+  }
+}
+
+size_t EgressScheduler::grant(Class c, size_t wanted, unsigned long now)
+{
+  if(c == ALERT)
+    return wanted;
+  refill(now);
+  if(tokens[c] <= 0 || !share(c, now))
+  {
+    deferred[c]++;
+    return 0;
+  }
+  return wanted < (size_t)tokens[c] ? wanted : (size_t)tokens[c];
+}
+
+void EgressScheduler::sent(Class c, size_t n, unsigned long now)
+{
+  refill(now);
+  bytes[c] += n;
+  if(c != ALERT)
+    tokens[c] -= n;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stddef.h>
+
+//Decides which network writer may send now, so an alert upload does not
+//queue behind live view traffic in lwIP and on the air. Strict priority
+//classes: ALERT (everything to Telegram) is never held back; CONTROL (small
+//HTTP responses, telemetry) and BULK (live view, snapshots, recording
+//downloads) get a byte budget per WINDOW_MS, a share of the measured uplink
+//that leaves headroom for queues to drain. From the radar trigger until the
+//upload is done BULK is paused and CONTROL is cut to a trickle, so the link
+//is empty by the time the photo is encoded. Pure logic on a millisecond
+//clock passed in by the caller, like PowerScheduler.
+class EgressScheduler
+{
+  public:
+  enum Class
+  {
+    ALERT,
+    CONTROL,
+    BULK,
+    CLASS_COUNT,
+  };
+
+  static const unsigned long WINDOW_MS = 100;
+  //percent of the link per window
+  static const int CONTROL_SHARE = 30;
+  static const int BULK_SHARE = 60;
+  static const int CONTROL_ALERT_SHARE = 5;
+  //a forgotten alertDone() does not pause BULK for longer than this
+  static const unsigned long MAX_ALERT_MS = 30000;
+
+  explicit EgressScheduler(unsigned long bytesPerSecond = 40000);
+
+  void setLinkRate(unsigned long bytesPerSecond);
+  void alertPending(unsigned long now);
+  void alertDone(unsigned long now);
+  bool alertActive(unsigned long now) const;
+
+  //how many of wanted bytes c may write now, 0 while it is paused or over budget
+  size_t grant(Class c, size_t wanted, unsigned long now);
+  bool admit(Class c, unsigned long now)
+  {
+    return grant(c, 1, now) > 0;
+  }
+  //what c actually wrote; may run the budget into debt, paid off by the next windows
+  void sent(Class c, size_t bytes, unsigned long now);
+
+  unsigned long bytes[CLASS_COUNT] = {};
+  unsigned long deferred[CLASS_COUNT] = {};
+  //from alertPending() to alertDone()
+  unsigned long lastAlertMs = 0;
+  unsigned long maxAlertMs = 0;
+
+  private:
+  unsigned long link;
+  long tokens[CLASS_COUNT] = {};
+  unsigned long windowStart = 0;
+  bool alert = false;
+  unsigned long alertSince = 0;
+
+  int share(Class c, unsigned long now) const;
+  void refill(unsigned long now);
+};
+
+extern EgressScheduler egress;
@@ -0,0 +1,356 @@
+#include "EventRecorder.h"
+#include <rom/crc.h>
+
+//RIFF, hdrl with avih and one strl (strh, strf), then the movi list header
+static const uint32_t AVI_HEADER_BYTES = 224;
+//offset of the "movi" fourcc, idx1 offsets count from there
+static const uint32_t MOVI_FOURCC = 220;
+static const uint32_t AVIF_HASINDEX = 0x10;
+static const uint32_t AVIIF_KEYFRAME = 0x10;
+
+static void put16(uint8_t* p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+static void fourcc(uint8_t* p, const char* code)
+{
+  memcpy(p, code, 4);
+}
+
+String EventRecorder::path(int slot, const char* extension) const
+{
+  char name[16];
+  snprintf(name, sizeof(name), "/%02d.%s", slot, extension);
+  return dir + name;
+}
+
+uint32_t EventRecorder::headerCrc(const RecordingHeader& header, const RecordedFrame* frames)
+{
+  RecordingHeader h = header;
+  h.crc = 0;
+  uint32_t crc = crc32_le(0, (const uint8_t*)&h, sizeof(h));
+  return crc32_le(crc, (const uint8_t*)frames, h.frames * sizeof(RecordedFrame));
+}
+
+bool EventRecorder::begin(fs::FS& fs, const char* dir, int segments, size_t segmentBytes)
+{
+  static const uint8_t zeros[512] = { 0 };
+  this->fs = &fs;
+  this->dir = dir;
+  this->segments = segments < MAX_SEGMENTS ? segments : MAX_SEGMENTS;
+  this->segmentBytes = segmentBytes;
+  if(!fs.exists(dir) && !fs.mkdir(dir))
+    return false;
+
+  bool complete = true;
+  int newest = -1;
+  for(int s = 0; s < this->segments; s++)
+  {
+    //the sidecar tells what the slot holds, the index buffer is free until the first frame
+    if(readSidecar(s))
+    {
+      if(headers[s].sequence >= nextSequence)
+        nextSequence = headers[s].sequence + 1;
+      if(newest < 0 || headers[s].sequence > headers[newest].sequence)
+        newest = s;
+    }
+
+    String avi = path(s, "avi");
+    File data = fs.open(avi, "r");
+    size_t have = data ? data.size() : 0;
+    data.close();
+    if(have >= segmentBytes)
+      continue;
+    data = fs.open(avi, have ? "a" : "w");
+    while(data && have < segmentBytes)
+    {
+      size_t n = data.write(zeros, min(sizeof(zeros), segmentBytes - have));
+      if(!n)
+        break;
+      have += n;
+    }
+    data.close();
+    complete = complete && have >= segmentBytes;
+  }
+
+  //frames written after the last flush of the newest segment overwrote its
+  //idx1; it is rebuilt from the sidecar so the file ends at that flush again
+  if(newest >= 0 && readSidecar(newest) && (file = fs.open(path(newest, "avi"), "r+")))
+  {
+    const RecordingHeader& h = headers[newest];
+    slot = newest;
+    moviEnd = AVI_HEADER_BYTES;
+    if(h.frames)
+      moviEnd = index[h.frames - 1].offset + index[h.frames - 1].size + (index[h.frames - 1].size & 1);
+    writeIndex();
+    file.close();
+    slot = -1;
+  }
+  return complete;
+}
+
+bool EventRecorder::readSidecar(int s)
+{
+  RecordingHeader& h = headers[s];
+  h.magic = 0;
+  File side = fs->open(path(s, "idx"), "r");
+  if(!side)
+    return false;
+  bool valid = side.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == RecordingHeader::MAGIC && h.frames <= MAX_FRAMES
+            && side.read((uint8_t*)index, h.frames * sizeof(RecordedFrame)) == h.frames * sizeof(RecordedFrame)
+            && headerCrc(h, index) == h.crc;
+  side.close();
+  if(!valid)
+    h.magic = 0;
+  return valid;
+}
+
+int EventRecorder::slotOf(uint32_t sequence) const
+{
+  for(int s = 0; s < segments; s++)
+    if(headers[s].magic && headers[s].sequence == sequence)
+      return s;
+  return -1;
+}
+
+bool EventRecorder::start(int width, int height, uint32_t timestamp)
+{
+  //an empty slot, else the oldest segment
+  int oldest = 0;
+  for(int s = 0; s < segments; s++)
+  {
+    if(!headers[s].magic)
+    {
+      oldest = s;
+      break;
+    }
+    if(headers[s].sequence < headers[oldest].sequence)
+      oldest = s;
+  }
+  //the old sidecar goes first, a reset before the first flush must not pair it with new frames
+  fs->remove(path(oldest, "idx"));
+  headers[oldest].magic = 0;
+  file = fs->open(path(oldest, "avi"), "r+");
+  if(!file)
+    return false;
+  slot = oldest;
+  headers[slot] = { RecordingHeader::MAGIC, nextSequence++, timestamp, (uint16_t)width, (uint16_t)height, 0, 0, 0, 0 };
+  moviEnd = AVI_HEADER_BYTES;
+  unflushed = 0;
+  lastFlush = millis();
+  return writeIndex();
+}
+
+bool EventRecorder::addFrame(const uint8_t* jpeg, size_t size, int width, int height, int distance, uint32_t timestamp)
+{
+  //chunks are padded to an even size, idx1 needs 16 bytes per frame
+  size_t chunk = 8 + size + (size & 1);
+  if(!fs || AVI_HEADER_BYTES + chunk + 8 + 16 > segmentBytes)
+    return false;
+  if(slot >= 0)
+  {
+    const RecordingHeader& h = headers[slot];
+    if(h.width != width || h.height != height || h.frames >= MAX_FRAMES
+       || moviEnd + chunk + 8 + (h.frames + 1) * 16 > segmentBytes)
+      close();
+  }
+  if(slot < 0 && !start(width, height, timestamp))
+    return false;
+
+  RecordingHeader& h = headers[slot];
+  uint8_t head[8];
+  fourcc(head, "00dc");
+  put32(head + 4, size);
+  bool ok = file.seek(moviEnd) && file.write(head, sizeof(head)) == sizeof(head) && file.write(jpeg, size) == size;
+  if(ok && (size & 1))
+    ok = file.write(head, 1) == 1;
+  if(!ok)
+  {
+    //the index still ends before this frame
+    close();
+    return false;
+  }
+  unsigned long now = millis();
+  if(!h.frames)
+    startMs = now;
+  index[h.frames] = { moviEnd + 8, (uint32_t)size, (uint32_t)(now - startMs), (int16_t)distance, 0 };
+  h.frames++;
+  h.durationMs = now - startMs;
+  moviEnd += chunk;
+  if(++unflushed >= FLUSH_FRAMES || now - lastFlush >= FLUSH_INTERVAL)
+    flush();
+  return true;
+}
+
+bool EventRecorder::writeIndex()
+{
+  RecordingHeader& h = headers[slot];
+  uint32_t largest = 0;
+  for(uint32_t i = 0; i < h.frames; i++)
+    largest = max(largest, index[i].size);
+  uint32_t usPerFrame = h.frames > 1 && h.durationMs ? h.durationMs * 1000 / (h.frames - 1) : 1000000;
+  uint32_t indexBytes = h.frames * 16;
+
+  //idx1 right after the last frame, rewritten on every flush
+  uint8_t entries[32 * 16];
+  uint8_t head[8];
+  fourcc(head, "idx1");
+  put32(head + 4, indexBytes);
+  if(!file.seek(moviEnd) || file.write(head, sizeof(head)) != sizeof(head))
+    return false;
+  for(uint32_t i = 0; i < h.frames;)
+  {
+    int n = 0;
+    for(; n < 32 && i < h.frames; n++, i++)
+    {
+      uint8_t* e = entries + n * 16;
+      fourcc(e, "00dc");
+      put32(e + 4, AVIIF_KEYFRAME);
+      put32(e + 8, index[i].offset - 8 - MOVI_FOURCC);
+      put32(e + 12, index[i].size);
+    }
+    if(file.write(entries, n * 16) != (size_t)n * 16)
+      return false;
+  }
+
+  uint8_t avi[AVI_HEADER_BYTES] = { 0 };
+  h.fileBytes = moviEnd + 8 + indexBytes;
+  fourcc(avi, "RIFF");
+  put32(avi + 4, h.fileBytes - 8);
+  fourcc(avi + 8, "AVI ");
+  fourcc(avi + 12, "LIST");
+  put32(avi + 16, 192);
+  fourcc(avi + 20, "hdrl");
+  fourcc(avi + 24, "avih");
+  put32(avi + 28, 56);
+  put32(avi + 32, usPerFrame);
+  put32(avi + 36, (uint32_t)(largest * 1000000ULL / usPerFrame));
+  put32(avi + 44, AVIF_HASINDEX);
+  put32(avi + 48, h.frames);
+  put32(avi + 56, 1);  //streams
+  put32(avi + 60, largest);
+  put32(avi + 64, h.width);
+  put32(avi + 68, h.height);
+  fourcc(avi + 88, "LIST");
+  put32(avi + 92, 116);
+  fourcc(avi + 96, "strl");
+  fourcc(avi + 100, "strh");
+  put32(avi + 104, 56);
+  fourcc(avi + 108, "vids");
+  fourcc(avi + 112, "MJPG");
+  put32(avi + 128, usPerFrame);  //scale / rate is the frame time
+  put32(avi + 132, 1000000);
+  put32(avi + 140, h.frames);
+  put32(avi + 144, largest);
+  put32(avi + 148, 0xffffffff);  //default quality
+  put16(avi + 160, h.width);
+  put16(avi + 162, h.height);
+  fourcc(avi + 164, "strf");
+  put32(avi + 168, 40);
+  put32(avi + 172, 40);  //BITMAPINFOHEADER
+  put32(avi + 176, h.width);
+  put32(avi + 180, h.height);
+  put16(avi + 184, 1);
+  put16(avi + 186, 24);
+  fourcc(avi + 188, "MJPG");
+  put32(avi + 192, h.width * h.height * 3);
+  fourcc(avi + 212, "LIST");
+  put32(avi + 216, moviEnd - MOVI_FOURCC);
+  fourcc(avi + 220, "movi");
+  if(!file.seek(0) || file.write(avi, sizeof(avi)) != sizeof(avi))
+    return false;
+  file.flush();
+  return true;
+}
+
+bool EventRecorder::writeSidecar()
+{
+  RecordingHeader& h = headers[slot];
+  h.crc = headerCrc(h, index);
+  String tmp = path(slot, "tmp");
+  File side = fs->open(tmp, "w");
+  if(!side)
+    return false;
+  size_t entries = h.frames * sizeof(RecordedFrame);
+  bool ok = side.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) && side.write((const uint8_t*)index, entries) == entries;
+  side.close();
+  return ok && fs->rename(tmp, path(slot, "idx"));
+}
+
+bool EventRecorder::flush()
+{
+  if(slot < 0)
+    return false;
+  unsigned long t = micros();
+  bool ok = writeIndex() && writeSidecar();
+  lastFlushMicros = micros() - t;
+  unflushed = 0;
+  lastFlush = millis();
+  return ok;
+}
+
+void EventRecorder::close()
+{
+  if(slot < 0)
+    return;
+  if(unflushed)
+    flush();
+  file.close();
+  slot = -1;
+}
+
+int EventRecorder::list(RecordingHeader* out, int max) const
+{
+  int count = 0;
+  for(int s = 0; s < segments && count < max; s++)
+  {
+    if(!headers[s].magic || !headers[s].frames)
+      continue;
+    //insertion by sequence, newest first
+    int i = count++;
+    for(; i > 0 && out[i - 1].sequence < headers[s].sequence; i--)
+      out[i] = out[i - 1];
+    out[i] = headers[s];
+  }
+  return count;
+}
+
+File EventRecorder::openSegment(uint32_t sequence, size_t& length)
+{
+  int s = slotOf(sequence);
+  if(s < 0 || !headers[s].frames)
+    return File();
+  length = headers[s].fileBytes;
+  return fs->open(path(s, "avi"), "r");
+}
+
+bool EventRecorder::printIndex(uint32_t sequence, Print& out)
+{
+  int s = slotOf(sequence);
+  if(s < 0)
+    return false;
+  const RecordingHeader& h = headers[s];
+  out.printf("frame ms distance_cm bytes\n");
+  if(s == slot)
+  {
+    for(uint32_t i = 0; i < h.frames; i++)
+      out.printf("%lu %lu %d %lu\n", (unsigned long)i, (unsigned long)index[i].ms, index[i].distance, (unsigned long)index[i].size);
+    return true;
+  }
+  File side = fs->open(path(s, "idx"), "r");
+  if(!side || !side.seek(sizeof(RecordingHeader)))
+    return false;
+  RecordedFrame frame;
+  for(uint32_t i = 0; i < h.frames && side.read((uint8_t*)&frame, sizeof(frame)) == sizeof(frame); i++)
+    out.printf("%lu %lu %d %lu\n", (unsigned long)i, (unsigned long)frame.ms, frame.distance, (unsigned long)frame.size);
+  side.close();
+  return true;
+}
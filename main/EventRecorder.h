@@ -0,0 +1,97 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+//one frame in a segment's index
+struct RecordedFrame
+{
+  uint32_t offset;    //of the JPEG data in the AVI file
+  uint32_t size;
+  uint32_t ms;        //since the first frame of the segment
+  int16_t distance;   //radar distance in cm
+  uint16_t reserved;
+};
+
+//sidecar of a segment, followed by its RecordedFrame entries
+struct RecordingHeader
+{
+  static const uint32_t MAGIC = 0x43455256;  //"VREC"
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t startTime;  //epoch seconds, 0 if the clock was not set
+  uint16_t width;
+  uint16_t height;
+  uint32_t frames;
+  uint32_t fileBytes;  //valid bytes of the AVI, the rest of the file is preallocated
+  uint32_t durationMs;
+  uint32_t crc;        //CRC32 of the header with crc = 0, then the entries
+};
+
+//Event recorder: JPEG frames go into MJPEG AVI segments on flash, each a file
+//of SEGMENT bytes preallocated at begin() and overwritten in place, so the
+//recorder never runs the file system full and never fights the spool for
+//space. Segments are used as a ring, the oldest is overwritten when a new
+//one starts. The index of the open segment is kept in RAM; every
+//FLUSH_FRAMES frames or FLUSH_INTERVAL ms it is written as the AVI idx1 and
+//as a sidecar with the per frame radar distance and time, and the AVI header
+//is patched, so a power loss costs the frames since the last flush only.
+class EventRecorder
+{
+  public:
+  static const int MAX_SEGMENTS = 16;
+  static const int MAX_FRAMES = 256;
+  static const int FLUSH_FRAMES = 8;
+  static const unsigned long FLUSH_INTERVAL = 5000;
+
+  //segments files of segmentBytes each; creates the missing ones, which takes
+  //a while on the first boot
+  bool begin(fs::FS& fs, const char* dir, int segments, size_t segmentBytes);
+
+  //appends to the open segment, starts the next one when it is full or the
+  //frame size changed
+  bool addFrame(const uint8_t* jpeg, size_t size, int width, int height, int distance, uint32_t timestamp);
+  //writes the index out, the segment stays open
+  bool flush();
+  //ends the segment, the next frame starts a new one
+  void close();
+
+  bool recording() const
+  {
+    return slot >= 0;
+  }
+
+  //headers of the recorded segments, newest first; out holds MAX_SEGMENTS
+  int list(RecordingHeader* out, int max) const;
+  //the segment's AVI for reading, length is its valid part
+  File openSegment(uint32_t sequence, size_t& length);
+  //one line per frame: number, ms, distance, bytes
+  bool printIndex(uint32_t sequence, Print& out);
+
+  unsigned long lastFlushMicros = 0;
+
+  private:
+  fs::FS* fs = nullptr;
+  String dir;
+  int segments = 0;
+  size_t segmentBytes = 0;
+  uint32_t nextSequence = 1;
+  //by slot, magic 0 where the slot holds nothing
+  RecordingHeader headers[MAX_SEGMENTS];
+
+  File file;
+  int slot = -1;
+  RecordedFrame index[MAX_FRAMES];
+  uint32_t moviEnd = 0;
+  unsigned long startMs = 0;
+  unsigned long lastFlush = 0;
+  int unflushed = 0;
+
+  String path(int slot, const char* extension) const;
+  //the slot's header into headers[], its entries into index
+  bool readSidecar(int slot);
+  bool start(int width, int height, uint32_t timestamp);
+  bool writeIndex();
+  bool writeSidecar();
+  static uint32_t headerCrc(const RecordingHeader& header, const RecordedFrame* frames);
+  int slotOf(uint32_t sequence) const;
+};
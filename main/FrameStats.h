@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+//statistics the I2S interrupt accumulates while it copies the lines,
+//luma is sampled on every second pixel
+struct FrameStats
+{
+  static const int HISTOGRAM_BINS = 32;
+  static const int THUMB_SCALE = 8;
+  static const int MAX_THUMB_WIDTH = 640 / THUMB_SCALE;
+  static const int MAX_THUMB_HEIGHT = 480 / THUMB_SCALE;
+
+  //limits for usable()
+  static const int MIN_MEAN_LUMA = 12;
+  static const int MAX_MEAN_LUMA = 243;
+  static const int MAX_CLIPPED_PERCENT = 60;
+  static const int MIN_SHARPNESS_X16 = 16;
+
+  uint32_t frame;           //framesReceived when the frame completed
+  uint32_t samples;
+  uint32_t lumaSum;
+  uint32_t histogram[HISTOGRAM_BINS];
+  uint32_t clipped;         //samples below 5 or above 250
+  uint32_t gradientEnergy;  //sum of squared horizontal luma differences / 16
+  int thumbWidth;
+  int thumbHeight;
+  uint8_t thumbnail[MAX_THUMB_WIDTH * MAX_THUMB_HEIGHT];  //1/8 scale luma
+
+  void reset()
+  {
+    samples = 0;
+    lumaSum = 0;
+    memset(histogram, 0, sizeof(histogram));
+    clipped = 0;
+    gradientEnergy = 0;
+  }
+
+  int meanLuma() const
+  {
+    return samples ? lumaSum / samples : 0;
+  }
+
+  int clippedPercent() const
+  {
+    return samples ? clipped * 100 / samples : 0;
+  }
+
+  //mean squared gradient, 16 times the stored scale
+  int sharpness() const
+  {
+    return samples ? gradientEnergy * 16 / samples : 0;
+  }
+
+  //false for black, washed out or featureless (covered lens) frames
+  bool usable() const
+  {
+    int mean = meanLuma();
+    return samples
+        && mean >= MIN_MEAN_LUMA && mean <= MAX_MEAN_LUMA
+        && clippedPercent() <= MAX_CLIPPED_PERCENT
+        && sharpness() >= MIN_SHARPNESS_X16;
+  }
+};
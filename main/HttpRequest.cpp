@@ -0,0 +1,53 @@
+#include "HttpRequest.h"
+
+bool HttpRequest::add(char c)
+{
+  if(done)
+    return true;
+  if(!requestLineDone && c != '\r' && c != '\n')
+    requestLine += c;
+  if(c == '\n')
+  {
+    if(currentLine.length() == 0)
+    {
+      done = true;
+      return true;
+    }
+    if(currentLine.startsWith("Range:") || currentLine.startsWith("range:"))
+      range = currentLine;
+    if(currentLine.startsWith("Sec-WebSocket-Key:"))
+    {
+      webSocketKey = currentLine.substring(18);
+      webSocketKey.trim();
+    }
+    currentLine = "";
+    if(requestLine.length() > 0)
+      requestLineDone = true;
+  }
+  else if(c != '\r')
+    currentLine += c;
+  return false;
+}
+
+HttpRequest::RangeResult HttpRequest::byteRange(size_t length, size_t& first, size_t& last) const
+{
+  first = 0;
+  last = length - 1;
+  int at = range.indexOf("bytes=");
+  if(at < 0)
+    return WHOLE;
+  String spec = range.substring(at + 6);
+  int dash = spec.indexOf('-');
+  if(dash == 0)
+  {
+    size_t suffix = spec.substring(1).toInt();
+    first = suffix < length ? length - suffix : 0;
+  }
+  else if(dash > 0)
+  {
+    first = spec.substring(0, dash).toInt();
+    if(dash + 1 < (int)spec.length() && isDigit(spec[dash + 1]))
+      last = min((size_t)spec.substring(dash + 1).toInt(), length - 1);
+  }
+  return dash < 0 || first > last ? UNSATISFIABLE : PARTIAL;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+
+//The head of one request to the web server, fed a character at a time as it
+//arrives: the request line and the two headers the server looks at. Kept
+//apart from serve() so the parsing can be tested without a socket.
+class HttpRequest
+{
+  public:
+  enum RangeResult
+  {
+    WHOLE,          //no Range header, the whole body
+    PARTIAL,        //first..last of it
+    UNSATISFIABLE,  //416
+  };
+
+  String requestLine;
+  String range;         //the whole Range header line
+  String webSocketKey;  //Sec-WebSocket-Key, trimmed
+
+  //true once the empty line after the headers has arrived
+  bool add(char c);
+  bool complete() const
+  {
+    return done;
+  }
+
+  //bytes=first-last, bytes=first- or bytes=-suffix of a body of length
+  //bytes; of a list only the first range
+  RangeResult byteRange(size_t length, size_t& first, size_t& last) const;
+
+  private:
+  String currentLine;
+  bool requestLineDone = false;
+  bool done = false;
+};
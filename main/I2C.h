@@ -1,137 +1,80 @@
+#pragma once
 #include "Arduino.h"
+#include <Wire.h>
 
-class I2C
+//one entry of a sensor register table
+struct RegisterValue
 {
-  void inline DELAY()
-  {
-    delayMicroseconds(1);
-  }
+  unsigned char reg;
+  unsigned char value;
+};
 
-  void inline SCLLOW()
-  {
-    pinMode(SCL, OUTPUT);
-    digitalWrite(SCL, 0);
-  }
+//SCCB on the ESP32 hardware I2C controller. SCCB has no register address
+//auto-increment and no repeated start, so every register is a transaction of
+//its own and a read is the register address, a stop, then a one byte read.
+//Addresses are the 8 bit SCCB write addresses (0x42 for the OV7670).
+class I2C
+{
+  TwoWire& wire;
 
-  void inline SCLHIGH()
+  public:
+  static const uint32_t FREQUENCY = 400000;  //SCCB maximum
+  int SDA;
+  int SCL;
+  I2C(const int data, const int clock, TwoWire& bus = Wire)
+    :wire(bus)
   {
-    pinMode(SCL, INPUT_PULLUP);  
-    digitalWrite(SCL, 1);
+    SDA = data;
+    SCL = clock;
+    wire.begin(SDA, SCL, FREQUENCY);
   }
 
-  void inline CLOCK()
-  {
-    DELAY();
-    SCLHIGH();
-    DELAY();
-    DELAY();
-    SCLLOW();
-    DELAY();
-  }
-  
-  void inline SDALOW()
-  {
-    pinMode(SDA, OUTPUT);
-    digitalWrite(SDA, 0);  
-  }
-  
-  void inline SDAHIGH()
+  bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data)
   {
-    pinMode(SDA, OUTPUT);
-    digitalWrite(SDA, 1);  
+    wire.beginTransmission(addr >> 1);
+    wire.write(reg);
+    wire.write(data);
+    return wire.endTransmission() == 0;
   }
 
-  void inline SDAPULLUP()
+  bool readRegister(unsigned char addr, unsigned char reg, unsigned char& data)
   {
-    pinMode(SDA, INPUT_PULLUP);  
+    wire.beginTransmission(addr >> 1);
+    wire.write(reg);
+    if(wire.endTransmission(true) != 0)
+      return false;
+    if(wire.requestFrom((uint8_t)(addr >> 1), (uint8_t)1) != 1)
+      return false;
+    data = wire.read();
+    return true;
   }
 
-  void pushByte(unsigned char b)
-  {
-    for(char i = 0; i < 8; i++)
-    {
-      if(b & 0x80)
-        SDAHIGH();
-      else
-        SDALOW();
-      b <<= 1;
-      CLOCK();
-    }  
-  }
-  
-  bool getAck()
+  //writes the table in order, returns the number of writes that were not acknowledged
+  int writeRegisters(unsigned char addr, const RegisterValue* table, int count)
   {
-    SDAPULLUP();
-    DELAY();
-    SCLHIGH();
-    DELAY();
-    int r = digitalRead(SDA);
-    SDALOW();
-    DELAY();
-    SCLLOW();
-    DELAY();
-    return r == 0;
+    int failed = 0;
+    for(int i = 0; i < count; i++)
+      if(!writeRegister(addr, table[i].reg, table[i].value))
+        failed++;
+    return failed;
   }
 
-  void start()
-  {
-    SDAPULLUP();
-    DELAY();
-    SCLHIGH();
-    DELAY();
-    SDALOW();
-    DELAY();
-    SCLLOW();
-    DELAY();
-  }
-  
-  void end()
-  {
-    SCLHIGH();
-    DELAY();
-    SDAPULLUP();
-    DELAY();
-  }
-  
-  public:
-  int SDA;
-  int SCL;
-  I2C(const int data, const int clock)
-  {
-    SDA = data;
-    SCL = clock;
-    pinMode(SDA, INPUT_PULLUP);
-    pinMode(SCL, INPUT_PULLUP);
-    digitalWrite(SDA, 0);
-    digitalWrite(SCL, 0);
-  }
-  
-  bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data)
+  //reads the table's registers back, returns how many differ or could not be
+  //read; a register listed twice is compared with its last value only
+  int verifyRegisters(unsigned char addr, const RegisterValue* table, int count)
   {
-    start();
-    pushByte(addr);
-    
-    if(!getAck())
+    int wrong = 0;
+    for(int i = 0; i < count; i++)
     {
-      end();
-      return false;
+      bool overwritten = false;
+      for(int j = i + 1; j < count && !overwritten; j++)
+        overwritten = table[j].reg == table[i].reg;
+      if(overwritten)
+        continue;
+      unsigned char value;
+      if(!readRegister(addr, table[i].reg, value) || value != table[i].value)
+        wrong++;
     }
-    
-    pushByte(reg);
-    if(!getAck())
-    {
-      end();
-      return false;
-    }
-  
-    pushByte(data);
-    if(!getAck())
-    {
-      end();
-      return false;
-    }
-  
-    end();
-    return true;
+    return wrong;
   }
 };
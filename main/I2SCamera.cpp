@@ -19,67 +19,88 @@ DMABuffer **I2SCamera::dmaBuffer = 0;
 unsigned char* I2SCamera::frame = 0;
 int I2SCamera::framePointer = 0;
 int I2SCamera::frameBytes = 0;
+int I2SCamera::frameCapacity = 0;
+int I2SCamera::bandFirst = 0;
+int I2SCamera::bandLines = 0;
+int I2SCamera::ringLines = 0;
+volatile int I2SCamera::bandsFilled = 0;
+volatile int I2SCamera::bandsReleased = 0;
+volatile bool I2SCamera::bandOverrun = false;
+SemaphoreHandle_t I2SCamera::bandSemaphore = 0;
 volatile bool I2SCamera::stopSignal = false;
+I2SCamera::PixelFormat I2SCamera::pixelFormat = I2SCamera::PIXEL_RGB565;
+SemaphoreHandle_t I2SCamera::vSyncSemaphore = 0;
+SemaphoreHandle_t I2SCamera::frameSemaphore = 0;
+int I2SCamera::timeoutMs = 1000;
+FrameStats I2SCamera::statsBuffers[2];
+FrameStats* volatile I2SCamera::statsWork = &I2SCamera::statsBuffers[0];
+FrameStats* volatile I2SCamera::statsDone = &I2SCamera::statsBuffers[1];
+uint16_t I2SCamera::thumbAccumulator[FrameStats::MAX_THUMB_WIDTH];
+volatile int I2SCamera::shortFrames = 0;
+volatile uint32_t I2SCamera::isrMaxCycles = 0;
+volatile uint32_t I2SCamera::linePeriodCycles = 0;
+uint32_t I2SCamera::lineStartCycles = 0;
+int I2SCamera::framesAtVSync = 0;
+volatile bool I2SCamera::capturing = false;
 
 void IRAM_ATTR I2SCamera::i2sInterrupt(void* arg)
 {
-    I2S0.int_clr.val = I2S0.int_raw.val;
-    blocksReceived++;
-    unsigned char* buf = dmaBuffer[dmaBufferActive]->buffer;
-    dmaBufferActive = (dmaBufferActive + 1) % dmaBufferCount;
-    if(framePointer < frameBytes)
-      for(int i = 0; i < xres * 4; i += 4)
-      {
-        frame[framePointer++] = buf[i + 2];
-        frame[framePointer++] = buf[i];
-      }
-    if (blocksReceived == yres)
-    {
-      framePointer = 0;
-      blocksReceived = 0;
-      framesReceived++;
-      if(stopSignal)
-      {
-        i2sStop();
-        stopSignal = false;
-      }
-    }
-    //    i2sStop();
+  lineInterrupt<ANY_FORMAT, 0, 0>();
 }
 
 void IRAM_ATTR I2SCamera::vSyncInterrupt(void* arg)
 {
     GPIO.status1_w1tc.val = GPIO.status1.val;
     GPIO.status_w1tc = GPIO.status;
-    if(gpio_get_level(vSyncPin))
-    {
-      //frame done
-    }
+    //falling edge: VSYNC pulse is over, next frame starts. Lines still counted
+    //and no frame completed since the last one: lines were lost, it is torn
+    if(capturing && blocksReceived && framesReceived == framesAtVSync)
+      shortFrames++;
+    framesAtVSync = framesReceived;
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(vSyncSemaphore, &woken);
+    if(woken)
+      portYIELD_FROM_ISR();
 }
 
 void I2SCamera::i2sStop()
 {
     esp_intr_disable(i2sInterruptHandle);
     esp_intr_disable(vSyncInterruptHandle);
+    capturing = false;
     i2sConfReset();
     I2S0.conf.rx_start = 0;
 }
 
-void I2SCamera::i2sRun()
+bool I2SCamera::waitVSync(int ms)
+{
+    xSemaphoreTake(vSyncSemaphore, 0);
+    esp_intr_enable(vSyncInterruptHandle);
+    if(xSemaphoreTake(vSyncSemaphore, pdMS_TO_TICKS(ms)) == pdTRUE)
+      return true;
+    esp_intr_disable(vSyncInterruptHandle);
+    return false;
+}
+
+bool I2SCamera::i2sRun()
 {
-    DEBUG_PRINTLN("I2S Run");
-    while (gpio_get_level(vSyncPin) == 0);
-    while (gpio_get_level(vSyncPin) != 0);
+    LOGD("camera", "I2S run");
+    if(!waitVSync(timeoutMs))
+    {
+      LOGD("camera", "VSYNC timeout");
+      return false;
+    }
 
     esp_intr_disable(i2sInterruptHandle);
     i2sConfReset();
     blocksReceived = 0;
     dmaBufferActive = 0;
     framePointer = 0;
-    DEBUG_PRINT("Sample count ");
-    DEBUG_PRINTLN(dmaBuffer[0]->sampleCount());
+    framesAtVSync = framesReceived;
+    capturing = true;
+    LOGD("camera", "Sample count %d", (int)dmaBuffer[0]->sampleCount());
     I2S0.rx_eof_num = dmaBuffer[0]->sampleCount();
-    I2S0.in_link.addr = (uint32_t)&(dmaBuffer[0]->descriptor);
+    I2S0.in_link.addr = (uintptr_t)&(dmaBuffer[0]->descriptor);
     I2S0.in_link.start = 1;
     I2S0.int_clr.val = I2S0.int_raw.val;
     I2S0.int_ena.val = 0;
@@ -87,20 +108,36 @@ void I2SCamera::i2sRun()
     esp_intr_enable(i2sInterruptHandle);
     esp_intr_enable(vSyncInterruptHandle);
     I2S0.conf.rx_start = 1;
+    return true;
 }
 
 bool I2SCamera::initVSync(int pin)
 {
-  DEBUG_PRINT("Initializing VSYNC... ");
   vSyncPin = (gpio_num_t)pin;
-  gpio_set_intr_type(vSyncPin, GPIO_INTR_POSEDGE);
+  if(!vSyncSemaphore)
+    vSyncSemaphore = xSemaphoreCreateBinary();
+  if(!frameSemaphore)
+    frameSemaphore = xSemaphoreCreateBinary();
+  if(!bandSemaphore)
+    bandSemaphore = xSemaphoreCreateBinary();
+  if(!vSyncSemaphore || !frameSemaphore || !bandSemaphore)
+  {
+    LOGE("camera", "VSYNC semaphores failed");
+    return false;
+  }
+  gpio_set_intr_type(vSyncPin, GPIO_INTR_NEGEDGE);
   gpio_intr_enable(vSyncPin);
+  //gpio_config() in i2sInit() resets the interrupt type, the handler stays registered
+  if(vSyncInterruptHandle)
+  {
+    return true;
+  }
   if(gpio_isr_register(&vSyncInterrupt, (void*)"vSyncInterrupt", ESP_INTR_FLAG_INTRDISABLED | ESP_INTR_FLAG_IRAM, &vSyncInterruptHandle) != ESP_OK) 
   {
-    DEBUG_PRINTLN("failed!");
+    LOGE("camera", "VSYNC interrupt failed");
     return false;
   }
-  DEBUG_PRINTLN("done.");
+  LOGD("camera", "VSYNC initialized");
   return true;
 }
 
@@ -109,24 +146,104 @@ void I2SCamera::deinitVSync()
   esp_intr_disable(vSyncInterruptHandle);
 }
 
-bool I2SCamera::init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7)
+bool I2SCamera::init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7, const int FRAME_CAPACITY, const PixelFormat FORMAT, LineInterrupt handler, const int DMA_LINE_BYTES)
 {
   xres = XRES;
   yres = YRES;
-  frameBytes = XRES * YRES * 2;
-  frame = (unsigned char*)malloc(frameBytes);
+  pixelFormat = FORMAT;
+  frameBytes = XRES * YRES * bytesPerPixel();
+  //the frame buffer is allocated once for the largest mode setGeometry() may
+  //switch to; below the frame size it is captured in bands
+  frameCapacity = FRAME_CAPACITY > 0 ? FRAME_CAPACITY : frameBytes;
+  frame = (unsigned char*)bufferPool.take(frameCapacity, BufferPool::INTERNAL);
   if(!frame)
   {
-    DEBUG_PRINTLN("Not enough memory for frame buffer!");
+    LOGE("camera", "Not enough memory for frame buffer");
+    return false;
+  }
+  i2sInit(VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7, handler);
+  if(!dmaBufferInit(DMA_LINE_BYTES))
+  {
+    LOGE("camera", "Not enough DMA memory for line buffers");
     return false;
   }
-  i2sInit(VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
-  dmaBufferInit(xres * 2 * 2);  //two bytes per dword packing, two bytes per pixel
+  setGeometry(xres, yres, pixelFormat);
   initVSync(VSYNC);
   return true;
 }
 
-bool I2SCamera::i2sInit(const int VSYNC, const int HREF, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7)
+//frames larger than the buffer are captured in bands, see setBand()
+bool I2SCamera::setGeometry(int XRES, int YRES, PixelFormat FORMAT)
+{
+  //two bytes per dword packing, two bytes per pixel
+  if(XRES > MAX_XRES || XRES * 2 * 2 > dmaBuffer[0]->capacity || XRES * 2 > frameCapacity)
+  {
+    LOGE("camera", "Frame does not fit the preallocated buffers");
+    return false;
+  }
+  xres = XRES;
+  yres = YRES;
+  pixelFormat = FORMAT;
+  for(int i = 0; i < dmaBufferCount; i++)
+    dmaBuffer[i]->resize(xres * 2 * 2);
+  int lines = maxBandLines();
+  return setBand(0, lines < yres ? lines : yres);
+}
+
+//the next frames keep only the lines first..first+lines-1
+bool I2SCamera::setBand(int first, int lines)
+{
+  if(first < 0 || lines <= 0 || first + lines > yres || lines * xres * bytesPerPixel() > frameCapacity)
+    return false;
+  bandFirst = first;
+  bandLines = lines;
+  frameBytes = lines * xres * bytesPerPixel();
+  return true;
+}
+
+bool I2SCamera::startBandRing(int lines)
+{
+  if(lines <= 0 || lines > maxRingLines() || lines > yres)
+    return false;
+  ringLines = lines;
+  bandsFilled = 0;
+  bandsReleased = 0;
+  bandOverrun = false;
+  xSemaphoreTake(bandSemaphore, 0);
+  xSemaphoreTake(frameSemaphore, 0);
+  if(!i2sRun())
+  {
+    ringLines = 0;
+    return false;
+  }
+  //the ISR stops at the end of this frame
+  stopSignal = true;
+  return true;
+}
+
+const unsigned char* I2SCamera::waitBand(int band)
+{
+  while(bandsFilled <= band && !bandOverrun)
+    if(xSemaphoreTake(bandSemaphore, pdMS_TO_TICKS(timeoutMs)) != pdTRUE)
+      return nullptr;
+  if(bandOverrun)
+    return nullptr;
+  return frame + (band & 1) * ringLines * xres * bytesPerPixel();
+}
+
+bool I2SCamera::finishBandRing()
+{
+  bool done = !bandOverrun && xSemaphoreTake(frameSemaphore, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+  if(!done)
+  {
+    i2sStop();
+    stopSignal = false;
+  }
+  ringLines = 0;
+  return done;
+}
+
+bool I2SCamera::i2sInit(const int VSYNC, const int HREF, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7, LineInterrupt handler)
 {    
   int pins[] = {VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7};    
   gpio_config_t conf = {
@@ -197,14 +314,14 @@ bool I2SCamera::i2sInit(const int VSYNC, const int HREF, const int PCLK, const i
     I2S0.timing.val = 0;
 
     // Allocate I2S interrupt, keep it disabled
-    esp_intr_alloc(ETS_I2S0_INTR_SOURCE, ESP_INTR_FLAG_INTRDISABLED | ESP_INTR_FLAG_LEVEL1 | ESP_INTR_FLAG_IRAM, &i2sInterrupt, NULL, &i2sInterruptHandle);
+    esp_intr_alloc(ETS_I2S0_INTR_SOURCE, ESP_INTR_FLAG_INTRDISABLED | ESP_INTR_FLAG_LEVEL1 | ESP_INTR_FLAG_IRAM, handler, NULL, &i2sInterruptHandle);
     return true;
 }
 
-void I2SCamera::dmaBufferInit(int bytes)
+bool I2SCamera::dmaBufferInit(int bytes)
 {
   dmaBufferCount = 2;
-  dmaBuffer = (DMABuffer**) malloc(sizeof(DMABuffer*) * dmaBufferCount);
+  dmaBuffer = new DMABuffer*[dmaBufferCount];
   for(int i = 0; i < dmaBufferCount; i++)
   {
     dmaBuffer[i] = new DMABuffer(bytes);
@@ -212,6 +329,10 @@ void I2SCamera::dmaBufferInit(int bytes)
       dmaBuffer[i-1]->next(dmaBuffer[i]);
   }
   dmaBuffer[dmaBufferCount - 1]->next(dmaBuffer[0]);
+  for(int i = 0; i < dmaBufferCount; i++)
+    if(!dmaBuffer[i]->buffer)
+      return false;
+  return true;
 }
 
 void I2SCamera::dmaBufferDeinit()
@@ -219,7 +340,7 @@ void I2SCamera::dmaBufferDeinit()
     if (!dmaBuffer) return;
     for(int i = 0; i < dmaBufferCount; i++)
       delete(dmaBuffer[i]);
-    delete(dmaBuffer);
+    delete[] dmaBuffer;
     dmaBuffer = 0;
     dmaBufferCount = 0;
 }
@@ -13,12 +13,27 @@
 #include "driver/gpio.h"
 #include "driver/periph_ctrl.h"
 #include "rom/lldesc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "XClk.h"
 #include "DMABuffer.h"
+#include "FrameStats.h"
 
 class I2SCamera
 {
   public:
+  static const int MAX_XRES = 640;
+  //the FORMAT of lineInterrupt() that reads pixelFormat at run time
+  static const int ANY_FORMAT = -1;
+
+  typedef void (*LineInterrupt)(void* arg);
+
+  enum PixelFormat
+  {
+    PIXEL_RGB565,
+    PIXEL_YUV422, //stored U Y V Y
+    PIXEL_Y8,     //luma only, chroma bytes are dropped in the ISR
+  };
   static gpio_num_t vSyncPin;
   static int blocksReceived;
   static int framesReceived;
@@ -32,7 +47,33 @@ class I2SCamera
   static unsigned char* frame;
   static int framePointer;
   static int frameBytes;
+  static int frameCapacity;
+  static int bandFirst;
+  static int bandLines;
+  //band ring of one frame, see startBandRing(); ringLines is 0 outside of one
+  static int ringLines;
+  static volatile int bandsFilled;
+  static volatile int bandsReleased;
+  static volatile bool bandOverrun;
+  static SemaphoreHandle_t bandSemaphore;
   static volatile bool stopSignal;
+  static PixelFormat pixelFormat;
+  static FrameStats statsBuffers[2];
+  static FrameStats* volatile statsWork;
+  static FrameStats* volatile statsDone;
+  static uint16_t thumbAccumulator[FrameStats::MAX_THUMB_WIDTH];
+  static SemaphoreHandle_t vSyncSemaphore;
+  static SemaphoreHandle_t frameSemaphore;
+  static int timeoutMs;
+  //capture health, read by the clock calibration: frames a VSYNC cut short
+  //(lines were lost, the frame is torn), the longest line ISR and the
+  //shortest line period seen, both in CPU cycles
+  static volatile int shortFrames;
+  static volatile uint32_t isrMaxCycles;
+  static volatile uint32_t linePeriodCycles;
+  static uint32_t lineStartCycles;
+  static int framesAtVSync;
+  static volatile bool capturing;
 
   typedef enum {
     /* camera sends byte sequence: s1, s2, s3, s4, ...
@@ -62,36 +103,252 @@ class I2SCamera
     while (I2S0.state.rx_fifo_reset_back);
   }
   
-  void start()
+  bool start()
   {
-    i2sRun();
+    return i2sRun();
   }
 
-  void stop()
+  //blocks until the frame in flight is complete, gives up after timeoutMs
+  bool stop()
   {
+    xSemaphoreTake(frameSemaphore, 0);
     stopSignal = true;
-    while(stopSignal);
+    if(xSemaphoreTake(frameSemaphore, pdMS_TO_TICKS(timeoutMs)) == pdTRUE)
+      return true;
+    i2sStop();
+    stopSignal = false;
+    return false;
   }
 
-  void oneFrame()
+  //false if the sensor stopped delivering VSYNC or a full frame in time
+  bool oneFrame()
   {
-    start();
-    stop();
+    if(!start())
+      return false;
+    return stop();
   }
   
   static void i2sStop();
-  static void i2sRun();
+  static bool i2sRun();
+  static bool waitVSync(int ms);
+
+  //statistics of the last completed frame (or band), no extra pass needed
+  static const FrameStats& lastStats()
+  {
+    return *statsDone;
+  }
+
+  static void resetHealth()
+  {
+    shortFrames = 0;
+    isrMaxCycles = 0;
+    linePeriodCycles = 0;
+  }
+
+  //worst line ISR in percent of a line period, 0 before the first full frame;
+  //at 100 the ISR misses lines
+  static int isrLoadPercent()
+  {
+    return linePeriodCycles ? (int)(isrMaxCycles * 100ULL / linePeriodCycles) : 0;
+  }
+
+  static int bytesPerPixel()
+  {
+    return pixelFormat == PIXEL_Y8 ? 1 : 2;
+  }
+
+  static bool setGeometry(int XRES, int YRES, PixelFormat FORMAT);
+  static bool setBand(int first, int lines);
+  static int maxBandLines()
+  {
+    return frameCapacity / (xres * bytesPerPixel());
+  }
 
-  static void dmaBufferInit(int bytes);
+  //One frame in bands of lines that alternate between the two halves of the
+  //frame buffer: the ISR fills band k+1 while the caller works on band k.
+  //The ISR stops keeping lines once it would overwrite a band the caller
+  //still holds, the frame is lost then (an overrun).
+  static bool startBandRing(int lines);
+  //pixels of band k once the ISR completed it, nullptr on a timeout or overrun
+  static const unsigned char* waitBand(int band);
+  //the caller is done with its oldest band, the ISR may refill that half
+  static void releaseBand()
+  {
+    bandsReleased++;
+  }
+  //waits for the end of the frame and leaves the ring; false after an overrun
+  static bool finishBandRing();
+  static int maxRingLines()
+  {
+    return frameCapacity / 2 / (xres * bytesPerPixel());
+  }
+
+  static bool dmaBufferInit(int bytes);
   static void dmaBufferDeinit();
 
   static bool initVSync(int pin);
   static void deinitVSync();
   
+  //the line ISR that follows setGeometry()
   static void IRAM_ATTR i2sInterrupt(void* arg);
+  //a line ISR built for one format and geometry, setGeometry() must not change them
+  template<int FORMAT, int XRES, int YRES> static void IRAM_ATTR fixedInterrupt(void* arg)
+  {
+    lineInterrupt<FORMAT, XRES, YRES>();
+  }
   static void IRAM_ATTR vSyncInterrupt(void* arg);
   
-  static bool i2sInit(const int VSYNC, const int HREF, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7);
+  static bool i2sInit(const int VSYNC, const int HREF, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7, LineInterrupt handler = &i2sInterrupt);
+
+  //DMA_LINE_BYTES is the largest line setGeometry() may switch to, 4 bytes per pixel
+  static bool init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7, const int FRAME_CAPACITY = 0, const PixelFormat FORMAT = PIXEL_RGB565, LineInterrupt handler = &i2sInterrupt, const int DMA_LINE_BYTES = MAX_XRES * 2 * 2);
 
-  static bool init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7);
+  protected:
+  static inline __attribute__((always_inline)) uint32_t cycleCount()
+  {
+    uint32_t cycles;
+#ifdef __XTENSA__
+    asm volatile("rsr %0, ccount" : "=a"(cycles));
+#else
+    //host build, see host/stubs
+    cycles = xthal_get_ccount();
+#endif
+    return cycles;
+  }
+
+  //one luma sample: histogram, clipping, gradient and thumbnail accumulator
+  static inline __attribute__((always_inline)) void sampleLuma(FrameStats* s, uint16_t* thumb, int x, int y, int& prev)
+  {
+    s->lumaSum += y;
+    s->histogram[y >> 3]++;
+    if(y < 5 || y > 250)
+      s->clipped++;
+    int d = y - prev;
+    s->gradientEnergy += (d * d) >> 4;
+    prev = y;
+    thumb[x >> 3] += y;
+  }
+
+  //the body of the line ISRs, inlined into them. ANY_FORMAT and XRES, YRES 0
+  //read pixelFormat, xres and yres per line; constants drop the other copy
+  //loops and give the compiler the trip count
+  template<int FORMAT, int XRES, int YRES> static inline __attribute__((always_inline)) void lineInterrupt();
 };
+
+template<int FORMAT, int XRES, int YRES> inline void I2SCamera::lineInterrupt()
+{
+    const int w = XRES ? XRES : xres;
+    const int h = YRES ? YRES : yres;
+    uint32_t entry = cycleCount();
+    I2S0.int_clr.val = I2S0.int_raw.val;
+    int line = blocksReceived++;
+    if(line == 0)
+      lineStartCycles = entry;
+    unsigned char* buf = dmaBuffer[dmaBufferActive]->buffer;
+    dmaBufferActive = (dmaBufferActive + 1) % dmaBufferCount;
+    FrameStats* stats = statsWork;
+    if(line == 0)
+    {
+      //spelled out, FrameStats::reset() may not be in IRAM
+      stats->samples = 0;
+      stats->lumaSum = 0;
+      stats->clipped = 0;
+      stats->gradientEnergy = 0;
+      memset(stats->histogram, 0, sizeof(stats->histogram));
+      memset(thumbAccumulator, 0, sizeof(thumbAccumulator));
+    }
+    const int format = FORMAT == ANY_FORMAT ? (int)pixelFormat : FORMAT;
+    //only the lines of the current band are kept; in a band ring every line
+    //goes to the half of its band, unless the caller still holds that band
+    bool keep = line >= bandFirst && framePointer < frameBytes;
+    if(ringLines)
+    {
+      int band = line / ringLines;
+      if(band >= bandsReleased + 2)
+        bandOverrun = true;
+      keep = !bandOverrun;
+      framePointer = ((band & 1) * ringLines + line - band * ringLines) * w * (format == PIXEL_Y8 ? 1 : 2);
+    }
+    if(keep)
+    {
+      //the statistics take the luma of every second pixel on the fly
+      int prev = 0;
+      if(format == PIXEL_Y8)
+        for(int i = 0, x = 0; i < w * 4; i += 8, x += 2)
+        {
+          int y = buf[i];
+          frame[framePointer++] = y;
+          frame[framePointer++] = buf[i + 4];
+          sampleLuma(stats, thumbAccumulator, x, y, prev);
+        }
+      else if(format == PIXEL_YUV422)
+        for(int i = 0, x = 0; i < w * 4; i += 8, x += 2)
+        {
+          int y = buf[i];
+          frame[framePointer++] = buf[i + 2];
+          frame[framePointer++] = y;
+          frame[framePointer++] = buf[i + 6];
+          frame[framePointer++] = buf[i + 4];
+          sampleLuma(stats, thumbAccumulator, x, y, prev);
+        }
+      else
+        for(int i = 0, x = 0; i < w * 4; i += 8, x += 2)
+        {
+          int p = (buf[i] << 8) | buf[i + 2];
+          frame[framePointer++] = buf[i + 2];
+          frame[framePointer++] = buf[i];
+          frame[framePointer++] = buf[i + 6];
+          frame[framePointer++] = buf[i + 4];
+          int y = (((p >> 11) << 3) * 77 + (((p >> 5) & 0x3f) << 2) * 150 + ((p & 0x1f) << 3) * 29) >> 8;
+          sampleLuma(stats, thumbAccumulator, x, y, prev);
+        }
+      stats->samples += w / 2;
+      //8 lines of 4 samples per thumbnail pixel
+      if((line & 7) == 7)
+      {
+        uint8_t* row = stats->thumbnail + (line >> 3) * (w >> 3);
+        for(int tx = 0; tx < (w >> 3); tx++)
+        {
+          row[tx] = thumbAccumulator[tx] >> 5;
+          thumbAccumulator[tx] = 0;
+        }
+      }
+    }
+    if(ringLines && (blocksReceived == h || blocksReceived % ringLines == 0))
+    {
+      bandsFilled++;
+      BaseType_t woken = pdFALSE;
+      xSemaphoreGiveFromISR(bandSemaphore, &woken);
+      if(woken)
+        portYIELD_FROM_ISR();
+    }
+    uint32_t busy = cycleCount() - entry;
+    if(busy > isrMaxCycles)
+      isrMaxCycles = busy;
+    if (blocksReceived == h)
+    {
+      if(h > 1)
+      {
+        uint32_t period = (entry - lineStartCycles) / (h - 1);
+        if(!linePeriodCycles || period < linePeriodCycles)
+          linePeriodCycles = period;
+      }
+      stats->frame = framesReceived;
+      stats->thumbWidth = w >> 3;
+      stats->thumbHeight = h >> 3;
+      statsWork = statsDone;
+      statsDone = stats;
+      framePointer = 0;
+      blocksReceived = 0;
+      framesReceived++;
+      if(stopSignal)
+      {
+        i2sStop();
+        stopSignal = false;
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(frameSemaphore, &woken);
+        if(woken)
+          portYIELD_FROM_ISR();
+      }
+    }
+}
@@ -0,0 +1,108 @@
+#include "LiveView.h"
+#include "BufferPool.h"
+
+static JpegEncoder encoder;
+//one mosaic row of tiles, U Y V Y
+static uint8_t stripe[LiveView::MOSAIC_TILES * LiveView::TILE * LiveView::TILE * 2];
+
+//display row y, the frame is stored bottom up; the rows below the picture
+//repeat its last one
+const uint8_t* LiveView::row(const uint8_t* frame, int width, int height, int y)
+{
+  if(y >= height)
+    y = height - 1;
+  return frame + (height - 1 - y) * width * 2;
+}
+
+void LiveView::blockMeans(const uint8_t* frame, int width, int height, int tx, int ty, uint8_t* means) const
+{
+  for(int by = 0; by < 4; by++)
+  {
+    int sums[4] = { 0, 0, 0, 0 };
+    for(int y = 0; y < 4; y++)
+    {
+      const uint8_t* p = row(frame, width, height, ty * TILE + by * 4 + y) + tx * TILE * 2;
+      for(int bx = 0; bx < 4; bx++, p += 8)
+        sums[bx] += p[1] + p[3] + p[5] + p[7];
+    }
+    for(int bx = 0; bx < 4; bx++)
+      means[by * 4 + bx] = sums[bx] >> 4;
+  }
+}
+
+bool LiveView::update(const uint8_t* frame, int width, int height, Print& out)
+{
+  int tilesX = width / TILE;
+  int tilesY = (height + TILE - 1) / TILE;
+  if(tilesX > MAX_TILES_X || tilesY > MAX_TILES_Y)
+    return false;
+  bool keyframe = keyframePending || millis() - lastKeyframe >= KEYFRAME_INTERVAL;
+
+  int count = 0;
+  for(int ty = 0; ty < tilesY; ty++)
+    for(int tx = 0; tx < tilesX; tx++)
+    {
+      uint8_t means[16];
+      uint8_t* ref = reference[ty * tilesX + tx];
+      blockMeans(frame, width, height, tx, ty, means);
+      bool differs = keyframe;
+      for(int i = 0; i < 16 && !differs; i++)
+        differs = abs(means[i] - ref[i]) > CHANGE_THRESHOLD;
+      if(!differs)
+        continue;
+      //the reference only moves when the tile is sent, slow drift adds up until it is
+      memcpy(ref, means, 16);
+      changed[count][0] = tx;
+      changed[count][1] = ty;
+      count++;
+    }
+  if(!count)
+    return true;
+
+  int mosaicTiles = count < MOSAIC_TILES ? count : MOSAIC_TILES;
+  int mosaicRows = (count + MOSAIC_TILES - 1) / MOSAIC_TILES;
+  int mosaicWidth = mosaicTiles * TILE;
+  JpegEncoder::Buffer jpeg = { nullptr, 0, 0 };
+  jpeg.data = (uint8_t*)bufferPool.take(1, BufferPool::LARGE, &jpeg.capacity);
+  if(!jpeg.data)
+    return false;
+  bool ok = encoder.begin(mosaicWidth, mosaicRows * TILE, QUALITY, JpegEncoder::fixedWriter, &jpeg, JpegEncoder::YUV422);
+  for(int r = 0; r < mosaicRows && ok; r++)
+  {
+    memset(stripe, 0x80, mosaicWidth * TILE * 2);
+    for(int i = r * MOSAIC_TILES; i < count && i < (r + 1) * MOSAIC_TILES; i++)
+      for(int y = 0; y < TILE; y++)
+        memcpy(stripe + (y * mosaicWidth + (i - r * MOSAIC_TILES) * TILE) * 2,
+               row(frame, width, height, changed[i][1] * TILE + y) + changed[i][0] * TILE * 2, TILE * 2);
+    ok = encoder.addStripe(stripe, TILE);
+  }
+  ok = ok && encoder.finish();
+
+  if(ok)
+  {
+    uint8_t head[10] = { 'L', 'V', (uint8_t)(keyframe ? 1 : 0), (uint8_t)mosaicTiles,
+                         (uint8_t)width, (uint8_t)(width >> 8), (uint8_t)height, (uint8_t)(height >> 8),
+                         (uint8_t)count, (uint8_t)(count >> 8) };
+    uint8_t length[4] = { (uint8_t)jpeg.size, (uint8_t)(jpeg.size >> 8), (uint8_t)(jpeg.size >> 16), (uint8_t)(jpeg.size >> 24) };
+    size_t bytes = sizeof(head) + count * 2 + sizeof(length) + jpeg.size;
+    ok = out.write(head, sizeof(head)) + out.write(&changed[0][0], count * 2) + out.write(length, sizeof(length))
+       + out.write(jpeg.data, jpeg.size) == bytes;
+    bytesSent += bytes;
+  }
+  bufferPool.give(jpeg.data);
+  if(!ok)
+  {
+    //the viewer may have missed tiles, resend all of them
+    keyframePending = true;
+    return false;
+  }
+  if(keyframe)
+  {
+    keyframePending = false;
+    lastKeyframe = millis();
+    keyframes++;
+  }
+  updates++;
+  tilesSent += count;
+  return true;
+}
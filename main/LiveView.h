@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+#include "jpeg_encoder.h"
+
+//Tile delta live view. Each update compares the frame with what the viewer
+//already has in 16x16 tiles, using 4x4 block means of the luma so sensor
+//noise does not count as change, and sends only the tiles that changed.
+//They are packed side by side into one mosaic JPEG: a tile is exactly one
+//4:2:0 MCU, so every tile is compressed on its own while the JPEG headers
+//are paid once per update. A keyframe sends every tile.
+//
+//Message, little endian: 'L' 'V', flags (1 = keyframe), mosaic tiles per
+//row, width, height, tile count (u16 each), then per tile its column and row
+//(u8 each), the JPEG length (u32) and the mosaic JPEG. No message is sent
+//when nothing changed.
+class LiveView
+{
+  public:
+  static const int TILE = 16;
+  static const int MAX_TILES_X = 20;  //up to 320x240
+  static const int MAX_TILES_Y = 15;
+  static const int MOSAIC_TILES = 10;
+  //4x4 block mean luma steps that make a tile changed
+  static const int CHANGE_THRESHOLD = 6;
+  static const int QUALITY = 60;
+  static const unsigned long INTERVAL = 250;
+  static const unsigned long KEYFRAME_INTERVAL = 10000;
+
+  //frame is U Y V Y as the camera stores it, bottom up like every capture here;
+  //width and height a multiple of 16 and 8. False if the message could not
+  //be built or written.
+  bool update(const uint8_t* frame, int width, int height, Print& out);
+  //the next update is a keyframe, for a new viewer
+  void reset()
+  {
+    lastKeyframe = 0;
+    keyframePending = true;
+  }
+
+  unsigned long updates = 0;
+  unsigned long keyframes = 0;
+  unsigned long tilesSent = 0;
+  unsigned long bytesSent = 0;
+
+  private:
+  //4x4 block means of every tile as the viewer has it
+  uint8_t reference[MAX_TILES_X * MAX_TILES_Y][16];
+  uint8_t changed[MAX_TILES_X * MAX_TILES_Y][2];
+  bool keyframePending = true;
+  unsigned long lastKeyframe = 0;
+
+  void blockMeans(const uint8_t* frame, int width, int height, int tx, int ty, uint8_t* means) const;
+  static const uint8_t* row(const uint8_t* frame, int width, int height, int y);
+};
@@ -0,0 +1,207 @@
+#include "Log.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+Logger logger;
+
+static const char LEVELS[] = "-EWID";
+
+void Logger::begin(Print& out)
+{
+  this->out = &out;
+  historyLock = xSemaphoreCreateMutex();
+  //core 0, next to Wi-Fi; the loop task runs on core 1
+  xTaskCreatePinnedToCore(task, "log", 4096, this, 1, nullptr, 0);
+}
+
+void Logger::task(void* arg)
+{
+  Logger* self = (Logger*)arg;
+  for(;;)
+    if(!self->drain())
+      vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+void Logger::commit(const uint8_t* record, size_t length, uint8_t level)
+{
+  length = (length + 3) & ~3;
+  uint32_t at = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  do
+  {
+    //at may be older than tail, then the CAS fails and it is read again
+    if((int32_t)(at + length - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) > (int32_t)RING_BYTES)
+    {
+      __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } while(!__atomic_compare_exchange_n(&head, &at, at + length, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+  //everything but the first word, which marks the record complete
+  uint8_t* bytes = (uint8_t*)ring;
+  size_t from = (at + 4) % RING_BYTES;
+  size_t first = length - 4 < RING_BYTES - from ? length - 4 : RING_BYTES - from;
+  memcpy(bytes + from, record + 4, first);
+  memcpy(bytes, record + 4 + first, length - 4 - first);
+  __atomic_store_n(&ring[at % RING_BYTES / 4], length | COMMITTED | (uint32_t)level << 24, __ATOMIC_RELEASE);
+}
+
+bool Logger::drain()
+{
+  bool any = false;
+  static unsigned long reportedDrops = 0;
+  while(tail != __atomic_load_n(&head, __ATOMIC_ACQUIRE))
+  {
+    uint32_t word = __atomic_load_n(&ring[tail % RING_BYTES / 4], __ATOMIC_ACQUIRE);
+    //claimed but still being written
+    if(!(word & COMMITTED))
+      break;
+    size_t length = word & 0xffff;
+    alignas(Header) uint8_t record[MAX_RECORD];
+    uint8_t* bytes = (uint8_t*)ring;
+    size_t from = tail % RING_BYTES;
+    size_t first = length < RING_BYTES - from ? length : RING_BYTES - from;
+    memcpy(record, bytes + from, first);
+    memcpy(record + first, bytes, length - first);
+    //cleared, a record written here later is incomplete until its first word is stored
+    memset(bytes + from, 0, first);
+    memset(bytes, 0, length - first);
+    __atomic_store_n(&tail, tail + length, __ATOMIC_RELEASE);
+    records++;
+
+    char line[MAX_LINE];
+    size_t n = format(record, length, line);
+    if(out)
+      out->write((const uint8_t*)line, n);
+    keep(line, n);
+    any = true;
+  }
+  if(dropped != reportedDrops)
+  {
+    char line[64];
+    size_t n = snprintf(line, sizeof(line), "log: %lu records dropped\n", dropped - reportedDrops);
+    reportedDrops = dropped;
+    if(out)
+      out->write((const uint8_t*)line, n);
+    keep(line, n);
+  }
+  return any;
+}
+
+size_t Logger::format(const uint8_t* record, size_t length, char* line)
+{
+  const Header& header = *(const Header*)record;
+  const uint8_t* arg = record + sizeof(Header);
+  const uint8_t* end = record + length;
+  int level = header.word >> 24;
+  int n = snprintf(line, MAX_LINE, "%lu.%03lu %c %s: ", (unsigned long)(header.micros / 1000), (unsigned long)(header.micros % 1000),
+                   LEVELS[level < 5 ? level : 0], header.tag);
+  size_t used = n > 0 ? n : 0;
+  const char* f = header.format;
+  //one line left for the '\n'
+  while(*f && used < MAX_LINE - 2)
+  {
+    if(*f != '%' || f[1] == '%')
+    {
+      line[used++] = *f;
+      f += *f == '%' ? 2 : 1;
+      continue;
+    }
+    char spec[16] = "%";
+    size_t s = 1;
+    for(f++; *f && strchr("-+ #0123456789.", *f) && s < 10; f++)
+      spec[s++] = *f;
+    while(*f && strchr("hlLzjt", *f))
+      f++;
+    char conversion = *f;
+    if(!conversion)
+      break;
+    f++;
+    size_t room = MAX_LINE - 1 - used;
+    int written = 0;
+    Type type = arg < end ? (Type)*arg++ : (Type)0;
+    bool isInteger = strchr("diouxXc", conversion);
+    if(type == INT32 && isInteger)
+    {
+      int32_t v;
+      memcpy(&v, arg, sizeof(v));
+      arg += sizeof(v);
+      spec[s++] = conversion;
+      written = snprintf(line + used, room, spec, v);
+    }
+    else if(type == INT64 && isInteger)
+    {
+      int64_t v;
+      memcpy(&v, arg, sizeof(v));
+      arg += sizeof(v);
+      spec[s++] = 'l';
+      spec[s++] = 'l';
+      spec[s++] = conversion;
+      written = snprintf(line + used, room, spec, (long long)v);
+    }
+    else if(type == DOUBLE && strchr("fFeEgGaA", conversion))
+    {
+      double v;
+      memcpy(&v, arg, sizeof(v));
+      arg += sizeof(v);
+      spec[s++] = conversion;
+      written = snprintf(line + used, room, spec, v);
+    }
+    else if(type == STRING && conversion == 's')
+    {
+      size_t size = *arg++;
+      spec[s++] = 's';
+      written = snprintf(line + used, room, spec, (const char*)arg);
+      arg += size + 1;
+    }
+    else if(type == POINTER && conversion == 'p')
+    {
+      const void* v;
+      memcpy(&v, arg, sizeof(v));
+      arg += sizeof(v);
+      written = snprintf(line + used, room, "%p", v);
+    }
+    else
+    {
+      //the arguments do not match the format, the rest is not trusted
+      written = snprintf(line + used, room, "<?>");
+      arg = end;
+    }
+    if(written > 0)
+      used += (size_t)written < room ? written : room - 1;
+  }
+  //the format's own '\n' is dropped, every record is one line
+  while(used && line[used - 1] == '\n')
+    used--;
+  line[used++] = '\n';
+  line[used] = 0;
+  return used;
+}
+
+void Logger::keep(const char* line, size_t length)
+{
+  if(historyLock)
+    xSemaphoreTake((SemaphoreHandle_t)historyLock, portMAX_DELAY);
+  for(size_t i = 0; i < length; i++)
+    history[historyEnd++ % HISTORY_BYTES] = line[i];
+  if(historyLock)
+    xSemaphoreGive((SemaphoreHandle_t)historyLock);
+}
+
+void Logger::printHistory(Print& out)
+{
+  static char copy[HISTORY_BYTES];
+  if(historyLock)
+    xSemaphoreTake((SemaphoreHandle_t)historyLock, portMAX_DELAY);
+  uint32_t end = historyEnd;
+  size_t length = end < HISTORY_BYTES ? end : HISTORY_BYTES;
+  for(size_t i = 0; i < length; i++)
+    copy[i] = history[(end - length + i) % HISTORY_BYTES];
+  if(historyLock)
+    xSemaphoreGive((SemaphoreHandle_t)historyLock);
+  //a ring that went round starts with a cut line
+  size_t start = 0;
+  if(end > HISTORY_BYTES)
+    while(start < length && copy[start++] != '\n')
+      ;
+  out.write((const uint8_t*)copy + start, length - start);
+}
@@ -1,14 +1,209 @@
 #pragma once
 #include "Arduino.h"
+#include <type_traits>
 
-/*
-#define DEBUG_PRINTLN(a) Serial.println(a)
-#define DEBUG_PRINT(a) Serial.print(a)
-#define DEBUG_PRINTLNF(a, f) Serial.println(a, f)
-#define DEBUG_PRINTF(a, f) Serial.print(a, f)
-*/
-#define DEBUG_PRINTLN(a)
-#define DEBUG_PRINT(a)
-#define DEBUG_PRINTLNF(a, f)
-#define DEBUG_PRINTF(a, f)
+//Logging into a ring of binary records that a low priority task drains.
+//A LOGx call does not format and does not lock: it claims the record's room
+//with a compare and swap and stores micros(), the tag, the format pointer and
+//the arguments as they are, strings copied (MAX_STRING bytes at most). So any
+//task on either core, an ISR included, can log without waiting on the UART.
+//The drain task formats the records to the output given to begin() and keeps
+//the last HISTORY_BYTES of text for GET /log. A full ring drops the record and
+//counts it, the caller never waits.
+//Tag and format must outlive the record, string literals that is. Width and
+//precision come from the format, '*' is not supported; the integer length
+//modifiers are ignored, the argument's own type is used.
+//
+//Levels are removed at compile time: LOGLEVEL is the build wide maximum, a
+//file lowers its own by defining LOG_MODULE_LEVEL before its first include.
+//A call above the level is not in the binary, its format string included.
 
+#define LOGLEVEL_NONE 0
+#define LOGLEVEL_ERROR 1
+#define LOGLEVEL_WARN 2
+#define LOGLEVEL_INFO 3
+#define LOGLEVEL_DEBUG 4
+
+#ifndef LOGLEVEL
+#define LOGLEVEL LOGLEVEL_INFO
+#endif
+#ifndef LOG_MODULE_LEVEL
+#define LOG_MODULE_LEVEL LOGLEVEL
+#endif
+
+#define LOG_AT(level, tag, ...) \
+  do { \
+    if((level) <= LOG_MODULE_LEVEL && (level) <= LOGLEVEL) \
+      logger.write(level, tag, __VA_ARGS__); \
+  } while(0)
+#define LOGE(tag, ...) LOG_AT(LOGLEVEL_ERROR, tag, __VA_ARGS__)
+#define LOGW(tag, ...) LOG_AT(LOGLEVEL_WARN, tag, __VA_ARGS__)
+#define LOGI(tag, ...) LOG_AT(LOGLEVEL_INFO, tag, __VA_ARGS__)
+#define LOGD(tag, ...) LOG_AT(LOGLEVEL_DEBUG, tag, __VA_ARGS__)
+
+class Logger
+{
+  public:
+  //powers of two
+  static const size_t RING_BYTES = 8192;
+  static const size_t HISTORY_BYTES = 4096;
+  static const size_t MAX_RECORD = 256;
+  static const size_t MAX_STRING = 120;
+  static const size_t MAX_LINE = 256;
+
+  //starts the drain task on core 0; what was logged before is kept
+  void begin(Print& out);
+
+  template<typename... A> void write(uint8_t level, const char* tag, const char* format, A... args)
+  {
+    alignas(Header) uint8_t record[MAX_RECORD];
+    size_t length = sizeof(Header);
+    pack(record, length, args...);
+    Header& header = *(Header*)record;
+    header.micros = micros();
+    header.tag = tag;
+    header.format = format;
+    commit(record, length, level);
+  }
+
+  //formats what is waiting, false if there was nothing
+  bool drain();
+  //the newest history lines, oldest first
+  void printHistory(Print& out);
+
+  unsigned long records = 0;
+  unsigned long dropped = 0;
+
+  private:
+  struct Header
+  {
+    //bytes (multiple of 4) | COMMITTED | level << 24, stored last
+    uint32_t word;
+    uint32_t micros;
+    const char* tag;
+    const char* format;
+  };
+  static const uint32_t COMMITTED = 0x10000;
+
+  //argument types in a record, each followed by its value
+  enum Type : uint8_t
+  {
+    INT32 = 'i',
+    INT64 = 'I',
+    DOUBLE = 'd',
+    STRING = 's',  //length byte, the bytes, a zero
+    POINTER = 'p',
+  };
+
+  uint32_t ring[RING_BYTES / 4];
+  volatile uint32_t head = 0;
+  volatile uint32_t tail = 0;
+  Print* out = nullptr;
+  char history[HISTORY_BYTES];
+  uint32_t historyEnd = 0;
+  void* historyLock = nullptr;
+
+  void commit(const uint8_t* record, size_t length, uint8_t level);
+  size_t format(const uint8_t* record, size_t length, char* line);
+  void keep(const char* line, size_t length);
+  static void task(void* arg);
+
+  static void put(uint8_t* record, size_t& length, Type type, const void* value, size_t size)
+  {
+    if(length + 1 + size > MAX_RECORD)
+      return;
+    record[length] = type;
+    memcpy(record + length + 1, value, size);
+    length += 1 + size;
+  }
+
+  template<typename T> static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type add(uint8_t* record, size_t& length, T value)
+  {
+    if(sizeof(T) <= 4)
+    {
+      int32_t v = (int32_t)value;
+      put(record, length, INT32, &v, sizeof(v));
+    }
+    else
+    {
+      int64_t v = (int64_t)value;
+      put(record, length, INT64, &v, sizeof(v));
+    }
+  }
+
+  static void add(uint8_t* record, size_t& length, double value)
+  {
+    put(record, length, DOUBLE, &value, sizeof(value));
+  }
+
+  static void add(uint8_t* record, size_t& length, const char* text)
+  {
+    if(!text)
+      text = "(null)";
+    size_t size = strnlen(text, MAX_STRING);
+    if(length + 3 + size > MAX_RECORD)
+      size = length + 3 < MAX_RECORD ? MAX_RECORD - length - 3 : 0;
+    if(length + 3 + size > MAX_RECORD)
+      return;
+    record[length++] = STRING;
+    record[length++] = size;
+    memcpy(record + length, text, size);
+    length += size;
+    record[length++] = 0;
+  }
+
+  static void add(uint8_t* record, size_t& length, const void* pointer)
+  {
+    put(record, length, POINTER, &pointer, sizeof(pointer));
+  }
+
+  static void pack(uint8_t*, size_t&)
+  {
+  }
+
+  template<typename T, typename... A> static void pack(uint8_t* record, size_t& length, T value, A... rest)
+  {
+    add(record, length, value);
+    pack(record, length, rest...);
+  }
+};
+
+extern Logger logger;
+
+//Print that logs every line it is given, for the printStats(Print&) style reports
+class LogPrint : public Print
+{
+  public:
+  LogPrint(uint8_t level, const char* tag)
+    :level(level), tag(tag)
+  {
+  }
+
+  ~LogPrint()
+  {
+    if(length)
+      write('\n');
+  }
+
+  size_t write(uint8_t c) override
+  {
+    if(c == '\r')
+      return 1;
+    if(c != '\n')
+    {
+      line[length++] = c;
+      if(length < sizeof(line) - 1)
+        return 1;
+    }
+    line[length] = 0;
+    logger.write(level, tag, "%s", line);
+    length = 0;
+    return 1;
+  }
+
+  private:
+  uint8_t level;
+  const char* tag;
+  char line[Logger::MAX_STRING + 1];
+  size_t length = 0;
+};
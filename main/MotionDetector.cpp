@@ -0,0 +1,129 @@
+#include "MotionDetector.h"
+#include <string.h>
+
+MotionDetector::MotionDetector()
+{
+  reset();
+}
+
+void MotionDetector::reset()
+{
+  width = 0;
+  height = 0;
+  frames = 0;
+}
+
+bool MotionDetector::sameGeometry(const FrameStats& stats) const
+{
+  return stats.thumbWidth == width && stats.thumbHeight == height;
+}
+
+MotionResult MotionDetector::score(const FrameStats& stats, uint8_t* changed) const
+{
+  MotionResult r;
+  r.valid = ready() && sameGeometry(stats);
+  r.score = 0;
+  r.changedTiles = 0;
+  r.tiles = width * height;
+  r.x0 = r.y0 = r.x1 = r.y1 = 0;
+  if(!r.valid || !r.tiles)
+    return r;
+
+  const uint8_t* t = stats.thumbnail;
+  //global offset (median difference), so an exposure step does not light up
+  //every tile while a large object does not shift it
+  uint16_t histogram[511];
+  memset(histogram, 0, sizeof(histogram));
+  for(int i = 0; i < r.tiles; i++)
+    histogram[t[i] - (background[i] >> 4) + 255]++;
+  int offset = 0;
+  for(int v = 0, count = 0; v < 511; v++)
+  {
+    count += histogram[v];
+    if(count * 2 >= r.tiles)
+    {
+      offset = (v - 255) << 4;
+      break;
+    }
+  }
+
+  int minX = width, minY = height, maxX = -1, maxY = -1;
+  for(int y = 0, i = 0; y < height; y++)
+    for(int x = 0; x < width; x++, i++)
+    {
+      int d = ((int32_t)t[i] << 4) - background[i] - offset;
+      if(d < 0)
+        d = -d;
+      int threshold = deviation[i] * NOISE_FACTOR;
+      if(threshold < (MIN_THRESHOLD << 4))
+        threshold = MIN_THRESHOLD << 4;
+      bool c = d > threshold;
+      if(changed)
+        changed[i] = c;
+      if(!c)
+        continue;
+      r.changedTiles++;
+      if(x < minX) minX = x;
+      if(x > maxX) maxX = x;
+      if(y < minY) minY = y;
+      if(y > maxY) maxY = y;
+    }
+
+  r.score = r.changedTiles * 1000 / r.tiles;
+  if(r.changedTiles)
+  {
+    r.x0 = minX * FrameStats::THUMB_SCALE;
+    r.y0 = minY * FrameStats::THUMB_SCALE;
+    r.x1 = (maxX + 1) * FrameStats::THUMB_SCALE;
+    r.y1 = (maxY + 1) * FrameStats::THUMB_SCALE;
+  }
+  return r;
+}
+
+MotionResult MotionDetector::evaluate(const FrameStats& stats) const
+{
+  return score(stats, 0);
+}
+
+MotionResult MotionDetector::update(const FrameStats& stats)
+{
+  int tiles = stats.thumbWidth * stats.thumbHeight;
+  if(tiles <= 0 || tiles > MAX_TILES)
+  {
+    MotionResult r = {false, 0, 0, 0, 0, 0, 0, 0};
+    return r;
+  }
+  if(!sameGeometry(stats))
+  {
+    //new mode, learn from scratch
+    width = stats.thumbWidth;
+    height = stats.thumbHeight;
+    frames = 0;
+    for(int i = 0; i < tiles; i++)
+    {
+      background[i] = stats.thumbnail[i] << 4;
+      deviation[i] = MIN_THRESHOLD << 4;
+    }
+  }
+
+  uint8_t changed[MAX_TILES];
+  MotionResult r = score(stats, changed);
+
+  //fast learning for background tiles, slow for changed ones so that
+  //something that stays in the scene is eventually absorbed
+  for(int i = 0; i < tiles; i++)
+  {
+    int v = stats.thumbnail[i] << 4;
+    int d = v - background[i];
+    int shift = (r.valid && changed[i]) ? 6 : (ready() ? 4 : 1);
+    background[i] += d >> shift;
+    if(!r.valid || !changed[i])
+    {
+      int a = d < 0 ? -d : d;
+      deviation[i] += (a - (int)deviation[i]) >> 4;
+    }
+  }
+  if(frames < WARMUP_FRAMES)
+    frames++;
+  return r;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include "FrameStats.h"
+
+struct MotionResult
+{
+  bool valid;          //false while the background is still being learned
+  int score;           //changed tiles in permille of all tiles
+  int changedTiles;
+  int tiles;
+  //bounding box of the changed tiles in frame pixels (sensor orientation,
+  //not flipped like the photos), empty if nothing changed
+  int x0, y0, x1, y1;
+};
+
+//Change detector over the 8x8 tile means of the ISR thumbnail (FrameStats).
+//Keeps a running average background per tile plus its mean deviation, a tile
+//counts as changed when it leaves the background by more than its own noise.
+//Global brightness shifts (AEC/AGC steps) are subtracted first.
+class MotionDetector
+{
+  public:
+  static const int MAX_TILES = 40 * 30;  //QVGA thumbnail
+  static const int WARMUP_FRAMES = 8;
+  static const int MIN_THRESHOLD = 6;    //luma steps
+  static const int NOISE_FACTOR = 3;
+
+  MotionDetector();
+  void reset();
+
+  //scores the frame and learns it into the background
+  MotionResult update(const FrameStats& stats);
+  //scores the frame without touching the model, e.g. to rank a burst
+  MotionResult evaluate(const FrameStats& stats) const;
+
+  bool ready() const
+  {
+    return frames >= WARMUP_FRAMES;
+  }
+
+  private:
+  int width, height;
+  int frames;
+  uint16_t background[MAX_TILES];  //luma << 4
+  uint16_t deviation[MAX_TILES];   //mean absolute deviation << 4
+
+  bool sameGeometry(const FrameStats& stats) const;
+  MotionResult score(const FrameStats& stats, uint8_t* changed) const;
+};
@@ -2,142 +2,319 @@
 #include "XClk.h"
 #include "Log.h"
 
-OV7670::OV7670(Mode m, const int SIOD, const int SIOC, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7)
+OV7670::OV7670(Mode m, const int SIOD, const int SIOC, const int VSYNC, const int XCLK)
   :i2c(SIOD, SIOC)
 {
-  ClockEnable(XCLK, 20000000); //base is 80MHz
+  xclkPin = XCLK;
+  isParked = false;
+  fixedMode = false;
+  for(int i = 0; i < MODE_COUNT; i++)
+    clocks[i] = defaultClock((Mode)i);
+  xclkHz = clocks[m].xclkHz;
+  ClockEnable(XCLK, xclkHz); //base is 80MHz
   
-  DEBUG_PRINT("Waiting for VSYNC...");  
   pinMode(VSYNC, INPUT);
-  while(!digitalRead(VSYNC));
-  while(digitalRead(VSYNC));
-  DEBUG_PRINTLN(" done");
+  initVSync(VSYNC);
+  if(waitVSync(timeoutMs))
+    LOGD("camera", "First VSYNC seen");
+  else
+    LOGW("camera", "No VSYNC from the sensor");
+  deinitVSync();
 
   mode = m;
-  switch(mode)
+  modeSwitchMicros = 0;
+  initMicros = 0;
+  registerErrors = 0;
+}
+
+OV7670::OV7670(Mode m, const int SIOD, const int SIOC, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7, Mode largestMode, int frameCapacity)
+  :OV7670(m, SIOD, SIOC, VSYNC, XCLK)
+{
+  unsigned long t = micros();
+  verifyTables = true;
+  configure(mode);
+  verifyTables = false;
+  initMicros = micros() - t;
+  //testImage();
+  int capacity = modeBytes(mode);
+  if(modeBytes(largestMode) > capacity)
+    capacity = modeBytes(largestMode);
+  if(frameCapacity > capacity)
+    capacity = frameCapacity;
+  I2SCamera::init(modeXres(mode), modeYres(mode), VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7, capacity, modeFormat(mode));
+}
+
+OV7670::Clock OV7670::defaultClock(Mode m)
+{
+  switch(modeXres(m))
   {
-    case VGA_RGB565:
-    xres = 640;
-    yres = 480;
-    break;
-    case QVGA_RGB565:
-    xres = 320;
-    yres = 240;
-    break;
-    case QQVGA_RGB565:
-    xres = 160;
-    yres = 120;
-    QQVGARGB565();
-    break;
-    case QQQVGA_RGB565:
-    xres = 80;
-    yres = 60;
-    QQQVGARGB565();    
-    break;
-    default:
-    xres = 0;
-    yres = 0;
+    case 640: return {20000000, 0x03};  //divided by 4 so the line ISR keeps up
+    case 320: return {20000000, 0x01};
+    default: return {20000000, 0x80};
   }
-  //testImage();
-  I2SCamera::init(xres, yres, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
 }
 
-void OV7670::testImage()
+void OV7670::setClock(Mode m, const Clock& c)
 {
-  i2c.writeRegister(ADDR, 0x71, 0x35 | 0x80);
+  clocks[m] = c;
+  if(m == mode)
+    applyClock(m);
 }
-  
-void OV7670::saturation(int s)  //-2 to 2
+
+void OV7670::applyClock(Mode m)
 {
-  //color matrix values
-  i2c.writeRegister(ADDR, 0x4f, 0x80 + 0x20 * s);
-  i2c.writeRegister(ADDR, 0x50, 0x80 + 0x20 * s);
-  i2c.writeRegister(ADDR, 0x51, 0x00);
-  i2c.writeRegister(ADDR, 0x52, 0x22 + (0x11 * s) / 2);
-  i2c.writeRegister(ADDR, 0x53, 0x5e + (0x2f * s) / 2);
-  i2c.writeRegister(ADDR, 0x54, 0x80 + 0x20 * s);
-  i2c.writeRegister(ADDR, 0x58, 0x9e);  //matrix signs
+  const Clock& c = clocks[m];
+  //a parked sensor gets its XCLK back in unpark()
+  if(c.xclkHz != xclkHz && !isParked)
+    ClockEnable(xclkPin, c.xclkHz);
+  xclkHz = c.xclkHz;
+  const RegisterValue regs[] = {
+    {REG_CLKRC, c.clkrc},
+  };
+  applyTable(regs);
 }
 
-void OV7670::frameControl(int hStart, int hStop, int vStart, int vStop)
+bool OV7670::setMode(Mode m)
 {
-  i2c.writeRegister(ADDR, REG_HSTART, hStart >> 3);
-  i2c.writeRegister(ADDR, REG_HSTOP,  hStop >> 3);
-  i2c.writeRegister(ADDR, REG_HREF, ((hStop & 0b111) << 3) | (hStart & 0b111));
+  unsigned long t = micros();
+  if(m == mode)
+  {
+    modeSwitchMicros = 0;
+    return true;
+  }
+  if(fixedMode)
+    return false;
+  if(!setGeometry(modeXres(m), modeYres(m), modeFormat(m)))
+    return false;
+  //Y8 is YUV422 on the wire, only the ISR differs
+  bool yuv = modeFormat(mode) != PIXEL_RGB565;
+  if(yuv != (modeFormat(m) != PIXEL_RGB565))
+    outputFormat(m);
+  mode = m;
+  scaling(mode);
+  //the frame in flight during the writes is mixed, the next VSYNC starts a clean one
+  bool synced = waitVSync(timeoutMs);
+  deinitVSync();
+  modeSwitchMicros = micros() - t;
+  return synced;
+}
 
-  i2c.writeRegister(ADDR, REG_VSTART, vStart >> 2);
-  i2c.writeRegister(ADDR, REG_VSTOP, vStop >> 2);
-  i2c.writeRegister(ADDR, REG_VREF, ((vStop & 0b11) << 2) | (vStart & 0b11));
+void OV7670::applyTable(const RegisterValue* table, int count)
+{
+  registerErrors += i2c.writeRegisters(ADDR, table, count);
+  if(verifyTables)
+    registerErrors += i2c.verifyRegisters(ADDR, table, count);
 }
 
-void OV7670::QQQVGA()
+void OV7670::park()
 {
-    i2c.writeRegister(ADDR, REG_COM3, 0x04);  //DCW enable
-    i2c.writeRegister(ADDR, REG_COM14, 0x1b); //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register
-    i2c.writeRegister(ADDR, REG_SCALING_XSC, 0x3a);
-    i2c.writeRegister(ADDR, REG_SCALING_YSC, 0x35);
-    i2c.writeRegister(ADDR, REG_SCALING_DCWCTR, 0x33); //downsample by 8
-    i2c.writeRegister(ADDR, REG_SCALING_PCLK_DIV, 0xf3); //pixel clock divided by 8
-    i2c.writeRegister(ADDR, REG_SCALING_PCLK_DELAY, 0x02);
+  if(isParked)
+    return;
+  //SCCB still needs the clock for this write; the low bits are the output drive
+  unsigned char com2 = 0x01;
+  i2c.readRegister(ADDR, REG_COM2, com2);
+  i2c.writeRegister(ADDR, REG_COM2, com2 | COM2_SSLEEP);
+  ClockDisable();
+  isParked = true;
 }
 
-void OV7670::QQVGA()
+void OV7670::verticalFlip(bool on)
 {
-  //160x120 (1/4)
-  //i2c.writeRegister(ADDR, REG_CLKRC, 0x01);
-  i2c.writeRegister(ADDR, REG_COM3, 0x04);  //DCW enable
-  
-  i2c.writeRegister(ADDR, REG_COM14, 0x1a); //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register
-  i2c.writeRegister(ADDR, REG_SCALING_XSC, 0x3a);
-  i2c.writeRegister(ADDR, REG_SCALING_YSC, 0x35);
-  
-  i2c.writeRegister(ADDR, REG_SCALING_DCWCTR, 0x22); //downsample by 4
-  i2c.writeRegister(ADDR, REG_SCALING_PCLK_DIV, 0xf2); //pixel clock divided by 4
-  i2c.writeRegister(ADDR, REG_SCALING_PCLK_DELAY, 0x02);
+  unsigned char mvfp = 0;
+  i2c.readRegister(ADDR, REG_MVFP, mvfp);
+  writeRegister(REG_MVFP, on ? mvfp | MVFP_VFLIP : mvfp & ~MVFP_VFLIP);
 }
-  
-void OV7670::QQVGARGB565()
+
+void OV7670::unpark()
 {
-  i2c.writeRegister(ADDR, REG_COM7, 0b10000000);  //all registers default
-      
-  i2c.writeRegister(ADDR, REG_CLKRC, 0b10000000); //double clock
-  i2c.writeRegister(ADDR, REG_COM11, 0b1000 | 0b10); //enable auto 50/60Hz detect + exposure timing can be less...
+  if(!isParked)
+    return;
+  ClockEnable(xclkPin, xclkHz);
+  unsigned char com2 = 0x01 | COM2_SSLEEP;
+  i2c.readRegister(ADDR, REG_COM2, com2);
+  i2c.writeRegister(ADDR, REG_COM2, com2 & ~COM2_SSLEEP);
+  isParked = false;
+}
 
-  i2c.writeRegister(ADDR, REG_COM7, 0b100); //RGB
-  i2c.writeRegister(ADDR, REG_COM15, 0b11000000 | 0b010000); //RGB565
+void OV7670::configure(Mode m)
+{
+  reset();
+  outputFormat(m);
+  scaling(m);
+  colorDefaults();
+}
 
-  QQVGA();
+void OV7670::reset()
+{
+  i2c.writeRegister(ADDR, REG_COM7, 0b10000000);  //all registers default
+  delay(1);  //the reset takes a moment, writes right after it are lost
 
-  frameControl(196, 52, 8, 488); //no clue why horizontal needs such strange values, vertical works ok
-  
+  static constexpr RegisterValue clock[] = {
+    {REG_CLKRC, 0b10000000}, //double clock
+    {REG_COM11, 0b1000 | 0b10}, //enable auto 50/60Hz detect + exposure timing can be less...
+  };
+  applyTable(clock);
   //i2c.writeRegister(ADDR, REG_COM10, 0x02); //VSYNC negative
   //i2c.writeRegister(ADDR, REG_MVFP, 0x2b);  //mirror flip
+}
 
-  i2c.writeRegister(ADDR, 0xb0, 0x84);// no clue what this is but it's most important for colors
+void OV7670::colorDefaults()
+{
+  static constexpr RegisterValue color[] = {
+    {0xb0, 0x84}, // no clue what this is but it's most important for colors
+  };
+  applyTable(color);
   saturation(0);
-  i2c.writeRegister(ADDR, 0x13, 0xe7); //AWB on
-  i2c.writeRegister(ADDR, 0x6f, 0x9f); // Simple AWB
+  static constexpr RegisterValue whiteBalance[] = {
+    {0x13, 0xe7}, //AWB on
+    {0x6f, 0x9f}, // Simple AWB
+  };
+  applyTable(whiteBalance);
 }
 
-void OV7670::QQQVGARGB565()
+void OV7670::outputFormat(Mode m)
 {
-  i2c.writeRegister(ADDR, REG_COM7, 0b10000000);  //all registers default
-      
-  i2c.writeRegister(ADDR, REG_CLKRC, 0b10000000); //double clock
-  i2c.writeRegister(ADDR, REG_COM11, 0b1000 | 0b10); //enable auto 50/60Hz detect + exposure timing can be less...
+  if(modeFormat(m) == PIXEL_RGB565)
+    RGB565();
+  else
+    YUV422();
+}
 
-  i2c.writeRegister(ADDR, REG_COM7, 0b100); //RGB
-  i2c.writeRegister(ADDR, REG_COM15, 0b11000000 | 0b010000); //RGB565
+void OV7670::RGB565()
+{
+  static constexpr RegisterValue regs[] = {
+    {REG_COM7, 0b100}, //RGB
+    {REG_COM15, 0b11000000 | 0b010000}, //RGB565
+  };
+  applyTable(regs);
+}
 
-  QQQVGA();
-  
+void OV7670::YUV422()
+{
+  static constexpr RegisterValue regs[] = {
+    {REG_COM7, 0b000}, //YUV
+    {REG_COM15, 0b11000000}, //full output range
+    {REG_TSLB, TSLB_YLAST},
+  };
+  applyTable(regs);
+}
+
+void OV7670::scaling(Mode m)
+{
+  switch(modeXres(m))
+  {
+    case 640:
+    VGA();
+    break;
+    case 320:
+    QVGA();
+    break;
+    case 160:
+    QQVGA();
+    break;
+    case 80:
+    QQQVGA();
+    break;
+    default:
+    break;
+  }
+  timing(m);
+}
+
+void OV7670::timing(Mode m)
+{
+  applyClock(m);
   frameControl(196, 52, 8, 488); //no clue why horizontal needs such strange values, vertical works ok
-  
-  //i2c.writeRegister(ADDR, REG_MVFP, 0x2b);  //mirror flip
-   
-  i2c.writeRegister(ADDR, 0xb0, 0x84);// no clue what this is but it's most important for colors
-  saturation(0);
-  i2c.writeRegister(ADDR, 0x13, 0xe7); //AWB on
-  i2c.writeRegister(ADDR, 0x6f, 0x9f); // Simple AWB
+}
+
+void OV7670::testImage()
+{
+  i2c.writeRegister(ADDR, 0x71, 0x35 | 0x80);
 }
   
+void OV7670::saturation(int s)  //-2 to 2
+{
+  //color matrix values
+  const RegisterValue regs[] = {
+    {0x4f, (unsigned char)(0x80 + 0x20 * s)},
+    {0x50, (unsigned char)(0x80 + 0x20 * s)},
+    {0x51, 0x00},
+    {0x52, (unsigned char)(0x22 + (0x11 * s) / 2)},
+    {0x53, (unsigned char)(0x5e + (0x2f * s) / 2)},
+    {0x54, (unsigned char)(0x80 + 0x20 * s)},
+    {0x58, 0x9e},  //matrix signs
+  };
+  applyTable(regs);
+}
+
+void OV7670::frameControl(int hStart, int hStop, int vStart, int vStop)
+{
+  const RegisterValue regs[] = {
+    {REG_HSTART, (unsigned char)(hStart >> 3)},
+    {REG_HSTOP, (unsigned char)(hStop >> 3)},
+    {REG_HREF, (unsigned char)(((hStop & 0b111) << 3) | (hStart & 0b111))},
+    {REG_VSTART, (unsigned char)(vStart >> 2)},
+    {REG_VSTOP, (unsigned char)(vStop >> 2)},
+    {REG_VREF, (unsigned char)(((vStop & 0b11) << 2) | (vStart & 0b11))},
+  };
+  applyTable(regs);
+}
+
+void OV7670::VGA()
+{
+  //640x480, clock from clocks[]
+  static constexpr RegisterValue regs[] = {
+    {REG_COM3, 0x00},
+    {REG_COM14, 0x00},
+    {REG_SCALING_XSC, 0x3a},
+    {REG_SCALING_YSC, 0x35},
+    {REG_SCALING_DCWCTR, 0x11},
+    {REG_SCALING_PCLK_DIV, 0xf0},
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  applyTable(regs);
+}
+
+void OV7670::QVGA()
+{
+  //320x240 (1/2)
+  static constexpr RegisterValue regs[] = {
+    {REG_COM3, 0x04},  //DCW enable
+    {REG_COM14, 0x19}, //pixel clock divided by 2, manual scaling enable
+    {REG_SCALING_XSC, 0x3a},
+    {REG_SCALING_YSC, 0x35},
+    {REG_SCALING_DCWCTR, 0x11}, //downsample by 2
+    {REG_SCALING_PCLK_DIV, 0xf1}, //pixel clock divided by 2
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  applyTable(regs);
+}
+
+void OV7670::QQQVGA()
+{
+  static constexpr RegisterValue regs[] = {
+    {REG_COM3, 0x04},  //DCW enable
+    {REG_COM14, 0x1b}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register
+    {REG_SCALING_XSC, 0x3a},
+    {REG_SCALING_YSC, 0x35},
+    {REG_SCALING_DCWCTR, 0x33}, //downsample by 8
+    {REG_SCALING_PCLK_DIV, 0xf3}, //pixel clock divided by 8
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  applyTable(regs);
+}
+
+void OV7670::QQVGA()
+{
+  //160x120 (1/4)
+  static constexpr RegisterValue regs[] = {
+    {REG_COM3, 0x04},  //DCW enable
+    {REG_COM14, 0x1a}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register
+    {REG_SCALING_XSC, 0x3a},
+    {REG_SCALING_YSC, 0x35},
+    {REG_SCALING_DCWCTR, 0x22}, //downsample by 4
+    {REG_SCALING_PCLK_DIV, 0xf2}, //pixel clock divided by 4
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  applyTable(regs);
+}
@@ -5,39 +5,152 @@
 class OV7670: public I2SCamera
 {
   public:
+  //four sizes per format, smallest first; modeXres() and modeFormat() rely on it
   enum Mode
   {
     QQQVGA_RGB565,
     QQVGA_RGB565,
     QVGA_RGB565,
     VGA_RGB565,
+    QQQVGA_YUV422,
+    QQVGA_YUV422,
+    QVGA_YUV422,
+    VGA_YUV422,
+    QQQVGA_Y8,
+    QQVGA_Y8,
+    QVGA_Y8,
+    VGA_Y8,
   };
-  int xres, yres;
+  static const int MODE_COUNT = VGA_Y8 + 1;
+
+  //XCLK and the internal clock prescaler of one mode. The scaling PCLK
+  //divider is not part of it, it has to match the mode's downsampling.
+  struct Clock
+  {
+    uint32_t xclkHz;
+    uint8_t clkrc;   //REG_CLKRC, input clock / ((clkrc & 0x3f) + 1)
+  };
+  unsigned long modeSwitchMicros;
+  //sensor setup in the constructor, and the registers that were not
+  //acknowledged or read back different from their table then
+  unsigned long initMicros;
+  int registerErrors;
+
+  static constexpr int modeXres(Mode m)
+  {
+    return m >= QQQVGA_RGB565 && m < MODE_COUNT ? 80 << (m % 4) : 0;
+  }
+  static constexpr int modeYres(Mode m)
+  {
+    return modeXres(m) * 3 / 4;
+  }
+  static constexpr PixelFormat modeFormat(Mode m)
+  {
+    return m >= QQQVGA_Y8 ? PIXEL_Y8 : m >= QQQVGA_YUV422 ? PIXEL_YUV422 : PIXEL_RGB565;
+  }
+  //bytes of a whole frame in the frame buffer
+  static constexpr int modeBytes(Mode m)
+  {
+    return modeXres(m) * modeYres(m) * (modeFormat(m) == PIXEL_Y8 ? 1 : 2);
+  }
+  //the clocks the mode tables used to hardcode
+  static Clock defaultClock(Mode m);
 
   protected:
   static const int ADDR = 0x42;
   
   Mode mode;
   I2C i2c;
+  bool verifyTables;
+  int xclkPin;
+  uint32_t xclkHz;
+  bool isParked;
+  //set by OV7670Fixed, its line ISR is built for one mode
+  bool fixedMode;
+  Clock clocks[MODE_COUNT];
+
+  //XCLK on and the first VSYNC awaited, the registers are left to the caller
+  OV7670(Mode m, const int SIOD, const int SIOC, const int VSYNC, const int XCLK);
 
   void testImage();
   void saturation(int s);
   void frameControl(int hStart, int hStop, int vStart, int vStop);
   void QQVGA();
-  void QQVGARGB565();
   void QQQVGA();
-  void QQQVGARGB565();
+  void QVGA();
+  void VGA();
+  void RGB565();
+  void YUV422();
+  void configure(Mode m);
+  void reset();
+  void outputFormat(Mode m);
+  void scaling(Mode m);
+  //clock and window of a mode, after its scaling table
+  void timing(Mode m);
+  void colorDefaults();
+  void applyClock(Mode m);
   void inline writeRegister(unsigned char reg, unsigned char data)
   {
     i2c.writeRegister(ADDR, reg, data);
   }
+  //one batched call per table, read back while verifyTables is set
+  void applyTable(const RegisterValue* table, int count);
+  template<int N> void applyTable(const RegisterValue (&table)[N])
+  {
+    applyTable(table, N);
+  }
 
   public:
   void setRegister(unsigned char reg, unsigned char data) {
     writeRegister(reg, data);
 }
+  bool getRegister(unsigned char reg, unsigned char& data)
+  {
+    return i2c.readRegister(ADDR, reg, data);
+  }
+  //returns the number of registers that were not acknowledged
+  int setRegisters(const RegisterValue* table, int count)
+  {
+    return i2c.writeRegisters(ADDR, table, count);
+  }
+  //returns the number of registers that read back different
+  int verifyRegisters(const RegisterValue* table, int count)
+  {
+    return i2c.verifyRegisters(ADDR, table, count);
+  }
+
+  //the frame buffer holds the frame of m or of largestMode, whichever is
+  //larger, or frameCapacity bytes if that is more, for band rings; setMode()
+  //to a mode whose frame does not fit captures it in bands, see setBand()
+  OV7670(OV7670::Mode m, const int SIOD, const int SIOC, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7, OV7670::Mode largestMode = QQQVGA_RGB565, int frameCapacity = 0);
+
+  //rewrites scaling and window registers only, no sensor reset or reallocation
+  bool setMode(Mode m);
+
+  Mode currentMode() const
+  {
+    return mode;
+  }
+
+  //takes effect at once if m is the current mode, else at the next setMode(m)
+  void setClock(Mode m, const Clock& c);
+  const Clock& clock(Mode m) const
+  {
+    return clocks[m];
+  }
+
+  //soft sleep (COM2) and XCLK off, the registers keep their values
+  void park();
+  //XCLK and the sensor back on; the first frames after it are still settling
+  void unpark();
+
+  bool parked() const
+  {
+    return isParked;
+  }
 
-  OV7670(OV7670::Mode m, const int SIOD, const int SIOC, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7);
+  //the sensor reads its rows bottom up from the next frame on
+  void verticalFlip(bool on);
 
 
 //camera registers
@@ -45,6 +158,8 @@ class OV7670: public I2SCamera
   static const int REG_BLUE = 0x01;
   static const int REG_RED = 0x02;
   static const int REG_COM1 = 0x04;
+  static const int REG_COM2 = 0x09;
+    static const int COM2_SSLEEP = 0x10;  // Soft sleep mode
   static const int REG_VREF = 0x03;
   static const int REG_COM4 = 0x0d;
   static const int REG_COM5 = 0x0e;
@@ -70,6 +185,7 @@ class OV7670: public I2SCamera
   static const int COM11_50HZ = 0x08;
   static const int COM11_EXP = 0x0;
   static const int REG_TSLB = 0x3A;
+    static const int TSLB_YLAST = 0x04;   // U Y V Y output order (Y last), auto window
   static const int REG_RGB444 = 0x8C;
   static const int REG_COM15 = 0x40;
     static const int COM15_RGB565 = 0x10;
@@ -81,6 +197,7 @@ class OV7670: public I2SCamera
   static const int REG_VSTOP = 0x1A;
   static const int REG_COM3 = 0x0C;
   static const int REG_MVFP = 0x1E;
+    static const int MVFP_VFLIP = 0x10;
   static const int REG_COM13 = 0x3d;
     static const int COM13_UVSAT = 0x40;
   static const int REG_SCALING_XSC = 0x70;
@@ -0,0 +1,71 @@
+#pragma once
+#include "OV7670.h"
+
+//pinout of the sensor as a type, for OV7670Fixed
+template<int SIOD_, int SIOC_, int VSYNC_, int HREF_, int XCLK_, int PCLK_, int D0_, int D1_, int D2_, int D3_, int D4_, int D5_, int D6_, int D7_>
+struct OV7670Pins
+{
+  static const int SIOD = SIOD_;
+  static const int SIOC = SIOC_;
+  static const int VSYNC = VSYNC_;
+  static const int HREF = HREF_;
+  static const int XCLK = XCLK_;
+  static const int PCLK = PCLK_;
+  static const int D0 = D0_;
+  static const int D1 = D1_;
+  static const int D2 = D2_;
+  static const int D3 = D3_;
+  static const int D4 = D4_;
+  static const int D5 = D5_;
+  static const int D6 = D6_;
+  static const int D7 = D7_;
+};
+
+//OV7670 built for a single mode, for firmware that never calls setMode().
+//Geometry, format and buffer sizes are constants, the line ISR is compiled
+//for them alone: one copy loop with a known trip count instead of three
+//behind per line loads of pixelFormat, xres and yres. Only the mode's own
+//format and scaling tables are referenced, the linker drops the others
+//unless a runtime OV7670 is built as well.
+//CAPACITY below FRAME_BYTES captures in bands as with the runtime class;
+//setMode() to another mode fails.
+template<OV7670::Mode M, class Pins, int CAPACITY = OV7670::modeBytes(M)>
+class OV7670Fixed : public OV7670
+{
+  public:
+  static const int XRES = modeXres(M);
+  static const int YRES = modeYres(M);
+  static const PixelFormat FORMAT = modeFormat(M);
+  static const int LINE_BYTES = XRES * (FORMAT == PIXEL_Y8 ? 1 : 2);
+  static const int FRAME_BYTES = LINE_BYTES * YRES;
+  static_assert(XRES > 0, "not a mode");
+  static_assert(CAPACITY >= LINE_BYTES, "the frame buffer must hold a line");
+
+  OV7670Fixed()
+    :OV7670(M, Pins::SIOD, Pins::SIOC, Pins::VSYNC, Pins::XCLK)
+  {
+    fixedMode = true;
+    unsigned long t = micros();
+    verifyTables = true;
+    reset();
+    if(FORMAT == PIXEL_RGB565)
+      RGB565();
+    else
+      YUV422();
+    if(XRES == 640)
+      VGA();
+    else if(XRES == 320)
+      QVGA();
+    else if(XRES == 160)
+      QQVGA();
+    else
+      QQQVGA();
+    timing(M);
+    colorDefaults();
+    verifyTables = false;
+    initMicros = micros() - t;
+    //two bytes per dword packing, two bytes per pixel
+    I2SCamera::init(XRES, YRES, Pins::VSYNC, Pins::HREF, Pins::XCLK, Pins::PCLK, Pins::D0, Pins::D1, Pins::D2, Pins::D3, Pins::D4, Pins::D5, Pins::D6, Pins::D7,
+      CAPACITY, FORMAT, &fixedInterrupt<FORMAT, XRES, YRES>, XRES * 2 * 2);
+  }
+};
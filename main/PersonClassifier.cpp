@@ -0,0 +1,277 @@
+#include "PersonClassifier.h"
+
+#if PERSON_CLASSIFIER
+#if !__has_include("person_model_data.h")
+#error "PERSON_CLASSIFIER needs the exported model in person_model_data.h"
+#endif
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include "person_model_data.h"
+
+PersonClassifier::Arena PersonClassifier::arena;
+
+//box of source pixels that ends up in output pixel o, at least one pixel wide
+static inline int cropStart(int o, int size)
+{
+  return o * size / PersonClassifier::INPUT_SIZE;
+}
+
+static inline int cropEnd(int o, int size)
+{
+  int e = (o + 1) * size / PersonClassifier::INPUT_SIZE;
+  int s = cropStart(o, size);
+  return e > s ? e : s + 1;
+}
+
+void PersonClassifier::beginCrop(int x0, int y0, int size, int frameWidth, int frameHeight, I2SCamera::PixelFormat format)
+{
+  if(size > frameWidth) size = frameWidth;
+  if(size > frameHeight) size = frameHeight;
+  if(x0 < 0) x0 = 0;
+  if(y0 < 0) y0 = 0;
+  if(x0 + size > frameWidth) x0 = frameWidth - size;
+  if(y0 + size > frameHeight) y0 = frameHeight - size;
+  cropY = y0;
+  cropSize = size;
+  this->frameWidth = frameWidth;
+  this->format = format;
+  for(int o = 0; o < INPUT_SIZE; o++)
+  {
+    columnStart[o] = x0 + cropStart(o, size);
+    columnEnd[o] = x0 + cropEnd(o, size);
+  }
+  memset(arena.crop.sums, 0, sizeof(arena.crop.sums));
+}
+
+int PersonClassifier::luma(const uint8_t* row, int x) const
+{
+  if(format == I2SCamera::PIXEL_Y8)
+    return row[x];
+  if(format == I2SCamera::PIXEL_YUV422)
+    return row[x * 2 + 1];
+  int p = row[x * 2] | (row[x * 2 + 1] << 8);
+  return (((p >> 11) << 3) * 77 + (((p >> 5) & 0x3f) << 2) * 150 + ((p & 0x1f) << 3) * 29) >> 8;
+}
+
+void PersonClassifier::addBand(const uint8_t* pixels, int first, int lines)
+{
+  //the banded capture retries a frame it lost from the top
+  if(first == 0)
+    memset(arena.crop.sums, 0, sizeof(arena.crop.sums));
+  int bpp = format == I2SCamera::PIXEL_Y8 ? 1 : 2;
+  for(int oy = 0; oy < INPUT_SIZE; oy++)
+  {
+    int ya = cropY + cropStart(oy, cropSize);
+    int yb = cropY + cropEnd(oy, cropSize);
+    if(ya < first) ya = first;
+    if(yb > first + lines) yb = first + lines;
+    uint16_t* out = arena.crop.sums + oy * INPUT_SIZE;
+    for(int y = ya; y < yb; y++)
+    {
+      const uint8_t* row = pixels + (y - first) * frameWidth * bpp;
+      for(int ox = 0; ox < INPUT_SIZE; ox++)
+      {
+        int sum = 0;
+        for(int x = columnStart[ox]; x < columnEnd[ox]; x++)
+          sum += luma(row, x);
+        out[ox] += sum;
+      }
+    }
+  }
+}
+
+void PersonClassifier::bandSink(void* arg, const uint8_t* pixels, int first, int lines)
+{
+  ((PersonClassifier*)arg)->addBand(pixels, first, lines);
+}
+
+void PersonClassifier::finishCrop()
+{
+  for(int oy = 0; oy < INPUT_SIZE; oy++)
+  {
+    int h = cropEnd(oy, cropSize) - cropStart(oy, cropSize);
+    const uint16_t* sums = arena.crop.sums + oy * INPUT_SIZE;
+    int8_t* input = arena.crop.input + oy * INPUT_SIZE;
+    for(int ox = 0; ox < INPUT_SIZE; ox++)
+    {
+      int count = h * (columnEnd[ox] - columnStart[ox]);
+      input[ox] = (int8_t)((sums[ox] + count / 2) / count - 128);
+    }
+  }
+}
+
+//rounding fixed point rescale of the 32 bit accumulator to the output scale
+static inline int8_t requantize(int32_t acc, const PersonLayer& l)
+{
+  int s = 31 + l.shift;
+  int32_t v = (int32_t)(((int64_t)acc * l.multiplier + ((int64_t)1 << (s - 1))) >> s) + l.outputZero;
+  if(v < l.actMin) v = l.actMin;
+  if(v > l.actMax) v = l.actMax;
+  return (int8_t)v;
+}
+
+//TensorFlow "same" padding: output size and the padding before the first pixel
+static inline int samePadding(int in, int kernel, int stride, int& out)
+{
+  out = (in + stride - 1) / stride;
+  int total = (out - 1) * stride + kernel - in;
+  return total > 0 ? total / 2 : 0;
+}
+
+static void conv(const PersonLayer& l, const int8_t* in, int h, int w, int c, int8_t* out, int oh, int ow, int padY, int padX)
+{
+  int k = l.kernel;
+  for(int oy = 0; oy < oh; oy++)
+    for(int ox = 0; ox < ow; ox++)
+    {
+      int iy0 = oy * l.stride - padY;
+      int ix0 = ox * l.stride - padX;
+      for(int o = 0; o < l.outChannels; o++)
+      {
+        const int8_t* wk = l.weights + o * k * k * c;
+        int32_t acc = l.bias[o];
+        for(int ky = 0; ky < k; ky++)
+        {
+          int iy = iy0 + ky;
+          if(iy < 0 || iy >= h) continue;
+          for(int kx = 0; kx < k; kx++)
+          {
+            int ix = ix0 + kx;
+            if(ix < 0 || ix >= w) continue;
+            const int8_t* px = in + (iy * w + ix) * c;
+            const int8_t* wp = wk + (ky * k + kx) * c;
+            for(int i = 0; i < c; i++)
+              acc += (px[i] - l.inputZero) * wp[i];
+          }
+        }
+        *out++ = requantize(acc, l);
+      }
+    }
+}
+
+//channels run innermost, so each tap is one contiguous pass over the input
+//pixel and the weights, into a row of 32 bit accumulators
+static void depthwise(const PersonLayer& l, const int8_t* in, int h, int w, int c, int8_t* out, int oh, int ow, int padY, int padX)
+{
+  int32_t acc[PersonClassifier::MAX_CHANNELS];
+  int k = l.kernel;
+  for(int oy = 0; oy < oh; oy++)
+    for(int ox = 0; ox < ow; ox++)
+    {
+      memcpy(acc, l.bias, c * sizeof(int32_t));
+      int iy0 = oy * l.stride - padY;
+      int ix0 = ox * l.stride - padX;
+      for(int ky = 0; ky < k; ky++)
+      {
+        int iy = iy0 + ky;
+        if(iy < 0 || iy >= h) continue;
+        for(int kx = 0; kx < k; kx++)
+        {
+          int ix = ix0 + kx;
+          if(ix < 0 || ix >= w) continue;
+          const int8_t* px = in + (iy * w + ix) * c;
+          const int8_t* wp = l.weights + (ky * k + kx) * c;
+          for(int i = 0; i < c; i++)
+            acc[i] += (px[i] - l.inputZero) * wp[i];
+        }
+      }
+      for(int i = 0; i < c; i++)
+        *out++ = requantize(acc[i], l);
+    }
+}
+
+//1x1 convolution, also the fully connected layer (one pixel); the input pixel
+//is offset once and then dotted with every output row
+static void pointwise(const PersonLayer& l, const int8_t* in, int pixels, int c, int8_t* out)
+{
+  int16_t x[PersonClassifier::MAX_CHANNELS];
+  for(int p = 0; p < pixels; p++, in += c)
+  {
+    for(int i = 0; i < c; i++)
+      x[i] = in[i] - l.inputZero;
+    const int8_t* wp = l.weights;
+    for(int o = 0; o < l.outChannels; o++, wp += c)
+    {
+      int32_t acc = l.bias[o];
+      for(int i = 0; i < c; i++)
+        acc += x[i] * wp[i];
+      *out++ = requantize(acc, l);
+    }
+  }
+}
+
+static void avgpool(const int8_t* in, int pixels, int c, int8_t* out)
+{
+  int32_t acc[PersonClassifier::MAX_CHANNELS] = {0};
+  for(int p = 0; p < pixels; p++, in += c)
+    for(int i = 0; i < c; i++)
+      acc[i] += in[i];
+  for(int i = 0; i < c; i++)
+  {
+    int32_t v = acc[i] >= 0 ? (acc[i] + pixels / 2) / pixels : (acc[i] - pixels / 2) / pixels;
+    out[i] = (int8_t)v;
+  }
+}
+
+int PersonClassifier::classify()
+{
+  unsigned long t = micros();
+  finishCrop();
+
+  int h = INPUT_SIZE, w = INPUT_SIZE, c = 1;
+  int8_t* in = arena.tensor[0];
+  int8_t* out = arena.tensor[1];
+  for(int i = 0; i < personModel.layerCount; i++)
+  {
+    const PersonLayer& l = personModel.layers[i];
+    int oh = 1, ow = 1, oc = l.outChannels;
+    int padY = 0, padX = 0;
+    if(l.type == PersonLayer::CONV || l.type == PersonLayer::DEPTHWISE)
+    {
+      padY = samePadding(h, l.kernel, l.stride, oh);
+      padX = samePadding(w, l.kernel, l.stride, ow);
+    }
+    else if(l.type == PersonLayer::POINTWISE)
+    {
+      oh = h;
+      ow = w;
+    }
+    if(l.type == PersonLayer::DEPTHWISE || l.type == PersonLayer::AVGPOOL)
+      oc = c;
+    int depth = l.type == PersonLayer::FULLY ? h * w * c : c;
+    if(oh * ow * oc > TENSOR_BYTES || depth > MAX_CHANNELS)
+      return -1;
+
+    switch(l.type)
+    {
+      case PersonLayer::CONV: conv(l, in, h, w, c, out, oh, ow, padY, padX); break;
+      case PersonLayer::DEPTHWISE: depthwise(l, in, h, w, c, out, oh, ow, padY, padX); break;
+      case PersonLayer::POINTWISE: pointwise(l, in, h * w, c, out); break;
+      case PersonLayer::FULLY: pointwise(l, in, 1, h * w * c, out); break;
+      case PersonLayer::AVGPOOL: avgpool(in, h * w, c, out); break;
+      default: return -1;
+    }
+    h = oh;
+    w = ow;
+    c = oc;
+    int8_t* swap = in;
+    in = out;
+    out = swap;
+  }
+
+  //softmax over the dequantized logits
+  const PersonLayer& last = personModel.layers[personModel.layerCount - 1];
+  float sum = 0;
+  float person = 0;
+  for(int i = 0; i < c; i++)
+  {
+    float e = expf((in[i] - last.outputZero) * personModel.outputScale);
+    sum += e;
+    if(i == personModel.personClass)
+      person = e;
+  }
+  lastMicros = micros() - t;
+  return (int)(person * 100 / sum + 0.5f);
+}
+#endif
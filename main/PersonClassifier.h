@@ -0,0 +1,63 @@
+#pragma once
+//set to 1 (or -DPERSON_CLASSIFIER=1) to build the classifier,
+//it needs the exported model in person_model_data.h
+#ifndef PERSON_CLASSIFIER
+#define PERSON_CLASSIFIER 0
+#endif
+
+#if PERSON_CLASSIFIER
+#include <stdint.h>
+#include "I2SCamera.h"
+#include "PersonModel.h"
+
+//Runs a small int8 CNN (PersonModel.h) over a grayscale crop of the alert
+//frame. The crop is box filtered down to INPUT_SIZE while the banded capture
+//delivers the bands, and all tensors live in a static arena, nothing is
+//allocated on the heap.
+class PersonClassifier
+{
+  public:
+  static const int INPUT_SIZE = 96;
+  //largest activation tensor of the model, 48x48x8
+  static const int TENSOR_BYTES = 48 * 48 * 8;
+  static const int MAX_CHANNELS = 256;
+
+  unsigned long lastMicros;
+
+  //square crop in photo pixels (flipped vertically against the sensor),
+  //clamped into the frame
+  void beginCrop(int x0, int y0, int size, int frameWidth, int frameHeight, I2SCamera::PixelFormat format);
+  //feed the bands top down in photo order, pixels as the camera stores them;
+  //a band at line 0 starts the crop over
+  void addBand(const uint8_t* pixels, int first, int lines);
+  //banded capture callback, arg is the classifier
+  static void bandSink(void* arg, const uint8_t* pixels, int first, int lines);
+
+  //person confidence 0..100, -1 if the model does not fit the arena
+  int classify();
+
+  private:
+  int cropY, cropSize;
+  //source columns of every output column, the boxes are the same on each row
+  int16_t columnStart[INPUT_SIZE];
+  int16_t columnEnd[INPUT_SIZE];
+  int frameWidth;
+  I2SCamera::PixelFormat format;
+
+  //ping-pong tensors, while the crop is collected the second one holds
+  //the box filter sums
+  union Arena
+  {
+    int8_t tensor[2][TENSOR_BYTES];
+    struct
+    {
+      int8_t input[TENSOR_BYTES];
+      uint16_t sums[INPUT_SIZE * INPUT_SIZE];
+    } crop;
+  };
+  static Arena arena;
+
+  int luma(const uint8_t* row, int x) const;
+  void finishCrop();
+};
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+
+//Layout of an int8 quantized model for PersonClassifier, as written by the
+//exporter into person_model_data.h. Tensors are HWC, activations int8 with a
+//per tensor zero point, weights symmetric int8 (zero point 0).
+//Weight order:
+//  CONV        [out][ky][kx][in]
+//  DEPTHWISE   [ky][kx][channel]
+//  POINTWISE   [out][in]
+//  FULLY       [out][in]
+//  AVGPOOL     no weights, keeps the quantization of its input
+//Padding is TensorFlow "same", the last layer gives one logit per class.
+struct PersonLayer
+{
+  enum Type
+  {
+    CONV,
+    DEPTHWISE,
+    POINTWISE,
+    AVGPOOL,
+    FULLY,
+  };
+  uint8_t type;
+  uint8_t kernel;
+  uint8_t stride;
+  uint16_t outChannels;
+  const int8_t* weights;
+  const int32_t* bias;
+  //output = clamp(((acc * multiplier) >> (31 + shift)) + outputZero, actMin, actMax)
+  int32_t multiplier;
+  int8_t shift;
+  int8_t inputZero;
+  int8_t outputZero;
+  int8_t actMin;
+  int8_t actMax;
+};
+
+struct PersonModel
+{
+  int inputSize;           //square grayscale input, pixel - 128 as int8
+  const PersonLayer* layers;
+  int layerCount;
+  float outputScale;       //of the logits
+  int personClass;
+};
@@ -0,0 +1,75 @@
+#include "PowerScheduler.h"
+
+PowerScheduler::PowerScheduler(unsigned long now)
+  :start(now), lastActivity(now), cameraOnSince(now)
+{
+}
+
+void PowerScheduler::activity(unsigned long now)
+{
+  lastActivity = now;
+}
+
+bool PowerScheduler::shouldPark(unsigned long now) const
+{
+  return current == AWAKE && now - lastActivity >= PARK_AFTER_MS;
+}
+
+void PowerScheduler::parked(unsigned long now)
+{
+  if(current == PARKED)
+    return;
+  cameraOnMs += now - cameraOnSince;
+  current = PARKED;
+}
+
+void PowerScheduler::waking(unsigned long now)
+{
+  if(current != PARKED)
+    return;
+  current = WAKING;
+  wakeStart = now;
+  cameraOnSince = now;
+  wakes++;
+}
+
+bool PowerScheduler::wakeExpired(unsigned long now) const
+{
+  return current == WAKING && now - wakeStart >= WAKE_TIMEOUT_MS;
+}
+
+void PowerScheduler::frameReady(unsigned long now, bool usable)
+{
+  if(current != WAKING)
+    return;
+  lastWakeToFrameMs = now - wakeStart;
+  if(lastWakeToFrameMs > maxWakeToFrameMs)
+    maxWakeToFrameMs = lastWakeToFrameMs;
+  if(!usable)
+    wakeTimeouts++;
+  current = AWAKE;
+  lastActivity = now;
+}
+
+unsigned long PowerScheduler::sleepBudget() const
+{
+  return current == PARKED ? SLEEP_SLICE_MS : 0;
+}
+
+void PowerScheduler::slept(unsigned long ms)
+{
+  sleptMs += ms;
+}
+
+int PowerScheduler::cpuDutyPermille(unsigned long now) const
+{
+  unsigned long total = now - start;
+  return total ? (int)((total - sleptMs) * 1000ULL / total) : 1000;
+}
+
+int PowerScheduler::cameraDutyPermille(unsigned long now) const
+{
+  unsigned long total = now - start;
+  unsigned long on = cameraOnMs + (current == PARKED ? 0 : now - cameraOnSince);
+  return total ? (int)(on * 1000ULL / total) : 1000;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+//Decides when the node parks the camera and light-sleeps the CPU, and keeps
+//the books on it. Pure logic on a millisecond clock passed in by the caller,
+//so the same code runs against millis() on the board and a simulated clock
+//on the host.
+//
+//AWAKE: camera running, CPU polling. After PARK_AFTER_MS without radar
+//presence or pending work the camera is parked (PARKED) and the CPU sleeps
+//in slices of SLEEP_SLICE_MS, woken early by radar UART traffic. Presence
+//wakes the camera (WAKING) until the first usable frame or WAKE_TIMEOUT_MS,
+//whichever comes first.
+class PowerScheduler
+{
+  public:
+  enum State
+  {
+    AWAKE,
+    PARKED,
+    WAKING,
+  };
+
+  static const unsigned long PARK_AFTER_MS = 20000;
+  static const unsigned long SLEEP_SLICE_MS = 200;
+  static const unsigned long WAKE_TIMEOUT_MS = 1500;
+
+  explicit PowerScheduler(unsigned long now = 0);
+
+  State state() const
+  {
+    return current;
+  }
+
+  //radar presence or work that needs the camera or the network
+  void activity(unsigned long now);
+  //true once the camera has been quiet long enough to be parked
+  bool shouldPark(unsigned long now) const;
+  void parked(unsigned long now);
+  //the camera clock is back on
+  void waking(unsigned long now);
+  bool wakeExpired(unsigned long now) const;
+  //the first usable frame after waking(), or the wake gave up (usable false)
+  void frameReady(unsigned long now, bool usable);
+
+  //how long the CPU may light-sleep now, 0 to stay awake
+  unsigned long sleepBudget() const;
+  void slept(unsigned long ms);
+
+  //permille of the time since construction the CPU / the camera was running
+  int cpuDutyPermille(unsigned long now) const;
+  int cameraDutyPermille(unsigned long now) const;
+
+  int wakes = 0;
+  int wakeTimeouts = 0;
+  unsigned long lastWakeToFrameMs = 0;
+  unsigned long maxWakeToFrameMs = 0;
+
+  private:
+  State current = AWAKE;
+  unsigned long start;
+  unsigned long lastActivity;
+  unsigned long wakeStart = 0;
+  unsigned long cameraOnSince;
+  unsigned long cameraOnMs = 0;
+  unsigned long sleptMs = 0;
+};
@@ -0,0 +1,69 @@
+#include "RateController.h"
+#include <math.h>
+
+//bytes per pixel at quality 50 for a frame of the given sharpness, fitted to
+//the stripe encoder on synthetic frames of increasing detail
+static const float BASE_BYTES_PER_PIXEL = 0.003f;
+static const float DETAIL_BYTES_PER_PIXEL = 0.006f;
+//headers and tables
+static const int HEADER_BYTES = 620;
+
+RateController::RateController(unsigned long targetMs)
+  :targetMs(targetMs)
+{
+  connect = DEFAULT_CONNECT_MS;
+  bytesPerMs = DEFAULT_BYTES_PER_SECOND / 1000.0f;
+  calibration = 1;
+  uploads = 0;
+}
+
+void RateController::addUpload(size_t bytes, unsigned long connectMs, unsigned long transferMs)
+{
+  if(transferMs == 0)
+    transferMs = 1;
+  float rate = (float)bytes / transferMs;
+  //the first measurement replaces the default, later ones are averaged;
+  //a slower link is followed faster than a recovering one
+  if(uploads++ == 0)
+  {
+    connect = connectMs;
+    bytesPerMs = rate;
+    return;
+  }
+  connect += (connectMs - connect) / (connectMs > connect ? 2 : 4);
+  bytesPerMs += (rate - bytesPerMs) / (rate < bytesPerMs ? 2 : 4);
+}
+
+void RateController::addEncode(size_t predictedBytes, size_t actualBytes)
+{
+  if(!predictedBytes || !actualBytes)
+    return;
+  //the prediction already includes the current calibration
+  float ratio = (float)actualBytes / predictedBytes;
+  calibration *= powf(ratio, 0.5f);
+  if(calibration < 0.25f) calibration = 0.25f;
+  if(calibration > 4) calibration = 4;
+}
+
+size_t RateController::predictBytes(const FrameStats& stats, int width, int height, int quality) const
+{
+  //the size roughly follows the inverse quantiser scale to the power 0.7
+  int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  if(scale < 1) scale = 1;
+  float qualityFactor = powf(100.0f / scale, 0.7f);
+  float perPixel = BASE_BYTES_PER_PIXEL + DETAIL_BYTES_PER_PIXEL * sqrtf((float)stats.sharpness());
+  return HEADER_BYTES + (size_t)((float)width * height * perPixel * qualityFactor * calibration);
+}
+
+unsigned long RateController::predictMs(size_t bytes) const
+{
+  return (unsigned long)(connect + bytes / bytesPerMs);
+}
+
+int RateController::chooseQuality(const FrameStats& stats, int width, int height) const
+{
+  for(int q = MAX_QUALITY; q >= MIN_QUALITY; q -= QUALITY_STEP)
+    if(predictMs(predictBytes(stats, width, height, q)) <= targetMs)
+      return q;
+  return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "FrameStats.h"
+
+//Picks the JPEG quality for the alert photo so the upload fits a delivery
+//time target. The link is modelled as connect time (TLS handshake, a few
+//RTTs) plus bytes over throughput, both averaged over the recent uploads.
+//The JPEG size is predicted from the preview frame statistics and corrected
+//by the ratio of the actual to the predicted sizes of the earlier encodes.
+class RateController
+{
+  public:
+  static const int MIN_QUALITY = 30;
+  static const int MAX_QUALITY = 90;
+  static const int QUALITY_STEP = 5;
+  //assumed until the first upload is measured
+  static const unsigned long DEFAULT_CONNECT_MS = 1500;
+  static const unsigned long DEFAULT_BYTES_PER_SECOND = 40000;
+
+  unsigned long targetMs;
+
+  RateController(unsigned long targetMs = 4000);
+
+  //connectMs until the TLS session is up, transferMs from the first byte
+  //sent until the response arrived
+  void addUpload(size_t bytes, unsigned long connectMs, unsigned long transferMs);
+  //actual size of an encode that was predicted before
+  void addEncode(size_t predictedBytes, size_t actualBytes);
+
+  size_t predictBytes(const FrameStats& stats, int width, int height, int quality) const;
+  unsigned long predictMs(size_t bytes) const;
+  //highest quality whose predicted delivery fits the target, 0 if not even MIN_QUALITY fits
+  int chooseQuality(const FrameStats& stats, int width, int height) const;
+
+  unsigned long connectMs() const
+  {
+    return (unsigned long)connect;
+  }
+
+  unsigned long bytesPerSecond() const
+  {
+    return (unsigned long)(bytesPerMs * 1000);
+  }
+
+  private:
+  float connect;
+  float bytesPerMs;
+  float calibration;
+  int uploads;
+};
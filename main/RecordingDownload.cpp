@@ -0,0 +1,75 @@
+#include "RecordingDownload.h"
+#include <lwip/sockets.h>
+#include "Log.h"
+
+void RecordingDownload::begin(WiFiClient& client, File& file, size_t length)
+{
+  if(sending)
+    end("replaced");
+  this->client = client;
+  this->file = file;
+  left = length;
+  chunkLength = 0;
+  chunkSent = 0;
+  sending = true;
+  downloads++;
+}
+
+void RecordingDownload::end(const char* why)
+{
+  LOGI("web", "Recording download %s, %u bytes unsent", why, (unsigned)(left + chunkLength - chunkSent));
+  file.close();
+  client.stop();
+  sending = false;
+}
+
+bool RecordingDownload::service(unsigned long now)
+{
+  if(!sending)
+    return false;
+  if(egress.alertActive(now))
+  {
+    cutOffs++;
+    end("cut off by an alert");
+    return false;
+  }
+  if(!client.connected())
+  {
+    end("closed by the client");
+    return false;
+  }
+  for(int i = 0; i < CHUNKS; i++)
+  {
+    if(chunkSent == chunkLength)
+    {
+      if(!left)
+      {
+        end("complete");
+        return false;
+      }
+      size_t allowed = egress.grant(EgressScheduler::BULK, min(CHUNK, left), now);
+      if(!allowed)
+        return true;
+      chunkLength = file.read(chunk, allowed);
+      chunkSent = 0;
+      if(!chunkLength)
+      {
+        end("failed to read");
+        return false;
+      }
+      left -= chunkLength;
+    }
+    int n = send(client.fd(), chunk + chunkSent, chunkLength - chunkSent, MSG_DONTWAIT);
+    if(n < 0)
+    {
+      if(errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      end("failed");
+      return false;
+    }
+    chunkSent += n;
+    bytesSent += n;
+    egress.sent(EgressScheduler::BULK, n, now);
+  }
+  return true;
+}
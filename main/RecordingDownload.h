@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <FS.h>
+#include "EgressScheduler.h"
+
+//One recording download, sent from the loop instead of inside serve(). Each
+//service() reads up to CHUNKS chunks of the file within the BULK budget of
+//the egress scheduler and hands them to the socket without waiting: what the
+//socket does not take stays in the chunk for the next call. An alert cuts the
+//download off, the player resumes with a Range request.
+class RecordingDownload
+{
+  public:
+  static const size_t CHUNK = 1024;
+  static const int CHUNKS = 4;
+
+  explicit RecordingDownload(EgressScheduler& egress)
+    :egress(egress)
+  {
+  }
+
+  //takes over the client, the response headers are sent; length bytes from
+  //the file's current position follow. A running download is dropped
+  void begin(WiFiClient& client, File& file, size_t length);
+  //false while nothing is being sent
+  bool service(unsigned long now);
+  bool active() const
+  {
+    return sending;
+  }
+
+  unsigned long downloads = 0;
+  unsigned long cutOffs = 0;
+  unsigned long bytesSent = 0;
+
+  private:
+  EgressScheduler& egress;
+  WiFiClient client;
+  File file;
+  bool sending = false;
+  size_t left = 0;
+  uint8_t chunk[CHUNK];
+  size_t chunkLength = 0;
+  size_t chunkSent = 0;
+
+  void end(const char* why);
+};
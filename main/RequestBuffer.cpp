@@ -0,0 +1,139 @@
+#include "RequestBuffer.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+void RequestBuffer::clear()
+{
+  start = HEAD_ROOM;
+  end = HEAD_ROOM;
+  overflow = false;
+}
+
+bool RequestBuffer::fits(size_t bytes)
+{
+  if(overflow || end + bytes > HEAD_ROOM + CAPACITY)
+  {
+    overflow = true;
+    return false;
+  }
+  return true;
+}
+
+void RequestBuffer::add(const char* data, size_t length)
+{
+  if(!fits(length))
+    return;
+  memcpy(buffer + end, data, length);
+  end += length;
+}
+
+void RequestBuffer::add(const char* text)
+{
+  add(text, strlen(text));
+}
+
+void RequestBuffer::add(unsigned long number)
+{
+  char digits[12];
+  add(digits, snprintf(digits, sizeof(digits), "%lu", number));
+}
+
+void RequestBuffer::addFormEncoded(const char* text)
+{
+  for(const uint8_t* c = (const uint8_t*)text; *c; c++)
+  {
+    if((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9')
+       || *c == '-' || *c == '.' || *c == '_' || *c == '~')
+    {
+      if(!fits(1)) return;
+      buffer[end++] = *c;
+    }
+    else if(*c == ' ')
+    {
+      if(!fits(1)) return;
+      buffer[end++] = '+';
+    }
+    else
+    {
+      if(!fits(3)) return;
+      buffer[end++] = '%';
+      buffer[end++] = HEX_DIGITS[*c >> 4];
+      buffer[end++] = HEX_DIGITS[*c & 15];
+    }
+  }
+}
+
+void RequestBuffer::addJsonEscaped(const char* text)
+{
+  for(const uint8_t* c = (const uint8_t*)text; *c; c++)
+  {
+    if(*c == '"' || *c == '\\')
+    {
+      if(!fits(2)) return;
+      buffer[end++] = '\\';
+      buffer[end++] = *c;
+    }
+    else if(*c == '\n')
+      add("\\n", 2);
+    else if(*c == '\r')
+      add("\\r", 2);
+    else if(*c == '\t')
+      add("\\t", 2);
+    else if(*c < 0x20)
+    {
+      if(!fits(6)) return;
+      memcpy(buffer + end, "\\u00", 4);
+      buffer[end + 4] = HEX_DIGITS[*c >> 4];
+      buffer[end + 5] = HEX_DIGITS[*c & 15];
+      end += 6;
+    }
+    else
+    {
+      if(!fits(1)) return;
+      buffer[end++] = *c;
+    }
+  }
+}
+
+size_t RequestBuffer::formatPartHeader(char* out, size_t size, const char* boundary, const char* name, const char* filename, const char* type)
+{
+  int n = snprintf(out, size, "--%s\r\nContent-Disposition: form-data; name=\"%s\"%s%s%s\r\n%s%s%s\r\n",
+                   boundary, name,
+                   filename ? "; filename=\"" : "", filename ? filename : "", filename ? "\"" : "",
+                   type ? "Content-Type: " : "", type ? type : "", type ? "\r\n" : "");
+  return n < 0 ? 0 : (size_t)n;
+}
+
+void RequestBuffer::addPartHeader(const char* boundary, const char* name, const char* filename, const char* type)
+{
+  size_t room = overflow ? 0 : HEAD_ROOM + CAPACITY - end;
+  size_t n = formatPartHeader(buffer + end, room, boundary, name, filename, type);
+  //snprintf truncated, the terminating zero needs one byte too
+  if(n >= room)
+  {
+    overflow = true;
+    return;
+  }
+  end += n;
+}
+
+void RequestBuffer::finish(const char* token, const char* method, const char* contentType, size_t bodyExtra)
+{
+  char head[HEAD_ROOM];
+  int n = snprintf(head, sizeof(head),
+                   "POST /bot%s/%s HTTP/1.1\r\n"
+                   "Host: api.telegram.org\r\n"
+                   "Content-Type: %s\r\n"
+                   "Content-Length: %lu\r\n"
+                   "Connection: close\r\n\r\n",
+                   token, method, contentType, (unsigned long)(bodyLength() + bodyExtra));
+  if(n < 0 || n >= (int)sizeof(head))
+  {
+    overflow = true;
+    return;
+  }
+  start = HEAD_ROOM - n;
+  memcpy(buffer + start, head, n);
+}
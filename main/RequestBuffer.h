@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+//Fixed buffer the Telegram requests are built in, so sending an alert does not
+//touch the heap. The body is written first, at HEAD_ROOM; finish() then
+//formats the request line and headers with the now known Content-Length into
+//the room in front of it, and the whole request goes out in one write. Large
+//parts (JPEGs) are not copied, finish() only counts them in the length.
+//An add that does not fit sets overflowed() and is dropped.
+class RequestBuffer
+{
+  public:
+  static const size_t HEAD_ROOM = 256;
+  static const size_t CAPACITY = 4096;
+
+  RequestBuffer()
+  {
+    clear();
+  }
+
+  void clear();
+  void add(const char* text);
+  void add(const char* data, size_t length);
+  void add(unsigned long number);
+  //application/x-www-form-urlencoded value: unreserved characters as they are,
+  //space as '+', all other bytes (UTF-8 included) as %XX
+  void addFormEncoded(const char* text);
+  //JSON string contents without the quotes
+  void addJsonEscaped(const char* text);
+  //"--boundary" and the part headers up to the empty line; the CRLF in front of
+  //every boundary but the first belongs to the content before it
+  void addPartHeader(const char* boundary, const char* name, const char* filename = nullptr, const char* type = nullptr);
+  //puts "POST /bot<token>/<method>" and the headers in front of the body,
+  //bodyExtra counts the body bytes that are sent separately after data()
+  void finish(const char* token, const char* method, const char* contentType, size_t bodyExtra = 0);
+
+  const char* data() const
+  {
+    return buffer + start;
+  }
+
+  size_t length() const
+  {
+    return end - start;
+  }
+
+  size_t bodyLength() const
+  {
+    return end - HEAD_ROOM;
+  }
+
+  bool overflowed() const
+  {
+    return overflow;
+  }
+
+  //formats a part header like addPartHeader into out, returns its length
+  static size_t formatPartHeader(char* out, size_t size, const char* boundary, const char* name, const char* filename = nullptr, const char* type = nullptr);
+
+  private:
+  char buffer[HEAD_ROOM + CAPACITY];
+  size_t start;
+  size_t end;
+  bool overflow;
+
+  bool fits(size_t bytes);
+};
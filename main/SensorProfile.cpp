@@ -0,0 +1,90 @@
+#include "SensorProfile.h"
+#include "Log.h"
+
+static const uint8_t PROFILE_VERSION = 1;
+static const char* PROFILE_KEY = "sensor";
+//settled frames in a row before a snapshot or before converge() returns
+static const int SETTLED_FRAMES = 2;
+
+const uint8_t SensorProfile::REGISTERS[REGISTER_COUNT] = {
+  OV7670::REG_GAIN, OV7670::REG_BLUE, OV7670::REG_RED, 0x6a,  //GGAIN
+  0x07, OV7670::REG_AECH, OV7670::REG_COM1,  //AECHH, AEC[1:0] in COM1
+};
+
+bool SensorProfile::restore(OV7670& camera)
+{
+  Stored profile;
+  restored = false;
+  stored = prefs.getBytes(PROFILE_KEY, &profile, sizeof(profile)) == sizeof(profile) && profile.version == PROFILE_VERSION;
+  if(!stored || profile.mode != camera.currentMode())
+    return false;
+  RegisterValue table[REGISTER_COUNT];
+  for(int i = 0; i < REGISTER_COUNT; i++)
+    table[i] = { REGISTERS[i], profile.values[i] };
+  restored = camera.setRegisters(table, REGISTER_COUNT) == 0;
+  return restored;
+}
+
+int SensorProfile::settle(OV7670& camera)
+{
+  bool captured = camera.oneFrame();
+  return settle(captured, camera.lastStats());
+}
+
+int SensorProfile::settle(bool captured, const FrameStats& stats)
+{
+  if(!captured || ++settleFrames > MAX_CONVERGE_FRAMES)
+  {
+    //a restored profile that does not converge is not kept for the next boot
+    if(restored)
+      drop("did not settle");
+    settleFrames = 0;
+    settleLuma = -1;
+    settleCount = 0;
+    return -1;
+  }
+  int luma = stats.meanLuma();
+  //the profile was taken in other light, starting from it does not help
+  if(settleFrames == 1 && restored && !stats.usable())
+    drop("first frame not usable");
+  settleCount = settleLuma >= 0 && abs(luma - settleLuma) <= SETTLED_LUMA && stats.usable() ? settleCount + 1 : 0;
+  settleLuma = luma;
+  return settleCount >= SETTLED_FRAMES ? settleFrames : 0;
+}
+
+void SensorProfile::observe(OV7670& camera, const FrameStats& stats)
+{
+  int luma = stats.meanLuma();
+  if(lastLuma >= 0 && abs(luma - lastLuma) > LIGHTING_JUMP && stored)
+    drop("lighting changed");
+  settledFrames = lastLuma >= 0 && abs(luma - lastLuma) <= SETTLED_LUMA && stats.usable() ? settledFrames + 1 : 0;
+  lastLuma = luma;
+  if(settledFrames < SETTLED_FRAMES || (stored && millis() - lastSnapshot < SNAPSHOT_INTERVAL))
+    return;
+
+  Stored profile;
+  lastSnapshot = millis();
+  if(!read(camera, profile))
+    return;
+  stored = prefs.putBytes(PROFILE_KEY, &profile, sizeof(profile)) == sizeof(profile);
+  LOGI("sensor", "Sensor profile saved: gain %d, exposure %d",
+       profile.values[0], (profile.values[4] & 0x3f) << 10 | profile.values[5] << 2 | (profile.values[6] & 3));
+}
+
+bool SensorProfile::read(OV7670& camera, Stored& profile)
+{
+  profile.version = PROFILE_VERSION;
+  profile.mode = camera.currentMode();
+  for(int i = 0; i < REGISTER_COUNT; i++)
+    if(!camera.getRegister(REGISTERS[i], profile.values[i]))
+      return false;
+  return true;
+}
+
+void SensorProfile::drop(const char* reason)
+{
+  prefs.remove(PROFILE_KEY);
+  stored = false;
+  restored = false;
+  LOGI("sensor", "Sensor profile dropped: %s", reason);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include "OV7670.h"
+
+//Warm boot cache of the converged exposure, gain and white balance registers.
+//The idle loop snapshots them into Preferences once the picture has settled;
+//after a reset they are written back in one batch before the first frame, so
+//AEC/AGC/AWB start next to where they were instead of at the COM7 defaults.
+//A profile only applies to the mode it was taken in. A sharp lighting change
+//drops it, and so does a restored profile whose first frame is not usable.
+class SensorProfile
+{
+  public:
+  static const unsigned long SNAPSHOT_INTERVAL = 10 * 60 * 1000UL;
+  static const int MAX_CONVERGE_FRAMES = 30;
+  //mean luma steps between two frames that count as settled / as a lighting change
+  static const int SETTLED_LUMA = 4;
+  static const int LIGHTING_JUMP = 48;
+
+  SensorProfile(Preferences& prefs)
+    :prefs(prefs)
+  {
+  }
+
+  //writes the stored profile if it was taken in the camera's current mode
+  bool restore(OV7670& camera);
+  //takes one frame towards a settled mean luma: 0 while settling, then the
+  //frames it took, -1 if it did not settle within MAX_CONVERGE_FRAMES; a
+  //restored profile is dropped then and the next call starts over
+  int settle(OV7670& camera);
+  //the same for a frame that was already taken, captured false on a timeout
+  int settle(bool captured, const FrameStats& stats);
+  //every idle frame: snapshots the settled registers, drops the profile on a
+  //sharp lighting change
+  void observe(OV7670& camera, const FrameStats& stats);
+
+  bool restored = false;
+
+  private:
+  //AGC gain, blue/red AWB gains, green gain, the three AEC parts
+  static const int REGISTER_COUNT = 7;
+  static const uint8_t REGISTERS[REGISTER_COUNT];
+
+  struct Stored
+  {
+    uint8_t version;
+    uint8_t mode;
+    uint8_t values[REGISTER_COUNT];
+  };
+
+  Preferences& prefs;
+  int lastLuma = -1;
+  int settledFrames = 0;
+  unsigned long lastSnapshot = 0;
+  bool stored = false;
+  int settleFrames = 0;
+  int settleLuma = -1;
+  int settleCount = 0;
+
+  bool read(OV7670& camera, Stored& profile);
+  void drop(const char* reason);
+};
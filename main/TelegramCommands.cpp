@@ -0,0 +1,242 @@
+#include "TelegramCommands.h"
+#include <time.h>
+#include "Log.h"
+
+static const char* OFFSET_KEY = "tgoffset";
+
+void TelegramCommands::begin(const char* host, uint16_t port, const char* token, const char* chatId)
+{
+  this->host = host;
+  this->port = port;
+  this->token = token;
+  this->chatId = chatId;
+  offset = prefs.getULong(OFFSET_KEY, 0);
+}
+
+void TelegramCommands::stop()
+{
+  client.stop();
+  state = IDLE;
+}
+
+TelegramCommands::Command TelegramCommands::poll(unsigned long now)
+{
+  if(!host)
+    return NONE;
+  if(state == IDLE)
+  {
+    if((long)(now - retryAt) < 0)
+      return NONE;
+    if(!request(now))
+      fail(now, "request failed");
+    return NONE;
+  }
+  if(now - requestMs > POLL_SECONDS * 1000UL + ANSWER_MARGIN)
+  {
+    fail(now, "no answer");
+    return NONE;
+  }
+  //what has arrived, a full answer at most
+  while(client.available() > 0)
+  {
+    if(state == HEADERS)
+    {
+      int c = client.read();
+      if(c < 0)
+        break;
+      if(c == '\r')
+        continue;
+      if(c != '\n')
+      {
+        if(lineLength < sizeof(line) - 1)
+          line[lineLength++] = c;
+        else
+          lineCut = true;
+        continue;
+      }
+      if(lineLength)
+      {
+        line[lineLength] = 0;
+        if(!lineCut)
+          headerLine();
+        lineLength = 0;
+        lineCut = false;
+        continue;
+      }
+      state = BODY;
+      if(contentLength == 0)
+        return answer(now);
+      continue;
+    }
+    uint8_t chunk[128];
+    size_t wanted = sizeof(chunk);
+    if(contentLength >= 0 && (long)wanted > contentLength - bodyRead)
+      wanted = contentLength - bodyRead;
+    int n = client.read(chunk, wanted);
+    if(n <= 0)
+      break;
+    size_t kept = bodyLength + n < BODY_SIZE ? n : BODY_SIZE - 1 - bodyLength;
+    memcpy(body + bodyLength, chunk, kept);
+    bodyLength += kept;
+    bodyRead += n;
+    if(contentLength >= 0 && bodyRead >= contentLength)
+      return answer(now);
+  }
+  if(!client.connected())
+  {
+    //without Content-Length the answer ends with the connection
+    if(state == BODY && contentLength < 0)
+      return answer(now);
+    fail(now, "connection closed");
+  }
+  return NONE;
+}
+
+bool TelegramCommands::request(unsigned long now)
+{
+  if(!client.connected())
+  {
+    client.stop();
+    if(!client.connect(host, port))
+      return false;
+  }
+  char buffer[256];
+  int n = snprintf(buffer, sizeof(buffer),
+                   "GET /bot%s/getUpdates?offset=%lu&limit=1&timeout=%d&allowed_updates=%%5B%%22message%%22%%5D HTTP/1.1\r\n"
+                   "Host: %s\r\nConnection: keep-alive\r\n\r\n",
+                   token, (unsigned long)offset, POLL_SECONDS, host);
+  if(n <= 0 || n >= (int)sizeof(buffer) || client.write((const uint8_t*)buffer, n) != (size_t)n)
+    return false;
+  state = HEADERS;
+  status = 0;
+  contentLength = -1;
+  closeAfter = false;
+  lineLength = 0;
+  lineCut = false;
+  bodyLength = 0;
+  bodyRead = 0;
+  requestMs = now;
+  polls++;
+  return true;
+}
+
+void TelegramCommands::headerLine()
+{
+  if(!status)
+  {
+    //"HTTP/1.1 200 OK"
+    const char* space = strchr(line, ' ');
+    status = space ? atoi(space + 1) : -1;
+    return;
+  }
+  if(!strncasecmp(line, "Content-Length:", 15))
+    contentLength = atol(line + 15);
+  else if(!strncasecmp(line, "Connection:", 11) && strstr(line + 11, "close"))
+    closeAfter = true;
+}
+
+TelegramCommands::Command TelegramCommands::answer(unsigned long now)
+{
+  state = IDLE;
+  body[bodyLength] = 0;
+  if(closeAfter)
+    client.stop();
+  if(status != 200 || !strstr(body, "\"ok\":true"))
+  {
+    fail(now, "negative answer");
+    return NONE;
+  }
+  failuresInRow = 0;
+  const char* id = find(body, "\"update_id\":");
+  if(!id)
+    return NONE;
+  offset = strtoul(id, nullptr, 10) + 1;
+  prefs.putULong(OFFSET_KEY, offset);
+
+  //edited messages, channel posts and the like are not asked for
+  const char* message = find(id, "\"message\":");
+  if(!message)
+    return NONE;
+  const char* chat = find(message, "\"chat\":{");
+  chat = chat ? find(chat, "\"id\":") : nullptr;
+  size_t chatLength = 0;
+  while(chat && (isdigit((unsigned char)chat[chatLength]) || chat[chatLength] == '-'))
+    chatLength++;
+  if(!chat || chatLength != strlen(chatId) || strncmp(chat, chatId, chatLength))
+  {
+    dropped++;
+    return NONE;
+  }
+  //before the NTP sync the age is unknown, the message is taken
+  const char* date = find(message, "\"date\":");
+  time_t clock = time(nullptr);
+  if(date && clock > 1600000000 && (uint32_t)(clock - strtoul(date, nullptr, 10)) > MAX_AGE_S)
+  {
+    dropped++;
+    return NONE;
+  }
+
+  //the JSON escapes '/' as "\/"
+  char text[32] = "";
+  const char* from = find(message, "\"text\":\"");
+  for(size_t i = 0; from && *from && *from != '"' && i < sizeof(text) - 1; from++)
+  {
+    if(*from == '\\' && !*++from)
+      break;
+    text[i++] = *from;
+    text[i] = 0;
+  }
+  commands++;
+  lastCommandMs = now;
+  return parse(text);
+}
+
+void TelegramCommands::fail(unsigned long now, const char* reason)
+{
+  client.stop();
+  state = IDLE;
+  failures++;
+  failuresInRow++;
+  unsigned long wait = RETRY_MIN << (failuresInRow < 6 ? failuresInRow - 1 : 5);
+  if(wait > RETRY_MAX)
+    wait = RETRY_MAX;
+  retryAt = now + wait;
+  LOGW("cmd", "Telegram commands: %s, retry in %lu ms", reason, wait);
+}
+
+const char* TelegramCommands::find(const char* from, const char* key)
+{
+  const char* at = strstr(from, key);
+  return at ? at + strlen(key) : nullptr;
+}
+
+TelegramCommands::Command TelegramCommands::parse(const char* text)
+{
+  static const struct
+  {
+    const char* word;
+    Command command;
+  } COMMANDS[] = {
+    { "snap", SNAP },
+    { "arm", ARM },
+    { "disarm", DISARM },
+    { "status", STATUS },
+    { "stats", STATS },
+    { "help", HELP },
+    { "start", HELP },
+  };
+  if(*text != '/')
+    return UNKNOWN;
+  //"/snap@SomeBot" in groups
+  size_t length = strcspn(text + 1, " @");
+  for(const auto& c : COMMANDS)
+    if(strlen(c.word) == length && !strncmp(text + 1, c.word, length))
+      return c.command;
+  return UNKNOWN;
+}
+
+const char* TelegramCommands::name(Command c)
+{
+  static const char* NAMES[] = { "none", "snap", "arm", "disarm", "status", "stats", "help", "unknown" };
+  return NAMES[c];
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <Arduino.h>
+#include <Client.h>
+#include <Preferences.h>
+
+//Inbound side of the bot: getUpdates long polls on a connection of its own
+//that is kept open between polls. poll() runs every loop pass and never
+//waits: it sends the next request once the previous answer is in and
+//otherwise takes whatever bytes have arrived. Telegram answers a poll as soon
+//as a message comes in, so a command reaches the node one round trip after it
+//was sent; without messages the poll is answered empty after POLL_SECONDS and
+//the next one goes out. Only the connect blocks, for the TLS handshake, which
+//keep-alive makes rare.
+//One update per answer (limit=1), its update_id + 1 is the offset of the next
+//poll and is kept in Preferences, so a command is carried out once even
+//across a reset. Messages from other chats than chatId and messages older
+//than MAX_AGE_S are dropped.
+class TelegramCommands
+{
+  public:
+  enum Command
+  {
+    NONE,
+    SNAP,
+    ARM,
+    DISARM,
+    STATUS,
+    STATS,
+    HELP,
+    UNKNOWN,
+  };
+
+  static const int POLL_SECONDS = 25;
+  //on top of POLL_SECONDS before an answer counts as lost
+  static const unsigned long ANSWER_MARGIN = 10000;
+  //after a failure, doubled per failure in a row
+  static const unsigned long RETRY_MIN = 2000;
+  static const unsigned long RETRY_MAX = 60000;
+  static const uint32_t MAX_AGE_S = 300;
+  //answers are cut here; update_id comes first, so a cut answer still moves the offset
+  static const size_t BODY_SIZE = 1024;
+
+  TelegramCommands(Client& client, Preferences& prefs)
+    :client(client), prefs(prefs)
+  {
+  }
+
+  void begin(const char* host, uint16_t port, const char* token, const char* chatId);
+  //the command that came in, NONE most of the time; may connect, so the
+  //caller skips it while it cannot afford the handshake
+  Command poll(unsigned long now);
+  //drops the connection, the next poll() reconnects
+  void stop();
+
+  static const char* name(Command c);
+
+  unsigned long polls = 0;
+  unsigned long commands = 0;
+  unsigned long dropped = 0;
+  unsigned long failures = 0;
+  //millis() when the answer with the last command was complete
+  unsigned long lastCommandMs = 0;
+
+  private:
+  enum State
+  {
+    IDLE,
+    HEADERS,
+    BODY,
+  };
+
+  Client& client;
+  Preferences& prefs;
+  const char* host = nullptr;
+  uint16_t port = 443;
+  const char* token = nullptr;
+  const char* chatId = nullptr;
+  uint32_t offset = 0;
+
+  State state = IDLE;
+  unsigned long requestMs = 0;
+  unsigned long retryAt = 0;
+  int failuresInRow = 0;
+  int status = 0;
+  long contentLength = -1;
+  bool closeAfter = false;
+  char line[64];
+  size_t lineLength = 0;
+  bool lineCut = false;
+  char body[BODY_SIZE];
+  size_t bodyLength = 0;
+  long bodyRead = 0;
+
+  bool request(unsigned long now);
+  void headerLine();
+  Command answer(unsigned long now);
+  void fail(unsigned long now, const char* reason);
+  static const char* find(const char* from, const char* key);
+  static Command parse(const char* text);
+};
@@ -0,0 +1,164 @@
+#include "TelemetryChannel.h"
+#include <lwip/sockets.h>
+#include <mbedtls/sha1.h>
+#include <mbedtls/base64.h>
+
+static const char* WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+void TelemetryChannel::acceptKey(const char* key, char* out)
+{
+  char joined[64 + 36 + 1];
+  snprintf(joined, sizeof(joined), "%s%s", key, WEBSOCKET_GUID);
+  unsigned char hash[20];
+  mbedtls_sha1_ret((const unsigned char*)joined, strlen(joined), hash);
+  size_t length = 0;
+  mbedtls_base64_encode((unsigned char*)out, 29, &length, hash, sizeof(hash));
+  out[length] = 0;
+}
+
+bool TelemetryChannel::add(WiFiClient& socket)
+{
+  for(Client& c : slots)
+  {
+    if(c.open)
+      continue;
+    c.socket = socket;
+    c.open = true;
+    c.head = 0;
+    c.count = 0;
+    c.dropped = 0;
+    c.outLength = 0;
+    c.outSent = 0;
+    c.skip = 0;
+    return true;
+  }
+  return false;
+}
+
+int TelemetryChannel::clients() const
+{
+  int n = 0;
+  for(const Client& c : slots)
+    n += c.open;
+  return n;
+}
+
+void TelemetryChannel::push(const TelemetryRecord& record)
+{
+  for(Client& c : slots)
+  {
+    if(!c.open)
+      continue;
+    //a full queue loses its oldest sample
+    if(c.count == QUEUE)
+    {
+      c.head = (c.head + 1) % QUEUE;
+      c.count--;
+      c.dropped++;
+    }
+    c.queue[(c.head + c.count) % QUEUE] = record;
+    c.count++;
+  }
+}
+
+void TelemetryChannel::close(Client& c)
+{
+  c.socket.stop();
+  c.open = false;
+}
+
+//browsers send close and pong frames only; anything else is read and dropped.
+//Only what has arrived is read, the rest of a frame is skipped on later passes
+void TelemetryChannel::readControl(Client& c)
+{
+  while(c.open)
+  {
+    //mask key and payload of the last frame
+    while(c.skip > 0 && c.socket.available() > 0)
+    {
+      uint8_t discard[32];
+      int n = c.socket.read(discard, min(c.skip, sizeof(discard)));
+      if(n <= 0)
+        return;
+      c.skip -= n;
+    }
+    if(c.skip > 0 || c.socket.available() < 2)
+      return;
+    uint8_t head[2];
+    c.socket.read(head, 2);
+    size_t length = head[1] & 0x7f;
+    //a close, or a frame too long to be one of ours
+    if((head[0] & 0x0f) == 0x8 || length > 125)
+    {
+      close(c);
+      return;
+    }
+    c.skip = length + ((head[1] & 0x80) ? 4 : 0);
+  }
+}
+
+void TelemetryChannel::buildMessage(Client& c)
+{
+  size_t payload = 4 + c.count * sizeof(TelemetryRecord);
+  uint8_t* p = c.out;
+  *p++ = 0x82;  //final binary frame
+  if(payload < 126)
+    *p++ = payload;
+  else
+  {
+    *p++ = 126;
+    *p++ = payload >> 8;
+    *p++ = payload;
+  }
+  memcpy(p, &c.dropped, 4);
+  p += 4;
+  for(; c.count > 0; c.count--, c.head = (c.head + 1) % QUEUE, p += sizeof(TelemetryRecord))
+    memcpy(p, &c.queue[c.head], sizeof(TelemetryRecord));
+  c.outLength = p - c.out;
+  c.outSent = 0;
+}
+
+//false when the socket is gone
+bool TelemetryChannel::sendPending(Client& c)
+{
+  while(c.outSent < c.outLength)
+  {
+    int n = send(c.socket.fd(), c.out + c.outSent, c.outLength - c.outSent, MSG_DONTWAIT);
+    if(n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    c.outSent += n;
+    bytesSent += n;
+  }
+  return true;
+}
+
+void TelemetryChannel::service()
+{
+  for(Client& c : slots)
+  {
+    if(!c.open)
+      continue;
+    if(!c.socket.connected())
+    {
+      close(c);
+      continue;
+    }
+    readControl(c);
+    if(!c.open)
+      continue;
+    //the previous message first, meanwhile the queue keeps the newest samples
+    if(!sendPending(c))
+    {
+      close(c);
+      continue;
+    }
+    if(c.outSent < c.outLength || !c.count)
+      continue;
+    const TelemetryRecord& oldest = c.queue[c.head];
+    if(c.count < BATCH && millis() - oldest.ms < BATCH_MS)
+      continue;
+    buildMessage(c);
+    if(!sendPending(c))
+      close(c);
+  }
+}
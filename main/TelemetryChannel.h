@@ -0,0 +1,69 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+
+//one radar sample as it goes over the wire, little endian
+struct TelemetryRecord
+{
+  static const uint8_t PRESENCE = 0x01;
+  static const uint8_t LOCKED = 0x02;
+  static const uint8_t CAMERA_PARKED = 0x04;
+  static const uint8_t RECORDING = 0x08;
+  static const uint8_t LIVE_VIEW = 0x10;
+  uint32_t ms;        //millis() of the radar reading
+  int16_t distance;   //cm
+  uint8_t flags;
+  uint8_t people;
+} __attribute__((packed));
+
+//WebSocket push channel for the radar samples. serve() does the upgrade and
+//hands the socket over with add(); from then on every sample is queued per
+//client and service() sends the queue as one binary message once BATCH
+//samples are waiting or the oldest is BATCH_MS old. A message is the number
+//of samples dropped for that client so far (u32), then the samples.
+//Sends never block: a client that does not take its data keeps its unsent
+//message and its queue overwrites the oldest samples, so every client costs
+//the same fixed memory however slow it is.
+class TelemetryChannel
+{
+  public:
+  static const int MAX_CLIENTS = 2;
+  static const int QUEUE = 64;
+  static const int BATCH = 16;
+  static const unsigned long BATCH_MS = 200;
+
+  //false when all slots are taken, the socket is not touched then
+  bool add(WiFiClient& socket);
+  void push(const TelemetryRecord& record);
+  void service();
+
+  int clients() const;
+
+  unsigned long bytesSent = 0;
+
+  //Sec-WebSocket-Accept for the request's key, out holds 29 bytes
+  static void acceptKey(const char* key, char* out);
+
+  private:
+  struct Client
+  {
+    WiFiClient socket;
+    bool open = false;
+    TelemetryRecord queue[QUEUE];
+    int head = 0;
+    int count = 0;
+    uint32_t dropped = 0;
+    //the message being sent, header, dropped count and a full queue at most
+    uint8_t out[4 + 4 + QUEUE * sizeof(TelemetryRecord)];
+    size_t outLength = 0;
+    size_t outSent = 0;
+    //bytes of the current incoming frame still to be dropped
+    size_t skip = 0;
+  };
+  Client slots[MAX_CLIENTS];
+
+  void close(Client& c);
+  void readControl(Client& c);
+  void buildMessage(Client& c);
+  bool sendPending(Client& c);
+};
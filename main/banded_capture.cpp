@@ -0,0 +1,125 @@
+/*
+ * Implementation for OV7670 Camera + HLK LD2420 Radar Sensor
+ * 
+ * This file contains the implementation of methods to capture images using the OV7670 camera,
+ * detect motion with the LD2420 radar sensor, and send alerts/images to Telegram automatically,
+ * mimicking a surveillance camera system.
+ * 
+ * Author: vuvvvv
+ * Repository/Reference: https://github.com/vuvvvv/Cam-Alert-CCTv
+ */
+
+#include "banded_capture.h"
+
+static JpegEncoder encoder;
+
+// one frame, false on a sensor timeout or an overrun; bands and the times add up
+static bool encodeFrame(OV7670* camera, int bandLines, BandSink sink, void* sinkArg, BandedCaptureStats& stats, size_t& heapMin) {
+  int height = camera->yres;
+
+  // the whole frame fits the buffer
+  if (bandLines >= height) {
+    unsigned long t = millis();
+    bool ok = camera->setBand(0, height) && camera->oneFrame();
+    stats.captureMs += millis() - t;
+    if (!ok) return false;
+    if (sink) sink(sinkArg, camera->frame, 0, height);
+    t = millis();
+    ok = encoder.addStripe(camera->frame, height);
+    stats.encodeMs += millis() - t;
+    stats.bands++;
+    return ok;
+  }
+
+  if (!camera->startBandRing(bandLines)) return false;
+  bool ok = true;
+  // only while the bands are still taken; once the encoder gave up the ISR
+  // overruns the bands nobody releases any more
+  bool overrun = false;
+  for (int first = 0, band = 0; first < height && ok; first += bandLines, band++) {
+    int lines = height - first < bandLines ? height - first : bandLines;
+    unsigned long t = millis();
+    const uint8_t* pixels = camera->waitBand(band);
+    stats.captureMs += millis() - t;
+    if (!pixels) {
+      ok = false;
+      overrun = camera->bandOverrun;
+      break;
+    }
+    if (sink) sink(sinkArg, pixels, first, lines);
+    t = millis();
+    ok = encoder.addStripe(pixels, lines);
+    stats.encodeMs += millis() - t;
+    camera->releaseBand();
+    stats.bands++;
+
+    size_t heapNow = ESP.getFreeHeap();
+    if (heapNow < heapMin) heapMin = heapNow;
+  }
+  if (!camera->finishBandRing() && ok) {
+    ok = false;
+    overrun = camera->bandOverrun;
+  }
+  if (overrun) stats.overruns++;
+  return ok;
+}
+
+bool captureBandedJPEG(OV7670* camera, int quality, uint8_t** jpegOut, size_t* jpegSize, BandedCaptureStats* stats,
+                       BandSink sink, void* sinkArg) {
+  if (!camera || !jpegOut || !jpegSize) return false;
+
+  size_t heapStart = ESP.getFreeHeap();
+  size_t heapMin = heapStart;
+  BandedCaptureStats run = {};
+  JpegEncoder::Buffer out = { nullptr, 0, 0 };
+  out.data = (uint8_t*)bufferPool.take(1, BufferPool::LARGE, &out.capacity);
+  if (!out.data) return false;
+
+  camera->verticalFlip(true);
+  bool ok = false;
+  int bandLines = 0;
+  for (int attempt = 1; attempt <= BAND_ATTEMPTS && !ok; attempt++) {
+    bandLines = camera->yres;
+    // a frame larger than the buffer needs two bands of STRIPE_ALIGN lines in it
+    if (camera->maxBandLines() < camera->yres) {
+      bandLines = camera->maxRingLines();
+      bandLines -= bandLines % JpegEncoder::STRIPE_ALIGN;
+    }
+    if (bandLines <= 0) break;
+
+    // YUV goes to the encoder as is, only RGB565 needs a colour conversion
+    JpegEncoder::Input input = JpegEncoder::RGB565;
+    if (camera->pixelFormat == I2SCamera::PIXEL_YUV422) input = JpegEncoder::YUV422;
+    if (camera->pixelFormat == I2SCamera::PIXEL_Y8) input = JpegEncoder::GRAY8;
+    out.size = 0;
+    if (!encoder.begin(camera->xres, camera->yres, quality, JpegEncoder::fixedWriter, &out, input)) break;
+
+    run.frames++;
+    run.bands = 0;
+    int overruns = run.overruns;
+    ok = encodeFrame(camera, bandLines, sink, sinkArg, run, heapMin) && encoder.finish();
+    // a sensor timeout or a full JPEG slot is not retried
+    if (!ok && run.overruns == overruns) break;
+  }
+  camera->verticalFlip(false);
+
+  // back to the largest band the buffer holds, for the regular full frame captures
+  camera->setGeometry(camera->xres, camera->yres, camera->pixelFormat);
+
+  if (stats) {
+    *stats = run;
+    stats->bandLines = bandLines;
+    stats->workingSetBytes = camera->frameCapacity + camera->dmaBufferCount * camera->MAX_XRES * 2 * 2
+                             + sizeof(JpegEncoder) + out.capacity;
+    stats->peakHeapBytes = heapStart - heapMin;
+    stats->jpegBytes = out.size;
+  }
+
+  if (!ok) {
+    bufferPool.give(out.data);
+    return false;
+  }
+  *jpegOut = out.data;
+  *jpegSize = out.size;
+  return true;
+}
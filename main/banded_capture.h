@@ -0,0 +1,52 @@
+/*
+ * Implementation for OV7670 Camera + HLK LD2420 Radar Sensor
+ * 
+ * This file contains the implementation of methods to capture images using the OV7670 camera,
+ * detect motion with the LD2420 radar sensor, and send alerts/images to Telegram automatically,
+ * mimicking a surveillance camera system.
+ * 
+ * Author: vuvvvv
+ * Repository/Reference: https://github.com/vuvvvv/Cam-Alert-CCTv
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "OV7670.h"
+#include "BufferPool.h"
+#include "jpeg_encoder.h"
+
+struct BandedCaptureStats {
+  int bands;
+  int bandLines;
+  int frames;               // frames taken, one more per overrun
+  int overruns;             // frames lost because the encoder fell behind
+  size_t workingSetBytes;   // band buffer + DMA + encoder + JPEG output
+  size_t peakHeapBytes;     // heap actually consumed during the capture
+  unsigned long captureMs;  // waiting for bands
+  unsigned long encodeMs;
+  size_t jpegBytes;
+};
+
+// gets every band before it is encoded, top down: first is the band's top
+// line in the photo and the rows are in photo order (the sensor image flipped
+// vertically). A retried frame starts over with first 0
+typedef void (*BandSink)(void* arg, const uint8_t* pixels, int first, int lines);
+
+// frame buffer bytes a band ring needs for lines of width pixels: two bands
+// of JpegEncoder::STRIPE_ALIGN lines
+constexpr int bandRingBytes(int width) {
+  return width * 2 * JpegEncoder::STRIPE_ALIGN * 2;
+}
+
+// Captures the current camera mode from one frame and encodes it while it
+// arrives. A frame larger than the camera's buffer goes through a band ring
+// (I2SCamera::startBandRing): band k is encoded while the DMA fills band k+1.
+// When the encoder falls behind the frame is retried; after BAND_ATTEMPTS lost
+// frames the capture fails with stats->overruns set, a smaller mode may fit.
+// The sensor reads bottom up during the capture, the photo is flipped
+// vertically like the BMP view. The JPEG is written into a LARGE slot of
+// bufferPool, give jpegOut back there; the capture fails when no slot is free
+// or the JPEG does not fit one.
+const int BAND_ATTEMPTS = 2;
+bool captureBandedJPEG(OV7670* camera, int quality, uint8_t** jpegOut, size_t* jpegSize, BandedCaptureStats* stats = nullptr,
+                       BandSink sink = nullptr, void* sinkArg = nullptr);
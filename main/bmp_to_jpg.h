@@ -13,6 +13,7 @@
 #pragma once
 #include "esp_camera.h"
 #include "img_converters.h"
+#include "Log.h"
 
 // Helper: swap bytes in-place for RGB565 buffer (width*height pixels)
 void swap_rgb565_bytes(uint8_t* buf, size_t len) {
@@ -27,18 +28,19 @@ void swap_rgb565_bytes(uint8_t* buf, size_t len) {
 // -------------------Correcting byte order and flipping image-------------------
 void flipRGB565Vertically(uint8_t* buf, int width, int height) {
     int rowSize = width * 2;
-    uint8_t* rowBuffer = (uint8_t*)malloc(rowSize);
-    if (!rowBuffer) return;
+    // rows are swapped through a small stack chunk, no heap
+    uint8_t chunk[64];
 
     for (int y = 0; y < height / 2; y++) {
         uint8_t* top = buf + y * rowSize;
         uint8_t* bottom = buf + (height - 1 - y) * rowSize;
-        memcpy(rowBuffer, top, rowSize);
-        memcpy(top, bottom, rowSize);
-        memcpy(bottom, rowBuffer, rowSize);
+        for (int x = 0; x < rowSize; x += sizeof(chunk)) {
+            int n = rowSize - x < (int)sizeof(chunk) ? rowSize - x : sizeof(chunk);
+            memcpy(chunk, top + x, n);
+            memcpy(top + x, bottom + x, n);
+            memcpy(bottom + x, chunk, n);
+        }
     }
-
-    free(rowBuffer);
 }
 //------------------------------------------------------------------
 
@@ -71,26 +73,19 @@ bool convertBMPtoJPEG(uint8_t* inputBuf, int width, int height, uint8_t** jpegOu
 
     // First attempt: direct conversion
     bool ok = frame2jpg(&fb, quality, jpegOut, jpegSize);
-    Serial.printf("convertBMPtoJPEG: hasBmpHeader=%d width=%d height=%d rgbLen=%u -> frame2jpg ok=%d\n",
-                  hasBmpHeader, width, height, (unsigned)rgbLen, ok ? 1 : 0);
+    LOGD("jpeg", "convertBMPtoJPEG: hasBmpHeader=%d width=%d height=%d rgbLen=%u -> frame2jpg ok=%d",
+         hasBmpHeader, width, height, (unsigned)rgbLen, ok ? 1 : 0);
 
     if (!ok && trySwap) {
         // try swapping bytes then convert again
-        Serial.println("convertBMPtoJPEG: Attempting to swap byte order and reconvert...");
-        // we must operate on a writable buffer — allocate temp
-        uint8_t* temp = (uint8_t*)malloc(rgbLen);
-        if (!temp) {
-            Serial.println("convertBMPtoJPEG: Failed to allocate memory for timer (malloc)");
-            return false;
-        }
-        memcpy(temp, rgbData, rgbLen);
-        swap_rgb565_bytes(temp, rgbLen);
+        LOGD("jpeg", "convertBMPtoJPEG: Attempting to swap byte order and reconvert...");
+        // swapped in place and back afterwards instead of copying the frame
+        swap_rgb565_bytes(rgbData, rgbLen);
 
-        fb.buf = temp;
         bool ok2 = frame2jpg(&fb, quality, jpegOut, jpegSize);
-        Serial.printf("convertBMPtoJPEG: after swap ok=%d, jpegSize=%u\n", ok2 ? 1 : 0, ok2 ? (unsigned)*jpegSize : 0);
+        LOGD("jpeg", "convertBMPtoJPEG: after swap ok=%d, jpegSize=%u", ok2 ? 1 : 0, ok2 ? (unsigned)*jpegSize : 0);
 
-        free(temp);
+        swap_rgb565_bytes(rgbData, rgbLen);
         return ok2;
     }
 
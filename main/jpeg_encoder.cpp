@@ -0,0 +1,467 @@
+/*
+ * Implementation for OV7670 Camera + HLK LD2420 Radar Sensor
+ *
+ * This file contains the implementation of methods to capture images using the OV7670 camera,
+ * detect motion with the LD2420 radar sensor, and send alerts/images to Telegram automatically,
+ * mimicking a surveillance camera system.
+ *
+ * Author: vuvvvv
+ * Repository/Reference: https://github.com/vuvvvv/Cam-Alert-CCTv
+ */
+
+#include "jpeg_encoder.h"
+#include <stdlib.h>
+#include <string.h>
+
+// ----------------------standard tables (ITU T.81 Annex K)----------------------
+static const uint8_t ZIGZAG[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const uint8_t QUANT_LUMA[64] = {
+  16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+  14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+  18, 22, 37, 56, 68,109,103, 77, 24, 35, 55, 64, 81,104,113, 92,
+  49, 64, 78, 87,103,121,120,101, 72, 92, 95, 98,112,100,103, 99
+};
+
+static const uint8_t QUANT_CHROMA[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const uint8_t DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t DC_VALS[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t AC_LUMA_VALS[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+  0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+  0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+static const uint8_t AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t AC_CHROMA_VALS[162] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+  0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+  0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+//------------------------------------------------------------------------------
+
+bool JpegEncoder::memoryWriter(void* arg, const uint8_t* data, size_t len)
+{
+  Buffer* b = (Buffer*)arg;
+  if (b->size + len > b->capacity) {
+    size_t capacity = b->capacity ? b->capacity : 4096;
+    while (capacity < b->size + len) capacity += capacity / 2;
+    uint8_t* grown = (uint8_t*)realloc(b->data, capacity);
+    if (!grown) return false;
+    b->data = grown;
+    b->capacity = capacity;
+  }
+  memcpy(b->data + b->size, data, len);
+  b->size += len;
+  return true;
+}
+
+bool JpegEncoder::fixedWriter(void* arg, const uint8_t* data, size_t len)
+{
+  Buffer* b = (Buffer*)arg;
+  if (b->size + len > b->capacity) return false;
+  memcpy(b->data + b->size, data, len);
+  b->size += len;
+  return true;
+}
+
+void JpegEncoder::buildHuffTable(HuffTable& t, const uint8_t* bits, const uint8_t* vals)
+{
+  memset(&t, 0, sizeof(t));
+  uint16_t code = 0;
+  int k = 0;
+  for (int len = 1; len <= 16; len++) {
+    for (int i = 0; i < bits[len - 1]; i++) {
+      t.code[vals[k]] = code++;
+      t.size[vals[k]] = len;
+      k++;
+    }
+    code <<= 1;
+  }
+}
+
+bool JpegEncoder::begin(int w, int h, int quality, Writer wr, void* arg, Input in)
+{
+  if (w <= 0 || h <= 0 || w > 65535 || h > 65535 || !wr) return false;
+  width = w;
+  height = h;
+  input = in;
+  mcuSize = input == GRAY8 ? 8 : 16;
+  line = 0;
+  mcuRow = 0;
+  failed = false;
+  written = 0;
+  writer = wr;
+  writerArg = arg;
+  bitBuffer = 0;
+  bitCount = 0;
+  outPos = 0;
+  dcPred[0] = dcPred[1] = dcPred[2] = 0;
+
+  buildHuffTable(dcTable[0], DC_LUMA_BITS, DC_VALS);
+  buildHuffTable(dcTable[1], DC_CHROMA_BITS, DC_VALS);
+  buildHuffTable(acTable[0], AC_LUMA_BITS, AC_LUMA_VALS);
+  buildHuffTable(acTable[1], AC_CHROMA_BITS, AC_CHROMA_VALS);
+
+  writeHeaders(quality);
+  return !failed;
+}
+
+// -------------------------output-------------------------
+void JpegEncoder::flushOut()
+{
+  if (outPos && !failed) {
+    if (!writer(writerArg, out, outPos)) failed = true;
+    written += outPos;
+  }
+  outPos = 0;
+}
+
+void JpegEncoder::put(uint8_t b)
+{
+  out[outPos++] = b;
+  if (outPos == sizeof(out)) flushOut();
+}
+
+void JpegEncoder::putBytes(const uint8_t* data, int len)
+{
+  for (int i = 0; i < len; i++) put(data[i]);
+}
+
+void JpegEncoder::putWord(uint16_t w)
+{
+  put(w >> 8);
+  put(w & 0xff);
+}
+
+void JpegEncoder::putBits(uint32_t bits, int count)
+{
+  bitBuffer = (bitBuffer << count) | (bits & ((1u << count) - 1));
+  bitCount += count;
+  while (bitCount >= 8) {
+    uint8_t b = (bitBuffer >> (bitCount - 8)) & 0xff;
+    put(b);
+    if (b == 0xff) put(0);  // byte stuffing
+    bitCount -= 8;
+  }
+}
+
+void JpegEncoder::flushBits()
+{
+  // pad the last byte with ones
+  if (bitCount > 0) putBits(0x7f, 8 - bitCount);
+  bitBuffer = 0;
+  bitCount = 0;
+}
+//---------------------------------------------------------
+
+void JpegEncoder::writeHeaders(int quality)
+{
+  if (quality < 1) quality = 1;
+  if (quality > 100) quality = 100;
+  int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+  static const float AAN[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+  };
+
+  uint8_t q[2][64];
+  for (int i = 0; i < 64; i++) {
+    int l = (QUANT_LUMA[i] * scale + 50) / 100;
+    int c = (QUANT_CHROMA[i] * scale + 50) / 100;
+    q[0][i] = l < 1 ? 1 : (l > 255 ? 255 : l);
+    q[1][i] = c < 1 ? 1 : (c > 255 ? 255 : c);
+  }
+  for (int t = 0; t < 2; t++)
+    for (int row = 0; row < 8; row++)
+      for (int col = 0; col < 8; col++) {
+        int i = row * 8 + col;
+        fdtbl[t][i] = 1.0f / (q[t][i] * AAN[row] * AAN[col] * 8.0f);
+      }
+
+  static const uint8_t SOI_APP0[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+    0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+  };
+  putBytes(SOI_APP0, sizeof(SOI_APP0));
+
+  int tables = input == GRAY8 ? 1 : 2;
+  int components = input == GRAY8 ? 1 : 3;
+
+  // DQT, tables in zigzag order
+  putWord(0xffdb);
+  putWord(2 + tables * 65);
+  for (int t = 0; t < tables; t++) {
+    put(t);
+    for (int i = 0; i < 64; i++) put(q[t][ZIGZAG[i]]);
+  }
+
+  // SOF0
+  putWord(0xffc0);
+  putWord(8 + components * 3);
+  put(8);
+  putWord(height);
+  putWord(width);
+  put(components);
+  if (components == 1) {
+    put(1); put(0x11); put(0);
+  } else {
+    put(1); put(0x22); put(0);
+    put(2); put(0x11); put(1);
+    put(3); put(0x11); put(1);
+  }
+
+  // DHT
+  const uint8_t* bits[4] = {DC_LUMA_BITS, AC_LUMA_BITS, DC_CHROMA_BITS, AC_CHROMA_BITS};
+  const uint8_t* vals[4] = {DC_VALS, AC_LUMA_VALS, DC_VALS, AC_CHROMA_VALS};
+  const uint8_t ids[4] = {0x00, 0x10, 0x01, 0x11};
+  for (int t = 0; t < tables * 2; t++) {
+    int count = 0;
+    for (int i = 0; i < 16; i++) count += bits[t][i];
+    putWord(0xffc4);
+    putWord(2 + 1 + 16 + count);
+    put(ids[t]);
+    putBytes(bits[t], 16);
+    putBytes(vals[t], count);
+  }
+
+  // DRI, one restart interval per MCU row
+  putWord(0xffdd);
+  putWord(4);
+  putWord((width + mcuSize - 1) / mcuSize);
+
+  // SOS
+  putWord(0xffda);
+  putWord(6 + 2 * components);
+  put(components);
+  put(1); put(0x00);
+  if (components == 3) {
+    put(2); put(0x11);
+    put(3); put(0x11);
+  }
+  put(0); put(63); put(0);
+}
+
+// AAN forward DCT, the scale factors are folded into fdtbl
+void JpegEncoder::fdct(float* d)
+{
+  for (int pass = 0; pass < 2; pass++) {
+    int step = pass ? 8 : 1;
+    int next = pass ? 1 : 8;
+    for (int i = 0; i < 8; i++) {
+      float* p = d + i * next;
+      float tmp0 = p[0 * step] + p[7 * step];
+      float tmp7 = p[0 * step] - p[7 * step];
+      float tmp1 = p[1 * step] + p[6 * step];
+      float tmp6 = p[1 * step] - p[6 * step];
+      float tmp2 = p[2 * step] + p[5 * step];
+      float tmp5 = p[2 * step] - p[5 * step];
+      float tmp3 = p[3 * step] + p[4 * step];
+      float tmp4 = p[3 * step] - p[4 * step];
+
+      float tmp10 = tmp0 + tmp3;
+      float tmp13 = tmp0 - tmp3;
+      float tmp11 = tmp1 + tmp2;
+      float tmp12 = tmp1 - tmp2;
+
+      p[0 * step] = tmp10 + tmp11;
+      p[4 * step] = tmp10 - tmp11;
+
+      float z1 = (tmp12 + tmp13) * 0.707106781f;
+      p[2 * step] = tmp13 + z1;
+      p[6 * step] = tmp13 - z1;
+
+      tmp10 = tmp4 + tmp5;
+      tmp11 = tmp5 + tmp6;
+      tmp12 = tmp6 + tmp7;
+
+      float z5 = (tmp10 - tmp12) * 0.382683433f;
+      float z2 = 0.541196100f * tmp10 + z5;
+      float z4 = 1.306562965f * tmp12 + z5;
+      float z3 = tmp11 * 0.707106781f;
+
+      float z11 = tmp7 + z3;
+      float z13 = tmp7 - z3;
+
+      p[5 * step] = z13 + z2;
+      p[3 * step] = z13 - z2;
+      p[1 * step] = z11 + z4;
+      p[7 * step] = z11 - z4;
+    }
+  }
+}
+
+void JpegEncoder::encodeBlock(float* block, int table, int& pred)
+{
+  fdct(block);
+  const float* f = fdtbl[table];
+  int q[64];
+  for (int i = 0; i < 64; i++) {
+    int n = ZIGZAG[i];
+    float v = block[n] * f[n];
+    q[i] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+  }
+
+  const HuffTable& dc = dcTable[table];
+  const HuffTable& ac = acTable[table];
+
+  int diff = q[0] - pred;
+  pred = q[0];
+  int v = diff < 0 ? -diff : diff;
+  int cat = 0;
+  while (v) { cat++; v >>= 1; }
+  putBits(dc.code[cat], dc.size[cat]);
+  if (cat) putBits(diff < 0 ? diff - 1 : diff, cat);
+
+  int last = 63;
+  while (last > 0 && q[last] == 0) last--;
+  int run = 0;
+  for (int i = 1; i <= last; i++) {
+    if (q[i] == 0) {
+      run++;
+      continue;
+    }
+    while (run >= 16) {
+      putBits(ac.code[0xf0], ac.size[0xf0]);
+      run -= 16;
+    }
+    int a = q[i] < 0 ? -q[i] : q[i];
+    int bits = 0;
+    while (a) { bits++; a >>= 1; }
+    int sym = (run << 4) | bits;
+    putBits(ac.code[sym], ac.size[sym]);
+    putBits(q[i] < 0 ? q[i] - 1 : q[i], bits);
+    run = 0;
+  }
+  if (last < 63) putBits(ac.code[0x00], ac.size[0x00]);
+}
+
+const uint8_t* JpegEncoder::row(const uint8_t* pixels, int lines, int y, bool bottomUp) const
+{
+  if (y >= lines) y = lines - 1;
+  int r = bottomUp ? lines - 1 - y : y;
+  int bytesPerPixel = input == GRAY8 ? 1 : 2;
+  return pixels + (size_t)r * width * bytesPerPixel;
+}
+
+// fills the 4 Y blocks and the Cb/Cr blocks of one 16x16 MCU,
+// edges are padded by repeating the last column/row
+void JpegEncoder::loadMCU(const uint8_t* pixels, int lines, int x0, int y0, bool bottomUp)
+{
+  float* cb = mcu[4];
+  float* cr = mcu[5];
+  for (int i = 0; i < 64; i++) cb[i] = cr[i] = 0;
+
+  for (int dy = 0; dy < 16; dy++) {
+    const uint8_t* src = row(pixels, lines, y0 + dy, bottomUp);
+    float* cbRow = cb + (dy >> 1) * 8;
+    float* crRow = cr + (dy >> 1) * 8;
+    for (int dx = 0; dx < 16; dx++) {
+      int x = x0 + dx;
+      if (x >= width) x = width - 1;
+      float Y, u, v;
+      if (input == YUV422) {
+        // U Y V Y: both pixels of a pair share U and V
+        const uint8_t* pair = src + (x & ~1) * 2;
+        Y = pair[(x & 1) * 2 + 1];
+        u = pair[0] - 128.0f;
+        v = pair[2] - 128.0f;
+      } else {
+        uint16_t p = src[x * 2] | (src[x * 2 + 1] << 8);
+        int r = ((p >> 11) & 0x1f) << 3;
+        int g = ((p >> 5) & 0x3f) << 2;
+        int b = (p & 0x1f) << 3;
+        Y = 0.299f * r + 0.587f * g + 0.114f * b;
+        u = -0.168736f * r - 0.331264f * g + 0.5f * b;
+        v = 0.5f * r - 0.418688f * g - 0.081312f * b;
+      }
+      mcu[(dy >> 3) * 2 + (dx >> 3)][(dy & 7) * 8 + (dx & 7)] = Y - 128.0f;
+      cbRow[dx >> 1] += u;
+      crRow[dx >> 1] += v;
+    }
+  }
+  for (int i = 0; i < 64; i++) {
+    cb[i] *= 0.25f;
+    cr[i] *= 0.25f;
+  }
+}
+
+void JpegEncoder::loadGrayBlock(const uint8_t* pixels, int lines, int x0, int y0, bool bottomUp)
+{
+  for (int dy = 0; dy < 8; dy++) {
+    const uint8_t* src = row(pixels, lines, y0 + dy, bottomUp);
+    for (int dx = 0; dx < 8; dx++) {
+      int x = x0 + dx;
+      if (x >= width) x = width - 1;
+      mcu[0][dy * 8 + dx] = src[x] - 128.0f;
+    }
+  }
+}
+
+bool JpegEncoder::addStripe(const uint8_t* pixels, int lines, bool bottomUp)
+{
+  if (failed || !pixels || lines <= 0 || line + lines > height) return false;
+  if (line + lines < height && lines % STRIPE_ALIGN) return false;
+
+  for (int y0 = 0; y0 < lines; y0 += mcuSize) {
+    if (mcuRow > 0) {
+      flushBits();
+      putWord(0xffd0 | ((mcuRow - 1) & 7));
+      dcPred[0] = dcPred[1] = dcPred[2] = 0;
+    }
+    for (int x0 = 0; x0 < width; x0 += mcuSize) {
+      if (input == GRAY8) {
+        loadGrayBlock(pixels, lines, x0, y0, bottomUp);
+        encodeBlock(mcu[0], 0, dcPred[0]);
+        continue;
+      }
+      loadMCU(pixels, lines, x0, y0, bottomUp);
+      for (int b = 0; b < 4; b++) encodeBlock(mcu[b], 0, dcPred[0]);
+      encodeBlock(mcu[4], 1, dcPred[1]);
+      encodeBlock(mcu[5], 1, dcPred[2]);
+    }
+    mcuRow++;
+  }
+  line += lines;
+  return !failed;
+}
+
+bool JpegEncoder::finish()
+{
+  if (line != height) failed = true;
+  flushBits();
+  putWord(0xffd9);
+  flushOut();
+  return !failed;
+}
@@ -0,0 +1,99 @@
+/*
+ * Implementation for OV7670 Camera + HLK LD2420 Radar Sensor
+ *
+ * This file contains the implementation of methods to capture images using the OV7670 camera,
+ * detect motion with the LD2420 radar sensor, and send alerts/images to Telegram automatically,
+ * mimicking a surveillance camera system.
+ *
+ * Author: vuvvvv
+ * Repository/Reference: https://github.com/vuvvvv/Cam-Alert-CCTv
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Baseline JPEG encoder that is fed the image in horizontal stripes, so the
+// whole frame never has to be in memory. Colour is written 4:2:0, grayscale
+// as a single component, and every MCU row starts a restart interval, which
+// makes each stripe an independent chunk of entropy coded data.
+class JpegEncoder
+{
+  public:
+  typedef bool (*Writer)(void* arg, const uint8_t* data, size_t len);
+
+  // growing heap buffer, use with memoryWriter
+  struct Buffer
+  {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+  };
+  static bool memoryWriter(void* arg, const uint8_t* data, size_t len);
+  // same Buffer, preallocated with its capacity; the encode fails when it is full
+  static bool fixedWriter(void* arg, const uint8_t* data, size_t len);
+
+  static const int STRIPE_ALIGN = 16;
+
+  // pixel layouts as the camera ISR stores them
+  enum Input
+  {
+    RGB565,   // little endian
+    YUV422,   // U Y V Y, used as YCbCr without conversion
+    GRAY8,    // luma only, encoded as one component
+  };
+
+  bool begin(int width, int height, int quality, Writer writer, void* arg, Input input = RGB565);
+  // lines must be a multiple of STRIPE_ALIGN except for the last stripe,
+  // bottomUp reads the stripe rows in reverse order (vertical flip)
+  bool addStripe(const uint8_t* pixels, int lines, bool bottomUp = false);
+  bool finish();
+
+  size_t bytesWritten() const { return written; }
+  int linesDone() const { return line; }
+
+  private:
+  struct HuffTable
+  {
+    uint16_t code[256];
+    uint8_t size[256];
+  };
+
+  int width, height;
+  Input input;
+  int mcuSize;
+  int line;
+  int mcuRow;
+  bool failed;
+  size_t written;
+
+  Writer writer;
+  void* writerArg;
+
+  float fdtbl[2][64];
+  HuffTable dcTable[2];
+  HuffTable acTable[2];
+  int dcPred[3];
+
+  uint32_t bitBuffer;
+  int bitCount;
+  uint8_t out[256];
+  int outPos;
+
+  float mcu[6][64];
+
+  void put(uint8_t b);
+  void putBytes(const uint8_t* data, int len);
+  void putWord(uint16_t w);
+  void flushOut();
+  void putBits(uint32_t bits, int count);
+  void flushBits();
+
+  void writeHeaders(int quality);
+  static void buildHuffTable(HuffTable& t, const uint8_t* bits, const uint8_t* vals);
+  void loadMCU(const uint8_t* pixels, int lines, int x, int y0, bool bottomUp);
+  void loadGrayBlock(const uint8_t* pixels, int lines, int x, int y0, bool bottomUp);
+  const uint8_t* row(const uint8_t* pixels, int lines, int y, bool bottomUp) const;
+  void encodeBlock(float* block, int table, int& pred);
+  static void fdct(float* d);
+};
@@ -13,6 +13,7 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 #include <Preferences.h>
+#include <LittleFS.h>
 #include "OV7670.h"
 #include "BMP.h"
 #include "time.h"
@@ -20,7 +21,26 @@
 #include "send_text.h"
 #include "LD2420.h"
 #include "send_photobmp.h"
+#include "send_media_group.h"
 #include "bmp_to_jpg.h"
+#include "banded_capture.h"
+#include "MotionDetector.h"
+#include "PersonClassifier.h"
+#include "RateController.h"
+#include "AlertSpool.h"
+#include "BufferPool.h"
+#include "SensorProfile.h"
+#include "PowerScheduler.h"
+#include "BootSequence.h"
+#include "ClockTuner.h"
+#include "EventRecorder.h"
+#include "TelemetryChannel.h"
+#include "EgressScheduler.h"
+#include "TelegramCommands.h"
+#include "Log.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
 extern "C" {
 #include "esp_camera.h"
 #include "img_converters.h"
@@ -110,6 +130,8 @@ const int daylightOffset_sec = 0;
 OV7670* camera;
 WiFiServer server(80);
 WiFiClientSecure secureClient;
+// the getUpdates long poll keeps its own connection open next to the uploads
+WiFiClientSecure commandClient;
 unsigned char bmpHeader[BMP::headerSize];
 
 
@@ -118,8 +140,18 @@ int streamPort = 80;
 String streamPath = "/camera";
 
 Preferences prefs;
+SensorProfile sensorProfile(prefs);
+// per mode sensor clocks found by GET /calibrate
+ClockTuner clockTuner(prefs);
+// /snap, /arm, /disarm, /status and /stats from CHAT_ID; disarmed, the radar
+// keeps reporting but raises no alerts
+TelegramCommands telegramCommands(commandClient, prefs);
+static bool alertsArmed = true;
 
 LD2420 ld2420;
+// every radar reading goes to the /telemetry WebSocket clients
+TelemetryChannel telemetry;
+MotionDetector motion;
 
 static int peopleCount = 0;
 static bool lastPresence = false;
@@ -131,6 +163,119 @@ static bool triggerLock = false;
 static unsigned long presenceEndTime = 0;
 const unsigned long clearTimeNeeded = 5000;
 
+// the camera idles at 80x60 and switches up only for the alert photo,
+// YUV422 goes into the JPEG encoder without a colour conversion
+const OV7670::Mode IDLE_MODE = OV7670::Mode::QQQVGA_RGB565;
+const OV7670::Mode ALERT_MODE = OV7670::Mode::VGA_YUV422;
+// used when not even the lowest quality gets a VGA photo out within DELIVERY_TARGET
+const OV7670::Mode FALLBACK_ALERT_MODE = OV7670::Mode::QVGA_YUV422;
+// the /live tile view; fits the frame buffer, so one frame per update
+const OV7670::Mode LIVE_MODE = OV7670::Mode::QQVGA_YUV422;
+const unsigned long DELIVERY_TARGET = 4000;
+RateController rate(DELIVERY_TARGET);
+// photos per alert: 1 sends the text and one photo, more send one album with
+// the text as caption (at most MEDIA_GROUP_MAX). The photos of a burst are
+// taken BURST_SPACING ms apart, one per loop pass, see serviceAlertBurst()
+const int BURST_FRAMES = 3;
+const unsigned long BURST_SPACING = 700;
+// declared up here so the generated prototypes can use them
+struct AlertPlan {
+  OV7670::Mode mode;
+  int quality;
+  size_t predictedBytes;  // per photo
+};
+struct AlertEvent {
+  uint32_t timestamp;
+  int distance;
+  int count;
+};
+// alerts that cannot be delivered go to flash; after a failed send no connect is
+// tried for SEND_BACKOFF ms, the spool then drains DRAIN_BATCH alerts per DRAIN_INTERVAL
+AlertSpool spool;
+const unsigned long SEND_BACKOFF = 30000;
+const unsigned long DRAIN_INTERVAL = 5000;
+const int DRAIN_BATCH = 4;
+// while an alert is locked a frame every RECORD_INTERVAL ms goes to a ring of
+// RECORD_SEGMENTS AVI files on flash, served under /recordings
+EventRecorder recorder;
+const int RECORD_SEGMENTS = 4;
+const size_t RECORD_SEGMENT_BYTES = 128 * 1024;
+const OV7670::Mode RECORD_MODE = OV7670::Mode::QVGA_YUV422;
+const int RECORD_QUALITY = 50;
+const unsigned long RECORD_INTERVAL = 1000;
+static bool recorderReady = false;
+// longest alert text including the terminating zero
+const size_t ALERT_TEXT_SIZE = 160;
+// the burst being taken; the radar, telemetry and the web server keep being
+// served between its photos
+struct AlertBurst {
+  bool active;
+  AlertEvent event;
+  char text[ALERT_TEXT_SIZE];
+  MotionResult seen;
+  AlertPlan plan;
+  int frames;
+  int count;
+  bool person;
+  uint8_t* jpegs[MEDIA_GROUP_MAX];
+  size_t sizes[MEDIA_GROUP_MAX];
+  unsigned long start;
+  unsigned long nextShot;
+};
+static AlertBurst burst;
+static unsigned long telegramRetryAt = 0;
+// boot progress and milestones, see bootStep()
+BootSequence boot;
+static bool cameraSettled = false;
+static bool warmStart = false;
+// parks the camera and light-sleeps between radar reports once nothing happens,
+// see PowerScheduler; POWER_REPORT_INTERVAL ms between duty cycle prints
+const bool LOW_POWER = true;
+const unsigned long POWER_REPORT_INTERVAL = 600000;
+PowerScheduler power;
+// frame buffer size; larger alert modes are captured from one frame through a
+// ring of two bands in the same buffer, which needs FRAME_BUFFER_BYTES at VGA
+const OV7670::Mode FRAME_BUFFER_MODE = OV7670::Mode::QQVGA_RGB565;
+const int FRAME_BUFFER_BYTES = max(OV7670::modeBytes(FRAME_BUFFER_MODE),
+                                   bandRingBytes(OV7670::modeXres(ALERT_MODE)));
+// every alert JPEG is encoded into one of JPEG_SLOTS fixed slots, the quality
+// is lowered until the predicted size fits one
+const size_t JPEG_SLOT_BYTES = 32 * 1024;
+const int JPEG_SLOTS = BURST_FRAMES;
+// reserved once in setup(), after Wi-Fi is up and before the camera. Without
+// PSRAM the JPEG slots come from internal RAM and get fewer when they do not
+// fit next to TLS_RESERVE_BYTES, what both TLS clients need for a handshake
+const size_t TLS_RESERVE_BYTES = 2 * 48 * 1024;
+const BufferPool::Class POOL_CLASSES[] = {
+  { BufferPool::DMA, I2SCamera::MAX_XRES * 2 * 2, 2 },  // I2S line buffers
+  { BufferPool::INTERNAL, (size_t)FRAME_BUFFER_BYTES, 1 },  // frame / band ring
+  { BufferPool::LARGE, JPEG_SLOT_BYTES, JPEG_SLOTS },  // alert and spooled JPEGs
+};
+// written after every sensor reset, and again when a restored profile does not settle
+const RegisterValue CAMERA_TUNING[] = {
+  { 0x13, 0xE7 },  // AWB, AGC, AEC enabled
+  { 0x0E, 0x61 },  // Sleep mode off, enable all
+  { 0x60, 0x50 },  // Brightness
+  { 0x80, 0x50 },  // Contrast
+  { 0x64, 0xF0 },  // Gain
+  { 0x65, 0x00 },
+  { 0x66, 0x00 },
+  { 0x9B, 0x02 },
+  { 0x00, 0xF0 },
+};
+// idle frames checked for exposure/sharpness before an alert photo is taken
+const int PREVIEW_ATTEMPTS = 3;
+// the camera learns the empty scene from an idle frame every MONITOR_INTERVAL ms;
+// a radar trigger needs MOTION_CONFIRM_PERMILLE changed tiles to raise an alert
+const unsigned long MONITOR_INTERVAL = 500;
+const int MOTION_CONFIRM_PERMILLE = 10;
+const bool REQUIRE_VISUAL_CONFIRMATION = true;
+#if PERSON_CLASSIFIER
+// alert photos below this person confidence are not uploaded
+const int PERSON_CONFIDENCE_PERCENT = 60;
+PersonClassifier classifier;
+#endif
+
 // ⚠️ You can change the detection distance, but note that the LD2420 sensor’s maximum range is 8 meters.
 const int MAX_DETECTION_CM = 700; // is cm convert to meters {100cm = 1m} but we used cm 
 //-------------------------------------------------------------------------------------------------------
@@ -143,84 +288,149 @@ unsigned long lastAlertTime = 0;
 
 
 // ---------------- setup ------------------------------------------------------------
+// setup() only starts what does not block; bootStep() brings the rest up from
+// loop() while Wi-Fi associates in the background
 void setup() {
   Serial.begin(115200);
-  delay(1000);
-  Serial.println("\n\n ESP32 Camera Stream Relay");
+  logger.begin(Serial);
+  LOGI("boot", "ESP32 Camera Stream Relay");
 
 
   prefs.begin("camera", false);
   String saved = prefs.getString("streamHost", "");
   if (saved.length() > 0) {
     streamHost = saved;
-    Serial.printf("Loaded streamHost from memory: %s\n", streamHost.c_str());
+    LOGI("boot", "Loaded streamHost from memory: %s", streamHost.c_str());
   } else {
-    Serial.println("No stored streamHost");
+    LOGI("boot", "No stored streamHost");
   }
+  alertsArmed = prefs.getBool("armed", true);
+  if (!alertsArmed) LOGI("boot", "Alerts disarmed");
 
 
-  Serial.printf("Connecting to %s", ssid);
+  LOGI("boot", "Connecting to %s in the background", ssid);
   WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-  }
-
-  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-  Serial.println();
-  Serial.println(WiFi.localIP());
-
-
-  Serial.println("Initializing camera OV7670...");
-  camera = new OV7670(OV7670::Mode::QQVGA_RGB565, SDA_PIN, SCL_PIN,
-                      VSYNC_PIN, HREF_PIN, XCLK_PIN, PCLK_PIN,
-                      D0_PIN, D1_PIN, D2_PIN, D3_PIN, D4_PIN, D5_PIN, D6_PIN, D7_PIN);
-  camera->setRegister(0x13, 0xE7);  // AWB, AGC, AEC enabled
-  camera->setRegister(0x0E, 0x61);  // Sleep mode off, enable all
-  camera->setRegister(0x60, 0x50);  // Brightness
-  camera->setRegister(0x80, 0x50);  // Contrast
-  camera->setRegister(0x64, 0xF0);  // Gain
-  camera->setRegister(0x65, 0x00);
-  camera->setRegister(0x66, 0x00);
-  camera->setRegister(0x9B, 0x02);
-  camera->setRegister(0x00, 0xF0);
-
-
-
+}
+//-----------------------------------------------------------------------------------
 
-  BMP::construct16BitHeader(bmpHeader, camera->xres, camera->yres);
+// ---------------- boot ------------------------------------------------------------
+// one step per loop pass in the order of BootSequence; the network side runs
+// next to it as soon as Wi-Fi is associated: clock, web server and the hello
+void bootStep() {
+  switch (boot.stage()) {
+    case BootSequence::STORAGE:
+      if (LittleFS.begin(true) && spool.begin(LittleFS)) {
+        LOGI("boot", "Alert spool: %d alerts waiting", spool.pending());
+      } else {
+        LOGE("boot", "Alert spool unavailable, undeliverable alerts are lost");
+      }
+      boot.stageDone(millis());
+      break;
+
+    case BootSequence::RADAR:
+      Serial2.begin(115200, SERIAL_8N1, LD2420_RX, LD2420_TX);
+      if (ld2420.begin(Serial2)) {
+        LOGI("boot", "LD2420 initialized successfully");
+        ld2420.setUpdateInterval(10);
+      } else {
+        LOGE("boot", "LD2420 init FAILED check wiring / baud / power");
+      }
+      boot.stageDone(millis());
+      LOGI("boot", "Armed %lu ms after reset", boot.armedMs);
+      break;
 
+    case BootSequence::CAMERA: {
+      if (!bufferPool.begin(POOL_CLASSES, sizeof(POOL_CLASSES) / sizeof(POOL_CLASSES[0]), TLS_RESERVE_BYTES)) {
+        LOGE("boot", "Buffer pool incomplete, some captures will fail");
+      }
+      LogPrint poolLog(LOGLEVEL_INFO, "pool");
+      bufferPool.printStats(poolLog);
+
+      LOGI("boot", "Initializing camera OV7670...");
+      camera = new OV7670(IDLE_MODE, SDA_PIN, SCL_PIN,
+                          VSYNC_PIN, HREF_PIN, XCLK_PIN, PCLK_PIN,
+                          D0_PIN, D1_PIN, D2_PIN, D3_PIN, D4_PIN, D5_PIN, D6_PIN, D7_PIN,
+                          FRAME_BUFFER_MODE, FRAME_BUFFER_BYTES);
+      LOGI("boot", "Sensor configured in %lu us, %d register errors", camera->initMicros, camera->registerErrors);
+      LOGI("boot", "%d calibrated mode clocks restored", clockTuner.restore(*camera));
+      // not read back: the gain is the AGC's once it runs
+      camera->setRegisters(CAMERA_TUNING, sizeof(CAMERA_TUNING) / sizeof(CAMERA_TUNING[0]));
+      BMP::construct16BitHeader(bmpHeader, camera->xres, camera->yres);
+
+      // the exposure and white balance of the last run, so the first alert after a reset is not dark or tinted
+      warmStart = sensorProfile.restore(*camera);
+      boot.stageDone(millis());
+      break;
+    }
 
-  Serial2.begin(115200, SERIAL_8N1, LD2420_RX, LD2420_TX);
+    case BootSequence::CAMERA_SETTLE: {
+      // one frame per pass, the radar keeps being served in between
+      int frames = sensorProfile.settle(*camera);
+      if (frames > 0) {
+        LOGI("boot", "Sensor settled after %d frames (%s)", frames, warmStart ? "profile restored" : "cold start");
+        cameraSettled = true;
+        boot.stageDone(millis());
+      } else if (frames < 0 && warmStart) {
+        // the profile is dropped by now, start over from the cold defaults
+        LOGW("boot", "Sensor did not settle from the restored profile, retrying from the cold defaults");
+        camera->setRegisters(CAMERA_TUNING, sizeof(CAMERA_TUNING) / sizeof(CAMERA_TUNING[0]));
+        warmStart = false;
+      } else if (frames < 0) {
+        // alerts still get photos, but nothing parks the camera or learns the scene
+        LOGE("boot", "Sensor did not settle within %d frames, running unsettled", SensorProfile::MAX_CONVERGE_FRAMES);
+        boot.stageDone(millis());
+      }
+      break;
+    }
 
+    case BootSequence::RECORDER: {
+      // after the radar: the first boot preallocates the segments, which takes a while
+      unsigned long start = millis();
+      recorderReady = recorder.begin(LittleFS, "/rec", RECORD_SEGMENTS, RECORD_SEGMENT_BYTES);
+      LOGI("boot", "Recorder %s in %lu ms", recorderReady ? "ready" : "unavailable", millis() - start);
+      boot.stageDone(millis());
+      break;
+    }
 
-  if (ld2420.begin(Serial2)) {
-    Serial.println("LD2420 initialized successfully");
-    ld2420.setUpdateInterval(10);
-  } else {
-    Serial.println("LD2420 init FAILED check wiring / baud / power");
+    case BootSequence::LOCAL_DONE:
+      break;
   }
 
-  server.begin();
-  Serial.println("Server started on port 80");
-  Serial.println("Open the browser at: http://" + WiFi.localIP().toString());
-  Serial.println("==================================================");
+  if (boot.wifi(WiFi.status() == WL_CONNECTED, millis())) {
+    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+    LOGI("boot", "Wi-Fi connected %lu ms after reset: %s", millis(), WiFi.localIP().toString().c_str());
+  }
 
+  if (boot.startServer()) {
+    server.begin();
+    LOGI("boot", "Server started on port 80");
+    LOGI("boot", "Open the browser at: http://%s", WiFi.localIP().toString().c_str());
+    LOGI("boot", "==================================================");
+  }
 
-  Serial.println("\nconnection to Telegram");
-  delay(2000);
-  bool testResult = sendTextToTelegram(" ESP32 Connected! IP: " + WiFi.localIP().toString());
-  if (testResult) {
-    Serial.println("Telegram connection is working correctly!");
-  } else {
-    Serial.println("Failed to connect to Telegram check the settings");
+  // the hello is the first Telegram request, it also marks the time online
+  if (boot.helloDue(triggerLock) && telegramReachable()) {
+    LOGI("boot", "connection to Telegram");
+    if (sendTextToTelegram((" ESP32 Connected! IP: " + WiFi.localIP().toString()).c_str())) {
+      boot.helloSent(millis());
+      LOGI("boot", "Telegram connection is working correctly! Online %lu ms after reset", boot.onlineMs);
+      commandClient.setCACert(TELEGRAM_CERTIFICATE_ROOT);
+      telegramCommands.begin("api.telegram.org", 443, BOT_TOKEN, CHAT_ID);
+    } else {
+      telegramFailed();
+      LOGE("boot", "Failed to connect to Telegram check the settings");
+    }
   }
 }
 //-----------------------------------------------------------------------------------
 
 //-------------------------------------Loop------------------------------------------
 void loop() {
-  serve();
+  bootStep();
+  if (boot.serverStarted()) serve();
+  if (boot.serverStarted()) serveDownload();
+  if (boot.serverStarted() && !triggerLock) serveLive(LIVE_MODE, IDLE_MODE);
+  if (!boot.armed()) return;
 
 
   ld2420.update();
@@ -236,21 +446,73 @@ void loop() {
 
     unsigned long now = millis();
     if (now - lastAlertTime >= ALERT_INTERVAL) {
-      Serial.printf("Distance (%d cm) exceeded the maximum (%d cm). Empty state enforced.\n", distance, MAX_DETECTION_CM);
+      LOGW("main", "Distance (%d cm) exceeded the maximum (%d cm). Empty state enforced.", distance, MAX_DETECTION_CM);
       lastAlertTime = now;
     }
   }
 
 
+  static unsigned long lastReading = 0;
+  if (ld2420.getLastUpdateTime() != lastReading) {
+    lastReading = ld2420.getLastUpdateTime();
+    uint8_t flags = (presence ? TelemetryRecord::PRESENCE : 0) | (triggerLock ? TelemetryRecord::LOCKED : 0)
+                    | (camera && camera->parked() ? TelemetryRecord::CAMERA_PARKED : 0)
+                    | (recorder.recording() ? TelemetryRecord::RECORDING : 0) | (liveViewing() ? TelemetryRecord::LIVE_VIEW : 0);
+    telemetry.push({ (uint32_t)lastReading, (int16_t)distance, flags, (uint8_t)min(peopleCount, 255) });
+  }
+  // the uplink measured by the uploads sets the budgets of the local viewers
+  egress.setLinkRate(rate.bytesPerSecond());
+  if (egress.admit(EgressScheduler::CONTROL, millis())) {
+    unsigned long telemetrySent = telemetry.bytesSent;
+    telemetry.service();
+    egress.sent(EgressScheduler::CONTROL, telemetry.bytesSent - telemetrySent, millis());
+  }
+
   static unsigned long lastDebugPrint = 0;
   if (millis() - lastDebugPrint > 5000) {
-    Serial.printf("Detected: %s | Distance: %d cm | Lock: %s\n",
-                  presence ? "Yes" : "No",
-                  distance,
-                  triggerLock ? "Locked" : "Open");
+    LOGD("main", "Detected: %s | Distance: %d cm | Lock: %s",
+         presence ? "Yes" : "No",
+         distance,
+         triggerLock ? "Locked" : "Open");
     lastDebugPrint = millis();
   }
 
+  // a command is answered from here, between two radar reads
+  if (!triggerLock && telegramOnline()) {
+    TelegramCommands::Command command = telegramCommands.poll(millis());
+    if (command != TelegramCommands::NONE) handleCommand(command, presence, distance);
+  }
+
+  static unsigned long lastDrain = 0;
+  if (spool.pending() && !triggerLock && telegramOnline() && millis() - lastDrain >= DRAIN_INTERVAL) {
+    egress.alertPending(millis());
+    drainSpool();
+    egress.alertDone(millis());
+    lastDrain = millis();
+  }
+
+  static unsigned long lastMonitor = 0;
+  // radar presence, pending deliveries and open viewer connections keep the
+  // camera and the CPU up
+  bool busy = presence || triggerLock || (spool.pending() && telegramOnline()) || (boot.networkUp() && !boot.online())
+              || liveViewing() || downloading() || telemetry.clients() > 0;
+  if (busy) power.activity(millis());
+  if (presence && camera && camera->parked()) wakeCamera();
+  if (LOW_POWER && cameraSettled && power.shouldPark(millis())) {
+    camera->park();
+    power.parked(millis());
+    LOGI("main", "Camera parked");
+  }
+
+  // the background is learned at the idle mode, not from live view frames
+  if (cameraSettled && !camera->parked() && !presence && !triggerLock && !liveViewing() && millis() - lastMonitor >= MONITOR_INTERVAL) {
+    if (camera->oneFrame()) {
+      motion.update(camera->lastStats());
+      sensorProfile.observe(*camera, camera->lastStats());
+    }
+    lastMonitor = millis();
+  }
+
   if (triggerLock) {
 
 
@@ -258,26 +520,27 @@ void loop() {
 
       if (presenceEndTime == 0) {
         presenceEndTime = millis();
-        Serial.println("Exit complete Starting rearm countdown.");
+        LOGI("main", "Exit complete Starting rearm countdown.");
       }
 
 
-      if (millis() - presenceEndTime >= clearTimeNeeded) {
+      if (millis() - presenceEndTime >= clearTimeNeeded && !burst.active) {
         triggerLock = false;
         presenceEndTime = 0;
-        Serial.println("Camera system rearmed Ready for a new capture.");
+        recorder.close();
+        LOGI("main", "Camera system rearmed Ready for a new capture.");
       }
     } else {
 
       if (presenceEndTime != 0) {
         presenceEndTime = 0;
-        Serial.println("Motion detected again Resetting rearm countdown.");
+        LOGI("main", "Motion detected again Resetting rearm countdown.");
       }
     }
   }
 
 
-  if (presence && !lastPresence && !triggerLock) {
+  if (presence && !lastPresence && !triggerLock && alertsArmed) {
 
 
     if (millis() - lastSend > minInterval) {
@@ -285,58 +548,558 @@ void loop() {
 
       triggerLock = true;
       lastSend = millis();
-      peopleCount++;
       presenceEndTime = 0;
+      // live view and downloads hold off from here until the alert is out
+      egress.alertPending(millis());
 
+      // before the camera is up the alert goes out as text only
+      MotionResult seen = {};
+      bool usable = boot.cameraReady() && capturePreview(seen);
 
-      String alertMessage = String("⚠️ Alert ⚠️\n") + "Motion detected at " + String(distance) + " cm\n" + "Number of people: " + String(peopleCount) + "\n" + "Time: " + getFormattedTime();
+      if (REQUIRE_VISUAL_CONFIRMATION && usable && seen.valid && seen.score < MOTION_CONFIRM_PERMILLE) {
+        LOGI("main", "Radar trigger at %d cm not confirmed by the camera (motion %d). Locked.", distance, seen.score);
+      } else {
+        peopleCount++;
+
+        AlertEvent event = { (uint32_t)time(nullptr), distance, peopleCount };
+        char alertMessage[ALERT_TEXT_SIZE];
+        alertText(alertMessage, event, false);
+
+        LOGI("main", "New person! Distance: %d cm | Count: %d. Locked.", distance, peopleCount);
+        unsigned long alertStart = millis();
+        if (!usable) {
+          if (!sendText(alertMessage)) spoolAlert(event, nullptr, 0);
+          LOGI("main", "Frame not usable, photo skipped");
+        } else if (BURST_FRAMES > 1) {
+          startAlertBurst(event, alertMessage, seen);
+        } else {
+          bool textSent = sendText(alertMessage);
+          sendAlertPhoto(event, seen, textSent);
+        }
+        if (!burst.active) {
+          LOGI("main", "Alert handled in %lu ms", millis() - alertStart);
+          LogPrint poolLog(LOGLEVEL_INFO, "pool");
+          bufferPool.printStats(poolLog);
+        }
+      }
+      // a burst is done when its upload is
+      if (!burst.active) egress.alertDone(millis());
+    } else {
+      LOGI("main", "Person detected, but cooldown period has not ended yet.");
+    }
+  }
 
-      Serial.printf("New person! Distance: %d cm | Count: %d. Locked.\n", distance, peopleCount);
-      sendTextToTelegram(alertMessage);
+  if (burst.active) serviceAlertBurst();
 
+  static unsigned long lastRecord = 0;
+  if (triggerLock && recorderReady && !burst.active && !camera->parked() && millis() - lastRecord >= RECORD_INTERVAL) {
+    recordFrame(distance);
+    lastRecord = millis();
+  }
 
-      camera->oneFrame();
+  lastPresence = presence;
 
+  static unsigned long lastPowerReport = 0;
+  if (millis() - lastPowerReport >= POWER_REPORT_INTERVAL) {
+    LOGI("power", "Power: cpu %d.%d%% | camera %d.%d%% | %d wakes, last %lu ms, max %lu ms to a frame, %d timeouts",
+         power.cpuDutyPermille(millis()) / 10, power.cpuDutyPermille(millis()) % 10,
+         power.cameraDutyPermille(millis()) / 10, power.cameraDutyPermille(millis()) % 10,
+         power.wakes, power.lastWakeToFrameMs, power.maxWakeToFrameMs, power.wakeTimeouts);
+    LOGI("power", "Egress: alert %lu | control %lu, %lu deferred | bulk %lu, %lu deferred | last alert %lu ms, max %lu ms",
+         egress.bytes[EgressScheduler::ALERT], egress.bytes[EgressScheduler::CONTROL], egress.deferred[EgressScheduler::CONTROL],
+         egress.bytes[EgressScheduler::BULK], egress.deferred[EgressScheduler::BULK], egress.lastAlertMs, egress.maxAlertMs);
+    lastPowerReport = millis();
+  }
 
-      if (camera->frame == nullptr || camera->xres == 0 || camera->yres == 0) {
-        Serial.println("Failed to capture image: Invalid data");
-      } else {
+  // a parked camera does not make the node idle: with the CPU in light sleep
+  // Wi-Fi only runs in modem sleep and wakes for the DTIM beacons, so an open
+  // WebSocket or live view would stall for hundreds of ms per slice
+  unsigned long budget = LOW_POWER && !busy ? power.sleepBudget() : 0;
+  if (budget) {
+    lightSleep(budget);
+  } else {
+    delay(20);
+  }
+}
+//------------------------------------------------------------------------------------------------------------
 
-        flipRGB565Vertically(camera->frame, camera->xres, camera->yres);
-        swap_rgb565_bytes(camera->frame, camera->xres * camera->yres * 2);
+// ---------------------------power------------------------------------------------
+// the camera comes back within PowerScheduler::WAKE_TIMEOUT_MS: clock on, then
+// frames until the exposure gives a usable one
+bool wakeCamera() {
+  power.activity(millis());
+  if (!camera || !camera->parked()) return true;
+  camera->unpark();
+  power.waking(millis());
+  bool usable = false;
+  while (!usable && !power.wakeExpired(millis())) {
+    usable = camera->oneFrame() && camera->lastStats().usable();
+  }
+  power.frameReady(millis(), usable);
+  LOGI("camera", "Camera woken, %s frame after %lu ms", usable ? "usable" : "no usable", power.lastWakeToFrameMs);
+  return usable;
+}
 
+// ---------------------------clock calibration-------------------------------------
+// the modes the node runs in, the loop (and with it the radar) waits until done,
+// so the sweep only runs while alerts are disarmed
+bool calibrateCamera(Print& out) {
+  if (alertsArmed) {
+    out.print("Alerts are armed, send /disarm first: the radar is not read during the sweep\n");
+    return false;
+  }
+  if (!cameraSettled || triggerLock) {
+    out.print("Camera busy, try again later\n");
+    return false;
+  }
+  wakeCamera();
+  const OV7670::Mode modes[] = { IDLE_MODE, FALLBACK_ALERT_MODE, ALERT_MODE };
+  for (OV7670::Mode m : modes) {
+    bool stored = clockTuner.tune(*camera, m, out);
+    LOGI("camera", "Clock calibration mode %d: %s", (int)m, stored ? "stored" : "default kept");
+  }
+  camera->setMode(IDLE_MODE);
+  power.activity(millis());
+  return true;
+}
+//--------------------------------------------------------------------------------
+
+// the radar UART RX line wakes the CPU early: the start bit of its next report
+// is lost, the report after it is read normally
+void lightSleep(unsigned long ms) {
+  Serial.flush();
+  gpio_wakeup_enable((gpio_num_t)LD2420_RX, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(ms * 1000ULL);
+  int64_t start = esp_timer_get_time();
+  esp_light_sleep_start();
+  power.slept((unsigned long)((esp_timer_get_time() - start) / 1000));
+  gpio_wakeup_disable((gpio_num_t)LD2420_RX);
+}
+//--------------------------------------------------------------------------------
 
-        uint8_t* jpegData = nullptr;
-        size_t jpegSize = 0;
+// -----------------get time------------------------------------------
+// alerts keep their own timestamp, a spooled one is formatted long after it happened
+void formatTime(char* out, size_t size, time_t when) {
+  struct tm timeinfo;
+  // before the NTP sync the clock counts from 1970
+  if (when < 1600000000 || !localtime_r(&when, &timeinfo)) {
+    snprintf(out, size, "Time unavailable");
+    return;
+  }
+  strftime(out, size, "%Y-%m-%d %H:%M:%S", &timeinfo);
+}
+//--------------------------------------------------------------------
+
+// ---------------------------alert text---------------------------------------------
+// out holds ALERT_TEXT_SIZE bytes; formatted in place, an alert does not touch the heap
+void alertText(char* out, const AlertEvent& event, bool delayed) {
+  char when[30];
+  formatTime(when, sizeof(when), event.timestamp);
+  snprintf(out, ALERT_TEXT_SIZE, "%s\nMotion detected at %d cm\nNumber of people: %d\nTime: %s",
+           delayed ? "⚠️ Alert (delivered late) ⚠️" : "⚠️ Alert ⚠️", event.distance, event.count, when);
+}
+//--------------------------------------------------------------------------------
 
-        if (convertBMPtoJPEG(camera->frame, camera->xres, camera->yres, &jpegData, &jpegSize, 80, false)) {
-          bool sent = sendPhotoToTelegram(jpegData, jpegSize);
-          Serial.println(sent ? "Sent image" : "Failed to send");
+// ---------------------------offline spool------------------------------------------
+// no connect attempts without Wi-Fi or shortly after a failed send, each one blocks the loop
+bool telegramReachable() {
+  return WiFi.status() == WL_CONNECTED && (long)(millis() - telegramRetryAt) >= 0;
+}
 
-          free(jpegData);
-        } else {
-          Serial.println("Failed to convert image to JPEG");
-        }
+// alerts go to the spool until the hello got through, see BootSequence
+bool telegramOnline() {
+  return boot.online() && telegramReachable();
+}
+
+void telegramFailed() {
+  telegramRetryAt = millis() + SEND_BACKOFF;
+}
+
+bool sendText(const char* text) {
+  if (!telegramOnline()) return false;
+  if (sendTextToTelegram(text)) return true;
+  telegramFailed();
+  return false;
+}
+
+void spoolAlert(const AlertEvent& event, const uint8_t* jpeg, size_t size) {
+  if (spool.append(event.timestamp, event.distance, event.count, jpeg, size)) {
+    LOGI("spool", "Alert spooled (%u bytes photo), %d waiting", (unsigned)size, spool.pending());
+  } else {
+    LOGE("spool", "Alert spool write failed, alert lost");
+  }
+}
+
+// one batch is one request, so it is committed or rolled back as a whole and
+// a failed send never repeats an alert that went out: a run of photos as one
+// album with their alert texts as captions, a single photo with its caption,
+// or a run of alerts without photo as one message
+void drainSpool() {
+  static char captions[DRAIN_BATCH][ALERT_TEXT_SIZE];
+  static char texts[DRAIN_BATCH * (ALERT_TEXT_SIZE + 2)];
+  const char* captionList[DRAIN_BATCH];
+  SpoolRecord records[DRAIN_BATCH];
+  uint8_t* jpegs[DRAIN_BATCH];
+  size_t sizes[DRAIN_BATCH];
+  size_t textLength = 0;
+  size_t bytes = 0;
+
+  int count = spool.takeBatch(records, jpegs, DRAIN_BATCH);
+  if (!count) {
+    // nothing readable, or no heap for the photo right now
+    spool.rollback();
+    return;
+  }
+  bool photos = records[0].jpegSize != 0;
+  for (int i = 0; i < count; i++) {
+    AlertEvent event = { records[i].timestamp, records[i].distance, records[i].count };
+    if (photos) {
+      alertText(captions[i], event, true);
+      captionList[i] = captions[i];
+      sizes[i] = records[i].jpegSize;
+      bytes += sizes[i];
+    } else {
+      char text[ALERT_TEXT_SIZE];
+      alertText(text, event, true);
+      textLength += snprintf(texts + textLength, sizeof(texts) - textLength, "%s%s", textLength ? "\n\n" : "", text);
+    }
+  }
+
+  unsigned long start = millis();
+  UploadTiming timing;
+  bool ok;
+  if (!photos) {
+    ok = sendTextToTelegram(texts);
+  } else if (count >= MEDIA_GROUP_MIN) {
+    ok = sendMediaGroupToTelegram(captionList, jpegs, sizes, count, &timing);
+  } else {
+    ok = sendPhotoToTelegram(jpegs[0], sizes[0], &timing, captions[0]);
+  }
+
+  if (ok) {
+    spool.commit();
+    if (photos) rate.addUpload(bytes, timing.connectMs, timing.transferMs);
+    LOGI("spool", "Spool: delivered %d alerts (%u bytes) in %lu ms, %d waiting, %d evicted",
+         count, (unsigned)bytes, millis() - start, spool.pending(), spool.evicted());
+  } else {
+    spool.rollback();
+    telegramFailed();
+    LOGE("spool", "Spool: delivery failed, retrying later");
+  }
+  if (photos) {
+    for (int i = 0; i < count; i++) bufferPool.give(jpegs[i]);
+  }
+}
+//--------------------------------------------------------------------------------
+
+// ---------------------------preview frame----------------------------------------
+// the idle frame statistics are checked first, so dark, washed out or blocked
+// frames are dropped before paying for the capture, the encode and the upload;
+// the same frame is scored against the learned background
+bool capturePreview(MotionResult& seen) {
+  // a live view may have left the camera in its mode
+  camera->setMode(IDLE_MODE);
+  bool usable = false;
+  for (int attempt = 0; attempt < PREVIEW_ATTEMPTS && !usable; attempt++) {
+    usable = camera->oneFrame() && camera->lastStats().usable();
+  }
+  const FrameStats& preview = camera->lastStats();
+  seen = motion.evaluate(preview);
+  LOGI("alert", "Preview: luma %d | clipped %d%% | sharpness %d | motion %d (%d,%d)-(%d,%d)",
+       preview.meanLuma(), preview.clippedPercent(), preview.sharpness(),
+       seen.score, seen.x0, seen.y0, seen.x1, seen.y1);
+  return usable;
+}
+//--------------------------------------------------------------------------------
+
+// ---------------------------alert photo------------------------------------------
+// quality and resolution for the photos of one upload come from the preview
+// statistics and the measured uplink; switches the camera to the chosen mode
+AlertPlan planAlertPhotos(int frames) {
+  const FrameStats& preview = camera->lastStats();
+  AlertPlan plan = { ALERT_MODE, 0, 0 };
+  // the photos of a burst are predicted as one frame that many times as high
+  plan.quality = rate.chooseQuality(preview, OV7670::modeXres(plan.mode), OV7670::modeYres(plan.mode) * frames);
+  if (!plan.quality) {
+    plan.mode = FALLBACK_ALERT_MODE;
+    plan.quality = rate.chooseQuality(preview, OV7670::modeXres(plan.mode), OV7670::modeYres(plan.mode) * frames);
+    if (!plan.quality) plan.quality = RateController::MIN_QUALITY;
+  }
+  plan.predictedBytes = rate.predictBytes(preview, OV7670::modeXres(plan.mode), OV7670::modeYres(plan.mode), plan.quality);
+  // a photo larger than its pool slot fails the encode
+  while (plan.quality > RateController::MIN_QUALITY && plan.predictedBytes > JPEG_SLOT_BYTES * 9 / 10) {
+    plan.quality -= RateController::QUALITY_STEP;
+    plan.predictedBytes = rate.predictBytes(preview, OV7670::modeXres(plan.mode), OV7670::modeYres(plan.mode), plan.quality);
+  }
+  LOGI("alert", "Uplink %lu B/s, connect %lu ms: %d x quality %d, predicted %u bytes in %lu ms",
+       rate.bytesPerSecond(), rate.connectMs(), frames, plan.quality,
+       (unsigned)(plan.predictedBytes * frames), rate.predictMs(plan.predictedBytes * frames));
+
+  if (camera->setMode(plan.mode)) {
+    LOGI("alert", "Camera switched to %dx%d in %lu us", camera->xres, camera->yres, camera->modeSwitchMicros);
+  } else {
+    LOGE("alert", "Camera mode switch failed, capturing at idle resolution");
+  }
+  return plan;
+}
+
+// one photo at the planned mode, or at FALLBACK_ALERT_MODE when the encoder
+// cannot keep up with the sensor at it; person turns false when the classifier
+// is built in and sees nobody
+bool captureAlertPhoto(const AlertPlan& plan, const MotionResult& seen, uint8_t** jpegData, size_t* jpegSize, bool* person) {
+  BandedCaptureStats captureStats = {};
+  BandSink sink = nullptr;
+  void* sinkArg = nullptr;
+  *person = true;
+
+  bool captured = false;
+  for (int pass = 0; pass < 2 && !captured; pass++) {
+    if (pass) {
+      if (!captureStats.overruns || camera->currentMode() == FALLBACK_ALERT_MODE || !camera->setMode(FALLBACK_ALERT_MODE)) break;
+      LOGW("alert", "Encoder overran the band ring %d times, retrying at %dx%d", captureStats.overruns, camera->xres, camera->yres);
+    }
+#if PERSON_CLASSIFIER
+    // square around the changed tiles of the preview, the whole frame height without
+    // motion; the preview is in sensor orientation, the crop in photo orientation
+    int scale = camera->xres / OV7670::modeXres(IDLE_MODE);
+    int size = camera->yres;
+    int cx = camera->xres / 2;
+    int cy = camera->yres / 2;
+    if (seen.x1 > seen.x0) {
+      size = max(seen.x1 - seen.x0, seen.y1 - seen.y0) * scale * 5 / 4;
+      size = max(size, (int)PersonClassifier::INPUT_SIZE);
+      cx = (seen.x0 + seen.x1) * scale / 2;
+      cy = camera->yres - (seen.y0 + seen.y1) * scale / 2;
+    }
+    classifier.beginCrop(cx - size / 2, cy - size / 2, size, camera->xres, camera->yres, camera->pixelFormat);
+    sink = PersonClassifier::bandSink;
+    sinkArg = &classifier;
+#endif
+    captured = captureBandedJPEG(camera, plan.quality, jpegData, jpegSize, &captureStats, sink, sinkArg);
+  }
+  if (!captured) {
+    LOGE("alert", "Failed to capture image: camera timeout, encoder overrun or out of memory");
+    return false;
+  }
+  LOGI("alert", "Captured %dx%d from %d frames in %d bands of %d lines: capture %lu ms, encode %lu ms, %u bytes, working set %u bytes, peak heap %u bytes",
+       camera->xres, camera->yres, captureStats.frames, captureStats.bands, captureStats.bandLines,
+       captureStats.captureMs, captureStats.encodeMs, (unsigned)captureStats.jpegBytes,
+       (unsigned)captureStats.workingSetBytes, (unsigned)captureStats.peakHeapBytes);
+  if (camera->xres == OV7670::modeXres(plan.mode)) rate.addEncode(plan.predictedBytes, *jpegSize);
+
+#if PERSON_CLASSIFIER
+  int confidence = classifier.classify();
+  LOGI("alert", "Person confidence %d%% in %lu us", confidence, classifier.lastMicros);
+  *person = confidence < 0 || confidence >= PERSON_CONFIDENCE_PERCENT;
+#endif
+  return true;
+}
+
+void reportUpload(size_t bytes, const UploadTiming& timing) {
+  LOGI("alert", "Sent %u bytes: delivered in %lu ms, target %lu ms",
+       (unsigned)bytes, timing.connectMs + timing.transferMs, rate.targetMs);
+  rate.addUpload(bytes, timing.connectMs, timing.transferMs);
+}
+
+// textSent tells whether the alert text already went out; whatever could not be
+// delivered is spooled as one record
+void sendAlertPhoto(const AlertEvent& event, const MotionResult& seen, bool textSent) {
+  AlertPlan plan = planAlertPhotos(1);
+  uint8_t* jpegData = nullptr;
+  size_t jpegSize = 0;
+  bool person;
+  bool spooled = false;
+
+  if (captureAlertPhoto(plan, seen, &jpegData, &jpegSize, &person)) {
+    camera->setMode(IDLE_MODE);
+    if (person) {
+      UploadTiming timing;
+      if (telegramOnline() && sendPhotoToTelegram(jpegData, jpegSize, &timing)) {
+        reportUpload(jpegSize, timing);
+      } else {
+        LOGE("alert", "Failed to send");
+        if (telegramOnline()) telegramFailed();
+        spoolAlert(event, jpegData, jpegSize);
+        spooled = true;
       }
     } else {
-      Serial.println("Person detected, but cooldown period has not ended yet.");
+      LOGI("alert", "No person in the photo, upload skipped");
     }
+    bufferPool.give(jpegData);
+  } else {
+    camera->setMode(IDLE_MODE);
   }
 
-  lastPresence = presence;
+  if (!textSent && !spooled) spoolAlert(event, nullptr, 0);
+}
+//--------------------------------------------------------------------------------
+
+// ---------------------------commands---------------------------------------------
+// every command gets its answer before the loop goes on; the reply is one
+// upload, so command to reply is one poll round trip plus that upload
+void handleCommand(TelegramCommands::Command command, bool presence, int distance) {
+  char reply[320];
+  LOGI("cmd", "Command /%s", TelegramCommands::name(command));
+  power.activity(millis());
+
+  switch (command) {
+    case TelegramCommands::SNAP: {
+      if (!cameraSettled || !wakeCamera() || !camera->oneFrame()) {
+        sendText("Camera not ready");
+        break;
+      }
+      AlertPlan plan = planAlertPhotos(1);
+      uint8_t* jpegData = nullptr;
+      size_t jpegSize = 0;
+      bool person;
+      bool captured = captureAlertPhoto(plan, MotionResult(), &jpegData, &jpegSize, &person);
+      camera->setMode(IDLE_MODE);
+      if (!captured) {
+        sendText("Capture failed");
+        break;
+      }
+      UploadTiming timing;
+      if (sendPhotoToTelegram(jpegData, jpegSize, &timing)) {
+        reportUpload(jpegSize, timing);
+      } else {
+        telegramFailed();
+      }
+      bufferPool.give(jpegData);
+      break;
+    }
 
-  delay(20);
+    case TelegramCommands::ARM:
+    case TelegramCommands::DISARM:
+      alertsArmed = command == TelegramCommands::ARM;
+      prefs.putBool("armed", alertsArmed);
+      sendText(alertsArmed ? "Alerts armed" : "Alerts disarmed, the radar keeps watching");
+      break;
+
+    case TelegramCommands::STATUS: {
+      char when[30];
+      formatTime(when, sizeof(when), time(nullptr));
+      snprintf(reply, sizeof(reply), "%s\nPresence: %s, %d cm\nPeople counted: %d\nCamera: %s\nSpool: %d waiting\nUptime: %lu s\nIP: %s\nTime: %s",
+               alertsArmed ? "Armed" : "Disarmed", presence ? "yes" : "no", distance, peopleCount,
+               !boot.cameraReady() ? "not ready" : camera->parked() ? "parked" : "running", spool.pending(),
+               millis() / 1000, WiFi.localIP().toString().c_str(), when);
+      sendText(reply);
+      break;
+    }
+
+    case TelegramCommands::STATS:
+      snprintf(reply, sizeof(reply), "Uplink %lu B/s, connect %lu ms\nCPU %d.%d%%, camera %d.%d%%, %d wakes\n"
+                                     "Egress: alert %lu B, bulk %lu B, %lu deferred\nCommands: %lu polls, %lu commands, %lu dropped, %lu failures\n"
+                                     "Spool: %d waiting, %d evicted",
+               rate.bytesPerSecond(), rate.connectMs(),
+               power.cpuDutyPermille(millis()) / 10, power.cpuDutyPermille(millis()) % 10,
+               power.cameraDutyPermille(millis()) / 10, power.cameraDutyPermille(millis()) % 10, power.wakes,
+               egress.bytes[EgressScheduler::ALERT], egress.bytes[EgressScheduler::BULK], egress.deferred[EgressScheduler::BULK],
+               telegramCommands.polls, telegramCommands.commands, telegramCommands.dropped, telegramCommands.failures,
+               spool.pending(), spool.evicted());
+      sendText(reply);
+      break;
+
+    default:
+      sendText("Commands: /snap /arm /disarm /status /stats");
+      break;
+  }
+  LOGI("cmd", "Command answered %lu ms after it arrived", millis() - telegramCommands.lastCommandMs);
+}
+//--------------------------------------------------------------------------------
+
+// ---------------------------recording--------------------------------------------
+void recordFrame(int distance) {
+  uint8_t* jpeg = nullptr;
+  size_t size = 0;
+  if (camera->setMode(RECORD_MODE) && captureBandedJPEG(camera, RECORD_QUALITY, &jpeg, &size)) {
+    if (!recorder.addFrame(jpeg, size, camera->xres, camera->yres, distance, (uint32_t)time(nullptr))) {
+      LOGE("recorder", "Recorder write failed");
+    }
+    bufferPool.give(jpeg);
+  }
+  camera->setMode(IDLE_MODE);
+}
+//--------------------------------------------------------------------------------
+
+// ---------------------------alert burst------------------------------------------
+// the camera stays in the planned mode until the last photo; the first one is
+// taken on the pass that raised the alert
+void startAlertBurst(const AlertEvent& event, const char* alertMessage, const MotionResult& seen) {
+  burst.frames = min(BURST_FRAMES, MEDIA_GROUP_MAX);
+  burst.plan = planAlertPhotos(burst.frames);
+  burst.event = event;
+  snprintf(burst.text, sizeof(burst.text), "%s", alertMessage);
+  burst.seen = seen;
+  burst.count = 0;
+  burst.person = false;
+  burst.start = millis();
+  burst.nextShot = burst.start;
+  burst.active = true;
+  serviceAlertBurst();
 }
-//------------------------------------------------------------------------------------------------------------
 
-// -----------------get time------------------------------------------
-String getFormattedTime() {
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    return "Time unavailable";
+// one photo per call once it is due; after the last one, or a failed capture,
+// the burst is uploaded
+void serviceAlertBurst() {
+  if (burst.count < burst.frames) {
+    if ((long)(millis() - burst.nextShot) < 0) return;
+    burst.nextShot += BURST_SPACING;
+    bool framePerson;
+    if (captureAlertPhoto(burst.plan, burst.seen, &burst.jpegs[burst.count], &burst.sizes[burst.count], &framePerson)) {
+      burst.person = burst.person || framePerson;
+      burst.count++;
+      if (burst.count < burst.frames) return;
+    }
   }
-  char buffer[30];
-  strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
-  return String(buffer);
+  camera->setMode(IDLE_MODE);
+  sendAlertBurst();
+  for (int i = 0; i < burst.count; i++) bufferPool.give(burst.jpegs[i]);
+  burst.active = false;
+  egress.alertDone(millis());
+  LOGI("main", "Alert burst of %d photos handled in %lu ms", burst.count, millis() - burst.start);
+  LogPrint poolLog(LOGLEVEL_INFO, "pool");
+  bufferPool.printStats(poolLog);
 }
-//--------------------------------------------------------------------
+
+// the text and the photos share one sendMediaGroup request; the text goes out on
+// its own when there are not enough photos for an album or nobody is in them.
+// An alert that cannot be delivered is spooled with its first photo
+void sendAlertBurst() {
+  const AlertEvent& event = burst.event;
+  uint8_t** jpegs = burst.jpegs;
+  size_t* sizes = burst.sizes;
+  int count = burst.count;
+  bool person = burst.person;
+  size_t total = 0;
+  for (int i = 0; i < count; i++) total += sizes[i];
+
+  UploadTiming timing;
+  const char* captions[MEDIA_GROUP_MAX] = { burst.text };
+  if (!telegramOnline()) {
+    spoolAlert(event, count && person ? jpegs[0] : nullptr, count && person ? sizes[0] : 0);
+  } else if (count >= MEDIA_GROUP_MIN && person) {
+    if (sendMediaGroupToTelegram(captions, jpegs, sizes, count, &timing)) {
+      reportUpload(total, timing);
+    } else {
+      LOGE("alert", "Failed to send the album");
+      telegramFailed();
+      spoolAlert(event, jpegs[0], sizes[0]);
+    }
+  } else {
+    bool textSent = sendText(burst.text);
+    if (count && person) {
+      if (telegramOnline() && sendPhotoToTelegram(jpegs[0], sizes[0], &timing)) {
+        reportUpload(sizes[0], timing);
+        if (!textSent) spoolAlert(event, nullptr, 0);
+      } else {
+        if (telegramOnline()) telegramFailed();
+        spoolAlert(event, jpegs[0], sizes[0]);
+      }
+    } else {
+      if (count) LOGI("alert", "No person in the photos, upload skipped");
+      if (!textSent) spoolAlert(event, nullptr, 0);
+    }
+  }
+}
+//--------------------------------------------------------------------------------
@@ -0,0 +1,79 @@
+/*
+ * Implementation for OV7670 Camera + HLK LD2420 Radar Sensor
+ * 
+ * This file contains the implementation of methods to capture images using the OV7670 camera,
+ * detect motion with the LD2420 radar sensor, and send alerts/images to Telegram automatically,
+ * mimicking a surveillance camera system.
+ * 
+ * Author: vuvvvv
+ * Repository/Reference: https://github.com/vuvvvv/Cam-Alert-CCTv
+ */
+
+
+#include "send_media_group.h"
+
+#define MEDIA_BOUNDARY "----CamAlertMediaGroup"
+static const char MEDIA_TAIL[] = "\r\n--" MEDIA_BOUNDARY "--\r\n";
+
+// "\r\n" ending the content before it, then the part header of photo i
+static size_t photoPartHeader(char* out, size_t size, int i) {
+  char name[12];
+  char filename[16];
+  snprintf(name, sizeof(name), "photo%d", i);
+  snprintf(filename, sizeof(filename), "photo%d.jpg", i);
+  out[0] = '\r';
+  out[1] = '\n';
+  return 2 + RequestBuffer::formatPartHeader(out + 2, size - 2, MEDIA_BOUNDARY, name, filename, "image/jpeg");
+}
+
+// ----------------Sending an album to Telegram----------------
+bool sendMediaGroupToTelegram(const char* const* captions, uint8_t* const* jpegs, const size_t* sizes, int count, UploadTiming* timing) {
+  if (count < MEDIA_GROUP_MIN || count > MEDIA_GROUP_MAX) return false;
+
+  // the album refers to the file parts by name
+  telegramRequest.clear();
+  telegramRequest.addPartHeader(MEDIA_BOUNDARY, "chat_id");
+  telegramRequest.add(CHAT_ID);
+  telegramRequest.add("\r\n");
+  telegramRequest.addPartHeader(MEDIA_BOUNDARY, "media");
+  telegramRequest.add("[");
+  for (int i = 0; i < count; i++) {
+    if (i) telegramRequest.add(",");
+    telegramRequest.add("{\"type\":\"photo\",\"media\":\"attach://photo");
+    telegramRequest.add((unsigned long)i);
+    telegramRequest.add("\"");
+    if (captions[i] && captions[i][0]) {
+      telegramRequest.add(",\"caption\":\"");
+      telegramRequest.addJsonEscaped(captions[i]);
+      telegramRequest.add("\"");
+    }
+    telegramRequest.add("}");
+  }
+  telegramRequest.add("]");
+
+  char part[128];
+  size_t extra = sizeof(MEDIA_TAIL) - 1;
+  for (int i = 0; i < count; i++) {
+    extra += photoPartHeader(part, sizeof(part), i) + sizes[i];
+  }
+  telegramRequest.finish(BOT_TOKEN, "sendMediaGroup", "multipart/form-data; boundary=" MEDIA_BOUNDARY, extra);
+
+  unsigned long start = millis();
+  if (!telegramConnect()) {
+    return false;
+  }
+  unsigned long connected = millis();
+
+  if (!telegramSendRequest()) {
+    secureClient.stop();
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    telegramWrite((const uint8_t*)part, photoPartHeader(part, sizeof(part), i));
+    telegramWrite(jpegs[i], sizes[i]);
+  }
+  telegramWrite((const uint8_t*)MEDIA_TAIL, sizeof(MEDIA_TAIL) - 1);
+
+  return telegramResponse(start, connected, timing);
+}
+//--------------------------------------------------------------------------------
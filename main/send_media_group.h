@@ -0,0 +1,29 @@
+/*
+ * Implementation for OV7670 Camera + HLK LD2420 Radar Sensor
+ * 
+ * This file contains the implementation of methods to capture images using the OV7670 camera,
+ * detect motion with the LD2420 radar sensor, and send alerts/images to Telegram automatically,
+ * mimicking a surveillance camera system.
+ * 
+ * Author: vuvvvv
+ * Repository/Reference: https://github.com/vuvvvv/Cam-Alert-CCTv
+ */
+
+
+#ifndef SEND_MEDIA_GROUP_H
+#define SEND_MEDIA_GROUP_H
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include "send_text.h"
+
+// Telegram accepts 2 to 10 photos per album
+const int MEDIA_GROUP_MIN = 2;
+const int MEDIA_GROUP_MAX = 10;
+
+// Sends the photos as one album in a single multipart request, captions has
+// one entry per photo (nullptr or empty for none). The parts are written
+// straight from the JPEG buffers, the body is never assembled in RAM.
+bool sendMediaGroupToTelegram(const char* const* captions, uint8_t* const* jpegs, const size_t* sizes, int count, UploadTiming* timing = nullptr);
+
+#endif
@@ -11,60 +11,49 @@
 
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
+#include "send_text.h"
+#include "Log.h"
 
 
 
 extern WiFiClientSecure secureClient;
 
-bool sendPhotoToTelegram(uint8_t* jpgData, size_t jpgSize) {
-  
-  bool success = false;
-  
-  secureClient.setCACert(TELEGRAM_CERTIFICATE_ROOT);
-  
-  if (!secureClient.connect("api.telegram.org", 443)) {
-    Serial.println("Failed to connect to Telegram API");
- 
-    secureClient.stop(); 
-    return false;
+#define PHOTO_BOUNDARY "----WebKitFormBoundary"
+static const char PHOTO_TAIL[] = "\r\n--" PHOTO_BOUNDARY "--\r\n";
+
+// caption, if given, is sent with the photo in the same request
+bool sendPhotoToTelegram(uint8_t* jpgData, size_t jpgSize, UploadTiming* timing = nullptr, const char* caption = nullptr) {
+
+  // the part headers go out with the request headers, the JPEG straight from its buffer
+  telegramRequest.clear();
+  telegramRequest.addPartHeader(PHOTO_BOUNDARY, "chat_id");
+  telegramRequest.add(CHAT_ID);
+  telegramRequest.add("\r\n");
+  if (caption && caption[0]) {
+    telegramRequest.addPartHeader(PHOTO_BOUNDARY, "caption");
+    telegramRequest.add(caption);
+    telegramRequest.add("\r\n");
   }
+  telegramRequest.addPartHeader(PHOTO_BOUNDARY, "photo", "photo.jpg", "image/jpeg");
+  telegramRequest.finish(BOT_TOKEN, "sendPhoto", "multipart/form-data; boundary=" PHOTO_BOUNDARY,
+                         jpgSize + sizeof(PHOTO_TAIL) - 1);
 
-  
-  String boundary = "----WebKitFormBoundary";
-  String head = "--" + boundary + "\r\n"
-              "Content-Disposition: form-data; name=\"chat_id\"\r\n\r\n" +
-              CHAT_ID + "\r\n--" + boundary + "\r\n" +
-              "Content-Disposition: form-data; name=\"photo\"; filename=\"photo.jpg\"\r\n" +
-              "Content-Type: image/jpeg\r\n\r\n";
-
-  String tail = "\r\n--" + boundary + "--\r\n";
-
-  secureClient.println("POST /bot" + String(BOT_TOKEN) + "/sendPhoto HTTP/1.1");
-  secureClient.println("Host: api.telegram.org");
-  secureClient.println("Content-Type: multipart/form-data; boundary=" + boundary);
-  secureClient.println("Content-Length: " + String(head.length() + jpgSize + tail.length()));
-  secureClient.println();
-  
-  secureClient.print(head);
-  secureClient.write(jpgData, jpgSize);
-  secureClient.print(tail);
-
-  
-  while (secureClient.connected()) {
-    String line = secureClient.readStringUntil('\n');
-    if (line == "\r") break;
+  unsigned long start = millis();
+  if (!telegramConnect()) {
+    return false;
   }
+  unsigned long connected = millis();
 
-  
-  String response = secureClient.readString();
-  Serial.println(" Telegram response:");
-  Serial.println(response);
-  
- 
-  success = response.indexOf("\"ok\":true") > 0;
-
-  
-  secureClient.stop();
+  if (!telegramSendRequest()) {
+    secureClient.stop();
+    return false;
+  }
+  telegramWrite(jpgData, jpgSize);
+  telegramWrite((const uint8_t*)PHOTO_TAIL, sizeof(PHOTO_TAIL) - 1);
 
+  bool success = telegramResponse(start, connected, timing);
+  if (success) {
+    LOGI("telegram", "Photo sent successfully!");
+  }
   return success;
 }
@@ -12,53 +12,123 @@
 
 
 #include "send_text.h"
+#include "EgressScheduler.h"
+#include "Log.h"
 
-// ----------------Sending text message to Telegram----------------
-bool sendTextToTelegram(String text) {
-    Serial.println("Sending text message to Telegram...");
-    
+RequestBuffer telegramRequest;
+
+static const unsigned long RESPONSE_TIMEOUT = 10000;
+
+// ----------------Telegram connection----------------
+bool telegramConnect() {
     secureClient.setCACert(TELEGRAM_CERTIFICATE_ROOT);
-    secureClient.setTimeout(10000);
-    
+    secureClient.setTimeout(RESPONSE_TIMEOUT);
+
     if (!secureClient.connect("api.telegram.org", 443)) {
-        Serial.println("Failed to connect to api.telegram.org");
+        LOGE("telegram", "Failed to connect to api.telegram.org");
+        secureClient.stop();
+        return false;
+    }
+    return true;
+}
+
+bool telegramSendRequest() {
+    if (telegramRequest.overflowed()) {
+        LOGE("telegram", "Telegram request does not fit the request buffer");
         return false;
     }
-    
-    Serial.println("Connected to Telegram successfully!");
-    
-    String url = "/bot" + String(BOT_TOKEN) + "/sendMessage";
-    String payload = "chat_id=" + String(CHAT_ID) + "&text=" + text;
-    
-    secureClient.println("POST " + url + " HTTP/1.1");
-    secureClient.println("Host: api.telegram.org");
-    secureClient.println("Content-Type: application/x-www-form-urlencoded");
-    secureClient.println("Content-Length: " + String(payload.length()));
-    secureClient.println("Connection: close");
-    secureClient.println();
-    secureClient.print(payload);
-    
-    Serial.println("Waiting for response...");
-    
-    bool success = false;
-    unsigned long timeout = millis();
-    while (secureClient.connected() && millis() - timeout < 10000) {
-        if (secureClient.available()) {
-            String line = secureClient.readStringUntil('\n');
-            if (line.indexOf("\"ok\":true") > 0) {
-                Serial.println("Message sent successfully!");
-                success = true;
-                break;
-            }
-            if (line.indexOf("\"ok\":false") > 0) {
-                Serial.println("Failed Negative response from Telegram");
-                break;
-            }
+    // one write, so the request line, the headers and the short body share a TLS record
+    return telegramWrite((const uint8_t*)telegramRequest.data(), telegramRequest.length()) == telegramRequest.length();
+}
+
+size_t telegramWrite(const uint8_t* data, size_t length) {
+    size_t written = secureClient.write(data, length);
+    egress.sent(EgressScheduler::ALERT, written, millis());
+    return written;
+}
+
+static int readResponseByte(unsigned long deadline) {
+    while (!secureClient.available()) {
+        if (!secureClient.connected() || (long)(millis() - deadline) >= 0) return -1;
+        delay(1);
+    }
+    return secureClient.read();
+}
+
+bool telegramResponse(unsigned long start, unsigned long connected, UploadTiming* timing) {
+    unsigned long deadline = millis() + RESPONSE_TIMEOUT;
+
+    // status code from "HTTP/1.1 200 OK", then the headers up to the empty line
+    int status = 0;
+    int spaces = 0;
+    int c;
+    while ((c = readResponseByte(deadline)) >= 0 && c != '\n') {
+        if (c == ' ') spaces++;
+        else if (spaces == 1 && c >= '0' && c <= '9') status = status * 10 + (c - '0');
+    }
+    int lineLength = 0;
+    while ((c = readResponseByte(deadline)) >= 0) {
+        if (c == '\n') {
+            if (lineLength == 0) break;
+            lineLength = 0;
+        } else if (c != '\r') {
+            lineLength++;
         }
     }
-    
+    // the body read below can run into the timeout, so the transfer ends with the headers
+    if (timing) {
+        timing->connectMs = connected - start;
+        timing->transferMs = millis() - connected;
+    }
+
+    // the only '"' in the pattern past the first is at index 3, so a mismatch
+    // on '"' restarts the match at 1
+    static const char OK[] = "\"ok\":true";
+    size_t matched = 0;
+    while (matched < sizeof(OK) - 1 && (c = readResponseByte(deadline)) >= 0) {
+        if (c == OK[matched]) matched++;
+        else matched = c == '"' ? 1 : 0;
+    }
+    bool success = status == 200 && matched == sizeof(OK) - 1;
+    if (!success) {
+        LOGE("telegram", "Negative response from Telegram (HTTP %d)", status);
+    }
+
     secureClient.stop();
     return success;
 }
 //--------------------------------------------------------------------------------
 
+// ----------------Sending text message to Telegram----------------
+bool sendTextToTelegram(const char* text) {
+    LOGD("telegram", "Sending text message to Telegram...");
+
+    telegramRequest.clear();
+    telegramRequest.add("chat_id=");
+    telegramRequest.addFormEncoded(CHAT_ID);
+    telegramRequest.add("&text=");
+    telegramRequest.addFormEncoded(text);
+    telegramRequest.finish(BOT_TOKEN, "sendMessage", "application/x-www-form-urlencoded");
+
+    unsigned long start = millis();
+    if (!telegramConnect()) {
+        return false;
+    }
+    unsigned long connected = millis();
+    LOGD("telegram", "Connected to Telegram successfully!");
+
+    if (!telegramSendRequest()) {
+        secureClient.stop();
+        return false;
+    }
+
+    LOGD("telegram", "Waiting for response...");
+    bool success = telegramResponse(start, connected);
+    if (success) {
+        LOGI("telegram", "Message sent successfully!");
+    }
+    return success;
+}
+//--------------------------------------------------------------------------------
+
+
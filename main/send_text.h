@@ -16,13 +16,32 @@
 
 #include <Arduino.h>
 #include <WiFiClientSecure.h>
+#include "RequestBuffer.h"
 
 extern const char* BOT_TOKEN;
 extern const char* CHAT_ID;
 extern const char* TELEGRAM_CERTIFICATE_ROOT;
 extern WiFiClientSecure secureClient;
 
-
-bool sendTextToTelegram(String text);
+// measured link times of one upload, for the rate controller
+struct UploadTiming {
+  unsigned long connectMs;    // TCP + TLS handshake
+  unsigned long transferMs;   // request sent until the response headers arrived
+};
+
+// the request buffer shared by all senders, they run one at a time from loop()
+extern RequestBuffer telegramRequest;
+
+// connects secureClient to api.telegram.org
+bool telegramConnect();
+// writes telegramRequest to secureClient in one piece
+bool telegramSendRequest();
+// writes to secureClient and books it as alert traffic with the egress scheduler
+size_t telegramWrite(const uint8_t* data, size_t length);
+// reads the answer to the request just sent without buffering it, true for a
+// 200 with "ok":true; start and connected are the millis() around the connect
+bool telegramResponse(unsigned long start, unsigned long connected, UploadTiming* timing = nullptr);
+
+bool sendTextToTelegram(const char* text);
 
 #endif
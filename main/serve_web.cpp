@@ -17,15 +17,141 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 #include "OV7670.h"
+#include "banded_capture.h"
+#include "LiveView.h"
+#include "EgressScheduler.h"
+#include "RecordingDownload.h"
+#include "HttpRequest.h"
+#include "Log.h"
 
 
+// ------------------------------------recordings------------------------------
+// GET /recordings lists the segments, /recordings/<n>.avi serves one with
+// single Range support so players can seek, /recordings/<n>.txt is its frame index;
+// the AVI goes out from serveDownload() at the bulk rate of the egress scheduler
+// and is cut off when an alert starts, the player resumes with a Range request
+static RecordingDownload download(egress);
+
+bool downloading() {
+  return download.active();
+}
+
+void serveDownload() {
+  download.service(millis());
+}
+
+// true when the client was handed to the download and stays open
+static bool serveRecordings(WiFiClient& client, const HttpRequest& request) {
+  unsigned long sequence = 0;
+  char extension[4] = "";
+  if (sscanf(request.requestLine.c_str(), "GET /recordings/%lu.%3s", &sequence, extension) != 2) {
+    RecordingHeader list[EventRecorder::MAX_SEGMENTS];
+    int count = recorder.list(list, EventRecorder::MAX_SEGMENTS);
+    client.println("HTTP/1.1 200 OK");
+    client.println("Content-type:text/html; charset=utf-8");
+    client.println("Connection: close");
+    client.println();
+    client.print("<!DOCTYPE html><html><head><meta charset='utf-8'><title>Recordings</title></head><body><pre>");
+    for (int i = 0; i < count; i++) {
+      time_t when = list[i].startTime;
+      struct tm timeinfo;
+      char started[24] = "time unavailable";
+      if (when >= 1600000000 && localtime_r(&when, &timeinfo)) strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S", &timeinfo);
+      client.printf("%s  %3lu frames  %4lu s  <a href='/recordings/%lu.avi'>%lu.avi</a>  <a href='/recordings/%lu.txt'>frames</a>\n",
+                    started, (unsigned long)list[i].frames, (unsigned long)(list[i].durationMs / 1000),
+                    (unsigned long)list[i].sequence, (unsigned long)list[i].sequence, (unsigned long)list[i].sequence);
+    }
+    if (!count) client.print("No recordings\n");
+    client.print("</pre></body></html>");
+    return false;
+  }
+
+  size_t length = 0;
+  File file;
+  if (!strcmp(extension, "avi")) file = recorder.openSegment(sequence, length);
+  if (!strcmp(extension, "txt")) {
+    client.println("HTTP/1.1 200 OK");
+    client.println("Content-type:text/plain; charset=utf-8");
+    client.println("Connection: close");
+    client.println();
+    if (!recorder.printIndex(sequence, client)) client.print("No such recording\n");
+    return false;
+  }
+  if (!file) {
+    client.println("HTTP/1.1 404 Not Found");
+    client.println("Content-type:text/plain");
+    client.println("Connection: close");
+    client.println();
+    client.print("404 Not Found");
+    return false;
+  }
+
+  size_t first, last;
+  HttpRequest::RangeResult range = request.byteRange(length, first, last);
+  if (range == HttpRequest::UNSATISFIABLE) {
+    client.println("HTTP/1.1 416 Range Not Satisfiable");
+    client.printf("Content-Range: bytes */%u\r\n", (unsigned)length);
+    client.println("Connection: close");
+    client.println();
+    file.close();
+    return false;
+  }
+  client.println(range == HttpRequest::PARTIAL ? "HTTP/1.1 206 Partial Content" : "HTTP/1.1 200 OK");
+  client.println("Content-Type: video/x-msvideo");
+  client.println("Accept-Ranges: bytes");
+  if (range == HttpRequest::PARTIAL) client.printf("Content-Range: bytes %u-%u/%u\r\n", (unsigned)first, (unsigned)last, (unsigned)length);
+  client.printf("Content-Length: %u\r\n", (unsigned)(last - first + 1));
+  client.println("Connection: close");
+  client.println();
+  file.seek(first);
+  download.begin(client, file, last - first + 1);
+  return true;
+}
+//--------------------------------------------------------------------------
+
+// ------------------------------------live view------------------------------
+// one viewer at a time; the connection stays open and gets a tile update every
+// LiveView::INTERVAL ms from serveLive(). The camera stays in the live mode
+// while someone watches and goes back to the idle mode once they leave
+static WiFiClient liveClient;
+static bool liveActive = false;
+static LiveView liveView;
+
+bool liveViewing() {
+  return liveActive;
+}
+
+void serveLive(OV7670::Mode liveMode, OV7670::Mode idleMode) {
+  static unsigned long lastUpdate = 0;
+  if (!liveActive) return;
+  if (!liveClient.connected()) {
+    LOGI("web", "Live view closed: %lu updates, %lu keyframes, %lu tiles, %lu bytes",
+         liveView.updates, liveView.keyframes, liveView.tilesSent, liveView.bytesSent);
+    liveClient.stop();
+    liveActive = false;
+    camera->setMode(idleMode);
+    return;
+  }
+  if (millis() - lastUpdate < LiveView::INTERVAL) return;
+  // over the bulk budget the update waits, the next one carries the changes
+  if (!egress.admit(EgressScheduler::BULK, millis())) return;
+  lastUpdate = millis();
+  wakeCamera();
+  if (camera->setMode(liveMode) && camera->oneFrame()) {
+    unsigned long sent = liveView.bytesSent;
+    if (!liveView.update(camera->frame, camera->xres, camera->yres, liveClient)) LOGW("web", "Live view update failed");
+    egress.sent(EgressScheduler::BULK, liveView.bytesSent - sent, millis());
+  }
+}
+//--------------------------------------------------------------------------
+
 void serve() {
   WiFiClient client = server.available();
   if (!client) return;
 
-  String currentLine = "";
-  String requestLine = "";
-  bool isRequestLineDone = false;
+  HttpRequest request;
+  const String& requestLine = request.requestLine;
+  bool keepOpen = false;
 
   unsigned long timeout = millis();
   while (client.connected() && (millis() - timeout) < 3000) {
@@ -33,188 +159,346 @@ void serve() {
       char c = client.read();
       timeout = millis();
 
-      if (!isRequestLineDone && c != '\r' && c != '\n') {
-        requestLine += c;
-      }
+      if (request.add(c)) {
+
+        // ---------------------------------------------------------web page-------------------------------------------------------------
+        if (requestLine.startsWith("GET / ") || requestLine.startsWith("GET /index")) {
+          client.println("HTTP/1.1 200 OK");
+          client.println("Content-type:text/html; charset=utf-8");
+          client.println("Connection: close");
+          client.println();
+          client.print(
+            "<!DOCTYPE html><html><head><meta charset='utf-8'><title>Cam-Alert-CCTV</title>"
+            "<meta name='viewport' content='width=device-width, initial-scale=1.0'>"
+            "<style>"
+            "*{margin:0;padding:0;box-sizing:border-box;}"
+            "body{font-family:'Segoe UI',Tahoma,Geneva,Verdana,sans-serif;background:linear-gradient(135deg,#0f0c29,#302b63,#24243e);min-height:100vh;color:#fff;}"
+            ".header{background:rgba(255,255,255,0.05);backdrop-filter:blur(10px);padding:25px;text-align:center;border-bottom:2px solid rgba(255,255,255,0.1);box-shadow:0 4px 30px rgba(0,0,0,0.3);}"
+            ".header h1{font-size:32px;font-weight:700;letter-spacing:2px;background:linear-gradient(45deg,#00f2fe,#4facfe);-webkit-background-clip:text;-webkit-text-fill-color:transparent;margin-bottom:8px;}"
+            ".header p{font-size:14px;color:rgba(255,255,255,0.7);letter-spacing:1px;}"
+            ".container{max-width:1200px;margin:30px auto;padding:0 20px;}"
+            ".controls{background:rgba(255,255,255,0.08);backdrop-filter:blur(15px);border-radius:20px;padding:25px;text-align:center;margin-bottom:25px;border:1px solid rgba(255,255,255,0.1);box-shadow:0 8px 32px rgba(0,0,0,0.3);}"
+            ".btn{padding:14px 32px;background:linear-gradient(135deg,#667eea 0%,#764ba2 100%);color:#fff;border:none;border-radius:50px;font-size:16px;font-weight:600;cursor:pointer;margin:10px;transition:all 0.3s ease;box-shadow:0 4px 15px rgba(102,126,234,0.4);text-transform:uppercase;letter-spacing:1px;}"
+            ".btn:hover{transform:translateY(-2px);box-shadow:0 6px 25px rgba(102,126,234,0.6);background:linear-gradient(135deg,#764ba2 0%,#667eea 100%);}"
+            ".btn:active{transform:translateY(0);}"
+            ".info{background:rgba(255,255,255,0.06);backdrop-filter:blur(10px);padding:15px;border-radius:15px;margin-bottom:20px;text-align:center;border:1px solid rgba(255,255,255,0.1);box-shadow:0 4px 20px rgba(0,0,0,0.2);}"
+            ".info b{color:#4facfe;font-weight:700;margin-left:8px;}"
+            ".stream-container{background:rgba(255,255,255,0.08);backdrop-filter:blur(15px);border-radius:20px;padding:20px;border:1px solid rgba(255,255,255,0.1);box-shadow:0 8px 32px rgba(0,0,0,0.3);overflow:hidden;}"
+            "#radar{display:block;width:100%;height:150px;}"
+            "#stream{display:block;margin:auto;width:100%;height:auto;image-rendering:pixelated;border-radius:12px;background:linear-gradient(135deg,#1e1e1e,#2d2d2d);box-shadow:0 10px 40px rgba(0,0,0,0.5);}"
+            "#status{background:linear-gradient(135deg,rgba(76,175,80,0.2),rgba(67,160,71,0.2));backdrop-filter:blur(10px);padding:12px;border-radius:12px;font-size:14px;font-weight:500;margin-top:20px;border:1px solid rgba(76,175,80,0.3);}"
+            "@keyframes pulse{0%,100%{opacity:1;}50%{opacity:0.7;}}"
+            ".loading{animation:pulse 1.5s ease-in-out infinite;}"
+            "@media(max-width:768px){"
+            ".header h1{font-size:24px;}"
+            ".btn{padding:12px 24px;font-size:14px;margin:5px;}"
+            ".container{padding:0 15px;margin:20px auto;}"
+            "}"
+            "</style></head><body>"
+            "<div class='header'>"
+            "<h1>🎥 CAM-ALERT-CCTV</h1>"
+            "<p>Security Camera Monitoring System</p>"
+            "</div>"
+            "<div class='container'>"
+            "<div class='controls'>"
+            "<button class='btn' onclick='location.reload()'> Updating stream</button>"
+            "</div>"
+            "<div class='info'>📡 Current stream IP: <b>"
+            + (streamHost.length() > 0 ? streamHost : "Not specified") + "</b></div>"
+                                                                         "<div class='stream-container'>"
+                                                                         "<canvas id='stream' width='160' height='120'></canvas>"
+                                                                         "</div>"
+                                                                         "<div class='info' id='status' class='loading'> Loading...</div>"
+                                                                         "<div class='stream-container'><canvas id='radar' width='600' height='150'></canvas></div>"
+                                                                         "<div class='info' id='radarText'> Radar: waiting...</div>"
+                                                                         "</div>"
+                                                                         "<script>"
+                                                                         "async function live() {"
+                                                                         "  const canvas = document.getElementById('stream');"
+                                                                         "  const ctx = canvas.getContext('2d');"
+                                                                         "  const status = document.getElementById('status');"
+                                                                         "  try {"
+                                                                         "    status.textContent = '📡 Connecting...';"
+                                                                         "    status.className = 'info loading';"
+                                                                         "    const response = await fetch('/live');"
+                                                                         "    if(!response.ok) throw new Error('Request failed:' + response.status);"
+                                                                         "    const reader = response.body.getReader();"
+                                                                         "    let buf = new Uint8Array(0);"
+                                                                         "    const need = async n => {"
+                                                                         "      while(buf.length < n) {"
+                                                                         "        const r = await reader.read();"
+                                                                         "        if(r.done) throw new Error('Stream closed');"
+                                                                         "        const b = new Uint8Array(buf.length + r.value.length);"
+                                                                         "        b.set(buf); b.set(r.value, buf.length); buf = b;"
+                                                                         "      }"
+                                                                         "    };"
+                                                                         "    const take = n => { const v = buf.slice(0, n); buf = buf.subarray(n); return v; };"
+                                                                         "    for(;;) {"
+                                                                         "      await need(10);"
+                                                                         "      const h = new DataView(take(10).buffer);"
+                                                                         "      const tiles = h.getUint8(3), w = h.getUint16(4, true), ht = h.getUint16(6, true), n = h.getUint16(8, true);"
+                                                                         "      if(canvas.width != w || canvas.height != ht) { canvas.width = w; canvas.height = ht; }"
+                                                                         "      await need(n * 2 + 4);"
+                                                                         "      const pos = take(n * 2);"
+                                                                         "      const len = new DataView(take(4).buffer).getUint32(0, true);"
+                                                                         "      await need(len);"
+                                                                         "      const img = await createImageBitmap(new Blob([take(len)], {type: 'image/jpeg'}));"
+                                                                         "      for(let i = 0; i < n; i++)"
+                                                                         "        ctx.drawImage(img, (i % tiles) * 16, Math.floor(i / tiles) * 16, 16, 16, pos[2 * i] * 16, pos[2 * i + 1] * 16, 16, 16);"
+                                                                         "      img.close();"
+                                                                         "      status.textContent = ' Last update: ' + new Date().toLocaleTimeString('ar-SA') + ' (' + n + ' tiles)';"
+                                                                         "      status.className = 'info';"
+                                                                         "    }"
+                                                                         "  } catch(e) {"
+                                                                         "    status.textContent = ' Error: ' + e.message;"
+                                                                         "    status.className = 'info';"
+                                                                         "    setTimeout(live, 2000);"
+                                                                         "  }"
+                                                                         "}"
+                                                                         "live();"
+                                                                         "const samples = [];"
+                                                                         "function telemetry() {"
+                                                                         "  const ws = new WebSocket('ws://' + location.host + '/telemetry');"
+                                                                         "  ws.binaryType = 'arraybuffer';"
+                                                                         "  ws.onmessage = m => {"
+                                                                         "    const d = new DataView(m.data);"
+                                                                         "    for(let o = 4; o + 8 <= d.byteLength; o += 8)"
+                                                                         "      samples.push({ms: d.getUint32(o, true), cm: d.getInt16(o + 4, true), flags: d.getUint8(o + 6), people: d.getUint8(o + 7)});"
+                                                                         "    const last = samples[samples.length - 1];"
+                                                                         "    while(samples.length && last.ms - samples[0].ms > 30000) samples.shift();"
+                                                                         "    document.getElementById('radarText').textContent = ' Radar: ' + (last.flags & 1 ? 'presence at ' + last.cm + ' cm' : 'clear') +"
+                                                                         "      ' | people ' + last.people + ' | ' + (last.flags & 2 ? 'locked' : 'open') + (last.flags & 4 ? ' | camera parked' : '') +"
+                                                                         "      (last.flags & 8 ? ' | recording' : '') + ' | dropped ' + d.getUint32(0, true);"
+                                                                         "  };"
+                                                                         "  ws.onclose = () => setTimeout(telemetry, 2000);"
+                                                                         "}"
+                                                                         "function plot() {"
+                                                                         "  const c = document.getElementById('radar'), g = c.getContext('2d');"
+                                                                         "  g.clearRect(0, 0, c.width, c.height);"
+                                                                         "  if(samples.length) {"
+                                                                         "    const end = samples[samples.length - 1].ms, x = ms => c.width - (end - ms) * c.width / 30000, y = cm => c.height - cm * c.height / 800;"
+                                                                         "    for(const s of samples) if(s.flags & 2) { g.fillStyle = 'rgba(255,82,82,0.15)'; g.fillRect(x(s.ms), 0, 3, c.height); }"
+                                                                         "    g.strokeStyle = '#4facfe'; g.beginPath();"
+                                                                         "    samples.forEach((s, i) => { const cm = s.flags & 1 ? s.cm : 0; i ? g.lineTo(x(s.ms), y(cm)) : g.moveTo(x(s.ms), y(cm)); });"
+                                                                         "    g.stroke();"
+                                                                         "  }"
+                                                                         "  requestAnimationFrame(plot);"
+                                                                         "}"
+                                                                         "telemetry();"
+                                                                         "plot();"
+                                                                         "</script></body></html>");
+          break;
+        }
+        //--------------------------------------------------------------------------------------------------------------------------------------------------------
 
-      if (c == '\n') {
-        if (currentLine.length() == 0) {
+        // ------------------------------------live view------------------------------
+        if (requestLine.startsWith("GET /live")) {
+          if (liveActive) liveClient.stop();
+          client.println("HTTP/1.1 200 OK");
+          client.println("Content-Type: application/octet-stream");
+          client.println("Cache-Control: no-store");
+          client.println("Connection: close");
+          client.println();
+          liveClient = client;
+          liveActive = true;
+          liveView.reset();
+          keepOpen = true;
+          break;
+        }
+        //--------------------------------------------------------------------------
 
-          // ---------------------------------------------------------web page-------------------------------------------------------------
-          if (requestLine.startsWith("GET / ") || requestLine.startsWith("GET /index")) {
-            client.println("HTTP/1.1 200 OK");
-            client.println("Content-type:text/html; charset=utf-8");
+        // ------------------------------------telemetry------------------------------
+        if (requestLine.startsWith("GET /telemetry")) {
+          if (request.webSocketKey.length() == 0 || request.webSocketKey.length() > 64) {
+            client.println("HTTP/1.1 400 Bad Request");
             client.println("Connection: close");
             client.println();
-            client.print(
-              "<!DOCTYPE html><html><head><meta charset='utf-8'><title>Cam-Alert-CCTV</title>"
-              "<meta name='viewport' content='width=device-width, initial-scale=1.0'>"
-              "<style>"
-              "*{margin:0;padding:0;box-sizing:border-box;}"
-              "body{font-family:'Segoe UI',Tahoma,Geneva,Verdana,sans-serif;background:linear-gradient(135deg,#0f0c29,#302b63,#24243e);min-height:100vh;color:#fff;}"
-              ".header{background:rgba(255,255,255,0.05);backdrop-filter:blur(10px);padding:25px;text-align:center;border-bottom:2px solid rgba(255,255,255,0.1);box-shadow:0 4px 30px rgba(0,0,0,0.3);}"
-              ".header h1{font-size:32px;font-weight:700;letter-spacing:2px;background:linear-gradient(45deg,#00f2fe,#4facfe);-webkit-background-clip:text;-webkit-text-fill-color:transparent;margin-bottom:8px;}"
-              ".header p{font-size:14px;color:rgba(255,255,255,0.7);letter-spacing:1px;}"
-              ".container{max-width:1200px;margin:30px auto;padding:0 20px;}"
-              ".controls{background:rgba(255,255,255,0.08);backdrop-filter:blur(15px);border-radius:20px;padding:25px;text-align:center;margin-bottom:25px;border:1px solid rgba(255,255,255,0.1);box-shadow:0 8px 32px rgba(0,0,0,0.3);}"
-              ".btn{padding:14px 32px;background:linear-gradient(135deg,#667eea 0%,#764ba2 100%);color:#fff;border:none;border-radius:50px;font-size:16px;font-weight:600;cursor:pointer;margin:10px;transition:all 0.3s ease;box-shadow:0 4px 15px rgba(102,126,234,0.4);text-transform:uppercase;letter-spacing:1px;}"
-              ".btn:hover{transform:translateY(-2px);box-shadow:0 6px 25px rgba(102,126,234,0.6);background:linear-gradient(135deg,#764ba2 0%,#667eea 100%);}"
-              ".btn:active{transform:translateY(0);}"
-              ".info{background:rgba(255,255,255,0.06);backdrop-filter:blur(10px);padding:15px;border-radius:15px;margin-bottom:20px;text-align:center;border:1px solid rgba(255,255,255,0.1);box-shadow:0 4px 20px rgba(0,0,0,0.2);}"
-              ".info b{color:#4facfe;font-weight:700;margin-left:8px;}"
-              ".stream-container{background:rgba(255,255,255,0.08);backdrop-filter:blur(15px);border-radius:20px;padding:20px;border:1px solid rgba(255,255,255,0.1);box-shadow:0 8px 32px rgba(0,0,0,0.3);overflow:hidden;}"
-              "img{display:block;margin:auto;width:100%;height:auto;border-radius:12px;background:linear-gradient(135deg,#1e1e1e,#2d2d2d);box-shadow:0 10px 40px rgba(0,0,0,0.5);}"
-              "#status{background:linear-gradient(135deg,rgba(76,175,80,0.2),rgba(67,160,71,0.2));backdrop-filter:blur(10px);padding:12px;border-radius:12px;font-size:14px;font-weight:500;margin-top:20px;border:1px solid rgba(76,175,80,0.3);}"
-              "@keyframes pulse{0%,100%{opacity:1;}50%{opacity:0.7;}}"
-              ".loading{animation:pulse 1.5s ease-in-out infinite;}"
-              "@media(max-width:768px){"
-              ".header h1{font-size:24px;}"
-              ".btn{padding:12px 24px;font-size:14px;margin:5px;}"
-              ".container{padding:0 15px;margin:20px auto;}"
-              "}"
-              "</style></head><body>"
-              "<div class='header'>"
-              "<h1>🎥 CAM-ALERT-CCTV</h1>"
-              "<p>Security Camera Monitoring System</p>"
-              "</div>"
-              "<div class='container'>"
-              "<div class='controls'>"
-              "<button class='btn' onclick='location.reload()'> Updating stream</button>"
-              "</div>"
-              "<div class='info'>📡 Current stream IP: <b>"
-              + (streamHost.length() > 0 ? streamHost : "Not specified") + "</b></div>"
-                                                                           "<div class='stream-container'>"
-                                                                           "<img id='stream'>"
-                                                                           "</div>"
-                                                                           "<div class='info' id='status' class='loading'> Loading...</div>"
-                                                                           "</div>"
-                                                                           "<script>"
-                                                                           "let isRunning = true;"
-                                                                           "async function updateStream() {"
-                                                                           "  if(!isRunning) return;"
-                                                                           "  try {"
-                                                                           "    const status = document.getElementById('status');"
-                                                                           "    status.textContent = '📡 Fetching image...';"
-                                                                           "    status.className = 'info loading';"
-                                                                           "    const response = await fetch('/camera?' + Date.now());"
-                                                                           "    if(!response.ok) throw new Error('Request failed:' + response.status);"
-                                                                           "    const blob = await response.blob();"
-                                                                           "    const url = URL.createObjectURL(blob);"
-                                                                           "    const img = document.getElementById('stream');"
-                                                                           "    const oldUrl = img.src;"
-                                                                           "    img.src = url;"
-                                                                           "    if(oldUrl && oldUrl.startsWith('blob:')) URL.revokeObjectURL(oldUrl);"
-                                                                           "    status.textContent = ' Last update: ' + new Date().toLocaleTimeString('ar-SA');"
-                                                                           "    status.className = 'info';"
-                                                                           "    setTimeout(updateStream, 200);"
-                                                                           "  } catch(e) {"
-                                                                           "    document.getElementById('status').textContent = ' Error: ' + e.message;"
-                                                                           "    document.getElementById('status').className = 'info';"
-                                                                           "    setTimeout(updateStream, 2000);"
-                                                                           "  }"
-                                                                           "}"
-                                                                           "updateStream();"
-                                                                           "</script></body></html>");
             break;
           }
-          //--------------------------------------------------------------------------------------------------------------------------------------------------------
-
-          // ------------------------------------streamHost------------------------------
-          if (requestLine.startsWith("GET /setstream?")) {
-            int idx = requestLine.indexOf("host=");
-            String hostVal = "";
-            if (idx >= 0) {
-              int start = idx + 5;
-              int end = requestLine.indexOf('&', start);
-              if (end < 0) end = requestLine.indexOf(' ', start);
-              if (end < 0) end = requestLine.length();
-              hostVal = requestLine.substring(start, end);
-              hostVal.replace("%20", " ");
-              hostVal.replace("%3A", ":");
-              hostVal.replace("%2F", "/");
-            }
-
-            client.println("HTTP/1.1 200 OK");
-            client.println("Content-type:text/plain; charset=utf-8");
+          if (telemetry.clients() >= TelemetryChannel::MAX_CLIENTS) {
+            client.println("HTTP/1.1 503 Service Unavailable");
             client.println("Connection: close");
             client.println();
-
-            if (hostVal.length() > 0) {
-              prefs.putString("streamHost", hostVal);
-              streamHost = hostVal;
-              client.printf("streamHost set successfully = %s\n", streamHost.c_str());
-              Serial.printf("streamHost has been set -> %s\n", streamHost.c_str());
-            } else {
-              client.print("No host value provided\n");
-            }
             break;
           }
-          //--------------------------------------------------------------------------
+          char accept[29];
+          TelemetryChannel::acceptKey(request.webSocketKey.c_str(), accept);
+          client.println("HTTP/1.1 101 Switching Protocols");
+          client.println("Upgrade: websocket");
+          client.println("Connection: Upgrade");
+          client.printf("Sec-WebSocket-Accept: %s\r\n", accept);
+          client.println();
+          keepOpen = telemetry.add(client);
+          break;
+        }
+        //--------------------------------------------------------------------------
+
+        // ------------------------------------boot timing------------------------------
+        if (requestLine.startsWith("GET /boot")) {
+          client.println("HTTP/1.1 200 OK");
+          client.println("Content-type:text/plain; charset=utf-8");
+          client.println("Connection: close");
+          client.println();
+          // ms after reset, 0 while still pending
+          client.printf("armed_ms=%lu\nonline_ms=%lu\nuptime_ms=%lu\n", boot.armedMs, boot.onlineMs, millis());
+          break;
+        }
+        //--------------------------------------------------------------------------
+
+        // ------------------------------------log------------------------------------
+        // the newest lines the log task has written out, the records still in
+        // its ring are not formatted yet
+        if (requestLine.startsWith("GET /log")) {
+          client.println("HTTP/1.1 200 OK");
+          client.println("Content-type:text/plain; charset=utf-8");
+          client.println("Cache-Control: no-store");
+          client.println("Connection: close");
+          client.println();
+          logger.printHistory(client);
+          client.printf("-- %lu records, %lu dropped\n", logger.records, logger.dropped);
+          break;
+        }
+        //--------------------------------------------------------------------------
+
+        if (requestLine.startsWith("GET /recordings")) {
+          keepOpen = serveRecordings(client, request);
+          break;
+        }
+
+        // ------------------------------------clock calibration------------------------------
+        if (requestLine.startsWith("GET /calibrate")) {
+          client.println("HTTP/1.1 200 OK");
+          client.println("Content-type:text/plain; charset=utf-8");
+          client.println("Connection: close");
+          client.println();
+          // rows as they are measured, takes up to a few minutes; refused while armed
+          calibrateCamera(client);
+          break;
+        }
+        //--------------------------------------------------------------------------
+
+        // ------------------------------------streamHost------------------------------
+        if (requestLine.startsWith("GET /setstream?")) {
+          int idx = requestLine.indexOf("host=");
+          String hostVal = "";
+          if (idx >= 0) {
+            int start = idx + 5;
+            int end = requestLine.indexOf('&', start);
+            if (end < 0) end = requestLine.indexOf(' ', start);
+            if (end < 0) end = requestLine.length();
+            hostVal = requestLine.substring(start, end);
+            hostVal.replace("%20", " ");
+            hostVal.replace("%3A", ":");
+            hostVal.replace("%2F", "/");
+          }
+
+          client.println("HTTP/1.1 200 OK");
+          client.println("Content-type:text/plain; charset=utf-8");
+          client.println("Connection: close");
+          client.println();
+
+          if (hostVal.length() > 0) {
+            prefs.putString("streamHost", hostVal);
+            streamHost = hostVal;
+            client.printf("streamHost set successfully = %s\n", streamHost.c_str());
+            LOGI("web", "streamHost has been set -> %s", streamHost.c_str());
+          } else {
+            client.print("No host value provided\n");
+          }
+          break;
+        }
+        //--------------------------------------------------------------------------
 
-          // ----------------------------Streaming image------------------------------
-          if (requestLine.startsWith("GET /camera")) {
-            uint8_t* buffer = nullptr;
-            size_t size = 0;
-            bool fromStream = false;
+        // ----------------------------Streaming image------------------------------
+        if (requestLine.startsWith("GET /camera")) {
+          if (!egress.admit(EgressScheduler::BULK, millis())) {
+            client.println("HTTP/1.1 503 Service Unavailable");
+            client.println("Retry-After: 1");
+            client.println("Content-type:text/plain");
+            client.println("Connection: close");
+            client.println();
+            client.print("Link busy");
+            break;
+          }
+          wakeCamera();
+          uint8_t* buffer = nullptr;
+          size_t size = 0;
+          bool fromStream = false;
 
-            if (streamHost.length() > 0) {
+          if (streamHost.length() > 0) {
 
-              IPAddress myIP = WiFi.localIP();
-              String myIPStr = myIP.toString();
+            IPAddress myIP = WiFi.localIP();
+            String myIPStr = myIP.toString();
 
-              if (streamHost != myIPStr && streamHost != "localhost" && streamHost != "127.0.0.1") {
+            if (streamHost != myIPStr && streamHost != "localhost" && streamHost != "127.0.0.1") {
 
-              } else {
-              }
+            } else {
             }
+          }
 
-            if (fromStream && buffer != nullptr && size > 0) {
+          if (fromStream && buffer != nullptr && size > 0) {
+            client.println("HTTP/1.1 200 OK");
+            client.println("Content-Type: image/jpeg");
+            client.printf("Content-Length: %u\r\n", size);
+            client.println("Connection: close");
+            client.println();
+            client.write(buffer, size);
+            bufferPool.give(buffer);
+          } else if (camera->pixelFormat != I2SCamera::PIXEL_RGB565) {
+            // BMP only carries RGB565, other modes are sent as JPEG
+            uint8_t* jpegData = nullptr;
+            size_t jpegSize = 0;
+            if (captureBandedJPEG(camera, 80, &jpegData, &jpegSize)) {
               client.println("HTTP/1.1 200 OK");
               client.println("Content-Type: image/jpeg");
-              client.printf("Content-Length: %u\r\n", size);
+              client.printf("Content-Length: %u\r\n", jpegSize);
               client.println("Connection: close");
               client.println();
-              client.write(buffer, size);
-              delete[] buffer;
+              client.write(jpegData, jpegSize);
+              egress.sent(EgressScheduler::BULK, jpegSize, millis());
+              bufferPool.give(jpegData);
             } else {
-
-              camera->oneFrame();
-
-              client.println("HTTP/1.1 200 OK");
-              client.println("Content-Type: image/bmp");
-              client.printf("Content-Length: %u\r\n", BMP::headerSize + (camera->xres * camera->yres * 2));
+              client.println("HTTP/1.1 503 Service Unavailable");
+              client.println("Content-type:text/plain");
               client.println("Connection: close");
               client.println();
-              client.write(bmpHeader, BMP::headerSize);
-              client.write(camera->frame, camera->xres * camera->yres * 2);
+              client.print("Camera timeout");
             }
-            break;
-          }
-          //---------------------------------------------------------------------------------------------------
-
-
+          } else if (!camera->oneFrame()) {
+            client.println("HTTP/1.1 503 Service Unavailable");
+            client.println("Content-type:text/plain");
+            client.println("Connection: close");
+            client.println();
+            client.print("Camera timeout");
+          } else {
 
-          // ------------------Unknown request---------------------------------
-          client.println("HTTP/1.1 404 Not Found");
-          client.println("Content-type:text/plain");
-          client.println("Connection: close");
-          client.println();
-          client.print("404 Not Found");
+            BMP::construct16BitHeader(bmpHeader, camera->xres, camera->yres);
+            client.println("HTTP/1.1 200 OK");
+            client.println("Content-Type: image/bmp");
+            client.printf("Content-Length: %u\r\n", BMP::headerSize + (camera->xres * camera->yres * 2));
+            client.println("Connection: close");
+            client.println();
+            client.write(bmpHeader, BMP::headerSize);
+            client.write(camera->frame, camera->xres * camera->yres * 2);
+            egress.sent(EgressScheduler::BULK, BMP::headerSize + camera->xres * camera->yres * 2, millis());
+          }
           break;
-
-        } else {
-          currentLine = "";
         }
+        //---------------------------------------------------------------------------------------------------
 
-        if (!isRequestLineDone && requestLine.length() > 0) {
-          isRequestLineDone = true;
-        }
-      } else if (c != '\r') {
-        currentLine += c;
+
+
+        // ------------------Unknown request---------------------------------
+        client.println("HTTP/1.1 404 Not Found");
+        client.println("Content-type:text/plain");
+        client.println("Connection: close");
+        client.println();
+        client.print("404 Not Found");
+        break;
       }
     }
   }
 
-  client.stop();
+  if (!keepOpen) client.stop();
 }
 //--------------------------------------------------------------------------
\ No newline at end of file
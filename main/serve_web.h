@@ -13,6 +13,9 @@
 #include <WiFi.h>
 #include <Preferences.h>
 #include "OV7670.h"
+#include "EventRecorder.h"
+#include "TelemetryChannel.h"
+#include "BootSequence.h"
 
 
 
@@ -22,7 +25,24 @@ extern Preferences prefs;
 extern OV7670* camera;
 extern unsigned char bmpHeader[];
 extern String streamHost;
+extern BootSequence boot;
+extern EventRecorder recorder;
+extern TelemetryChannel telemetry;
+// unparks the camera if the power scheduler had parked it
+bool wakeCamera();
+// steps the sensor clock of the used modes and prints fps and errors per step,
+// false with the reason printed while alerts are armed, an alert is running or
+// the camera is not up yet
+bool calibrateCamera(Print& out);
 
 
 
 void serve(); 
+// true while a viewer has /live open
+bool liveViewing();
+// sends the next tile update to the live viewer, captured in liveMode
+void serveLive(OV7670::Mode liveMode, OV7670::Mode idleMode);
+// true while a recording is being downloaded
+bool downloading();
+// sends the next chunks of the running recording download
+void serveDownload();